@@ -0,0 +1,274 @@
+"""
+@compiler python
+@project FREEDM Deployment
+@description Runs a cluster of PosixBrokers on the loopback interface of one
+    machine for a fixed duration and reports the counters each broker wrote
+    when it shut down. This replaces the Supercluster fabfile for performance
+    regression runs which do not need real hardware.
+@license These source code files were created at as part of the
+    FREEDM DGI Subthrust, and are intended for use in teaching or
+    research.  They may be freely copied, modified and redistributed
+    as long as modified versions are clearly marked as such and
+    this notice is not removed.
+
+    Neither the authors nor the FREEDM Project nor the
+    National Science Foundation
+    make any warranty, express or implied, nor assumes
+    any legal responsibility for the accuracy,
+    completeness or usefulness of these codes or any
+    information distributed with these codes.
+
+    Suggested modifications or questions about these codes
+    can be directed to Dr. Bruce McMillin, Department of
+    Computer Science, Missouri University of Science and
+    Technology, Rolla, MO  65409 (ff@mst.edu).
+"""
+from __future__ import print_function
+
+import optparse
+import os
+import shutil
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+ADDRESS = '127.0.0.1'
+DEFAULT_DEVICES = 'sst:Sst,gendev0:Drer,stodev0:Desd,loaddev0:Load'
+STATS_FILE = 'stats.txt'
+EVENT_FILE = 'events.bin'
+
+# The counters summarized in the report, as (column, counter) pairs.
+COLUMNS = [
+    ('sent', 'net.messages.sent'),
+    ('received', 'net.messages.received'),
+    ('dgrams out', 'net.datagrams.sent'),
+    ('dgrams in', 'net.datagrams.received'),
+    ('resent', 'net.datagrams.resent'),
+    ('dropped', 'net.emulator.dropped'),
+    ('groups', 'gm.group.changes'),
+    ('gm over', 'scheduler.gm.overruns'),
+    ('sc over', 'scheduler.sc.overruns'),
+    ('lb over', 'scheduler.lb.overruns'),
+]
+
+class Node(object):
+    """
+    One broker of the cluster, with its own working directory.
+    """
+    def __init__(self,broker,root,index,port):
+        """
+        Creates the working directory of the node.
+
+        @param broker The path of the PosixBroker executable
+        @param root The directory which holds every node's directory
+        @param index The number of the node in the cluster
+        @param port The port the node listens on
+        """
+        self.broker = broker
+        self.index = index
+        self.port = port
+        self.path = os.path.join(root,'node%d' % index)
+        self.process = None
+        self.log = None
+        os.makedirs(os.path.join(self.path,'config'))
+
+    def configure(self,ports,devices,verbose,threads,network,events):
+        """
+        Writes the node's freedm.cfg and an empty logger.cfg. The UUID is
+        generated from the loopback address rather than the hostname so that
+        it matches the UUID every peer computes from its add-host entry.
+
+        @param ports The ports of every node in the cluster
+        @param devices A list of name:type device pairs
+        @param verbose The global verbosity of the broker
+        @param threads The number of threads which run the broker
+        @param network The network emulation settings file, or None
+        @param events True to record binary events to events.bin
+        """
+        config = os.path.join(self.path,'config','freedm.cfg')
+        with open(config,'w') as cfg:
+            cfg.write('address=%s\n' % ADDRESS)
+            cfg.write('port=%d\n' % self.port)
+            for port in ports:
+                if port != self.port:
+                    cfg.write('add-host=%s:%d\n' % (ADDRESS,port))
+            for device in devices:
+                cfg.write('add-device=%s\n' % device)
+            cfg.write('verbose=%d\n' % verbose)
+            cfg.write('threads=%d\n' % threads)
+            cfg.write('stats-file=%s\n' % STATS_FILE)
+            if network:
+                cfg.write('network-config=%s\n' % network)
+            if events:
+                cfg.write('event-log=%s\n' % EVENT_FILE)
+        open(os.path.join(self.path,'config','logger.cfg'),'w').close()
+        uuid = subprocess.check_output([self.broker,'-g',ADDRESS],
+            cwd=self.path).decode().strip()
+        with open(config,'a') as cfg:
+            cfg.write('setuuid=%s\n' % uuid)
+
+    def start(self):
+        """
+        Launches the broker with its output sent to broker.log.
+        """
+        self.log = open(os.path.join(self.path,'broker.log'),'w')
+        self.process = subprocess.Popen([self.broker],cwd=self.path,
+            stdout=self.log,stderr=subprocess.STDOUT)
+
+    def stop(self,timeout):
+        """
+        Interrupts the broker and waits for it to write its counters.
+
+        @param timeout Seconds to wait before the broker is killed
+        @return The exit code of the broker, or None if it was killed
+        """
+        if self.process.poll() is None:
+            self.process.send_signal(signal.SIGINT)
+        deadline = time.time() + timeout
+        while self.process.poll() is None and time.time() < deadline:
+            time.sleep(0.1)
+        code = self.process.poll()
+        if code is None:
+            self.process.kill()
+            self.process.wait()
+        self.log.close()
+        return code
+
+    def counters(self):
+        """
+        Reads the counters the broker wrote when it shut down.
+
+        @return A dictionary from counter name to value
+        """
+        result = dict()
+        try:
+            with open(os.path.join(self.path,STATS_FILE)) as stats:
+                for line in stats:
+                    fields = line.split()
+                    if len(fields) == 2:
+                        # histogram means are the only fractional values
+                        if '.' in fields[1]:
+                            result[fields[0]] = float(fields[1])
+                        else:
+                            result[fields[0]] = int(fields[1])
+        except IOError:
+            pass
+        return result
+
+def report(nodes,counters,out):
+    """
+    Prints one row of counters per node followed by the cluster totals.
+
+    @param nodes The nodes of the cluster
+    @param counters The counters of each node, in the same order
+    @param out The stream to write to
+    """
+    width = max(10,max(len(c[0]) for c in COLUMNS) + 1)
+    out.write('%-8s' % 'node' + ''.join('%*s' % (width,c[0]) for c in COLUMNS))
+    out.write('\n')
+    totals = [0] * len(COLUMNS)
+    for node,values in zip(nodes,counters):
+        row = []
+        for i,column in enumerate(COLUMNS):
+            value = values.get(column[1],0)
+            totals[i] += value
+            row.append('%*d' % (width,value))
+        out.write('%-8s' % node.port + ''.join(row) + '\n')
+    out.write('%-8s' % 'total' + ''.join('%*d' % (width,t) for t in totals))
+    out.write('\n')
+
+def write_csv(filename,nodes,counters):
+    """
+    Writes every counter of every node as a CSV file with one row per node.
+
+    @param filename The file to write
+    @param nodes The nodes of the cluster
+    @param counters The counters of each node, in the same order
+    """
+    names = sorted(set(name for values in counters for name in values))
+    with open(filename,'w') as csv:
+        csv.write(','.join(['port'] + names) + '\n')
+        for node,values in zip(nodes,counters):
+            row = [str(node.port)] + [str(values.get(n,0)) for n in names]
+            csv.write(','.join(row) + '\n')
+
+def main():
+    parser = optparse.OptionParser(
+        usage='%prog [options]',
+        description='Runs PosixBrokers on %s and reports their counters.'
+            % ADDRESS)
+    parser.add_option('-n','--nodes',type='int',default=4,
+        help='number of brokers to run [%default]')
+    parser.add_option('-t','--duration',type='float',default=30,
+        help='seconds to run the cluster for [%default]')
+    parser.add_option('-b','--broker',default='./PosixBroker',
+        help='path of the PosixBroker executable [%default]')
+    parser.add_option('-p','--port',type='int',default=51870,
+        help='port of the first broker [%default]')
+    parser.add_option('-d','--devices',default=DEFAULT_DEVICES,
+        help='comma separated name:type devices of each broker [%default]')
+    parser.add_option('-o','--output',default=None,
+        help='directory for the node directories (kept after the run)')
+    parser.add_option('-v','--verbose',type='int',default=3,
+        help='verbosity of the brokers [%default]')
+    parser.add_option('--threads',type='int',default=1,
+        help='threads per broker [%default]')
+    parser.add_option('-e','--network',default=None,
+        help='network emulation settings shared by every broker')
+    parser.add_option('--events',action='store_true',default=False,
+        help='record each broker\'s binary events to %s' % EVENT_FILE)
+    parser.add_option('--csv',default=None,
+        help='also write every counter of every node to this file')
+    parser.add_option('--stop-timeout',type='float',default=10,
+        help='seconds to wait for a broker to exit [%default]')
+    (options,args) = parser.parse_args()
+
+    broker = os.path.abspath(options.broker)
+    if not os.access(broker,os.X_OK):
+        parser.error('%s is not executable' % broker)
+    if options.output:
+        root = os.path.abspath(options.output)
+        if os.path.exists(root):
+            parser.error('%s already exists' % root)
+        os.makedirs(root)
+    else:
+        root = tempfile.mkdtemp(prefix='freedm-cluster-')
+
+    network = None
+    if options.network:
+        network = os.path.abspath(options.network)
+    ports = [options.port + i for i in range(options.nodes)]
+    devices = [d for d in options.devices.split(',') if d]
+    nodes = [Node(broker,root,i,port) for i,port in enumerate(ports)]
+    failed = False
+    try:
+        for node in nodes:
+            node.configure(ports,devices,options.verbose,options.threads,
+                network,options.events)
+        for node in nodes:
+            node.start()
+        print('Running %d brokers for %g seconds in %s'
+            % (len(nodes),options.duration,root))
+        time.sleep(options.duration)
+    finally:
+        for node in nodes:
+            if node.process is not None:
+                code = node.stop(options.stop_timeout)
+                if code != 0:
+                    failed = True
+                    print('Broker on port %d exited with %s'
+                        % (node.port,'SIGKILL' if code is None else code),
+                        file=sys.stderr)
+
+    counters = [node.counters() for node in nodes]
+    report(nodes,counters,sys.stdout)
+    if options.csv:
+        write_csv(options.csv,nodes,counters)
+    if not options.output and not failed:
+        shutil.rmtree(root)
+    return 1 if failed else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -44,14 +44,21 @@
 
 #include "CListener.hpp"
 #include "CConnectionManager.hpp"
+#include "CReadyQueue.hpp"
+#include "CHistogram.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/asio/deadline_timer.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <string>
 #include <boost/noncopyable.hpp>
 #include <boost/function.hpp>
-#include <list>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <map>
+#include <iosfwd>
 
 namespace freedm {
     namespace broker {
@@ -61,6 +68,18 @@ class CDispatcher;
 /// How long we should wait before aligning the modules again
 const unsigned int ALIGNMENT_DURATION = 2000;
 
+/// How many tasks each module's ready ring holds before overflowing
+const unsigned int READY_QUEUE_SIZE = 1024;
+
+/// How long (in ms) the worker may run tasks before yielding by default
+const unsigned int BATCH_BUDGET = 10;
+
+/// Timers which expire within this many ms of each other fire together
+const unsigned int TIMER_TOLERANCE = 1;
+
+/// The default time (in ms) a phase runs before an idle module gives it away
+const unsigned int MINIMUM_PHASE = 50;
+
 /// Central monolith of the Broker Architecture.
 class CBroker : private boost::noncopyable
 {
@@ -68,13 +87,47 @@ public:
     typedef boost::function<void (boost::system::error_code)> Scheduleable;
     typedef boost::function<void ()> BoundScheduleable;
     typedef std::string ModuleIdent;
+    typedef unsigned int ModuleID;
     typedef std::pair<ModuleIdent, boost::posix_time::time_duration> PhaseTuple;
     typedef std::vector< PhaseTuple > ModuleVector;
     typedef unsigned int PhaseMarker;
     typedef unsigned int TimerHandle;
-    typedef std::map<TimerHandle, ModuleIdent> TimerAlloc;
-    typedef std::map<TimerHandle, boost::asio::deadline_timer* > TimersMap;
-    typedef std::map<ModuleIdent, std::list< BoundScheduleable > > ReadyMap;
+
+    /// A task waiting in a ready queue.
+    struct ReadyTask
+    {
+        /// The task to run
+        BoundScheduleable task;
+        /// When the task was placed in the ready queue
+        boost::posix_time::ptime queued;
+    };
+
+    /// Scheduler statistics kept for each module.
+    struct ModuleMetrics
+    {
+        /// Microseconds tasks waited between being queued and running
+        CHistogram latency;
+        /// Microseconds each task ran for
+        CHistogram execution;
+        /// Tasks waiting in the ready queue when the module's phase began
+        CHistogram depth;
+        /// Number of tasks run
+        unsigned long tasks;
+        /// Number of phases the module has been given
+        unsigned long phases;
+        /// Phases ended early because the module was idle
+        unsigned long shortened;
+        /// Tasks still queued when the module's phase ended
+        unsigned long deferred;
+        /// Batches which were still running when the module's phase ended
+        unsigned long overruns;
+    };
+
+    typedef CReadyQueue<ReadyTask> ReadyQueue;
+    typedef std::vector< boost::shared_ptr<ReadyQueue> > ReadyVector;
+    typedef boost::shared_ptr<boost::asio::io_service::strand> StrandPtr;
+    typedef std::vector<StrandPtr> StrandVector;
+    typedef std::map<ModuleIdent, ModuleID> ModuleIDMap;
     
     /// Type of a pointer to a Broker.
     typedef boost::shared_ptr<CBroker> BrokerPtr;
@@ -85,11 +138,8 @@ public:
                    CDispatcher& p_dispatch, boost::asio::io_service &m_ios,
                    freedm::broker::CConnectionManager &m_conMan);
 
-    /// Terminate the timers since they are pointers.
-    ~CBroker();
-
-    /// Run the Server's io_service loop.
-    void Run();
+    /// Run the Server's io_service loop on the given number of threads.
+    void Run(unsigned int threads = 1);
  
     /// Return a reference to the IO Service
     boost::asio::io_service& GetIOService();
@@ -106,11 +156,17 @@ public:
     /// Schedule a task
     void Schedule(ModuleIdent m, BoundScheduleable x, bool start_worker=true);
 
+    /// Schedule a task for a module by its integer identifier
+    void Schedule(ModuleID m, BoundScheduleable x, bool start_worker=true);
+
+    /// Find the integer identifier of a registered module
+    ModuleID GetModuleID(ModuleIdent m);
+
     /// Allocate a timer
     TimerHandle AllocateTimer(ModuleIdent module);
 
-    /// Mark that you should try and cancel some timer
-    void CancelTimer(ModuleIdent handle);
+    /// Cancel the task waiting on some timer
+    void CancelTimer(TimerHandle handle);
 
     /// Access the connection manager
     CConnectionManager& GetConnectionManager() { return m_connManager; };
@@ -119,13 +175,36 @@ public:
     CDispatcher& GetDispatcher() { return m_dispatch; };
     
     /// Registers a module for the scheduler
-    void RegisterModule(ModuleIdent m, boost::posix_time::time_duration phase);
+    void RegisterModule(ModuleIdent m, boost::posix_time::time_duration phase,
+        boost::posix_time::time_duration minimum =
+            boost::posix_time::milliseconds(MINIMUM_PHASE));
+
+    /// Sets how long the worker may run tasks before yielding
+    void SetBatchBudget(boost::posix_time::time_duration budget);
+
+    /// Lets idle modules give the rest of their phase to the next module
+    void SetAdaptivePhases(bool adaptive);
+
+    /// Returns a snapshot of the scheduler statistics for a module
+    ModuleMetrics GetMetrics(ModuleIdent m);
+
+    /// Writes the scheduler statistics of every module
+    void PrintMetrics(std::ostream & out);
+
+    /// Sets a function to also run when the metrics are requested
+    void SetMetricsReporter(BoundScheduleable reporter);
 
 private:
 
     /// Handle completion of an asynchronous accept operation.
     void HandleAccept(const boost::system::error_code& e);
 
+    /// Stops the broker or reports the metrics when a signal arrives.
+    void HandleSignal(const boost::system::error_code& e, int signum);
+
+    /// Writes the scheduler statistics to the log.
+    void LogMetrics();
+
     /// The io_service used to perform asynchronous operations.
     boost::asio::io_service &m_ioService;
 
@@ -141,14 +220,38 @@ private:
     ///Schedule to Move Onto The Next Phase.
     void ChangePhase(const boost::system::error_code &err);
 
-    ///Check to see if the scheduled task should actually be run.
-    void ScheduledTask(Scheduleable x, TimerHandle handle, const boost::system::error_code &err);
+    ///Decide whether the phase ends when the phase timer expires.
+    void HandlePhaseTimer(const boost::system::error_code &err, unsigned int count);
+
+    ///End the phase early if the active module is idle.
+    void EndPhase();
+
+    ///Check whether the active module has run out of work.
+    bool PhaseIdle();
+
+    ///Move onto the next phase (holding the scheduler lock).
+    void AdvancePhase();
+
+    ///Move every timer that has expired into its module's ready queue.
+    void HandleTimers(const boost::system::error_code &err);
+
+    ///Arm the shared timer for the earliest pending expiration.
+    void ArmTimers();
 
     ///Verify the queue is empty
     void Worker();
 
+    ///Run a batch of tasks on a module's strand and then continue the worker.
+    void Execute(ReadyTask x, PhaseMarker phase);
+
+    ///Start the worker if it is idle.
+    void StartWorker();
+
+    ///Find or create the identifier for a module (holding the scheduler lock)
+    ModuleID AssignModuleID(ModuleIdent m);
+
     ///Flag for if the executer is scheduled to run again.
-    bool m_busy;
+    boost::atomic<bool> m_busy;
     
     ///The last time the phases were aligned
     boost::posix_time::ptime m_last_alignment;
@@ -157,22 +260,102 @@ private:
     ModuleVector m_modules;
     
     ///Whose turn is it for round robin.
-    PhaseMarker m_phase;
+    boost::atomic<PhaseMarker> m_phase;
 
     ///Time for the phases
     boost::asio::deadline_timer m_phasetimer;
 
-    ///The current counter for the time handlers
-    TimerHandle m_handlercounter;
+    ///The signals which stop the broker or report its metrics
+    boost::asio::signal_set m_signals;
+
+    ///Run with LogMetrics when the metrics are requested
+    BoundScheduleable m_reporter;
+
+    ///How long the worker may run tasks before yielding to the ioservice
+    boost::posix_time::time_duration m_budget;
+
+    ///Microseconds spent running tasks during the current phase
+    boost::atomic<long> m_phaseused;
+
+    ///How long the current phase was scheduled to last
+    boost::posix_time::time_duration m_phaseallotted;
+
+    ///Whether idle modules give the rest of their phase away
+    bool m_adaptive;
+
+    ///Incremented at every phase change
+    unsigned int m_phasecount;
+
+    ///When the current phase began on the synchronized clock
+    boost::posix_time::ptime m_phasestart;
+
+    ///When the current phase's slot ends on the synchronized clock
+    boost::posix_time::ptime m_phasedeadline;
+
+    ///How long each phase runs before it may be given away, by phase
+    std::vector<boost::posix_time::time_duration> m_phaseMinimums;
+
+    ///A timer allocated to a module, indexed by its handle.
+    struct TimerSlot
+    {
+        ///The module which owns the timer
+        ModuleID module;
+        ///The task waiting on the timer (empty if the timer is idle)
+        Scheduleable task;
+        ///Incremented each time the timer is set or cancelled
+        unsigned int generation;
+    };
+
+    ///A pending expiration; stale once the slot's generation moves on.
+    struct TimerEntry
+    {
+        ///When the timer expires
+        boost::posix_time::ptime expires;
+        ///The timer that expires
+        TimerHandle handle;
+        ///The generation of the slot this expiration belongs to
+        unsigned int generation;
+        ///Orders the expiration heap so the soonest is on top.
+        bool operator<(const TimerEntry &other) const
+            { return expires > other.expires; }
+    };
+
+    ///Every allocated timer
+    std::vector<TimerSlot> m_timerslots;
+
+    ///Heap of pending expirations, soonest first
+    std::vector<TimerEntry> m_timerqueue;
+
+    ///The single asio timer that waits on the soonest expiration
+    boost::asio::deadline_timer m_tasktimer;
+
+    ///When m_tasktimer is set to fire (not_a_date_time if it is idle)
+    boost::posix_time::ptime m_tasktimerexpires;
+
+    ///Lock for the timer slots and expiration heap.
+    boost::mutex m_timermutex;
+
+    ///The jobs of each module that are ready to run as soon as their phase
+    ///comes up, indexed by module identifier
+    ReadyVector m_ready;
+
+    ///The strand each module's tasks are executed on
+    StrandVector m_strands;
+
+    ///The identifier assigned to each module name
+    ModuleIDMap m_moduleIDs;
+
+    ///The name of each module, indexed by module identifier
+    std::vector<ModuleIdent> m_moduleNames;
 
-    ///How the timers are allocated.
-    TimerAlloc m_allocs;    
+    ///The identifier of the module which owns each phase
+    std::vector<ModuleID> m_phaseModules;
 
-    ///A list of timers used for scheduling
-    TimersMap m_timers;
+    ///Scheduler statistics, indexed by module identifier
+    std::vector<ModuleMetrics> m_metrics;
 
-    ///A map of jobs that are ready to run as soon as their phase comes up
-    ReadyMap m_ready;
+    ///Lock for the scheduler statistics.
+    boost::mutex m_metricsmutex;
 
     ///Lock for the scheduler.
     boost::shared_mutex m_schmutex;
@@ -0,0 +1,138 @@
+//////////////////////////////////////////////////////////
+/// @file         CCallTable.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Matches the replies of peers to the calls waiting on them
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CCALLTABLE_HPP
+#define CCALLTABLE_HPP
+
+#include "CMessage.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace freedm {
+    namespace broker {
+
+/// The calls a module is waiting on, by correlation id.
+class CCallTable : private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description A call is a request sent to some peers. Its id travels
+    ///     in the request and comes back in each reply, so a reply is matched
+    ///     to the call it answers no matter how many calls are open or how
+    ///     late it arrives. A call completes as soon as every peer has
+    ///     replied, or at its deadline with whatever replies it has; either
+    ///     way its completion runs exactly once. A cancelled call never
+    ///     completes and its replies are refused.
+    ///
+    /// @limitations Completions run on the thread which completes the call,
+    ///     with the table unlocked, and may open or cancel other calls.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// Identifies a call; zero is never used.
+    typedef unsigned int CallID;
+
+    /// What a call gathered by the time it completed.
+    struct Result
+    {
+        /// The replies, by the uuid of the peer which sent each
+        std::map<std::string, CMessage> replies;
+        /// The peers which had not replied by the deadline
+        std::set<std::string> missing;
+    };
+
+    /// Runs once when a call completes.
+    typedef boost::function<void (const Result &)> Completion;
+
+    /// Creates a table with no calls.
+    CCallTable();
+
+    /// Opens a call to the peers which completes by the deadline.
+    CallID Open(const std::set<std::string> & peers,
+            boost::posix_time::ptime deadline, Completion done);
+
+    /// Records a peer's reply to the call it names, true if one was waiting.
+    bool Answer(const CMessage & reply, const std::string & uuid);
+
+    /// Drops a call without completing it, true if it was open.
+    bool Cancel(CallID id);
+
+    /// True if the call has neither completed nor been cancelled.
+    bool IsOpen(CallID id) const;
+
+    /// Completes the calls whose deadline is at or before the time.
+    void Expire(boost::posix_time::ptime now);
+
+    /// The earliest deadline of an open call (not_a_date_time if none).
+    boost::posix_time::ptime GetNextDeadline() const;
+
+    /// Puts a call's id in a request, whose handler must be set.
+    static void Stamp(CMessage & request, CallID id);
+
+    /// Copies the id of a request to its reply, whose handler must be set.
+    static void Correlate(const CMessage & request, CMessage & reply);
+
+    /// The id a message carries, or zero if it carries none.
+    static CallID GetCallID(const CMessage & msg);
+private:
+    /// A call waiting on replies.
+    struct Call
+    {
+        /// When the call completes without the missing replies
+        boost::posix_time::ptime deadline;
+        /// Runs when the call completes
+        Completion done;
+        /// The replies so far and the peers which have not replied
+        Result result;
+    };
+
+    /// Completes a call, which the caller has removed from the table.
+    static void Complete(const Call & call);
+
+    /// The open calls by id.
+    std::map<CallID, Call> m_calls;
+    /// The open calls in the order of their deadlines.
+    std::set< std::pair<boost::posix_time::ptime, CallID> > m_deadlines;
+    /// The id of the last call opened.
+    CallID m_lastID;
+    /// Protects the calls, which replies and the deadline timer both touch.
+    mutable boost::mutex m_mutex;
+};
+
+    } // namespace broker
+} // namespace freedm
+
+#endif // CCALLTABLE_HPP
@@ -0,0 +1,131 @@
+//////////////////////////////////////////////////////////
+/// @file         CClock.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  The broker clock service
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CCLOCK_HPP
+#define CCLOCK_HPP
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace freedm {
+    namespace broker {
+
+/// Somewhere the broker can read the time from.
+class IClockSource
+{
+public:
+    /// Virtual destructor for the derived sources.
+    virtual ~IClockSource() {}
+
+    /// Time which never moves backwards, from an arbitrary starting point.
+    virtual boost::posix_time::ptime GetMonotonicTime() = 0;
+
+    /// The wall clock time in UTC.
+    virtual boost::posix_time::ptime GetWallTime() = 0;
+};
+
+/// Reads the operating system's monotonic and wall clocks.
+class CSystemClockSource : public IClockSource
+{
+public:
+    /// Reads the monotonic clock of the operating system.
+    virtual boost::posix_time::ptime GetMonotonicTime();
+
+    /// Reads the system clock.
+    virtual boost::posix_time::ptime GetWallTime();
+};
+
+/// A singleton which tells the broker what time it is.
+class CClock : private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description All times come from one source, the system clocks unless
+    ///     a test or simulation installs another. The wall clock is read
+    ///     once, when the source is installed; after that the DGI time is
+    ///     that reading advanced by the monotonic clock plus the clock skew
+    ///     agreed by group management. Steps of the wall clock (from NTP, for
+    ///     example) therefore never move the DGI time.
+    ///
+    ///     The cached times are only updated by Tick, which the broker calls
+    ///     as it starts handling each event. They cost a single atomic load
+    ///     and suit checks which can tolerate a few milliseconds of error.
+    ///
+    /// @limitations The source must not be replaced while the broker runs.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// Returns the singleton instance of the clock.
+    static CClock& instance();
+
+    /// Installs a new time source; an empty pointer restores the system one.
+    void SetSource(boost::shared_ptr<IClockSource> source);
+
+    /// Refreshes the cached times.
+    void Tick();
+
+    /// The monotonic time, read now.
+    boost::posix_time::ptime GetMonotonicTime();
+
+    /// The monotonic time as of the last Tick.
+    boost::posix_time::ptime GetCachedTime() const;
+
+    /// The skew corrected time shared by the DGI nodes, read now.
+    boost::posix_time::ptime GetDGITime();
+
+    /// The skew corrected time as of the last Tick.
+    boost::posix_time::ptime GetCachedDGITime() const;
+
+    /// The local wall time (without the skew) for display, read now.
+    boost::posix_time::ptime GetLocalTime();
+private:
+    /// Installs the system clock source.
+    CClock();
+
+    /// Converts a monotonic time to the wall clock time it corresponds to.
+    boost::posix_time::ptime ToWallTime(boost::posix_time::ptime monotonic) const;
+
+    /// The source of the time.
+    boost::shared_ptr<IClockSource> m_source;
+    /// The monotonic time when the source was installed.
+    boost::posix_time::ptime m_monotonicbase;
+    /// The wall clock time when the source was installed.
+    boost::posix_time::ptime m_wallbase;
+    /// The offset of the local time zone from UTC.
+    boost::posix_time::time_duration m_localoffset;
+    /// Microseconds after m_monotonicbase at the last Tick.
+    boost::atomic<boost::int64_t> m_cached;
+};
+
+    } // namespace broker
+} // namespace freedm
+
+#endif // CCLOCK_HPP
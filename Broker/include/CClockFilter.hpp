@@ -0,0 +1,96 @@
+//////////////////////////////////////////////////////////
+/// @file         CClockFilter.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Estimates clock offsets from request and reply timestamps
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CCLOCKFILTER_HPP
+#define CCLOCKFILTER_HPP
+
+#include <deque>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace freedm {
+    namespace broker {
+
+/// Picks the most trustworthy of the recent clock offsets measured to a peer.
+class CClockFilter
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Each measurement takes the four timestamps of an NTP
+    ///     exchange: the request sent (t1) and the reply received (t4) by the
+    ///     local clock, the request received (t2) and the reply sent (t3) by
+    ///     the remote clock. The remote clock is ahead by
+    ///     ((t2 - t1) + (t3 - t4)) / 2, give or take half the round trip
+    ///     delay (t4 - t1) - (t3 - t2), which a delay that is spent more on
+    ///     one leg than the other skews. The filter keeps a window of recent
+    ///     measurements and, like the NTP clock filter, trusts the one with
+    ///     the least delay; measurements slower than the limit are dropped.
+    ///
+    /// @limitations Offsets are only comparable if neither clock was
+    ///     adjusted between the measurements, so the caller should measure
+    ///     against unadjusted clocks.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// One exchange of clock readings.
+    struct Sample
+    {
+        /// How far the remote clock is ahead of the local clock
+        boost::posix_time::time_duration offset;
+        /// The round trip delay, excluding time spent at the remote end
+        boost::posix_time::time_duration delay;
+    };
+
+    /// Computes the offset and delay of an exchange from its timestamps.
+    static Sample Measure(boost::posix_time::ptime t1,
+            boost::posix_time::ptime t2, boost::posix_time::ptime t3,
+            boost::posix_time::ptime t4);
+
+    /// Creates a filter which keeps the given number of measurements.
+    explicit CClockFilter(boost::posix_time::time_duration maxDelay =
+                boost::posix_time::milliseconds(100),
+            unsigned int window = 8);
+
+    /// Adds a measurement, returning false if its delay was over the limit.
+    bool Add(const Sample & sample);
+
+    /// Gets the measurement with the least delay, if there is any.
+    bool GetBest(Sample & best) const;
+private:
+    /// The longest delay a kept measurement may have.
+    boost::posix_time::time_duration m_maxDelay;
+    /// How many measurements are kept.
+    unsigned int m_window;
+    /// The recent measurements, oldest first.
+    std::deque<Sample> m_samples;
+};
+
+    } // namespace broker
+} // namespace freedm
+
+#endif // CCLOCKFILTER_HPP
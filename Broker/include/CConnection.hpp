@@ -44,6 +44,8 @@
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <iomanip>
 #include <set>
@@ -83,7 +85,18 @@ public:
     /// Handler that calls the correct protocol for accept logic
     bool Recieve(const CMessage &msg);
 
+    /// Writes a clock request, noting when the kernel sent it.
+    void SendClockRequest(const char * data, std::size_t length,
+            boost::posix_time::ptime queued);
+
+    /// Finds when the kernel sent the clock request queued at a time.
+    bool GetClockRequestSent(boost::posix_time::ptime queued,
+            boost::posix_time::ptime & sent);
+
 private:
+    /// Hands a message to its protocol from within the connection strand
+    void HandleSend(CMessage msg);
+
     typedef boost::shared_ptr<IProtocol> ProtocolPtr;
     typedef std::map<std::string,ProtocolPtr> ProtocolMap;
     /// Protocol Handler Map
@@ -91,6 +104,16 @@ private:
     
     /// Default protocol
     std::string m_defaultprotocol;
+
+    /// Whether the socket has been asked for send stamps, and the answer
+    enum { STAMPS_UNTRIED, STAMPS_ON, STAMPS_OFF } m_sendStamps;
+
+    /// The kernel send times of recent clock requests, by their queue time
+    std::deque< std::pair<boost::posix_time::ptime,
+            boost::posix_time::ptime> > m_clockRequests;
+
+    /// Protects the send times, which group management reads
+    boost::mutex m_clockMutex;
 };
 
 typedef boost::shared_ptr<CConnection> ConnectionPtr;
@@ -125,10 +125,6 @@ public:
 
     /// Iterator to the end of the connections map.
     connectionmap::iterator GetConnectionsEnd() { return m_connections.end(); };
-    
-    // Transient Network Simulation
-    /// Load a network configuration & apply it.
-    void LoadNetworkConfig();
 
 private:
     /// Mapping from uuid to hostname.
@@ -142,7 +138,7 @@ private:
     /// Node UUID
     std::string m_uuid;
     /// Mutex for protecting the handler maps above
-    boost::mutex m_Mutex;       
+    mutable boost::mutex m_Mutex;       
 };
 
 } // namespace broker
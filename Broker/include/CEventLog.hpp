@@ -0,0 +1,214 @@
+//////////////////////////////////////////////////////////
+/// @file         CEventLog.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  A memory-mapped log of fixed-layout binary events
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CEVENTLOG_HPP
+#define CEVENTLOG_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace freedm {
+    namespace broker {
+
+/// A singleton which records binary events in a memory-mapped file.
+class CEventLog : private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description The file is a header followed by a ring of fixed-size
+    ///     records. Writing an event reserves a slot with one atomic add and
+    ///     fills it in place; nothing is formatted and no system call is
+    ///     made, so events can be recorded where a formatted log line would
+    ///     be too expensive. Because the file is a shared mapping, records
+    ///     written before a crash are still in it afterwards. When the ring
+    ///     is full the oldest records are overwritten.
+    ///
+    ///     Each record carries a sequence number, written last, so a reader
+    ///     can skip slots that were being filled when the broker stopped and
+    ///     can put the ring back in order. PosixEventDecoder prints a file as
+    ///     text or CSV.
+    ///
+    ///     Arguments are numbers. A peer is recorded as the Hash of its UUID.
+    ///
+    /// @limitations Until Open is called, and after Close, events are
+    ///     discarded. Close must not run while another thread may be
+    ///     writing an event. A writer which falls a whole ring behind another can
+    ///     leave a slot that holds a mix of two records.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// The modules which record events.
+    enum Module { BROKER, GM, LB, SC };
+
+    /// The events which can be recorded. Never renumber these; add new
+    /// events at the end and describe them in CEventLog.cpp.
+    enum Event
+    {
+        /// gm: group, leader, members, fids
+        GM_STATE = 1,
+        /// gm: group, leader
+        GM_GROUP_CHANGED,
+        /// lb: state, generation, storage, load, gateway, normal
+        LB_LOAD_TABLE,
+        /// lb: peer, demand, supplying
+        LB_MIGRATION,
+        /// sc: value
+        SC_SNAPSHOT,
+        /// sc: states, intransit
+        SC_COLLECTED,
+        /// One past the last event.
+        EVENT_COUNT
+    };
+
+    /// The most arguments an event can have.
+    static const unsigned int MAX_ARGS = 6;
+
+    /// The layout of one record in the file.
+    struct Record
+    {
+        /// The position of the record in the log, counted from 1; 0 marks
+        /// a slot that is empty or was never completed.
+        boost::uint64_t s_sequence;
+        /// Microseconds since 1970 by the DGI clock.
+        boost::int64_t s_time;
+        /// The Event.
+        boost::uint16_t s_event;
+        /// The Module which recorded the event.
+        boost::uint16_t s_module;
+        /// The number of arguments which are set.
+        boost::uint32_t s_argc;
+        /// The arguments of the event.
+        double s_args[MAX_ARGS];
+    };
+
+    /// The layout of the start of the file.
+    struct Header
+    {
+        /// Identifies the file format.
+        char s_magic[8];
+        /// The version of the record layout.
+        boost::uint32_t s_version;
+        /// The size of one record.
+        boost::uint32_t s_recordSize;
+        /// The number of records in the ring.
+        boost::uint64_t s_capacity;
+        /// The UUID of the node which wrote the file.
+        char s_uuid[48];
+    };
+
+    /// How an event is printed.
+    struct EventInfo
+    {
+        /// The name of the event.
+        const char * s_name;
+        /// The number of arguments.
+        unsigned int s_argc;
+        /// The names of the arguments.
+        const char * s_args[MAX_ARGS];
+    };
+
+    /// Returns the singleton instance of the log.
+    static CEventLog& instance();
+
+    /// Closes the log.
+    ~CEventLog();
+
+    /// Creates (or replaces) the file and starts recording to it.
+    void Open(const std::string & filename, const std::string & uuid,
+            unsigned int capacity);
+
+    /// Stops recording and flushes the file.
+    void Close();
+
+    /// True while events are being recorded.
+    bool IsOpen() const
+        { return m_records.load(boost::memory_order_acquire) != 0; }
+
+    /// Records an event with up to MAX_ARGS arguments.
+    void WriteArray(Module module, Event event, unsigned int argc,
+            const double * args);
+
+    /// Records an event with no arguments.
+    void Write(Module module, Event event);
+
+    /// Records an event with one argument.
+    void Write(Module module, Event event, double a0);
+
+    /// Records an event with two arguments.
+    void Write(Module module, Event event, double a0, double a1);
+
+    /// Records an event with three arguments.
+    void Write(Module module, Event event, double a0, double a1, double a2);
+
+    /// Records an event with four arguments.
+    void Write(Module module, Event event, double a0, double a1, double a2,
+            double a3);
+
+    /// Records an event with six arguments.
+    void Write(Module module, Event event, double a0, double a1, double a2,
+            double a3, double a4, double a5);
+
+    /// Reads every completed record of a file in time order.
+    static Header Read(const std::string & filename,
+            std::vector<Record> & records);
+
+    /// The 32-bit FNV-1a hash which identifies a peer in the arguments.
+    static double Hash(const std::string & uuid);
+
+    /// Describes an event, or returns 0 for an unknown event.
+    static const EventInfo * Describe(unsigned int event);
+
+    /// The name of a module.
+    static const char * ModuleName(unsigned int module);
+private:
+    /// Starts closed.
+    CEventLog();
+
+    /// The mapping of the open file.
+    boost::scoped_ptr<boost::interprocess::mapped_region> m_region;
+    /// The first record of the mapping, or 0 while closed.
+    boost::atomic<Record *> m_records;
+    /// The number of records in the ring.
+    boost::uint64_t m_capacity;
+    /// The number of slots reserved so far.
+    boost::atomic<boost::uint64_t> m_next;
+    /// Serializes Open and Close.
+    boost::mutex m_mutex;
+};
+
+    } // namespace broker
+} // namespace freedm
+
+#endif // CEVENTLOG_HPP
@@ -0,0 +1,167 @@
+//////////////////////////////////////////////////////////
+/// @file         CFailureDetector.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Judges from message arrivals whether peers have failed
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CFAILUREDETECTOR_HPP
+#define CFAILUREDETECTOR_HPP
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace freedm {
+    namespace broker {
+
+/// Something which judges from message arrivals whether peers have failed.
+class IFailureDetector
+{
+public:
+    /// Virtual destructor for the derived detectors.
+    virtual ~IFailureDetector() {}
+
+    /// Notes that a message from the peer arrived at the given time.
+    virtual void Heartbeat(const std::string & uuid,
+            boost::posix_time::ptime time) = 0;
+
+    /// How strongly the peer is suspected at the given time, from 0 up.
+    virtual double GetSuspicion(const std::string & uuid,
+            boost::posix_time::ptime time) const = 0;
+};
+
+/// The phi accrual failure detector of Hayashibara et al.
+class CPhiAccrualDetector : public IFailureDetector
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Keeps the most recent intervals between the messages of
+    ///     each peer and treats them as normally distributed. The suspicion
+    ///     is phi = -log10 of the chance that the peer is merely this late:
+    ///     phi 1 is wrong one time in ten, phi 8 one time in 10^8. The
+    ///     acceptable pause is added to the mean interval, so a peer which
+    ///     goes quiet between phases is not suspected at once, and the
+    ///     deviation has a floor so a very regular peer is not suspected for
+    ///     a little jitter. Until a peer has sent twice its intervals are
+    ///     taken to be the first estimate.
+    ///
+    /// @limitations A peer which has never been heard from has an infinite
+    ///     suspicion.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// Creates a detector with no history.
+    CPhiAccrualDetector(boost::posix_time::time_duration pause,
+            boost::posix_time::time_duration minDeviation =
+                boost::posix_time::milliseconds(100),
+            boost::posix_time::time_duration estimate =
+                boost::posix_time::seconds(1),
+            unsigned int window = 100);
+
+    /// Notes that a message from the peer arrived at the given time.
+    virtual void Heartbeat(const std::string & uuid,
+            boost::posix_time::ptime time);
+
+    /// The phi of the peer at the given time.
+    virtual double GetSuspicion(const std::string & uuid,
+            boost::posix_time::ptime time) const;
+private:
+    /// The recent arrivals of one peer.
+    struct History
+    {
+        /// When the last message arrived.
+        boost::posix_time::ptime last;
+        /// The most recent intervals, in milliseconds.
+        std::deque<double> intervals;
+        /// The sum of the intervals.
+        double sum;
+        /// The sum of the squares of the intervals.
+        double squares;
+    };
+
+    /// Adds an interval to a history, dropping the oldest if it is full.
+    void Record(History & history, double interval);
+
+    /// The acceptable pause, in milliseconds.
+    double m_pause;
+    /// The least deviation assumed, in milliseconds.
+    double m_minDeviation;
+    /// The interval assumed before there are any, in milliseconds.
+    double m_estimate;
+    /// The number of intervals kept per peer.
+    unsigned int m_window;
+    /// The arrivals of each peer, by UUID.
+    std::map<std::string, History> m_history;
+    /// Protects the histories, which every connection's strand updates.
+    mutable boost::mutex m_mutex;
+};
+
+/// A singleton which holds the broker's failure detector.
+class CFailureDetector : private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Every message the broker receives, of any module and
+    ///     including acknowledgements, is a heartbeat of its sender. Group
+    ///     management asks whether a peer it has not heard from in its own
+    ///     messages is still trusted before removing it. Without a detector
+    ///     no peer is trusted and the fixed timeouts decide alone.
+    ///
+    /// @limitations The detector must not be replaced while the broker runs.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// Returns the singleton instance of the failure detector.
+    static CFailureDetector& instance();
+
+    /// Installs a detector and the suspicion at which a peer has failed.
+    void SetDetector(boost::shared_ptr<IFailureDetector> detector,
+            double threshold);
+
+    /// Notes that a message from the peer arrived now.
+    void Heartbeat(const std::string & uuid);
+
+    /// The suspicion of the peer now, or 0 without a detector.
+    double GetSuspicion(const std::string & uuid) const;
+
+    /// True if a detector is installed and suspects the peer too little.
+    bool IsTrusted(const std::string & uuid) const;
+private:
+    /// Starts without a detector.
+    CFailureDetector();
+
+    /// The detector, or an empty pointer.
+    boost::shared_ptr<IFailureDetector> m_detector;
+    /// The suspicion at which a peer has failed.
+    double m_threshold;
+};
+
+    } // namespace broker
+} // namespace freedm
+
+#endif // CFAILUREDETECTOR_HPP
@@ -43,10 +43,12 @@ namespace freedm {
 
 namespace broker {
 
-// We have to forward declare GMAgent (and its namespace!) to make it a friend.
+// We have to forward declare the group management modules (and their
+// namespace!) to make them friends.
 namespace gm {
 
 class GMAgent;
+class SwimAgent;
 
 }
 
@@ -55,6 +57,7 @@ class CGlobalPeerList : public boost::noncopyable
     public:
         friend class freedm::broker::IReadHandler;
         friend class freedm::broker::gm::GMAgent;
+        friend class freedm::broker::gm::SwimAgent;
         /// Provides a PeerNodePtr type
         typedef boost::shared_ptr<IPeerNode> PeerNodePtr;
         /// The peerset type
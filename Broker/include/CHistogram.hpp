@@ -0,0 +1,114 @@
+//////////////////////////////////////////////////////////
+/// @file         CHistogram.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  A log-linear histogram for latency measurements
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CHISTOGRAM_HPP
+#define CHISTOGRAM_HPP
+
+#include <iosfwd>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace freedm {
+    namespace broker {
+
+/// Records the distribution of a non-negative quantity.
+class CHistogram
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Values are counted in buckets whose width doubles with
+    ///     every power of two, and each power of two is split into a fixed
+    ///     number of linear sub-buckets (as HdrHistogram does). Every value
+    ///     is therefore recorded with a relative error under 1/SUB_BUCKETS,
+    ///     in constant time and with no allocation after construction.
+    ///
+    /// @limitations Not synchronized; the owner must serialize access.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// The type of the recorded values.
+    typedef boost::uint64_t Value;
+
+    /// Creates an empty histogram.
+    CHistogram();
+
+    /// Counts one occurrence of a value.
+    void Record(Value value);
+
+    /// Forgets everything that has been recorded.
+    void Reset();
+
+    /// The number of values recorded.
+    Value GetCount() const { return m_count; }
+
+    /// The smallest value recorded (0 if empty).
+    Value GetMin() const { return m_count ? m_min : 0; }
+
+    /// The largest value recorded.
+    Value GetMax() const { return m_max; }
+
+    /// The mean of the recorded values (0 if empty).
+    double GetMean() const;
+
+    /// The value below which the given percent of the values fall.
+    Value GetPercentile(double percent) const;
+
+    /// Writes a one line summary of the distribution.
+    void Print(std::ostream & out) const;
+private:
+    /// log2 of the number of linear sub-buckets per power of two.
+    static const unsigned int SUB_BUCKET_BITS = 4;
+    /// The number of linear sub-buckets per power of two.
+    static const unsigned int SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+
+    /// The bucket a value is counted in.
+    static unsigned int BucketOf(Value value);
+
+    /// The largest value that is counted in a bucket.
+    static Value HighestIn(unsigned int bucket);
+
+    /// The count of each bucket.
+    std::vector<Value> m_buckets;
+    /// The number of values recorded.
+    Value m_count;
+    /// The sum of the values recorded.
+    double m_sum;
+    /// The smallest value recorded.
+    Value m_min;
+    /// The largest value recorded.
+    Value m_max;
+};
+
+/// Prints the summary of a histogram.
+std::ostream & operator<<(std::ostream & out, const CHistogram & histogram);
+
+    } // namespace broker
+} // namespace freedm
+
+#endif // CHISTOGRAM_HPP
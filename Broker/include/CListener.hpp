@@ -51,6 +51,7 @@ namespace freedm {
     namespace broker {
 
 class CConnectionManager;
+class CConnection;
 class CBroker;
 
 /// Represents a single CListner from a client.
@@ -75,8 +76,14 @@ public:
     /// Get Remote UUID
     std::string GetUUID() { return m_uuid; };
 private:
-    /// Handle completion of a read operation.
-    void HandleRead(const boost::system::error_code& e, std::size_t bytes_transferred);
+    /// Waits for the next datagram.
+    void Listen();
+
+    /// Reads and handles a datagram once the socket is readable.
+    void HandleRead(const boost::system::error_code& e);
+
+    /// Process a parsed message within the strand of its connection.
+    void HandleMessage(boost::shared_ptr<CConnection> conn, CMessage msg);
 
     /// Variable used for tracking the remote endpoint of incoming messages.
     boost::asio::ip::udp::endpoint m_endpoint;
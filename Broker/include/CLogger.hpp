@@ -28,17 +28,31 @@
 #include <cstdlib>
 #include <fstream>
 #include <string>
+#include <vector>
 
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/foreach.hpp>
 #include <boost/iostreams/concepts.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/program_options.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include "config.hpp"
+
 namespace po = boost::program_options;
 
+// The most verbose level compiled in, set with -DCOMPILED_LOG_LEVEL=<0-8>.
+#ifndef COMPILED_LOG_LEVEL
+#define COMPILED_LOG_LEVEL 8
+#endif
+
 // Pretty function is nonstandard. Fallback to standards if not using GNU C++.
 #ifndef __GNUG__
 #define __PRETTY_FUNCTION__ ( std::string("At ") + basename(__FILE__) + \
@@ -62,7 +76,9 @@ class CGlobalLogger : public boost::noncopyable
     ///////////////////////////////////////////////////////////////////////////
     /// @description The GlobalLogger is responsible for tracking a table which
     ///     lists the names of the different loggers and their current output
-    ///     levels.
+    ///     levels. Every change is pushed to the local loggers of that name,
+    ///     which keep their own copy so that a log statement never has to
+    ///     look its level up.
     ///
     /// @limitations Singleton. Cannot be copied.
     ///////////////////////////////////////////////////////////////////////////
@@ -70,7 +86,9 @@ class CGlobalLogger : public boost::noncopyable
         /// Retrieves the singleton instance of the global logger.
         static CGlobalLogger& instance();
         /// Register a local logger with the global logger.
-        void RegisterLocalLogger(const std::string logger);
+        void RegisterLocalLogger(CLocalLogger * logger);
+        /// Forget a local logger which is being destroyed.
+        void UnregisterLocalLogger(CLocalLogger * logger);
         /// Sets the logging level of a specific logger.
         void SetOutputLevel(const std::string logger, const unsigned int level);
         /// Fetch the logging level of a specific logger.
@@ -82,12 +100,89 @@ class CGlobalLogger : public boost::noncopyable
         /// Lists all the avaible loggers and their current levels
         void ListLoggers() const;
     private:
+        /// Copies the level of a name to the local loggers of that name.
+        void PushOutputLevel(const std::string logger);
         /// What the output level is if not set specifically.
         unsigned int m_default;
         /// Type of container for the output levels.
         typedef std::map< const std::string, unsigned int > OutputMap;
         /// The map of loggers to logger levels.
         OutputMap m_loggers;
+        /// Type of container for the local loggers.
+        typedef std::multimap< std::string, CLocalLogger * > LocalMap;
+        /// The local loggers by name (several files may share a name).
+        LocalMap m_locals;
+};
+
+/// Writes log records from a background thread
+class CLogWriter : public boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Once started, the writer gives every thread that logs a
+    ///     ring of records which only that thread fills and only the writer
+    ///     thread empties, so a log statement costs a clock read and a copy
+    ///     into a slot whose buffers are reused, with no lock or system call.
+    ///     The writer thread formats the timestamps, merges the rings in time
+    ///     order and writes to the output stream. When a ring is full the
+    ///     record is dropped and counted, and the writer reports the drops.
+    ///     Until Start is called, and after Stop, records are written
+    ///     synchronously by the thread that logs them.
+    ///
+    /// @limitations Singleton. A record appended while Stop runs may be lost.
+    ///////////////////////////////////////////////////////////////////////////
+    public:
+        /// Retrieves the singleton instance of the writer.
+        static CLogWriter& instance();
+        /// Starts the background thread writing to a stream.
+        void Start(std::ostream * out);
+        /// Writes everything queued and stops the background thread.
+        void Stop();
+        /// True while the background thread owns the output.
+        bool IsRunning() const { return m_running.load(boost::memory_order_acquire); }
+        /// Queues a record, or writes it at once if the writer is stopped.
+        void Write(const unsigned int level, const std::string & name,
+                const char * const s, std::streamsize n);
+        /// The number of records dropped because a ring was full.
+        boost::uint64_t GetDropped() const { return m_dropped.load(); }
+        /// The number of records each thread can queue.
+        static const unsigned int RING_SIZE = 4096;
+    private:
+        /// The records queued by one thread.
+        class Ring;
+        /// Type of the list of rings.
+        typedef std::vector< boost::shared_ptr<Ring> > RingList;
+        /// Writes to std::clog until started.
+        CLogWriter();
+        /// Stops the background thread.
+        ~CLogWriter();
+        /// Finds or creates the ring of the calling thread.
+        Ring & GetRing();
+        /// Marks a ring as abandoned when its thread exits.
+        static void RetireRing(Ring * ring);
+        /// Body of the background thread.
+        void Run();
+        /// Writes everything queued; returns false if nothing was.
+        bool Drain();
+        /// Set while the background thread owns the output.
+        boost::atomic<bool> m_running;
+        /// Tells the background thread to finish.
+        boost::atomic<bool> m_stopping;
+        /// Where the records are written.
+        std::ostream * m_ostream;
+        /// The ring of each thread.
+        boost::thread_specific_ptr<Ring> m_local;
+        /// Every ring, including those of finished threads not yet emptied.
+        RingList m_rings;
+        /// Protects the list of rings.
+        boost::mutex m_ringsMutex;
+        /// Serializes writes to the output stream.
+        boost::mutex m_outputMutex;
+        /// The number of records dropped.
+        boost::atomic<boost::uint64_t> m_dropped;
+        /// The dropped records already reported.
+        boost::uint64_t m_reported;
+        /// The background thread.
+        boost::scoped_ptr<boost::thread> m_thread;
 };
 
 /// Logging Output Software
@@ -102,7 +197,7 @@ class CLog : public boost::iostreams::sink
     public:
         /// Constructor; prepares a log of a specified level.
         CLog(const CLoggerPointer p, const unsigned int level_,
-                const std::string name_, std::ostream* const out_= &std::clog );
+                const std::string name_);
         /// Writes from a character array into the logger stream
         std::streamsize write( const char* const s, std::streamsize n);
         /// Determine the level of this logger
@@ -114,8 +209,157 @@ class CLog : public boost::iostreams::sink
         unsigned int m_level;
         /// String name of this logger
         const std::string m_name;
-        /// Output stream to use.
-        std::ostream * const m_ostream;
+};
+
+/// The statement being written to one output level
+class CLogLine
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Returned by the first << of a log statement. If the level
+    ///     is filtered out it holds no stream, and each following << is a
+    ///     single inlined test which formats nothing.
+    ///
+    /// @limitations Converts to an std::ostream (a bad one if disabled) for
+    ///     code that needs a real stream.
+    ///////////////////////////////////////////////////////////////////////////
+    public:
+        /// Wraps a stream, or nothing for a disabled level.
+        explicit CLogLine(std::ostream * stream) : m_stream(stream) {}
+        /// Writes a value if the level is enabled.
+        template <typename T>
+        CLogLine & operator<<(const T & value)
+        {
+            if (m_stream)
+            {
+                *m_stream << value;
+            }
+            return *this;
+        }
+        /// Applies a manipulator such as std::endl.
+        CLogLine & operator<<(std::ostream & (*manip)(std::ostream &))
+        {
+            if (m_stream)
+            {
+                *m_stream << manip;
+            }
+            return *this;
+        }
+        /// Applies a manipulator such as std::hex.
+        CLogLine & operator<<(std::ios_base & (*manip)(std::ios_base &))
+        {
+            if (m_stream)
+            {
+                *m_stream << manip;
+            }
+            return *this;
+        }
+        /// Lets the statement be passed to functions which take an ostream.
+        operator std::ostream &();
+    private:
+        /// The stream of the calling thread, or null if disabled.
+        std::ostream * m_stream;
+};
+
+/// One output level of a local logger
+class CLogStream : private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Behaves like the output stream for a single logging
+    ///     level. Each thread that writes to it gets its own buffered stream,
+    ///     so messages composed concurrently are never interleaved. When the
+    ///     level is filtered out the first << compares two integers and
+    ///     returns an empty CLogLine, which skips the formatting of every
+    ///     value that follows. The values themselves are still evaluated.
+    ///
+    /// @limitations Can be used wherever an std::ostream is expected, but
+    ///     the stream it converts to is only valid on the calling thread.
+    ///////////////////////////////////////////////////////////////////////////
+    public:
+        /// Constructor; prepares a stream of a specified level.
+        CLogStream(const CLoggerPointer p, const unsigned int level_,
+                const std::string name_);
+        /// Returns the stream that belongs to the calling thread.
+        std::ostream & GetStream();
+        /// True if the statements of this level are written.
+        bool IsEnabled() const;
+        /// Lets the log be passed to functions which take an ostream.
+        operator std::ostream &()
+        {
+            return IsEnabled() ? GetStream() : NullStream();
+        }
+        /// Writes a value to the calling thread's stream.
+        template <typename T>
+        CLogLine operator<<(const T & value)
+        {
+            return Begin() << value;
+        }
+        /// Applies a manipulator such as std::endl.
+        CLogLine operator<<(std::ostream & (*manip)(std::ostream &))
+        {
+            return Begin() << manip;
+        }
+        /// A stream which discards everything without formatting it.
+        static std::ostream & NullStream();
+    private:
+        /// Starts a statement, which is empty if the level is disabled.
+        CLogLine Begin()
+        {
+            return CLogLine(IsEnabled() ? &GetStream() : 0);
+        }
+        /// Type of the per-thread stream.
+        typedef boost::iostreams::stream<CLog> StreamType;
+        /// The local logger managing this stream
+        const CLoggerPointer m_parent;
+        /// The level of this stream
+        const unsigned int m_level;
+        /// String name of this stream
+        const std::string m_name;
+        /// The stream of each thread that has written to this level.
+        boost::thread_specific_ptr<StreamType> m_stream;
+};
+
+/// One output level of a local logger, fixed when compiling
+template <unsigned int LEVEL>
+class CLevelStream : public CLogStream
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description A CLogStream whose level is part of its type. Levels more
+    ///     verbose than COMPILED_LOG_LEVEL are disabled by a constant, so the
+    ///     compiler removes their statements along with the runtime check.
+    ///
+    /// @limitations The values of a removed statement are still evaluated if
+    ///     they have side effects.
+    ///////////////////////////////////////////////////////////////////////////
+    public:
+        /// Constructor; prepares a stream of the template's level.
+        CLevelStream(const CLoggerPointer p, const std::string name_)
+            : CLogStream(p, LEVEL, name_) {}
+        /// True if this level was compiled in.
+        static const bool COMPILED = LEVEL <= COMPILED_LOG_LEVEL;
+        /// True if the statements of this level are written.
+        bool IsEnabled() const { return COMPILED && CLogStream::IsEnabled(); }
+        /// Lets the log be passed to functions which take an ostream.
+        operator std::ostream &()
+        {
+            return IsEnabled() ? GetStream() : NullStream();
+        }
+        /// Writes a value to the calling thread's stream.
+        template <typename T>
+        CLogLine operator<<(const T & value)
+        {
+            return Begin() << value;
+        }
+        /// Applies a manipulator such as std::endl.
+        CLogLine operator<<(std::ostream & (*manip)(std::ostream &))
+        {
+            return Begin() << manip;
+        }
+    private:
+        /// Starts a statement, which is empty if the level is disabled.
+        CLogLine Begin()
+        {
+            return CLogLine(IsEnabled() ? &GetStream() : 0);
+        }
 };
 
 class CLocalLogger : private boost::noncopyable
@@ -132,36 +376,50 @@ class CLocalLogger : private boost::noncopyable
     public:
         ///Initializes the local statics
         CLocalLogger(const std::string loggername);
+        ///Unregisters from the global logger
+        ~CLocalLogger();
         ///Logger
-        boost::iostreams::stream<CLog> Trace;
+        CLevelStream<8> Trace;
         ///Logger
-	boost::iostreams::stream<CLog> Debug;
+        CLevelStream<7> Debug;
         ///Logger
-        boost::iostreams::stream<CLog> Info;
+        CLevelStream<6> Info;
         ///Logger
-        boost::iostreams::stream<CLog> Notice;
+        CLevelStream<5> Notice;
         ///Logger
-        boost::iostreams::stream<CLog> Status;
+        CLevelStream<4> Status;
         ///Logger
-        boost::iostreams::stream<CLog> Warn;
+        CLevelStream<3> Warn;
         ///Logger
-        boost::iostreams::stream<CLog> Error;
+        CLevelStream<2> Error;
         ///Logger
-        boost::iostreams::stream<CLog> Alert;
+        CLevelStream<1> Alert;
         ///Logger
-        boost::iostreams::stream<CLog> Fatal;
+        CLevelStream<0> Fatal;
         /// Returns the name of this logger
         std::string GetName() const;
         /// Returns the filtering level for this set of loggers.
-        unsigned int GetOutputLevel() const;
+        unsigned int GetOutputLevel() const
+        {
+            return m_level.load(boost::memory_order_relaxed);
+        }
         /// Sets the output level for this set of loggers. 
         void SetOutputLevel(const unsigned int level);
         
     private:
+        friend class CGlobalLogger;
         /// The name of this logger
         const std::string m_name;
+        /// The output level, kept up to date by the global logger.
+        boost::atomic<unsigned int> m_level;
 };
 
+/// True if the statements of this level are written.
+inline bool CLogStream::IsEnabled() const
+{
+    return m_parent->GetOutputLevel() >= m_level;
+}
+
 } // namespace broker
 } // namespace freedm
 
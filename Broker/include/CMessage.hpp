@@ -125,6 +125,12 @@ public:
     /// Getter for the send time
     boost::posix_time::ptime GetSendTimestamp() const;
 
+    /// Setter for the time the message arrived (not sent on the wire)
+    void SetReceiveTimestamp(boost::posix_time::ptime p);
+
+    /// Getter for the time the message arrived
+    boost::posix_time::ptime GetReceiveTimestamp() const;
+
     /// Is an expire time set?
     bool IsExpireTimeSet();
 
@@ -212,6 +218,9 @@ private:
     boost::posix_time::ptime m_expiretime;
 
     std::string m_handler;
+
+    /// The time the message arrived, by the skew corrected clock
+    boost::posix_time::ptime m_receivetime;
 };
 
 } // namespace broker
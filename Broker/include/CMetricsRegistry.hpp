@@ -0,0 +1,110 @@
+//////////////////////////////////////////////////////////
+/// @file         CMetricsRegistry.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Named counters and histograms shared by the whole broker
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CMETRICSREGISTRY_HPP
+#define CMETRICSREGISTRY_HPP
+
+#include "CHistogram.hpp"
+
+#include <iosfwd>
+#include <map>
+#include <string>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace freedm {
+    namespace broker {
+
+/// A singleton which holds the broker's named counters and histograms.
+class CMetricsRegistry : private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Counters are looked up by name once, usually into a
+    ///     file scope reference next to the file's logger, and are then
+    ///     bumped with a single atomic add. Names are dotted paths such as
+    ///     net.datagrams.sent; the registry prints them sorted, one
+    ///     "name value" pair per line, which is the format the cluster
+    ///     benchmark collects. A histogram prints as several such lines,
+    ///     its name followed by .count, .mean, .p50, .p99 and .max.
+    ///
+    /// @limitations Counters and histograms are never removed.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// The type of a counter.
+    typedef boost::atomic<boost::uint64_t> Counter;
+
+    /// A histogram which can be recorded to from any thread.
+    class Histogram : private boost::noncopyable
+    {
+    public:
+        /// Counts one occurrence of a value.
+        void Record(CHistogram::Value value);
+        /// A copy of the distribution recorded so far.
+        CHistogram GetSnapshot() const;
+    private:
+        /// The distribution.
+        CHistogram m_histogram;
+        /// Protects the distribution.
+        mutable boost::mutex m_mutex;
+    };
+
+    /// Returns the singleton instance of the registry.
+    static CMetricsRegistry& instance();
+
+    /// Finds the counter with the given name, creating it at zero.
+    Counter & GetCounter(const std::string & name);
+
+    /// Finds the histogram with the given name, creating it empty.
+    Histogram & GetHistogram(const std::string & name);
+
+    /// Writes every counter and histogram as "name value" lines.
+    void Print(std::ostream & out) const;
+private:
+    /// The type of the table of counters.
+    typedef std::map<std::string, boost::shared_ptr<Counter> > CounterMap;
+    /// The type of the table of histograms.
+    typedef std::map<std::string, boost::shared_ptr<Histogram> > HistogramMap;
+
+    /// The counters by name.
+    CounterMap m_counters;
+    /// The histograms by name.
+    HistogramMap m_histograms;
+    /// Protects the tables (but not the counters or histograms).
+    mutable boost::mutex m_mutex;
+};
+
+    } // namespace broker
+} // namespace freedm
+
+#endif // CMETRICSREGISTRY_HPP
@@ -0,0 +1,220 @@
+//////////////////////////////////////////////////////////
+/// @file         CNetworkEmulator.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Emulates delay, loss and other impairments of network links
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CNETWORKEMULATOR_HPP
+#define CNETWORKEMULATOR_HPP
+
+#include <cstddef>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/property_tree/ptree_fwd.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace freedm {
+    namespace broker {
+
+/// A singleton which decides what the network does to each datagram.
+class CNetworkEmulator : private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Each link, a direction and a peer UUID, has its own
+    ///     impairments: a fixed delay with uniform jitter, a chance that a
+    ///     datagram skips the delay (which reorders it ahead of those still
+    ///     waiting), a chance that it is duplicated, a bandwidth cap that
+    ///     queues datagrams behind each other, and loss from a two state
+    ///     Gilbert-Elliott model. Datagrams which must wait are kept in one
+    ///     queue served by a single timer and delivered on the strand of
+    ///     their connection.
+    ///
+    ///     The settings are read from an XML file when Start is called and
+    ///     again whenever its modification time changes. With no file the
+    ///     emulator is disabled and Deliver costs a single atomic load.
+    ///
+    /// @limitations Reloading resets the state of every link.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// The direction of a link, relative to this node.
+    enum Direction { INCOMING, OUTGOING };
+
+    /// The work which delivers one copy of a datagram.
+    typedef boost::function<void ()> Action;
+
+    /// Returns the singleton instance of the emulator.
+    static CNetworkEmulator& instance();
+
+    /// Loads the settings and checks the file for changes from now on.
+    void Start(boost::asio::io_service & ios, const std::string & filename,
+            boost::posix_time::time_duration interval);
+
+    /// Stops checking for changes and forgets the delayed datagrams.
+    void Stop();
+
+    /// Replaces the settings with those in a file.
+    bool Load(const std::string & filename);
+
+    /// Removes every impairment.
+    void Disable();
+
+    /// True if any settings are loaded.
+    bool IsEnabled() const { return m_enabled.load(boost::memory_order_acquire); }
+
+    /// Decides what happens to a datagram, queueing any delayed copies.
+    unsigned int Deliver(Direction dir, const std::string & uuid,
+            std::size_t bytes, boost::asio::io_service::strand & strand,
+            Action action);
+
+    /// The number of delayed copies which have not been delivered.
+    std::size_t GetPending() const;
+private:
+    /// The impairments of a link.
+    struct LinkSettings
+    {
+        /// Reads the settings of a link over the defaults.
+        LinkSettings(const boost::property_tree::ptree & pt,
+                const LinkSettings & defaults);
+        /// A link without impairments.
+        LinkSettings();
+        /// Fixed delay of every datagram.
+        boost::posix_time::time_duration delay;
+        /// Largest random change to the delay, in either direction.
+        boost::posix_time::time_duration jitter;
+        /// Chance that a datagram is sent without the delay.
+        double reorder;
+        /// Chance that a datagram is delivered twice.
+        double duplicate;
+        /// Bytes per second the link carries, or 0 for no limit.
+        double bandwidth;
+        /// Chance of loss in the good state.
+        double loss;
+        /// Chance of moving from the good state to the bad state.
+        double enter;
+        /// Chance of moving from the bad state to the good state.
+        double leave;
+        /// Chance of loss in the bad state.
+        double burstloss;
+    };
+
+    /// The settings and state of one link.
+    struct Link
+    {
+        /// Creates a link in the good state with an idle queue.
+        explicit Link(const LinkSettings & s);
+        /// The impairments of the link.
+        LinkSettings settings;
+        /// True while the link is in the bad state.
+        bool bad;
+        /// When the last queued datagram finishes transmitting.
+        boost::posix_time::ptime busy;
+    };
+
+    /// A delayed copy of a datagram.
+    struct Pending
+    {
+        /// When the copy is delivered.
+        boost::posix_time::ptime due;
+        /// Breaks ties so equal times are delivered in order.
+        boost::uint64_t sequence;
+        /// Delivers the copy on its strand.
+        Action action;
+        /// Orders the heap so the earliest copy is on top.
+        bool operator<(const Pending & other) const;
+    };
+
+    /// The links of one direction, by peer UUID.
+    typedef std::map<std::string, Link> LinkMap;
+
+    /// Starts with no settings.
+    CNetworkEmulator();
+
+    /// Reads every link from a parsed settings file.
+    void Parse(const boost::property_tree::ptree & pt);
+
+    /// Finds (or creates from the defaults) the link to a peer.
+    Link & GetLink(Direction dir, const std::string & uuid);
+
+    /// Draws a number from [0,1).
+    double Random();
+
+    /// Decides the delay of one copy of a datagram.
+    boost::posix_time::time_duration Delay(Link & link, std::size_t bytes,
+            boost::posix_time::ptime now);
+
+    /// Delivers the copies which are due and rearms the timer.
+    void HandleTimer(const boost::system::error_code & err);
+
+    /// Arms the timer for the earliest delayed copy.
+    void ArmTimer();
+
+    /// Reloads the settings if the file has been modified.
+    void HandleWatch(const boost::system::error_code & err);
+
+    /// Set when settings are loaded.
+    boost::atomic<bool> m_enabled;
+    /// The default settings of each direction.
+    LinkSettings m_defaults[2];
+    /// The links of each direction.
+    LinkMap m_links[2];
+    /// The delayed copies, as a heap.
+    std::vector<Pending> m_pending;
+    /// The number of copies ever delayed.
+    boost::uint64_t m_sequence;
+    /// The random number generator.
+    boost::mt19937 m_random;
+    /// The timer that waits on the earliest delayed copy.
+    boost::scoped_ptr<boost::asio::deadline_timer> m_timer;
+    /// The timer which checks the file for changes.
+    boost::scoped_ptr<boost::asio::deadline_timer> m_watch;
+    /// How often the file is checked.
+    boost::posix_time::time_duration m_interval;
+    /// The file the settings are read from.
+    std::string m_filename;
+    /// The modification time of the file when it was last read.
+    std::time_t m_modified;
+    /// Protects everything above.
+    mutable boost::mutex m_mutex;
+};
+
+    } // namespace broker
+} // namespace freedm
+
+#endif // CNETWORKEMULATOR_HPP
@@ -0,0 +1,81 @@
+//////////////////////////////////////////////////////////
+/// @file         CPacketTimestamps.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Kernel timestamps of the datagrams a socket sends and receives
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CPACKETTIMESTAMPS_HPP
+#define CPACKETTIMESTAMPS_HPP
+
+#include <cstddef>
+
+#include <sys/types.h>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace freedm {
+    namespace broker {
+
+/// Reads the times the kernel received and sent datagrams.
+class CPacketTimestamps : private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description A time read by the broker after a datagram arrives
+    ///     includes however long the datagram waited in the socket buffer
+    ///     and for a thread to read it; a time read before a send includes
+    ///     the wait in the network stack. The kernel can stamp datagrams as
+    ///     they pass the network device instead (SO_TIMESTAMPING), which
+    ///     leaves only the network in a clock measurement. Stamps are taken
+    ///     from the system clock and returned in DGI time.
+    ///
+    /// @limitations Only software stamps are used: hardware stamps come from
+    ///     the clock of the network card, which the DGI time cannot be
+    ///     related to. A send stamp which the kernel has not produced by the
+    ///     time the send returns is discarded.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// Asks the kernel to stamp the datagrams a socket receives.
+    static bool EnableReceive(int fd);
+
+    /// Lets the datagrams sent on a socket ask for a stamp.
+    static bool EnableSend(int fd);
+
+    /// Reads a datagram along with the time the kernel received it.
+    static ssize_t Receive(int fd, char * buffer, std::size_t length,
+            void * from, std::size_t & fromLength,
+            boost::posix_time::ptime & stamp);
+
+    /// Sends a datagram and reads the time the kernel sent it.
+    static ssize_t Send(int fd, const char * buffer, std::size_t length,
+            boost::posix_time::ptime & stamp);
+};
+
+    } // namespace broker
+} // namespace freedm
+
+#endif // CPACKETTIMESTAMPS_HPP
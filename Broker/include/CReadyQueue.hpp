@@ -0,0 +1,286 @@
+//////////////////////////////////////////////////////////
+/// @file         CReadyQueue.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  A bounded multi-producer, single-consumer task queue
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CREADYQUEUE_HPP
+#define CREADYQUEUE_HPP
+
+#include <cstddef>
+#include <deque>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace freedm {
+    namespace broker {
+
+/// A FIFO of ready tasks that can be filled from any thread.
+template <typename T>
+class CReadyQueue : private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Producers claim a slot of a fixed ring with a single
+    ///     compare and swap and publish it by bumping the slot's sequence
+    ///     number, so enqueueing never takes a lock or allocates. If the ring
+    ///     is full the item is placed on an overflow list under a mutex
+    ///     instead; once anything has overflowed, later items follow it
+    ///     there until the consumer has drained the overflow, which keeps
+    ///     the items of each producer in order.
+    ///
+    /// @limitations Only one thread may call Pop at a time. The capacity is
+    ///     rounded up to a power of two.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// Creates a queue whose ring holds at least capacity items.
+    explicit CReadyQueue(std::size_t capacity);
+
+    /// Adds an item to the back of the queue.
+    void Push(const T & item);
+
+    /// Removes the front of the queue into item, if there is one.
+    bool Pop(T & item);
+
+    /// Approximate number of items waiting in the queue.
+    std::size_t Size() const;
+
+    /// True if there is nothing waiting in the queue.
+    bool Empty() const { return Size() == 0; }
+
+    /// The number of items which did not fit in the ring.
+    std::size_t GetOverflowCount() const { return m_overflowed.load(); }
+private:
+    /// One slot of the ring.
+    struct Cell
+    {
+        /// Which lap of the ring this slot is ready for.
+        boost::atomic<std::size_t> sequence;
+        /// The stored item.
+        T data;
+    };
+
+    /// Tries to place an item in the ring without blocking.
+    bool TryPush(const T & item);
+
+    /// Tries to take an item from the ring without blocking.
+    bool TryPop(T & item);
+
+    /// The ring of slots.
+    boost::scoped_array<Cell> m_ring;
+    /// One less than the number of slots in the ring.
+    std::size_t m_mask;
+    /// The next slot a producer will claim.
+    boost::atomic<std::size_t> m_enqueue;
+    /// The next slot the consumer will read.
+    boost::atomic<std::size_t> m_dequeue;
+    /// Items waiting on the overflow list (including m_drain).
+    boost::atomic<std::size_t> m_pending;
+    /// Total number of items that have ever overflowed.
+    boost::atomic<std::size_t> m_overflowed;
+    /// Items which did not fit in the ring.
+    std::deque<T> m_overflow;
+    /// Overflow items claimed by the consumer, returned before the ring.
+    std::deque<T> m_drain;
+    /// Protects the overflow list.
+    boost::mutex m_mutex;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CReadyQueue::CReadyQueue
+/// @description Allocates the ring and marks every slot as free.
+/// @pre None
+/// @post The queue is empty.
+/// @param capacity The minimum number of items the ring can hold.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+CReadyQueue<T>::CReadyQueue(std::size_t capacity)
+    : m_enqueue(0),
+      m_dequeue(0),
+      m_pending(0),
+      m_overflowed(0)
+{
+    std::size_t size = 2;
+    while(size < capacity)
+    {
+        size *= 2;
+    }
+    m_ring.reset(new Cell[size]);
+    m_mask = size - 1;
+    for(std::size_t i = 0; i < size; i++)
+    {
+        m_ring[i].sequence.store(i, boost::memory_order_relaxed);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CReadyQueue::Push
+/// @description Places an item at the back of the queue. This is safe to call
+///     from any number of threads.
+/// @pre None
+/// @post The item will be returned by Pop after everything this thread pushed
+///     before it.
+/// @param item The item to enqueue.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void CReadyQueue<T>::Push(const T & item)
+{
+    if(m_pending.load(boost::memory_order_acquire) == 0 && TryPush(item))
+    {
+        return;
+    }
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_overflow.push_back(item);
+    m_pending.fetch_add(1, boost::memory_order_release);
+    m_overflowed.fetch_add(1, boost::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CReadyQueue::Pop
+/// @description Removes the item at the front of the queue. Overflow items
+///     that the consumer has already claimed come first, then the ring, and
+///     once the ring is empty the overflow list is claimed.
+/// @pre Only one thread calls Pop at a time.
+/// @post If true was returned, the front item has been removed.
+/// @param item Receives the front item.
+/// @return False if the queue was empty.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+bool CReadyQueue<T>::Pop(T & item)
+{
+    if(!m_drain.empty())
+    {
+        item = m_drain.front();
+        m_drain.pop_front();
+        m_pending.fetch_sub(1, boost::memory_order_release);
+        return true;
+    }
+    if(TryPop(item))
+    {
+        return true;
+    }
+    if(m_pending.load(boost::memory_order_acquire) == 0)
+    {
+        return false;
+    }
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        m_drain.swap(m_overflow);
+    }
+    if(m_drain.empty())
+    {
+        return false;
+    }
+    item = m_drain.front();
+    m_drain.pop_front();
+    m_pending.fetch_sub(1, boost::memory_order_release);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CReadyQueue::Size
+/// @description Counts the items in the ring and on the overflow list. The
+///     result can be stale as soon as it is returned.
+/// @return The approximate number of queued items.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+std::size_t CReadyQueue<T>::Size() const
+{
+    std::size_t head = m_dequeue.load(boost::memory_order_relaxed);
+    std::size_t tail = m_enqueue.load(boost::memory_order_relaxed);
+    std::size_t ring = (tail > head) ? tail - head : 0;
+    return ring + m_pending.load(boost::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CReadyQueue::TryPush
+/// @description Claims the next free slot of the ring and writes the item.
+/// @return False if the ring was full.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+bool CReadyQueue<T>::TryPush(const T & item)
+{
+    std::size_t pos = m_enqueue.load(boost::memory_order_relaxed);
+    Cell * cell;
+    while(true)
+    {
+        cell = &m_ring[pos & m_mask];
+        std::size_t seq = cell->sequence.load(boost::memory_order_acquire);
+        std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) -
+                static_cast<std::ptrdiff_t>(pos);
+        if(diff == 0)
+        {
+            if(m_enqueue.compare_exchange_weak(pos, pos + 1,
+                    boost::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if(diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = m_enqueue.load(boost::memory_order_relaxed);
+        }
+    }
+    cell->data = item;
+    cell->sequence.store(pos + 1, boost::memory_order_release);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CReadyQueue::TryPop
+/// @description Reads the front slot of the ring if it has been published.
+/// @return False if the ring was empty.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+bool CReadyQueue<T>::TryPop(T & item)
+{
+    std::size_t pos = m_dequeue.load(boost::memory_order_relaxed);
+    Cell * cell = &m_ring[pos & m_mask];
+    std::size_t seq = cell->sequence.load(boost::memory_order_acquire);
+    if(seq != pos + 1)
+    {
+        return false;
+    }
+    m_dequeue.store(pos + 1, boost::memory_order_relaxed);
+    item = cell->data;
+    // Release the stored item before the slot is handed back to producers.
+    cell->data = T();
+    cell->sequence.store(pos + m_mask + 1, boost::memory_order_release);
+    return true;
+}
+
+    } // namespace broker
+} // namespace freedm
+
+#endif // CREADYQUEUE_HPP
@@ -88,12 +88,9 @@ public:
     
     /// Get the ioservice
     boost::asio::io_service& GetIOService();
-    
-    /// Set the connection reliability for DCUSTOMNETWORK
-    void SetReliability(int r);
-    
-    /// Get the connection reliability for DCUSTOMNETWORK
-    int GetReliability();
+
+    /// Get the strand which serializes the handlers of this connection
+    boost::asio::io_service::strand& GetStrand();
 
     /// The maximum packet size in bytes
     static const unsigned int MAX_PACKET_SIZE = 60000;
@@ -101,6 +98,9 @@ private:
     /// Socket for the CConnection.
     boost::asio::ip::udp::socket m_socket;
 
+    /// Serializes the protocol state of this connection across threads.
+    boost::asio::io_service::strand m_strand;
+
     /// The manager for this CConnection.
     CConnectionManager& m_connManager;
 
@@ -109,9 +109,6 @@ private:
  
     /// The UUID of the remote endpoint for the connection
     std::string m_uuid;
-
-    /// The reliability of the connection (FOR -DCUSTOMNETWORK)
-    int m_reliability;
 };
 
 
@@ -0,0 +1,120 @@
+//////////////////////////////////////////////////////////
+/// @file         CRpcCaller.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Sends calls to peers and completes them by reply or deadline
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CRPCCALLER_HPP
+#define CRPCCALLER_HPP
+
+#include "CBroker.hpp"
+#include "CCallTable.hpp"
+#include "CMessage.hpp"
+#include "IPeerNode.hpp"
+
+#include <map>
+#include <string>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace freedm {
+    namespace broker {
+
+/// Sends a module's requests to peers and gathers the replies.
+class CRpcCaller : private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Each call sends one request to one or more peers and
+    ///     runs its completion once, when the last peer replies or when the
+    ///     call's timeout passes, whichever is first. The module passes the
+    ///     replies it receives to HandleReply, and the peers copy the call id
+    ///     into their replies with CCallTable::Correlate. Every call of a
+    ///     caller shares one broker timer, which is kept set for the earliest
+    ///     deadline, so the completions run on the module's own thread.
+    ///
+    /// @limitations A peer which answers without Correlate cannot complete a
+    ///     call; its reply is refused and the call runs to its deadline.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// A peer the caller can send to.
+    typedef boost::shared_ptr<IPeerNode> PeerNodePtr;
+
+    /// Sends a request to a peer.
+    typedef boost::function<void (PeerNodePtr, CMessage)> Sender;
+
+    /// Creates a caller for a module, which sends with send (or Send).
+    CRpcCaller(CBroker & broker, CBroker::ModuleIdent module,
+            Sender send = Sender());
+
+    /// Sends the request to every peer and waits at most timeout for them.
+    CCallTable::CallID Call(const std::map<std::string, PeerNodePtr> & peers,
+            CMessage request, boost::posix_time::time_duration timeout,
+            CCallTable::Completion done);
+
+    /// Sends the request to one peer and waits at most timeout for it.
+    CCallTable::CallID Call(PeerNodePtr peer, CMessage request,
+            boost::posix_time::time_duration timeout,
+            CCallTable::Completion done);
+
+    /// Matches a reply to its call, true if the call was waiting on it.
+    bool HandleReply(const CMessage & reply, PeerNodePtr peer);
+
+    /// Drops a call whose completion should not run, true if it was pending.
+    bool Cancel(CCallTable::CallID id);
+
+    /// True if the call is still waiting on replies.
+    bool IsPending(CCallTable::CallID id) const;
+private:
+    /// Sets the timer for the earliest deadline, if it is not set for it.
+    void Arm();
+
+    /// Completes the calls whose deadline has passed.
+    void HandleDeadline(const boost::system::error_code & err);
+
+    /// The broker which runs the timer.
+    CBroker & m_broker;
+    /// The timer shared by every call.
+    CBroker::TimerHandle m_timer;
+    /// Sends each request.
+    Sender m_send;
+    /// The calls waiting on replies.
+    CCallTable m_table;
+    /// The deadline the timer is set for, or not_a_date_time if it is idle.
+    boost::posix_time::ptime m_armed;
+    /// Protects the deadline the timer is set for.
+    boost::mutex m_armMutex;
+};
+
+    } // namespace broker
+} // namespace freedm
+
+#endif // CRPCCALLER_HPP
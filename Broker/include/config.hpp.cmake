@@ -30,9 +30,9 @@
 #define CONFIG_HPP
 
 #cmakedefine DATAGRAM
-#cmakedefine CUSTOMNETWORK
 #cmakedefine USE_DEVICE_PSCAD
 #cmakedefine USE_DEVICE_RTDS
+#define COMPILED_LOG_LEVEL @COMPILED_LOG_LEVEL@
 
 #endif // CONFIG_HPP
 
@@ -62,6 +62,10 @@ public:
     /// Sets a value on a device.
     virtual void Set(const Identifier device, const SettingKey key,
             const SettingValue value);
+
+    /// Calls the handler whenever a setting changes.
+    virtual bool Watch(const Identifier device, const SettingKey key,
+            ChangeHandler handler);
     
     /// Virtual destructor for derived classes.
     virtual ~CGenericAdapter() { }
@@ -75,6 +79,13 @@ private:
 
     /// Registry of device keys and values.
     mutable DeviceMap m_registry;
+
+    /// Map of device settings to the handlers watching them.
+    typedef std::multimap<std::pair<Identifier, SettingKey>, ChangeHandler>
+            WatchMap;
+
+    /// Handlers to call when a setting changes.
+    WatchMap m_watchers;
 };
 
 }
@@ -29,6 +29,7 @@
 #define CRTDSADAPTER_HPP
 
 #include <string>
+#include <vector>
 #include <iostream>
 #include <stdexcept>
 #include <sys/param.h>
@@ -84,6 +85,10 @@ public:
     /// retrieve data from state table
     SettingValue Get(const Identifier device, const SettingKey key) const;
 
+    /// call a handler whenever a value in the state table changes
+    bool Watch(const Identifier device, const SettingKey key,
+            ChangeHandler handler);
+
     /// shut down communication to FPGA
     void Quit();
 
@@ -121,6 +126,24 @@ private:
 
     /// timer object to set communication cycle pace
     boost::asio::deadline_timer m_GlobalTimer;
+
+    /// a state table value and the handler to call when it changes
+    struct Watcher
+    {
+        /// position of the value in the state table
+        size_t index;
+        /// device the value belongs to
+        Identifier device;
+        /// key of the value
+        SettingKey key;
+        /// function to call with the new value
+        ChangeHandler handler;
+    };
+
+    /// the state table values being watched
+    std::vector<Watcher> m_watchers;
+    /// protects m_watchers, which Run reads on the io_service thread
+    boost::mutex m_watchMutex;
 };
 
 }//namespace broker
@@ -27,6 +27,7 @@
 #ifndef IPHYSICALADAPTER_HPP
 #define	IPHYSICALADAPTER_HPP
 
+#include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -62,6 +63,10 @@ public:
     /// Pointer to a physical adapter.
     typedef boost::shared_ptr<IPhysicalAdapter> Pointer;
 
+    /// Called with the new value when a watched setting changes.
+    typedef boost::function<void (const Identifier device,
+            const SettingKey key, const SettingValue value)> ChangeHandler;
+
     /// Retrieves a value from a device.
     virtual SettingValue Get(const Identifier device,
             const SettingKey key) const = 0;
@@ -70,6 +75,12 @@ public:
     virtual void Set(const Identifier device, const SettingKey key,
             const SettingValue value) = 0;
 
+    /// Calls the handler whenever a setting changes, if the adapter can.
+    virtual bool Watch(const Identifier, const SettingKey, ChangeHandler)
+    {
+        return false;
+    }
+
     /// Virtual destructor for derived classes.
     virtual ~IPhysicalAdapter() { };
 };
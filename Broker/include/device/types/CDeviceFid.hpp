@@ -52,11 +52,16 @@ public:
 
     /// Determine whether or not this FID is active.
     bool IsActive() const;
+
+    /// Calls the handler whenever this FID opens or closes.
+    bool WatchState(IPhysicalAdapter::ChangeHandler handler);
 private:
     /// redefine base accessor as private
     using IDevice::Get;
     /// redefine base mutator as private
     using IDevice::Set;
+    /// redefine base watcher as private
+    using IDevice::Watch;
 };
 
 } // namespace device
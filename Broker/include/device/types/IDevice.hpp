@@ -78,6 +78,9 @@ public:
 
     /// Sets the value of some key in the structure
     void Set(const SettingKey key, const SettingValue value);
+
+    /// Calls the handler whenever the value of some key changes
+    bool Watch(const SettingKey key, IPhysicalAdapter::ChangeHandler handler);
 protected:
     friend class CPhysicalDeviceManager; // Temporary?
     
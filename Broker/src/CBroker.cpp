@@ -41,10 +41,19 @@
 ////////////////////////////////////////////////////////////////////
 
 #include "CBroker.hpp"
+#include "CClock.hpp"
 #include "CLogger.hpp"
 
 #include <boost/bind.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <csignal>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
 
 /// General FREEDM Namespace
 namespace freedm {
@@ -56,6 +65,13 @@ namespace {
 /// This file's logger.
 CLocalLogger Logger(__FILE__);
 
+/// Converts a duration to whole microseconds for the statistics, treating
+/// negative durations (from a clock that stepped backwards) as zero.
+CHistogram::Value Microseconds(boost::posix_time::time_duration d)
+{
+    return d.is_negative() ? 0 : d.total_microseconds();
+}
+
 }
         
 ///////////////////////////////////////////////////////////////////////////////
@@ -82,7 +98,9 @@ CBroker::CBroker(const std::string& p_address, const std::string& p_port,
       m_connManager(m_conMan),
       m_dispatch(p_dispatch),
       m_newConnection(new CListener(m_ioService, m_connManager, *this, m_conMan.GetUUID())),
-      m_phasetimer(m_ios)
+      m_phasetimer(m_ios),
+      m_signals(m_ios),
+      m_tasktimer(m_ios)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
     // Open the acceptor with the option to reuse the address (i.e. SO_REUSEADDR).
@@ -95,49 +113,66 @@ CBroker::CBroker(const std::string& p_address, const std::string& p_port,
     m_newConnection->GetSocket().bind(endpoint);;
     m_connManager.Start(m_newConnection);
     m_busy = false;
+    m_phase = 0;
+    m_budget = boost::posix_time::milliseconds(BATCH_BUDGET);
+    m_phaseused = 0;
+    m_phasecount = 0;
+    m_adaptive = false;
+
+    // Stop cleanly on an interrupt so the metrics are reported, and report
+    // them on request while running.
+    m_signals.add(SIGINT);
+    m_signals.add(SIGTERM);
+#ifdef SIGUSR1
+    m_signals.add(SIGUSR1);
+#endif
+    m_signals.async_wait(boost::bind(&CBroker::HandleSignal, this,
+        boost::asio::placeholders::error, boost::asio::placeholders::signal_number));
     
     // Try to align on the first phase change
-    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
-    now += CGlobalConfiguration::instance().GetClockSkew();
+    boost::posix_time::ptime now = CClock::instance().GetDGITime();
     now -= boost::posix_time::milliseconds(2*ALIGNMENT_DURATION);
     m_last_alignment = now;
 }
 
-///////////////////////////////////////////////////////////////////////////////
-/// @fn CBroker::~CBroker
-/// @description Cleans up all the timers from this module since the timers are
-///     stored as pointers.
-/// @pre None
-/// @post All the timers are destroyed and their handles no longer point at
-///     valid resources.
-///////////////////////////////////////////////////////////////////////////////
-CBroker::~CBroker()
-{
-    TimersMap::iterator it;
-    for(it=m_timers.begin(); it!=m_timers.end(); it++)
-    {
-        delete (*it).second;
-    }
-}
-
 ///////////////////////////////////////////////////////////////////////////////
 /// @fn CBroker::Run()
 /// @description Calls the ioservice run (initializing the ioservice thread)
-///               and then blocks until the ioservice runs out of work.
+///               and then blocks until the ioservice runs out of work. When
+///               more than one thread is requested, a pool of threads is
+///               started and each of them calls run on the same ioservice.
+///               Module tasks stay serialized by their module strand and
+///               connections by their connection strand, so the extra
+///               threads are used for receive processing, retransmission
+///               and timers.
 /// @pre  The ioservice has not been allocated a thread to operate on and has
 ///       some schedule of jobs waiting to be performed (so it doesn't exit
 ///       immediately.)
-/// @post The ioservice has terminated.
+/// @post The ioservice has terminated and every pool thread has joined.
+/// @param threads The number of threads to run the ioservice on. The calling
+///       thread counts as one of them.
 /// @return none
 ///////////////////////////////////////////////////////////////////////////////
-void CBroker::Run()
+void CBroker::Run(unsigned int threads)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    boost::thread_group pool;
+    typedef std::size_t (boost::asio::io_service::*RunFunction)();
+    RunFunction run = &boost::asio::io_service::run;
+
+    Logger.Status << "Running the broker on " << std::max(threads, 1u)
+                  << " thread(s)" << std::endl;
+    for(unsigned int i = 1; i < threads; i++)
+    {
+        pool.create_thread(boost::bind(run, &m_ioService));
+    }
     // The io_service::run() call will block until all asynchronous operations
     // have finished. While the server is running, there is always at least one
     // asynchronous operation outstanding: the asynchronous accept call waiting
     // for new incoming connections.
     m_ioService.run();
+    pool.join_all();
+    LogMetrics();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -182,26 +217,65 @@ void CBroker::HandleStop()
     // operations. Once all operations have finished the io_service::run() call
     // will exit.
     m_connManager.StopAll();
+    m_signals.cancel();
     m_ioService.stop(); 
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::HandleSignal
+/// @description Stops the broker on SIGINT or SIGTERM. On SIGUSR1 the
+///              scheduler statistics are written to the log, the metrics
+///              reporter runs, and the broker keeps waiting for signals.
+/// @pre The signal set is waiting.
+/// @post The broker is stopping, or the signal set is waiting again.
+/// @param e The error code of the wait.
+/// @param signum The signal which was delivered.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::HandleSignal(const boost::system::error_code& e, int signum)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    if(e)
+    {
+        return;
+    }
+#ifdef SIGUSR1
+    if(signum == SIGUSR1)
+    {
+        LogMetrics();
+        if(m_reporter)
+        {
+            m_reporter();
+        }
+        m_signals.async_wait(boost::bind(&CBroker::HandleSignal, this,
+            boost::asio::placeholders::error, boost::asio::placeholders::signal_number));
+        return;
+    }
+#endif
+    Logger.Status << "Caught signal " << signum << ", stopping" << std::endl;
+    Stop();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// @fn CBroker::RegisterModule
 /// @description Places the module in to the list of schedulable phases. The
 ///   scheduler cycles through these in order to do real-time round robin
 ///   scheduling.
-/// @pre None
+/// @pre The broker is not yet running on more than one thread; the module
+///   tables are read without a lock once it is.
 /// @post The module is registered with a phase duration specified by the
 ///   parameter phase.
 /// @param m the identifier for the module.
 /// @param phase the duration of the phase.
+/// @param minimum how long the phase runs before it may be given away in
+///   adaptive mode (at most the whole phase).
 ///////////////////////////////////////////////////////////////////////////////
-void CBroker::RegisterModule(CBroker::ModuleIdent m, boost::posix_time::time_duration phase)
+void CBroker::RegisterModule(CBroker::ModuleIdent m, boost::posix_time::time_duration phase,
+    boost::posix_time::time_duration minimum)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
     m_schmutex.lock();
     boost::system::error_code err;
-    bool exists;
+    bool exists = false;
     for(unsigned int i=0; i < m_modules.size(); i++)
     {
         if(m_modules[i].first == m)
@@ -212,7 +286,9 @@ void CBroker::RegisterModule(CBroker::ModuleIdent m, boost::posix_time::time_dur
     }
     if(!exists)
     {
+        m_phaseModules.push_back(AssignModuleID(m));
         m_modules.push_back(PhaseTuple(m,phase));
+        m_phaseMinimums.push_back(std::min(minimum, phase));
         if(m_modules.size() == 1)
         {
             m_schmutex.unlock();
@@ -223,11 +299,100 @@ void CBroker::RegisterModule(CBroker::ModuleIdent m, boost::posix_time::time_dur
     m_schmutex.unlock();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::SetBatchBudget
+/// @description Sets how long the worker may keep running tasks of the active
+///   module before it yields to the ioservice so that network and timer
+///   completions can be handled. A budget of zero runs one task per pass.
+/// @pre The broker is not yet running.
+/// @post The new budget is used by every following batch.
+/// @param budget The longest a single batch may run.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::SetBatchBudget(boost::posix_time::time_duration budget)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    m_budget = budget;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::SetAdaptivePhases
+/// @description Turns adaptive phase durations on or off. In adaptive mode a
+///   module which has run out of work ends its phase once its minimum has
+///   passed and the next module starts early; see AdvancePhase.
+/// @pre The broker is not yet running.
+/// @post Following phase changes use the chosen mode.
+/// @param adaptive True to let idle modules give their time away.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::SetAdaptivePhases(bool adaptive)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    m_adaptive = adaptive;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::AssignModuleID
+/// @description Gives a module the next integer identifier the first time it
+///   is named, along with its own ready queue and strand. Modules may be
+///   named by AllocateTimer before they register their phase.
+/// @pre The caller holds m_schmutex exclusively. The broker is not yet
+///   running on more than one thread.
+/// @post The module has an identifier, a ready queue and a strand.
+/// @param m The name of the module.
+/// @return The identifier of the module.
+///////////////////////////////////////////////////////////////////////////////
+CBroker::ModuleID CBroker::AssignModuleID(CBroker::ModuleIdent m)
+{
+    ModuleIDMap::iterator it = m_moduleIDs.find(m);
+    if(it != m_moduleIDs.end())
+    {
+        return it->second;
+    }
+    ModuleID id = m_moduleNames.size();
+    m_moduleIDs[m] = id;
+    m_moduleNames.push_back(m);
+    m_ready.push_back(boost::shared_ptr<ReadyQueue>(
+        new ReadyQueue(READY_QUEUE_SIZE)));
+    m_strands.push_back(StrandPtr(
+        new boost::asio::io_service::strand(m_ioService)));
+    boost::lock_guard<boost::mutex> lock(m_metricsmutex);
+    m_metrics.push_back(ModuleMetrics());
+    m_metrics.back().tasks = 0;
+    m_metrics.back().phases = 0;
+    m_metrics.back().shortened = 0;
+    m_metrics.back().deferred = 0;
+    m_metrics.back().overruns = 0;
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::GetModuleID
+/// @description Looks up the integer identifier assigned to a module when it
+///   was registered (or first given a timer). Modules that schedule often
+///   can keep the identifier and skip this lookup.
+/// @pre None
+/// @post None
+/// @param m The name of the module.
+/// @return The identifier of the module.
+/// @limitations Throws std::runtime_error if the module is not registered.
+///////////////////////////////////////////////////////////////////////////////
+CBroker::ModuleID CBroker::GetModuleID(CBroker::ModuleIdent m)
+{
+    boost::shared_lock<boost::shared_mutex> lock(m_schmutex);
+    ModuleIDMap::iterator it = m_moduleIDs.find(m);
+    if(it == m_moduleIDs.end())
+    {
+        throw std::runtime_error("Module is not registered: " + m);
+    }
+    return it->second;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// @fn CBroker::AllocateTimer
 /// @description Returns a handle to a timer to use for scheduling tasks.
 ///     timer recycling helps prevent forest fires (and accidental branching
-/// @pre The module is registered
+///     A handle is just an index into the broker's slab of timers; the slab
+///     shares one asio timer, so allocating a handle is cheap.
+/// @pre None
 /// @post A handle to a timer is returned.
 /// @param module the module the timer should be allocated to
 ///////////////////////////////////////////////////////////////////////////////
@@ -235,34 +400,153 @@ CBroker::TimerHandle CBroker::AllocateTimer(CBroker::ModuleIdent module)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
     m_schmutex.lock();
-    CBroker::TimerHandle myhandle;
-    boost::asio::deadline_timer* t = new boost::asio::deadline_timer(m_ioService);
-    myhandle = m_handlercounter;
-    m_handlercounter++;
-    m_allocs.insert(CBroker::TimerAlloc::value_type(myhandle,module));
-    m_timers.insert(CBroker::TimersMap::value_type(myhandle,t));
+    ModuleID id = AssignModuleID(module);
     m_schmutex.unlock();
-    return myhandle;
+    boost::lock_guard<boost::mutex> lock(m_timermutex);
+    TimerSlot slot;
+    slot.module = id;
+    slot.generation = 0;
+    m_timerslots.push_back(slot);
+    return m_timerslots.size() - 1;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 /// @fn CBroker::Schedule
 /// @description Given a binding to a function that should be run into the
-///   future, prepares it to be run... in the future.
-/// @pre The module is registered
+///   future, prepares it to be run... in the future. If the timer was already
+///   waiting, the task that was waiting on it is run with operation_aborted,
+///   just as when an asio timer is reset. A task with no wait goes straight to
+///   the module's ready queue without touching the timer queue.
+/// @pre The handle was returned by AllocateTimer
 /// @post A function is scheduled to be called in the future.
+/// @param h The timer to schedule the task on.
+/// @param wait How long to wait before the task is ready to run.
+/// @param x The task, which is passed the timer's error code.
 ///////////////////////////////////////////////////////////////////////////////
 void CBroker::Schedule(CBroker::TimerHandle h,
     boost::posix_time::time_duration wait, CBroker::Scheduleable x)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    m_schmutex.lock();
-    CBroker::Scheduleable s;
-    m_timers[h]->expires_from_now(wait);
-    s = boost::bind(&CBroker::ScheduledTask,this,x,h,boost::asio::placeholders::error);
+    boost::lock_guard<boost::mutex> lock(m_timermutex);
+    TimerSlot &slot = m_timerslots[h];
+    if(slot.task)
+    {
+        Schedule(slot.module, boost::bind(slot.task,
+            boost::asio::error::operation_aborted));
+    }
+    slot.generation++;
+    if(wait <= boost::posix_time::time_duration(0,0,0))
+    {
+        slot.task.clear();
+        Schedule(slot.module, boost::bind(x, boost::system::error_code()));
+        Logger.Debug<<"Scheduled task (NODELAY) for timer "<<h<<std::endl;
+        return;
+    }
+    slot.task = x;
+    TimerEntry entry;
+    entry.expires = CClock::instance().GetMonotonicTime() + wait;
+    entry.handle = h;
+    entry.generation = slot.generation;
+    m_timerqueue.push_back(entry);
+    std::push_heap(m_timerqueue.begin(), m_timerqueue.end());
+    ArmTimers();
     Logger.Debug<<"Scheduled task for timer "<<h<<std::endl;
-    m_timers[h]->async_wait(s);
-    m_schmutex.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::CancelTimer
+/// @description Cancels the task waiting on a timer. The task is still run,
+///   with operation_aborted, as it would be if an asio timer were cancelled.
+/// @pre The handle was returned by AllocateTimer
+/// @post The timer is idle.
+/// @param handle The timer to cancel.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::CancelTimer(CBroker::TimerHandle handle)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    boost::lock_guard<boost::mutex> lock(m_timermutex);
+    TimerSlot &slot = m_timerslots[handle];
+    if(slot.task)
+    {
+        Schedule(slot.module, boost::bind(slot.task,
+            boost::asio::error::operation_aborted));
+        slot.task.clear();
+    }
+    // Any queued expiration for this timer is now stale.
+    slot.generation++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::ArmTimers
+/// @description Drops stale expirations from the top of the heap and makes
+///   sure the shared asio timer will fire in time for the soonest one. The
+///   asio timer is left alone if it already fires within TIMER_TOLERANCE of
+///   that expiration, so timers that expire close together share one wakeup.
+/// @pre The caller holds m_timermutex.
+/// @post The shared timer is set for the soonest pending expiration.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::ArmTimers()
+{
+    while(!m_timerqueue.empty() &&
+        m_timerslots[m_timerqueue.front().handle].generation !=
+        m_timerqueue.front().generation)
+    {
+        std::pop_heap(m_timerqueue.begin(), m_timerqueue.end());
+        m_timerqueue.pop_back();
+    }
+    if(m_timerqueue.empty())
+    {
+        return;
+    }
+    boost::posix_time::ptime next = m_timerqueue.front().expires;
+    if(m_tasktimerexpires.is_not_a_date_time() || next +
+        boost::posix_time::milliseconds(TIMER_TOLERANCE) < m_tasktimerexpires)
+    {
+        m_tasktimerexpires = next;
+        m_tasktimer.expires_from_now(next - CClock::instance().GetMonotonicTime());
+        m_tasktimer.async_wait(boost::bind(&CBroker::HandleTimers, this,
+            boost::asio::placeholders::error));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::HandleTimers
+/// @description Called when the shared timer fires. Every timer that has
+///   expired (or will within TIMER_TOLERANCE) has its task placed in its
+///   module's ready queue, then the shared timer is set for the next one.
+/// @pre None
+/// @post Expired tasks are in the ready queues.
+/// @param err The error code of the shared timer. operation_aborted means the
+///   timer was moved to an earlier expiration and there is nothing to do.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::HandleTimers(const boost::system::error_code &err)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    if(err == boost::asio::error::operation_aborted)
+    {
+        return;
+    }
+    boost::lock_guard<boost::mutex> lock(m_timermutex);
+    CClock::instance().Tick();
+    boost::posix_time::ptime due = CClock::instance().GetCachedTime()
+        + boost::posix_time::milliseconds(TIMER_TOLERANCE);
+    m_tasktimerexpires = boost::posix_time::not_a_date_time;
+    while(!m_timerqueue.empty() && m_timerqueue.front().expires <= due)
+    {
+        TimerEntry entry = m_timerqueue.front();
+        std::pop_heap(m_timerqueue.begin(), m_timerqueue.end());
+        m_timerqueue.pop_back();
+        TimerSlot &slot = m_timerslots[entry.handle];
+        if(slot.generation != entry.generation || !slot.task)
+        {
+            continue;
+        }
+        Logger.Debug<<"Handle finished: "<<entry.handle<<" For module "
+                    <<m_moduleNames[slot.module]<<std::endl;
+        Schedule(slot.module, boost::bind(slot.task, err));
+        slot.task.clear();
+    }
+    ArmTimers();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -282,17 +566,37 @@ void CBroker::Schedule(CBroker::TimerHandle h,
 void CBroker::Schedule(ModuleIdent m, BoundScheduleable x, bool start_worker)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    m_schmutex.lock();
-    m_ready[m].push_back(x);
-    if(!m_busy && start_worker)
+    Schedule(GetModuleID(m), x, start_worker);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::Schedule
+/// @description Enters a bound schedulable into the job queue of the module
+///     with the given identifier. This does not take the scheduler lock, so
+///     it is cheap to call from any thread.
+/// @pre The module is registered.
+/// @post The task is placed in the work queue for the module m. If the
+///     start_worker parameter is set to true, the module's worker will be
+///     activated if it isn't already.
+/// @param m The identifier of the module the schedulable should be run as.
+/// @param x The method that will be run.
+/// @param start_worker tells the worker to begin processing again, if it is
+///     currently idle.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::Schedule(ModuleID m, BoundScheduleable x, bool start_worker)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    ReadyTask task;
+    task.task = x;
+    task.queued = CClock::instance().GetMonotonicTime();
+    m_ready[m]->Push(task);
+    if(start_worker)
     {
-        m_schmutex.unlock();
-        Worker();
-        m_schmutex.lock();
+        StartWorker();
     }
-    Logger.Debug<<"Module "<<m<<" now has queue size: "<<m_ready[m].size()<<std::endl;
-    Logger.Debug<<"Scheduled task (NODELAY) for "<<m<<std::endl;
-    m_schmutex.unlock();
+    Logger.Debug<<"Module "<<m_moduleNames[m]<<" now has queue size: "
+                <<m_ready[m]->Size()<<std::endl;
+    Logger.Debug<<"Scheduled task (NODELAY) for "<<m_moduleNames[m]<<std::endl;
 }
 
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -312,16 +616,132 @@ void CBroker::ChangePhase(const boost::system::error_code &err)
         return;
     }
     // Past this point assume there is at least one module.
-    m_schmutex.lock();
-    m_phase++;
+    boost::unique_lock<boost::shared_mutex> lock(m_schmutex);
+    AdvancePhase();
+}
+#pragma GCC diagnostic warning "-Wunused-parameter"
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::HandlePhaseTimer
+/// @description Called when the phase timer expires. In adaptive mode the
+///     timer first expires once the module's minimum has passed; if the
+///     module still has work its phase continues to the deadline, otherwise
+///     the phase ends here.
+/// @pre None
+/// @post The phase has changed, or the timer is set for the phase deadline.
+/// @param err The error code of the wait.
+/// @param count The phase the timer was set for.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::HandlePhaseTimer(const boost::system::error_code &err,
+    unsigned int count)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    if(err)
+    {
+        return;
+    }
+    boost::unique_lock<boost::shared_mutex> lock(m_schmutex);
+    // The phase may have ended early after the timer had already expired.
+    if(count != m_phasecount)
+    {
+        return;
+    }
+    boost::posix_time::ptime now = CClock::instance().GetDGITime();
+    if(m_adaptive && now < m_phasedeadline && !PhaseIdle())
+    {
+        m_phasetimer.expires_from_now(m_phasedeadline - now);
+        m_phasetimer.async_wait(boost::bind(&CBroker::HandlePhaseTimer, this,
+            boost::asio::placeholders::error, count));
+        return;
+    }
+    AdvancePhase();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::EndPhase
+/// @description Posted by the worker when it runs out of tasks. In adaptive
+///     mode the phase ends if its module has had its minimum time and is
+///     still idle; the rest of the phase goes to the next module.
+/// @pre None
+/// @post The phase has changed if the active module was idle past its
+///     minimum.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::EndPhase()
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    boost::unique_lock<boost::shared_mutex> lock(m_schmutex);
+    if(!m_adaptive || m_phase >= m_modules.size() || !PhaseIdle())
+    {
+        return;
+    }
+    boost::posix_time::ptime now = CClock::instance().GetDGITime();
+    if(now - m_phasestart < m_phaseMinimums[m_phase])
+    {
+        // HandlePhaseTimer checks again once the minimum has passed.
+        return;
+    }
+    Logger.Info<<"Phase "<<m_modules[m_phase].first<<" is idle, ending it "
+               <<(m_phasedeadline - now).total_milliseconds()<<" ms early"
+               <<std::endl;
+    AdvancePhase();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::PhaseIdle
+/// @description Checks whether the active module has nothing left to run.
+/// @pre The caller holds the scheduler lock.
+/// @return True if the worker is idle and the active ready queue is empty.
+///////////////////////////////////////////////////////////////////////////////
+bool CBroker::PhaseIdle()
+{
+    return !m_busy && m_ready[m_phaseModules[m_phase]]->Empty();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::AdvancePhase
+/// @description Moves to the next phase and sets the phase timer.
+///
+///     Phases are laid out on the synchronized clock in rounds: each round
+///     is as long as all of the phases together and every phase has a fixed
+///     slot within it. Normally each phase runs for its whole duration and
+///     every ALIGNMENT_DURATION the phase is realigned to the slot the clock
+///     says it should be in.
+///
+///     In adaptive mode each phase instead runs until the end of its slot.
+///     A phase can start early, when the previous module ended its phase
+///     because it was idle, so it receives whatever time the earlier
+///     modules gave up. The ends of the phases stay on the slot boundaries,
+///     so nodes remain aligned. If a phase change is late (the previous
+///     deadline has passed) the phase is realigned to the clock instead.
+/// @pre The caller holds the scheduler lock and at least one module is
+///     registered.
+/// @post The phase has been changed.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::AdvancePhase()
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
     // Get the time without millisec and with millisec then see how many millsec we
     // are into this second.
-    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
-    now += CGlobalConfiguration::instance().GetClockSkew();
+    boost::posix_time::ptime now = CClock::instance().GetDGITime();
+    // Report how much of the phase that just ended was spent running tasks.
+    if(m_phaseallotted.total_microseconds() > 0 && m_phase < m_modules.size())
+    {
+        ModuleID ending = m_phaseModules[m_phase];
+        Logger.Info<<"Phase "<<m_modules[m_phase].first<<" used "
+                   <<m_phaseused.exchange(0)/1000.0<<" of "
+                   <<(now - m_phasestart).total_milliseconds()<<" ms"<<std::endl;
+        boost::lock_guard<boost::mutex> lock(m_metricsmutex);
+        m_metrics[ending].deferred += m_ready[ending]->Size();
+        if(m_adaptive && now < m_phasedeadline)
+        {
+            m_metrics[ending].shortened++;
+        }
+    }
+    PhaseMarker phase = m_phase + 1;
     boost::posix_time::time_duration time = now.time_of_day();
-    if(m_phase >= m_modules.size())
+    if(phase >= m_modules.size())
     {
-        m_phase = 0;
+        phase = 0;
     }
     unsigned int round = 0;
     for(unsigned int i=0; i < m_modules.size(); i++)
@@ -338,117 +758,243 @@ void CBroker::ChangePhase(const boost::system::error_code &err)
     //  round so far (considering all the time that would be used by other phases up
     //  to that point) then that phase is the current one.
     // Post: CPhase should be the current phase and tmp should be 
-    while(cphase < m_modules.size() && tmp < intoround)
+    while(cphase < m_modules.size() && tmp <= intoround)
     {
         cphase++;
         tmp += m_modules[cphase].second.total_milliseconds();
     }
     unsigned int remaining = tmp-intoround;
-    unsigned int sched_duration = m_modules[m_phase].second.total_milliseconds();
+    boost::posix_time::time_duration sched_duration = m_modules[phase].second;
+    if(m_adaptive && !m_phasedeadline.is_not_a_date_time() && now < m_phasedeadline
+        && m_phasedeadline + m_modules[phase].second - now
+            <= boost::posix_time::milliseconds(round))
+    {
+        // The previous phase ended early: this phase starts now but still
+        // ends on its own slot boundary. No phase may be given more than a
+        // round, so idle rounds cannot push the deadlines ever further ahead.
+        m_phasedeadline += m_modules[phase].second;
+        sched_duration = m_phasedeadline - now;
+    }
     // How we want to do this is that every so of tone we want to figure out
     // what phase it should be and then schedule that phase?
     // As an aside, you could tune alignment duration down to 0 so that every
     // phase is specifically assigned to a time slice.
-    if(now-m_last_alignment > boost::posix_time::milliseconds(ALIGNMENT_DURATION))
+    else if(m_adaptive || now-m_last_alignment > boost::posix_time::milliseconds(ALIGNMENT_DURATION))
     {
-        Logger.Notice<<"Aligned phase to "<<cphase<<" (was "<<m_phase<<") for "
-                   <<remaining<<" ms"<<std::endl;
-        m_phase = cphase;
+        if(phase != cphase)
+        {
+            Logger.Notice<<"Aligned phase to "<<cphase<<" (was "<<phase<<") for "
+                       <<remaining<<" ms"<<std::endl;
+        }
+        phase = cphase;
         m_last_alignment = now;
-        sched_duration = remaining;
+        sched_duration = boost::posix_time::milliseconds(remaining);
+        m_phasedeadline = now + sched_duration;
     }
-    if(m_modules.size() > 0)
+    m_phase = phase;
+    m_phasecount++;
+    m_phaseused = 0;
+    m_phasestart = now;
+    m_phaseallotted = sched_duration;
     {
-        Logger.Debug<<"Phase: "<<m_modules[m_phase].first<<std::endl;
+        ModuleID starting = m_phaseModules[phase];
+        boost::lock_guard<boost::mutex> lock(m_metricsmutex);
+        m_metrics[starting].phases++;
+        m_metrics[starting].depth.Record(m_ready[starting]->Size());
     }
+    Logger.Debug<<"Phase: "<<m_modules[phase].first<<std::endl;
     //If the worker isn't going, start him again when you change phases.
-    if(!m_busy)
+    StartWorker();
+    // In adaptive mode, check back once the module's minimum is up.
+    boost::posix_time::time_duration wait = sched_duration;
+    if(m_adaptive && m_phaseMinimums[phase] < wait)
     {
-        m_schmutex.unlock();
-        Worker();
-        m_schmutex.lock();
+        wait = m_phaseMinimums[phase];
     }
-    m_phasetimer.expires_from_now(boost::posix_time::milliseconds(sched_duration));
-    m_phasetimer.async_wait(boost::bind(&CBroker::ChangePhase,this,
-        boost::asio::placeholders::error));
-    m_schmutex.unlock();
+    m_phasetimer.expires_from_now(wait);
+    m_phasetimer.async_wait(boost::bind(&CBroker::HandlePhaseTimer, this,
+        boost::asio::placeholders::error, m_phasecount));
 }
-#pragma GCC diagnostic warning "-Wunused-parameter"
 
 ///////////////////////////////////////////////////////////////////////////////
-/// @fn CBroker::ScheduledTask
-/// @description When a timer for a task expires, it enters this phase. The
-///     timer is removed from the timers list. Then Execute is called to keep
-///     the work queue going.
-/// @pre A task is scheduled for execution
-/// @post The task is entered into th ready queue. 
+/// @fn CBroker::StartWorker
+/// @description Starts the worker if it is not already running. Only one
+///     worker is ever active, so tasks run one at a time in queue order no
+///     matter how many threads are servicing the ioservice.
+/// @pre None
+/// @post If the worker was idle, it has been posted to the ioservice.
 ///////////////////////////////////////////////////////////////////////////////
-void CBroker::ScheduledTask(CBroker::Scheduleable x, CBroker::TimerHandle handle,
-    const boost::system::error_code &err)
+void CBroker::StartWorker()
 {
-    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    m_schmutex.lock();
-    ModuleIdent module = m_allocs[handle];
-    Logger.Debug<<"Handle finished: "<<handle<<" For module "<<module<<std::endl;
-    // First, prepare another bind, which uses the given error
-    CBroker::BoundScheduleable y = boost::bind(x,err);
-    // Put it into the ready queue
-    m_ready[module].push_back(y);
-    Logger.Debug<<"Module "<<module<<" now has queue size: "<<m_ready[module].size()<<std::endl;
-    if(!m_busy)
+    bool idle = false;
+    if(m_busy.compare_exchange_strong(idle, true))
     {
-        m_schmutex.unlock();
-        Worker();
-    }
-    else
-    {
-        m_schmutex.unlock();
+        m_ioService.post(boost::bind(&CBroker::Worker, this));
     }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 /// @fn CBroker::Worker
-/// @description Reads the current phase and if the phase is correct, queues
-///     all the tasks for that phase to the ioservice. If m_busy is set, the 
-///     worker is still working on clearing the queue. If it's set to false,
-///     the worker needs to be started when the scheduled task is called
-/// @pre None
-/// @post A task is scheduled to run.
+/// @description Reads the current phase and if the phase is correct, hands
+///     the first task for that phase to the module's strand. If m_busy is set,
+///     the worker is still working on clearing the queue. If it's set to
+///     false, the worker needs to be started when the scheduled task is called
+/// @pre The worker was started by StartWorker or Execute. The worker is the
+///     only consumer of the ready queues.
+/// @post A task is scheduled to run on the active module's strand, or the
+///     worker is marked idle.
 ///////////////////////////////////////////////////////////////////////////////
 void CBroker::Worker()
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    m_schmutex.lock();
-    if(m_phase >= m_modules.size())
+    CClock::instance().Tick();
+    PhaseMarker phase = m_phase;
+    if(phase >= m_modules.size())
     {
         m_busy = false;
-        m_schmutex.unlock();
         return;
     }
-    std::string active = m_modules[m_phase].first;
-    if(m_ready[active].size() > 0)
+    ModuleID active = m_phaseModules[phase];
+    CBroker::ReadyTask x;
+    // Extract the first item from the work queue:
+    if(m_ready[active]->Pop(x))
     {
         Logger.Debug<<"Performing Job"<<std::endl;
-        // Mark that the worker has something to do
-        m_busy = true;
-        // Extract the first item from the work queue:
-        CBroker::BoundScheduleable x = m_ready[active].front();
-        m_ready[active].pop_front();
-        // Execute the task.
-        m_schmutex.unlock();
-        x();
-        m_schmutex.lock();
-        // Schedule the worker again:
-        m_ioService.post(boost::bind(&CBroker::Worker, this));
+        // Execute the task on the module's strand.
+        m_strands[active]->dispatch(boost::bind(&CBroker::Execute, this, x, phase));
+        return;
     }
-    else
+    m_busy = false;
+    Logger.Debug<<"Worker Idle"<<std::endl;
+    // A task may have been queued (or the phase changed) after the queue was
+    // found empty but before the worker was marked idle.
+    if(!m_ready[active]->Empty() || m_phase != phase)
     {
-        m_busy = false;
-        Logger.Debug<<"Worker Idle"<<std::endl;
+        StartWorker();
+    }
+    else if(m_adaptive)
+    {
+        // The module may be able to give the rest of its phase away.
+        m_ioService.post(boost::bind(&CBroker::EndPhase, this));
     }
-    m_schmutex.unlock();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::Execute
+/// @description Runs the given task and then keeps draining the module's
+///     queue until it is empty, the batch budget is spent, or the phase
+///     changes. The worker is then rescheduled so the ioservice can handle
+///     other completions before the next batch.
+/// @pre Called from within the strand of the module that owns the phase.
+/// @post The batch has run, its duration is charged to the phase, and the
+///     worker has been posted again.
+/// @param x The first task of the batch.
+/// @param phase The phase the batch was started in.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::Execute(CBroker::ReadyTask x, CBroker::PhaseMarker phase)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    boost::posix_time::ptime start = CClock::instance().GetMonotonicTime();
+    boost::posix_time::ptime now = start, began;
+    boost::posix_time::time_duration elapsed;
+    ModuleID active = m_phaseModules[phase];
+    unsigned int tasks = 0;
+    do
+    {
+        began = now;
+        x.task();
+        tasks++;
+        now = CClock::instance().GetMonotonicTime();
+        elapsed = now - start;
+        boost::lock_guard<boost::mutex> lock(m_metricsmutex);
+        m_metrics[active].latency.Record(Microseconds(began - x.queued));
+        m_metrics[active].execution.Record(Microseconds(now - began));
+    }
+    while(elapsed < m_budget && m_phase == phase && m_ready[active]->Pop(x));
+    m_phaseused += elapsed.total_microseconds();
+    {
+        boost::lock_guard<boost::mutex> lock(m_metricsmutex);
+        m_metrics[active].tasks += tasks;
+        if(m_phase != phase)
+        {
+            m_metrics[active].overruns++;
+        }
+    }
+    Logger.Debug<<"Ran "<<tasks<<" task(s) in "<<elapsed.total_microseconds()
+                <<" us"<<std::endl;
+    // Schedule the worker again:
+    m_ioService.post(boost::bind(&CBroker::Worker, this));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::GetMetrics
+/// @description Copies the scheduler statistics of one module. Latency and
+///     execution times are in microseconds.
+/// @pre None
+/// @post None
+/// @param m The name of the module.
+/// @return The statistics gathered since the module was first named.
+/// @limitations Throws std::runtime_error if the module is not registered.
+///////////////////////////////////////////////////////////////////////////////
+CBroker::ModuleMetrics CBroker::GetMetrics(CBroker::ModuleIdent m)
+{
+    ModuleID id = GetModuleID(m);
+    boost::lock_guard<boost::mutex> lock(m_metricsmutex);
+    return m_metrics[id];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::PrintMetrics
+/// @description Writes the scheduler statistics of every module: the task,
+///     phase, deferral and overrun counters and the latency, execution time
+///     and queue depth distributions.
+/// @pre None
+/// @post None
+/// @param out The stream to write the statistics to.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::PrintMetrics(std::ostream & out)
+{
+    boost::lock_guard<boost::mutex> lock(m_metricsmutex);
+    out << "Scheduler metrics:" << std::endl;
+    for(unsigned int i = 0; i < m_metrics.size(); i++)
+    {
+        const ModuleMetrics & mm = m_metrics[i];
+        out << m_moduleNames[i] << ": tasks=" << mm.tasks
+            << " phases=" << mm.phases << " shortened=" << mm.shortened
+            << " deferred=" << mm.deferred
+            << " overruns=" << mm.overruns << std::endl
+            << "\tlatency (us): " << mm.latency << std::endl
+            << "\texecution (us): " << mm.execution << std::endl
+            << "\tqueue depth: " << mm.depth << std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::LogMetrics
+/// @description Writes the scheduler statistics of every module to the log.
+/// @pre None
+/// @post None
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::LogMetrics()
+{
+    std::stringstream ss;
+    PrintMetrics(ss);
+    Logger.Status << ss.str() << std::flush;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CBroker::SetMetricsReporter
+/// @description Sets a function to run on the ioservice thread whenever
+///              SIGUSR1 asks for the metrics, such as one which writes the
+///              metrics registry to a file for a local scraper.
+/// @pre The broker is not running yet.
+/// @post The reporter runs on every SIGUSR1.
+/// @param reporter The function to run.
+///////////////////////////////////////////////////////////////////////////////
+void CBroker::SetMetricsReporter(BoundScheduleable reporter)
+{
+    m_reporter = reporter;
+}
 
     } // namespace broker
 } // namespace freedm
@@ -0,0 +1,271 @@
+//////////////////////////////////////////////////////////
+/// @file         CCallTable.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Matches the replies of peers to the calls waiting on them
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CCallTable.hpp"
+
+#include <vector>
+
+#include <boost/thread/locks.hpp>
+
+namespace freedm {
+
+namespace broker {
+
+namespace {
+
+/// Where a message carries its call id: beside the fields of its module.
+std::string CallIDPath(const CMessage & msg)
+{
+    std::string handler = msg.GetHandler();
+    return handler.substr(0, handler.find('.')) + ".callid";
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CCallTable::CCallTable
+/// @description Creates a table with no calls.
+/// @pre None
+/// @post No call is open.
+///////////////////////////////////////////////////////////////////////////////
+CCallTable::CCallTable()
+    : m_lastID(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CCallTable::Open
+/// @description Opens a call which waits for a reply from each peer. A call
+///     to no peers has nothing to wait for and completes at once.
+/// @pre None
+/// @post The call is open until every peer replies or the deadline passes.
+/// @param peers The uuids of the peers the request is sent to.
+/// @param deadline When the call completes without the missing replies.
+/// @param done Runs once when the call completes.
+/// @return The id to send in the request.
+///////////////////////////////////////////////////////////////////////////////
+CCallTable::CallID CCallTable::Open(const std::set<std::string> & peers,
+        boost::posix_time::ptime deadline, Completion done)
+{
+    Call call;
+    call.deadline = deadline;
+    call.done = done;
+    call.result.missing = peers;
+    CallID id;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        do
+        {
+            id = ++m_lastID;
+        } while(id == 0 || m_calls.count(id) > 0);
+        if(!peers.empty())
+        {
+            m_calls[id] = call;
+            m_deadlines.insert(std::make_pair(deadline, id));
+            return id;
+        }
+    }
+    Complete(call);
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CCallTable::Answer
+/// @description Records a reply to the call whose id it carries. The call
+///     completes if this was the last reply it was waiting for.
+/// @pre None
+/// @post The reply is part of the call's result if the call was waiting on
+///     the peer.
+/// @param reply The reply, carrying the id of the call.
+/// @param uuid The peer which sent the reply.
+/// @return False if no open call was waiting on this peer, as for a late or
+///     repeated reply.
+///////////////////////////////////////////////////////////////////////////////
+bool CCallTable::Answer(const CMessage & reply, const std::string & uuid)
+{
+    Call finished;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        std::map<CallID, Call>::iterator it = m_calls.find(GetCallID(reply));
+        if(it == m_calls.end() || it->second.result.missing.erase(uuid) == 0)
+        {
+            return false;
+        }
+        it->second.result.replies[uuid] = reply;
+        if(!it->second.result.missing.empty())
+        {
+            return true;
+        }
+        finished = it->second;
+        m_deadlines.erase(std::make_pair(finished.deadline, it->first));
+        m_calls.erase(it);
+    }
+    Complete(finished);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CCallTable::Cancel
+/// @description Drops a call, whose completion will not run.
+/// @pre None
+/// @post The call is not open.
+/// @param id The call to drop.
+/// @return True if the call was open.
+///////////////////////////////////////////////////////////////////////////////
+bool CCallTable::Cancel(CallID id)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    std::map<CallID, Call>::iterator it = m_calls.find(id);
+    if(it == m_calls.end())
+    {
+        return false;
+    }
+    m_deadlines.erase(std::make_pair(it->second.deadline, id));
+    m_calls.erase(it);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CCallTable::IsOpen
+/// @description Checks whether a call is still waiting on replies.
+/// @param id The call to check.
+/// @return True if the call has neither completed nor been cancelled.
+///////////////////////////////////////////////////////////////////////////////
+bool CCallTable::IsOpen(CallID id) const
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_calls.count(id) > 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CCallTable::Expire
+/// @description Completes every call whose deadline has passed, soonest
+///     deadline first, with the replies it has.
+/// @pre None
+/// @post No open call has a deadline at or before the time.
+/// @param now The current time, on the clock the deadlines were set by.
+///////////////////////////////////////////////////////////////////////////////
+void CCallTable::Expire(boost::posix_time::ptime now)
+{
+    std::vector<Call> expired;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        while(!m_deadlines.empty() && m_deadlines.begin()->first <= now)
+        {
+            std::map<CallID, Call>::iterator it =
+                    m_calls.find(m_deadlines.begin()->second);
+            expired.push_back(it->second);
+            m_calls.erase(it);
+            m_deadlines.erase(m_deadlines.begin());
+        }
+    }
+    for(unsigned int i = 0; i < expired.size(); i++)
+    {
+        Complete(expired[i]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CCallTable::GetNextDeadline
+/// @description Finds when the next call will expire if not answered.
+/// @return The earliest deadline of an open call, or not_a_date_time if no
+///     call is open.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::ptime CCallTable::GetNextDeadline() const
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if(m_deadlines.empty())
+    {
+        return boost::posix_time::not_a_date_time;
+    }
+    return m_deadlines.begin()->first;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CCallTable::Stamp
+/// @description Puts a call's id in a request, beside the fields of the
+///     module named by the request's handler.
+/// @pre The request's handler is set.
+/// @post The request carries the id.
+/// @param request The request to stamp.
+/// @param id The call the request is for.
+///////////////////////////////////////////////////////////////////////////////
+void CCallTable::Stamp(CMessage & request, CallID id)
+{
+    request.m_submessages.put(CallIDPath(request), id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CCallTable::Correlate
+/// @description Copies the call id of a request, if it has one, to the
+///     reply, so the caller can match the reply to its call.
+/// @pre The reply's handler is set.
+/// @post The reply carries the request's id.
+/// @param request The request being answered.
+/// @param reply The answer to send back.
+///////////////////////////////////////////////////////////////////////////////
+void CCallTable::Correlate(const CMessage & request, CMessage & reply)
+{
+    CallID id = GetCallID(request);
+    if(id != 0)
+    {
+        Stamp(reply, id);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CCallTable::GetCallID
+/// @description Reads the call id a request or reply carries.
+/// @param msg The message to read.
+/// @return The id, or zero if the message carries none.
+///////////////////////////////////////////////////////////////////////////////
+CCallTable::CallID CCallTable::GetCallID(const CMessage & msg)
+{
+    return msg.m_submessages.get<CallID>(CallIDPath(msg), 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CCallTable::Complete
+/// @description Runs the completion of a call with what it gathered.
+/// @pre The call has been removed from the table, which is unlocked.
+/// @post The completion has run.
+/// @param call The call to complete.
+///////////////////////////////////////////////////////////////////////////////
+void CCallTable::Complete(const Call & call)
+{
+    if(call.done)
+    {
+        call.done(call.result);
+    }
+}
+
+} // namespace broker
+
+} // namespace freedm
@@ -0,0 +1,194 @@
+//////////////////////////////////////////////////////////
+/// @file         CClock.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  The broker clock service
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CClock.hpp"
+#include "CGlobalConfiguration.hpp"
+
+#include <ctime>
+
+#include <boost/date_time/c_local_time_adjustor.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace freedm {
+
+namespace broker {
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSystemClockSource::GetMonotonicTime
+/// @description Reads CLOCK_MONOTONIC, which is unaffected by changes to the
+///     system clock.
+/// @return The time since an unspecified point, as an offset from the epoch.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::ptime CSystemClockSource::GetMonotonicTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return boost::posix_time::from_time_t(ts.tv_sec) +
+        boost::posix_time::microseconds(ts.tv_nsec / 1000);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSystemClockSource::GetWallTime
+/// @description Reads the system clock.
+/// @return The current time in UTC.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::ptime CSystemClockSource::GetWallTime()
+{
+    return boost::posix_time::microsec_clock::universal_time();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClock::instance
+/// @description Returns the clock, creating it on first use.
+/// @return The singleton instance of the clock.
+///////////////////////////////////////////////////////////////////////////////
+CClock& CClock::instance()
+{
+    static CClock instance;
+    return instance;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClock::CClock
+/// @description Starts the clock on the system time source.
+/// @pre None
+/// @post The clock reads the operating system clocks.
+///////////////////////////////////////////////////////////////////////////////
+CClock::CClock()
+    : m_cached(0)
+{
+    SetSource(boost::shared_ptr<IClockSource>());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClock::SetSource
+/// @description Installs a time source and takes a new wall clock reading to
+///     anchor the DGI time to.
+/// @pre The broker is not running.
+/// @post Every time is read from the new source, and the cached times are
+///     current.
+/// @param source The new source, or an empty pointer for the system clocks.
+///////////////////////////////////////////////////////////////////////////////
+void CClock::SetSource(boost::shared_ptr<IClockSource> source)
+{
+    if(!source)
+    {
+        source.reset(new CSystemClockSource);
+    }
+    m_source = source;
+    m_monotonicbase = m_source->GetMonotonicTime();
+    m_wallbase = m_source->GetWallTime();
+    typedef boost::date_time::c_local_adjustor<boost::posix_time::ptime> Local;
+    m_localoffset = Local::utc_to_local(m_wallbase) - m_wallbase;
+    Tick();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClock::Tick
+/// @description Reads the source and stores the result for the cached reads.
+/// @pre None
+/// @post The cached times are current.
+///////////////////////////////////////////////////////////////////////////////
+void CClock::Tick()
+{
+    boost::posix_time::time_duration elapsed =
+        m_source->GetMonotonicTime() - m_monotonicbase;
+    m_cached.store(elapsed.total_microseconds(), boost::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClock::GetMonotonicTime
+/// @description Reads the monotonic time from the source.
+/// @return A time which never decreases. Only differences are meaningful.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::ptime CClock::GetMonotonicTime()
+{
+    return m_source->GetMonotonicTime();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClock::GetCachedTime
+/// @description Returns the monotonic time stored by the last Tick.
+/// @return The monotonic time of the last Tick.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::ptime CClock::GetCachedTime() const
+{
+    return m_monotonicbase +
+        boost::posix_time::microseconds(m_cached.load(boost::memory_order_relaxed));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClock::GetDGITime
+/// @description Reads the time which the DGI nodes agree upon.
+/// @return The current wall time, advanced monotonically, plus the skew.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::ptime CClock::GetDGITime()
+{
+    return ToWallTime(GetMonotonicTime()) +
+        CGlobalConfiguration::instance().GetClockSkew();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClock::GetCachedDGITime
+/// @description Returns the DGI time as of the last Tick.
+/// @return The DGI time of the last Tick.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::ptime CClock::GetCachedDGITime() const
+{
+    return ToWallTime(GetCachedTime()) +
+        CGlobalConfiguration::instance().GetClockSkew();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClock::GetLocalTime
+/// @description Reads the wall time in the local time zone. The time zone is
+///     looked up once, when the source is installed.
+/// @return The current local time.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::ptime CClock::GetLocalTime()
+{
+    return ToWallTime(GetMonotonicTime()) + m_localoffset;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClock::ToWallTime
+/// @description Maps a monotonic time onto the wall clock reading taken when
+///     the source was installed.
+/// @param monotonic A time read from the monotonic clock.
+/// @return The corresponding UTC time.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::ptime CClock::ToWallTime(boost::posix_time::ptime monotonic) const
+{
+    return m_wallbase + (monotonic - m_monotonicbase);
+}
+
+} // namespace broker
+
+} // namespace freedm
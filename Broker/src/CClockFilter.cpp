@@ -0,0 +1,118 @@
+//////////////////////////////////////////////////////////
+/// @file         CClockFilter.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Estimates clock offsets from request and reply timestamps
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CClockFilter.hpp"
+
+namespace freedm {
+    namespace broker {
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClockFilter::Measure
+/// @description Computes the offset and delay of one exchange.
+/// @param t1 When the request was sent, by the local clock.
+/// @param t2 When the request was received, by the remote clock.
+/// @param t3 When the reply was sent, by the remote clock.
+/// @param t4 When the reply was received, by the local clock.
+/// @return The remote clock's offset and the round trip delay.
+///////////////////////////////////////////////////////////////////////////////
+CClockFilter::Sample CClockFilter::Measure(boost::posix_time::ptime t1,
+        boost::posix_time::ptime t2, boost::posix_time::ptime t3,
+        boost::posix_time::ptime t4)
+{
+    Sample s;
+    s.offset = ((t2 - t1) + (t3 - t4)) / 2;
+    s.delay = (t4 - t1) - (t3 - t2);
+    return s;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClockFilter::CClockFilter
+/// @description Creates a filter with no measurements.
+/// @param maxDelay The longest round trip delay a measurement may have.
+/// @param window How many of the most recent measurements are kept.
+///////////////////////////////////////////////////////////////////////////////
+CClockFilter::CClockFilter(boost::posix_time::time_duration maxDelay,
+        unsigned int window)
+    : m_maxDelay(maxDelay)
+    , m_window(window)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClockFilter::Add
+/// @description Keeps a measurement, dropping the oldest once the window is
+///     full. A measurement slower than the limit says little about the
+///     offset and is not kept.
+/// @pre None
+/// @post The measurement is in the window if its delay is within the limit.
+/// @param sample The measurement.
+/// @return False if the measurement was dropped.
+///////////////////////////////////////////////////////////////////////////////
+bool CClockFilter::Add(const Sample & sample)
+{
+    if(sample.delay > m_maxDelay || sample.delay.is_negative())
+    {
+        return false;
+    }
+    m_samples.push_back(sample);
+    if(m_samples.size() > m_window)
+    {
+        m_samples.pop_front();
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CClockFilter::GetBest
+/// @description Finds the kept measurement with the least delay, whose
+///     offset has the smallest error bound.
+/// @param best Set to the measurement found.
+/// @return False if no measurement is kept.
+///////////////////////////////////////////////////////////////////////////////
+bool CClockFilter::GetBest(Sample & best) const
+{
+    if(m_samples.empty())
+    {
+        return false;
+    }
+    std::deque<Sample>::const_iterator it = m_samples.begin();
+    best = *it;
+    for(++it; it != m_samples.end(); ++it)
+    {
+        if(it->delay < best.delay)
+        {
+            best = *it;
+        }
+    }
+    return true;
+}
+
+    } // namespace broker
+} // namespace freedm
@@ -41,6 +41,10 @@
 #include "CSUConnection.hpp"
 #include "config.hpp"
 #include "CLogger.hpp"
+#include "CMetricsRegistry.hpp"
+#include "CPacketTimestamps.hpp"
+
+#include <cerrno>
 
 #include <vector>
 
@@ -56,6 +60,13 @@ namespace {
 /// This file's logger.
 CLocalLogger Logger(__FILE__);
 
+/// Messages given to the protocols for a remote peer.
+CMetricsRegistry::Counter & SentMessages =
+        CMetricsRegistry::instance().GetCounter("net.messages.sent");
+
+/// The number of clock requests whose send times are kept.
+const std::size_t CLOCK_REQUESTS_KEPT = 16;
+
 }
         
 ///////////////////////////////////////////////////////////////////////////////
@@ -74,6 +85,7 @@ CLocalLogger Logger(__FILE__);
 CConnection::CConnection(boost::asio::io_service& p_ioService,
   CConnectionManager& p_manager, CBroker& p_broker, std::string uuid)
   : CReliableConnection(p_ioService,p_manager,p_broker,uuid)
+  , m_sendStamps(STAMPS_UNTRIED)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
     m_protocols.insert(ProtocolMap::value_type(CSUConnection::Identifier(),
@@ -145,13 +157,31 @@ void CConnection::Send(CMessage & p_mesg)
         return;
     }
 
-    ProtocolMap::iterator sit = m_protocols.find(p_mesg.GetProtocol());    
+    SentMessages.fetch_add(1, boost::memory_order_relaxed);
+    // The protocol windows are shared with the listener and the retransmit
+    // timers, so the send is serialized through this connection's strand.
+    GetStrand().dispatch(boost::bind(&CConnection::HandleSend,
+        boost::static_pointer_cast<CConnection>(shared_from_this()), p_mesg));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CConnection::HandleSend
+/// @description Passes the message to the protocol it requests (or the
+///   default protocol if it does not name a known one).
+/// @pre Called from within the connection strand.
+/// @post The protocol has accepted the message into its send window.
+/// @param msg The message to write to the channel.
+///////////////////////////////////////////////////////////////////////////////
+void CConnection::HandleSend(CMessage msg)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    ProtocolMap::iterator sit = m_protocols.find(msg.GetProtocol());    
     
     if(sit == m_protocols.end())
     {
         sit = m_protocols.find(m_defaultprotocol);
     }
-    (*sit).second->Send(p_mesg);
+    (*sit).second->Send(msg);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -199,5 +229,80 @@ bool CConnection::Recieve(const CMessage &msg)
     return false;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CConnection::SendClockRequest
+/// @description Writes a clock request to the socket. Where the kernel can
+///   stamp the datagram as it leaves, the stamp is kept so the requester can
+///   measure the round trip without the time spent in the network stack.
+/// @pre Called from within the connection strand on a connected socket.
+/// @post The request has been written, and its kernel send time kept if the
+///   kernel stamped it.
+/// @param data The serialized request.
+/// @param length The size of the request.
+/// @param queued The send timestamp of the request, which the reply echoes.
+/// @throw boost::system::system_error if the write fails.
+///////////////////////////////////////////////////////////////////////////////
+void CConnection::SendClockRequest(const char * data, std::size_t length,
+        boost::posix_time::ptime queued)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    int fd = GetSocket().native_handle();
+    if(m_sendStamps == STAMPS_UNTRIED)
+    {
+        m_sendStamps = CPacketTimestamps::EnableSend(fd) ? STAMPS_ON : STAMPS_OFF;
+    }
+    if(m_sendStamps == STAMPS_ON)
+    {
+        boost::posix_time::ptime sent;
+        if(CPacketTimestamps::Send(fd, data, length, sent) >= 0)
+        {
+            if(!sent.is_not_a_date_time())
+            {
+                boost::mutex::scoped_lock lock(m_clockMutex);
+                m_clockRequests.push_back(std::make_pair(queued, sent));
+                if(m_clockRequests.size() > CLOCK_REQUESTS_KEPT)
+                {
+                    m_clockRequests.pop_front();
+                }
+            }
+            return;
+        }
+        if(errno != EINVAL)
+        {
+            throw boost::system::system_error(errno,
+                boost::system::system_category());
+        }
+        // Kernels before 4.13 cannot stamp a single datagram
+        Logger.Info << "Kernel send timestamps are unavailable" << std::endl;
+        m_sendStamps = STAMPS_OFF;
+    }
+    GetSocket().send(boost::asio::buffer(data, length));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CConnection::GetClockRequestSent
+/// @description Looks up the kernel send time of a recent clock request. A
+///   resent request keeps its queue time, so the latest send is returned.
+/// @pre None.
+/// @post None.
+/// @param queued The send timestamp of the request.
+/// @param sent Set to the time the kernel sent the request, if known.
+/// @return True if the kernel send time is known.
+///////////////////////////////////////////////////////////////////////////////
+bool CConnection::GetClockRequestSent(boost::posix_time::ptime queued,
+        boost::posix_time::ptime & sent)
+{
+    boost::mutex::scoped_lock lock(m_clockMutex);
+    for(std::size_t i = m_clockRequests.size(); i > 0; i--)
+    {
+        if(m_clockRequests[i-1].first == queued)
+        {
+            sent = m_clockRequests[i-1].second;
+            return true;
+        }
+    }
+    return false;
+}
+
     } // namespace broker
 } // namespace freedm
@@ -144,9 +144,12 @@ void CConnectionManager::PutHostname(std::string u_, remotehost host_)
 void CConnectionManager::Stop (CConnection::ConnectionPtr c)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    if(m_connections.right.count(c))
     {
-        m_connections.right.erase(c);
+        boost::lock_guard< boost::mutex > scopedLock_( m_Mutex );
+        if(m_connections.right.count(c))
+        {
+            m_connections.right.erase(c);
+        }
     }
     c->Stop();
 }
@@ -196,6 +199,7 @@ void CConnectionManager::StopAll ()
 ///////////////////////////////////////////////////////////////////////////////
 remotehost CConnectionManager::GetHostnameByUUID(std::string uuid) const
 {
+    boost::lock_guard< boost::mutex > scopedLock_( m_Mutex );
     if(m_hostnames.count(uuid))
     {
         return m_hostnames.find(uuid)->second;
@@ -225,25 +229,26 @@ ConnectionPtr CConnectionManager::GetConnectionByUUID(std::string uuid_)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
 
-    ConnectionPtr c_;  
+    ConnectionPtr c_, stale_;
     std::string s_,port;
 
+    // The listener and every module may ask for connections at once.
+    boost::unique_lock< boost::mutex > lock_( m_Mutex );
+
     // See if there is a connection in the open connections already
     if(m_connections.left.count(uuid_))
     {
         if(m_connections.left.at(uuid_)->GetSocket().is_open())
         {
-            #ifdef CUSTOMNETWORK
-            LoadNetworkConfig();
-            #endif
             return m_connections.left.at(uuid_);
         }
         else
         {
             Logger.Warn <<" Connection to " << uuid_ << " has gone stale " << std::endl;
             //The socket is not marked as open anymore, we
-            //should stop it.
-            Stop(m_connections.left.at(uuid_));
+            //should stop it (once the lock has been released).
+            stale_ = m_connections.left.at(uuid_);
+            m_connections.left.erase(uuid_);
         }
     }  
 
@@ -255,6 +260,11 @@ ConnectionPtr CConnectionManager::GetConnectionByUUID(std::string uuid_)
     if(mapIt_ == m_hostnames.end())
     {
         Logger.Warn<<"Couldn't find peer in host list"<<std::endl;
+        lock_.unlock();
+        if(stale_)
+        {
+            stale_->Stop();
+        }
         return ConnectionPtr();
     }
     s_ = mapIt_->second.hostname;
@@ -273,37 +283,13 @@ ConnectionPtr CConnectionManager::GetConnectionByUUID(std::string uuid_)
 
     //Once the connection is built, connection manager gets a call back to register it.    
     Logger.Debug<<"Inserting connection"<<std::endl;
-    PutConnection(uuid_,c_);
-    #ifdef CUSTOMNETWORK
-    LoadNetworkConfig();
-    #endif
-    return c_;
-}
-
-///////////////////////////////////////////////////////////////////////////////
-/// @fn CConnectionManager::LoadNetworkConfig
-/// @description Accesses the network.xml file and parses it, setting the
-///   network reliability for all specified interfaces. Only enabled with the
-///   -DCUSTOMNETWORK compile option
-/// @pre None
-/// @post All connections in the file are modified to behave as specified.
-///////////////////////////////////////////////////////////////////////////////
-void CConnectionManager::LoadNetworkConfig()
-{
-    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    boost::property_tree::ptree pt;
-    boost::property_tree::read_xml("network.xml",pt);    
-    int inreliability = pt.get("network.incoming.reliability",100);
-    m_inchannel->SetReliability(inreliability); 
-    BOOST_FOREACH(ptree::value_type & child, pt.get_child("network.outgoing"))
+    m_connections.insert(connectionmap::value_type(uuid_,c_));
+    lock_.unlock();
+    if(stale_)
     {
-        std::string uuid = child.second.get<std::string>("<xmlattr>.uuid");
-        int reliability = child.second.get<int>("reliability");
-        if(m_connections.left.count(uuid) != 0)
-        {
-            m_connections.left.at(uuid)->SetReliability(reliability);
-        }
-    }  
+        stale_->Stop();
+    }
+    return c_;
 }
 
 } // namespace broker
@@ -0,0 +1,361 @@
+//////////////////////////////////////////////////////////
+/// @file         CEventLog.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  A memory-mapped log of fixed-layout binary events
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CEventLog.hpp"
+#include "CClock.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace freedm {
+
+namespace broker {
+
+namespace {
+
+/// The first bytes of every event log.
+const char MAGIC[8] = { 'F', 'R', 'E', 'E', 'D', 'M', 'E', 'V' };
+
+/// The version of the record layout written by this broker.
+const boost::uint32_t VERSION = 1;
+
+/// The descriptions of the events, indexed by event.
+const CEventLog::EventInfo EVENTS[CEventLog::EVENT_COUNT] = {
+    { "unknown", 0, { 0 } },
+    { "gm.state", 4, { "group", "leader", "members", "fids" } },
+    { "gm.group_changed", 2, { "group", "leader" } },
+    { "lb.load_table", 6,
+        { "state", "generation", "storage", "load", "gateway", "normal" } },
+    { "lb.migration", 3, { "peer", "demand", "supplying" } },
+    { "sc.snapshot", 1, { "value" } },
+    { "sc.collected", 2, { "states", "intransit" } }
+};
+
+/// The names of the modules, indexed by module.
+const char * const MODULES[] = { "broker", "gm", "lb", "sc" };
+
+/// Orders records by time, then by sequence.
+bool EarlierRecord(const CEventLog::Record & a, const CEventLog::Record & b)
+{
+    if(a.s_time != b.s_time)
+    {
+        return a.s_time < b.s_time;
+    }
+    return a.s_sequence < b.s_sequence;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CEventLog::instance
+/// @description Returns the log, creating it closed on first use.
+/// @return The singleton instance of the log.
+///////////////////////////////////////////////////////////////////////////////
+CEventLog& CEventLog::instance()
+{
+    static CEventLog log;
+    return log;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CEventLog::CEventLog
+/// @description Creates a closed log.
+/// @pre None
+/// @post Events are discarded until Open is called.
+///////////////////////////////////////////////////////////////////////////////
+CEventLog::CEventLog()
+    : m_records(0)
+    , m_capacity(0)
+    , m_next(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CEventLog::~CEventLog
+/// @description Flushes and unmaps the file if it is open.
+/// @pre None
+/// @post The log is closed.
+///////////////////////////////////////////////////////////////////////////////
+CEventLog::~CEventLog()
+{
+    Close();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CEventLog::Open
+/// @description Creates a file large enough for the header and the ring,
+///     maps it and writes the header.
+/// @pre None
+/// @post Events are recorded to the file, starting at its first slot.
+/// @param filename The file to create; an existing file is replaced.
+/// @param uuid The UUID of this node, stored in the header.
+/// @param capacity The number of records in the ring.
+/// @ErrorHandling Throws std::runtime_error if the capacity is zero and
+///     boost::interprocess::interprocess_exception if the file cannot be
+///     created or mapped.
+///////////////////////////////////////////////////////////////////////////////
+void CEventLog::Open(const std::string & filename, const std::string & uuid,
+        unsigned int capacity)
+{
+    namespace ip = boost::interprocess;
+    if(capacity == 0)
+    {
+        throw std::runtime_error("The event log needs at least one record.");
+    }
+    Close();
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+
+    std::size_t size = sizeof(Header) + capacity * sizeof(Record);
+    {
+        std::filebuf file;
+        if(!file.open(filename.c_str(), std::ios::in | std::ios::out
+                | std::ios::trunc | std::ios::binary))
+        {
+            throw std::runtime_error("Unable to create " + filename);
+        }
+        file.pubseekoff(size - 1, std::ios::beg);
+        file.sputc(0);
+    }
+    ip::file_mapping file(filename.c_str(), ip::read_write);
+    m_region.reset(new ip::mapped_region(file, ip::read_write));
+
+    Header * header = static_cast<Header *>(m_region->get_address());
+    std::memcpy(header->s_magic, MAGIC, sizeof(MAGIC));
+    header->s_version = VERSION;
+    header->s_recordSize = sizeof(Record);
+    header->s_capacity = capacity;
+    std::strncpy(header->s_uuid, uuid.c_str(), sizeof(header->s_uuid) - 1);
+
+    m_capacity = capacity;
+    m_next.store(0, boost::memory_order_relaxed);
+    m_records.store(reinterpret_cast<Record *>(header + 1),
+            boost::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CEventLog::Close
+/// @description Stops recording, then flushes and unmaps the file.
+/// @pre No other thread is writing an event.
+/// @post Events are discarded.
+///////////////////////////////////////////////////////////////////////////////
+void CEventLog::Close()
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_records.store(0, boost::memory_order_release);
+    if(m_region)
+    {
+        m_region->flush();
+        m_region.reset();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CEventLog::WriteArray
+/// @description Reserves the next slot of the ring and fills it. The
+///     sequence number is cleared first and set last, so a slot which was
+///     being written when the broker stopped is skipped by Read.
+/// @pre None
+/// @post If the log is open, the event is in the file.
+/// @param module The module recording the event.
+/// @param event The event to record.
+/// @param argc The number of arguments; any beyond MAX_ARGS are ignored.
+/// @param args The arguments of the event.
+///////////////////////////////////////////////////////////////////////////////
+void CEventLog::WriteArray(Module module, Event event, unsigned int argc,
+        const double * args)
+{
+    static const boost::posix_time::ptime EPOCH(
+            boost::gregorian::date(1970, 1, 1));
+    Record * records = m_records.load(boost::memory_order_acquire);
+    if(records == 0)
+    {
+        return;
+    }
+    boost::uint64_t slot = m_next.fetch_add(1, boost::memory_order_relaxed);
+    Record & record = records[slot % m_capacity];
+    record.s_sequence = 0;
+    boost::atomic_thread_fence(boost::memory_order_release);
+
+    record.s_time = (CClock::instance().GetDGITime() - EPOCH)
+            .total_microseconds();
+    record.s_event = event;
+    record.s_module = module;
+    record.s_argc = std::min(argc, MAX_ARGS);
+    for(unsigned int i = 0; i < MAX_ARGS; i++)
+    {
+        record.s_args[i] = i < record.s_argc ? args[i] : 0.0;
+    }
+    boost::atomic_thread_fence(boost::memory_order_release);
+    record.s_sequence = slot + 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CEventLog::Write
+/// @description Records an event whose arguments are listed in the call;
+///     these forward to WriteArray.
+///////////////////////////////////////////////////////////////////////////////
+void CEventLog::Write(Module module, Event event)
+{
+    WriteArray(module, event, 0, 0);
+}
+
+void CEventLog::Write(Module module, Event event, double a0)
+{
+    WriteArray(module, event, 1, &a0);
+}
+
+void CEventLog::Write(Module module, Event event, double a0, double a1)
+{
+    double args[] = { a0, a1 };
+    WriteArray(module, event, 2, args);
+}
+
+void CEventLog::Write(Module module, Event event, double a0, double a1,
+        double a2)
+{
+    double args[] = { a0, a1, a2 };
+    WriteArray(module, event, 3, args);
+}
+
+void CEventLog::Write(Module module, Event event, double a0, double a1,
+        double a2, double a3)
+{
+    double args[] = { a0, a1, a2, a3 };
+    WriteArray(module, event, 4, args);
+}
+
+void CEventLog::Write(Module module, Event event, double a0, double a1,
+        double a2, double a3, double a4, double a5)
+{
+    double args[] = { a0, a1, a2, a3, a4, a5 };
+    WriteArray(module, event, 6, args);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CEventLog::Read
+/// @description Maps a file written by Open, checks its header and copies
+///     out every completed record.
+/// @param filename The file to read.
+/// @param records Receives the records sorted by time.
+/// @return The header of the file.
+/// @ErrorHandling Throws std::runtime_error if the file is not an event log
+///     of this version and boost::interprocess::interprocess_exception if it
+///     cannot be mapped.
+///////////////////////////////////////////////////////////////////////////////
+CEventLog::Header CEventLog::Read(const std::string & filename,
+        std::vector<Record> & records)
+{
+    namespace ip = boost::interprocess;
+    ip::file_mapping file(filename.c_str(), ip::read_only);
+    ip::mapped_region region(file, ip::read_only);
+
+    const Header * header = static_cast<const Header *>(region.get_address());
+    if(region.get_size() < sizeof(Header)
+        || std::memcmp(header->s_magic, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        throw std::runtime_error(filename + " is not an event log.");
+    }
+    if(header->s_version != VERSION || header->s_recordSize != sizeof(Record)
+        || region.get_size() < sizeof(Header)
+            + header->s_capacity * sizeof(Record))
+    {
+        throw std::runtime_error(filename + " has an unsupported layout.");
+    }
+
+    Header result = *header;
+    result.s_uuid[sizeof(result.s_uuid) - 1] = '\0';
+    const Record * first = reinterpret_cast<const Record *>(header + 1);
+    records.clear();
+    for(boost::uint64_t i = 0; i < header->s_capacity; i++)
+    {
+        if(first[i].s_sequence != 0)
+        {
+            records.push_back(first[i]);
+        }
+    }
+    std::sort(records.begin(), records.end(), &EarlierRecord);
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CEventLog::Hash
+/// @description Hashes a UUID with 32-bit FNV-1a, which a double holds
+///     exactly.
+/// @param uuid The UUID of a peer.
+/// @return The hash of the UUID.
+///////////////////////////////////////////////////////////////////////////////
+double CEventLog::Hash(const std::string & uuid)
+{
+    boost::uint32_t hash = 2166136261u;
+    for(std::string::const_iterator it = uuid.begin(); it != uuid.end(); it++)
+    {
+        hash ^= static_cast<unsigned char>(*it);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CEventLog::Describe
+/// @param event The number of an event.
+/// @return The description of the event, or 0 if it is unknown.
+///////////////////////////////////////////////////////////////////////////////
+const CEventLog::EventInfo * CEventLog::Describe(unsigned int event)
+{
+    if(event == 0 || event >= EVENT_COUNT)
+    {
+        return 0;
+    }
+    return &EVENTS[event];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CEventLog::ModuleName
+/// @param module The number of a module.
+/// @return The name of the module, or "unknown".
+///////////////////////////////////////////////////////////////////////////////
+const char * CEventLog::ModuleName(unsigned int module)
+{
+    if(module >= sizeof(MODULES) / sizeof(MODULES[0]))
+    {
+        return "unknown";
+    }
+    return MODULES[module];
+}
+
+} // namespace broker
+
+} // namespace freedm
@@ -0,0 +1,232 @@
+//////////////////////////////////////////////////////////
+/// @file         CFailureDetector.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Judges from message arrivals whether peers have failed
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CFailureDetector.hpp"
+#include "CClock.hpp"
+
+#include <cmath>
+#include <limits>
+
+#include <boost/thread/locks.hpp>
+
+namespace freedm {
+
+namespace broker {
+
+///////////////////////////////////////////////////////////////////////////////
+/// CPhiAccrualDetector::CPhiAccrualDetector
+/// @description Creates a detector with no history.
+/// @pre None
+/// @post Every peer is unknown.
+/// @param pause How much longer than usual a peer may stay quiet.
+/// @param minDeviation The least deviation of the intervals assumed.
+/// @param estimate The interval assumed until a peer has sent twice.
+/// @param window The number of intervals kept per peer.
+///////////////////////////////////////////////////////////////////////////////
+CPhiAccrualDetector::CPhiAccrualDetector(
+        boost::posix_time::time_duration pause,
+        boost::posix_time::time_duration minDeviation,
+        boost::posix_time::time_duration estimate, unsigned int window)
+    : m_pause(pause.total_microseconds() / 1000.0),
+      m_minDeviation(minDeviation.total_microseconds() / 1000.0),
+      m_estimate(estimate.total_microseconds() / 1000.0),
+      m_window(window > 2 ? window : 2)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CPhiAccrualDetector::Heartbeat
+/// @description Records the interval since the peer's last message. The
+///     first message seeds the history with two intervals around the
+///     estimate, so the deviation starts at a quarter of it.
+/// @pre Times of one peer do not go backwards.
+/// @post The history of the peer ends at time.
+/// @param uuid The peer the message came from.
+/// @param time When the message arrived.
+///////////////////////////////////////////////////////////////////////////////
+void CPhiAccrualDetector::Heartbeat(const std::string & uuid,
+        boost::posix_time::ptime time)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    std::map<std::string, History>::iterator it = m_history.find(uuid);
+    if(it == m_history.end())
+    {
+        History & history = m_history[uuid];
+        history.last = time;
+        history.sum = 0;
+        history.squares = 0;
+        Record(history, m_estimate * 0.75);
+        Record(history, m_estimate * 1.25);
+        return;
+    }
+    History & history = it->second;
+    Record(history, (time - history.last).total_microseconds() / 1000.0);
+    history.last = time;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CPhiAccrualDetector::Record
+/// @description Adds an interval and keeps the running sums.
+/// @param history The history of a peer.
+/// @param interval The interval in milliseconds.
+///////////////////////////////////////////////////////////////////////////////
+void CPhiAccrualDetector::Record(History & history, double interval)
+{
+    history.intervals.push_back(interval);
+    history.sum += interval;
+    history.squares += interval * interval;
+    if(history.intervals.size() > m_window)
+    {
+        double oldest = history.intervals.front();
+        history.intervals.pop_front();
+        history.sum -= oldest;
+        history.squares -= oldest * oldest;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CPhiAccrualDetector::GetSuspicion
+/// @description Computes phi from the logistic approximation of the normal
+///     distribution's tail.
+/// @param uuid The peer to judge.
+/// @param time The time to judge it at.
+/// @return The phi of the peer, 0 just after a message and growing while
+///     the peer is quiet; infinite for a peer never heard from.
+///////////////////////////////////////////////////////////////////////////////
+double CPhiAccrualDetector::GetSuspicion(const std::string & uuid,
+        boost::posix_time::ptime time) const
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    std::map<std::string, History>::const_iterator it = m_history.find(uuid);
+    if(it == m_history.end())
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    const History & history = it->second;
+    double count = history.intervals.size();
+    double mean = history.sum / count;
+    double variance = history.squares / count - mean * mean;
+    double deviation = std::sqrt(variance > 0 ? variance : 0);
+    if(deviation < m_minDeviation)
+    {
+        deviation = m_minDeviation;
+    }
+    double elapsed = (time - history.last).total_microseconds() / 1000.0;
+    double y = (elapsed - mean - m_pause) / deviation;
+    double e = std::exp(-y * (1.5976 + 0.070566 * y * y));
+    double phi;
+    if(elapsed > mean + m_pause)
+    {
+        phi = -std::log10(e / (1.0 + e));
+    }
+    else
+    {
+        phi = -std::log10(1.0 - 1.0 / (1.0 + e));
+    }
+    return phi > 0 ? phi : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CFailureDetector::instance
+/// @description Returns the failure detector, creating it on first use.
+/// @return The singleton instance of the failure detector.
+///////////////////////////////////////////////////////////////////////////////
+CFailureDetector& CFailureDetector::instance()
+{
+    static CFailureDetector detector;
+    return detector;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CFailureDetector::CFailureDetector
+/// @description Starts without a detector, so no peer is trusted.
+///////////////////////////////////////////////////////////////////////////////
+CFailureDetector::CFailureDetector()
+    : m_threshold(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CFailureDetector::SetDetector
+/// @description Installs the detector the broker consults.
+/// @pre The broker is not running yet.
+/// @post Heartbeats are passed to the detector.
+/// @param detector The detector, or an empty pointer to turn detection off.
+/// @param threshold The suspicion at or above which a peer has failed.
+///////////////////////////////////////////////////////////////////////////////
+void CFailureDetector::SetDetector(
+        boost::shared_ptr<IFailureDetector> detector, double threshold)
+{
+    m_detector = detector;
+    m_threshold = threshold;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CFailureDetector::Heartbeat
+/// @description Passes the arrival of a message to the detector.
+/// @param uuid The peer the message came from.
+///////////////////////////////////////////////////////////////////////////////
+void CFailureDetector::Heartbeat(const std::string & uuid)
+{
+    if(m_detector)
+    {
+        m_detector->Heartbeat(uuid, CClock::instance().GetMonotonicTime());
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CFailureDetector::GetSuspicion
+/// @param uuid The peer to judge.
+/// @return The suspicion of the peer now, or 0 without a detector.
+///////////////////////////////////////////////////////////////////////////////
+double CFailureDetector::GetSuspicion(const std::string & uuid) const
+{
+    if(!m_detector)
+    {
+        return 0;
+    }
+    return m_detector->GetSuspicion(uuid,
+            CClock::instance().GetMonotonicTime());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CFailureDetector::IsTrusted
+/// @param uuid The peer to judge.
+/// @return True if a detector is installed and suspects the peer less than
+///     the threshold.
+///////////////////////////////////////////////////////////////////////////////
+bool CFailureDetector::IsTrusted(const std::string & uuid) const
+{
+    return m_detector && GetSuspicion(uuid) < m_threshold;
+}
+
+} // namespace broker
+
+} // namespace freedm
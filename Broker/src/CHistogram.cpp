@@ -0,0 +1,206 @@
+//////////////////////////////////////////////////////////
+/// @file         CHistogram.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  A log-linear histogram for latency measurements
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CHistogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+
+namespace freedm {
+
+namespace broker {
+
+namespace {
+
+/// Number of buckets needed to cover every 64-bit value.
+const unsigned int BUCKET_COUNT = (64 - 4 + 1) * 16;
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CHistogram::CHistogram
+/// @description Allocates the buckets for the full 64-bit range.
+/// @pre None
+/// @post The histogram is empty.
+///////////////////////////////////////////////////////////////////////////////
+CHistogram::CHistogram()
+    : m_buckets(BUCKET_COUNT, 0)
+{
+    Reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CHistogram::Record
+/// @description Counts one occurrence of a value.
+/// @pre None
+/// @post The value is included in every statistic of the histogram.
+/// @param value The value to record.
+///////////////////////////////////////////////////////////////////////////////
+void CHistogram::Record(Value value)
+{
+    m_buckets[BucketOf(value)]++;
+    m_count++;
+    m_sum += static_cast<double>(value);
+    if(value < m_min)
+    {
+        m_min = value;
+    }
+    if(value > m_max)
+    {
+        m_max = value;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CHistogram::Reset
+/// @description Clears every bucket and statistic.
+/// @pre None
+/// @post The histogram is empty.
+///////////////////////////////////////////////////////////////////////////////
+void CHistogram::Reset()
+{
+    std::fill(m_buckets.begin(), m_buckets.end(), 0);
+    m_count = 0;
+    m_sum = 0;
+    m_min = ~Value(0);
+    m_max = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CHistogram::GetMean
+/// @description Computes the exact mean of the recorded values.
+/// @return The mean, or 0 if nothing has been recorded.
+///////////////////////////////////////////////////////////////////////////////
+double CHistogram::GetMean() const
+{
+    return m_count ? m_sum / m_count : 0.0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CHistogram::GetPercentile
+/// @description Finds the bucket holding the requested rank and reports the
+///     largest value that bucket can hold, clamped to the recorded maximum.
+/// @param percent The percentile to report, from 0 to 100.
+/// @return The percentile, or 0 if nothing has been recorded.
+///////////////////////////////////////////////////////////////////////////////
+CHistogram::Value CHistogram::GetPercentile(double percent) const
+{
+    if(m_count == 0)
+    {
+        return 0;
+    }
+    Value rank = static_cast<Value>(std::ceil(percent / 100.0 * m_count));
+    if(rank < 1)
+    {
+        rank = 1;
+    }
+    Value seen = 0;
+    for(unsigned int i = 0; i < m_buckets.size(); i++)
+    {
+        seen += m_buckets[i];
+        if(seen >= rank)
+        {
+            Value high = HighestIn(i);
+            return high < m_max ? high : m_max;
+        }
+    }
+    return m_max;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CHistogram::Print
+/// @description Writes the count, extremes, mean and common percentiles.
+/// @param out The stream to write to.
+///////////////////////////////////////////////////////////////////////////////
+void CHistogram::Print(std::ostream & out) const
+{
+    out << "count=" << m_count << " min=" << GetMin() << " mean=" << GetMean()
+        << " p50=" << GetPercentile(50) << " p90=" << GetPercentile(90)
+        << " p99=" << GetPercentile(99) << " max=" << m_max;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CHistogram::BucketOf
+/// @description Values below 2*SUB_BUCKETS have a bucket each. Above that,
+///     the top SUB_BUCKET_BITS+1 bits of a value select the bucket within
+///     its power of two.
+/// @param value The value to place.
+/// @return The index of the bucket.
+///////////////////////////////////////////////////////////////////////////////
+unsigned int CHistogram::BucketOf(Value value)
+{
+    if(value < 2 * SUB_BUCKETS)
+    {
+        return static_cast<unsigned int>(value);
+    }
+    unsigned int msb = 0;
+    for(Value v = value; v > 1; v >>= 1)
+    {
+        msb++;
+    }
+    unsigned int shift = msb - SUB_BUCKET_BITS;
+    unsigned int mantissa = static_cast<unsigned int>(value >> shift);
+    return (shift + 1) * SUB_BUCKETS + (mantissa - SUB_BUCKETS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CHistogram::HighestIn
+/// @description Inverts BucketOf.
+/// @param bucket The index of the bucket.
+/// @return The largest value which is counted in the bucket.
+///////////////////////////////////////////////////////////////////////////////
+CHistogram::Value CHistogram::HighestIn(unsigned int bucket)
+{
+    if(bucket < 2 * SUB_BUCKETS)
+    {
+        return bucket;
+    }
+    unsigned int shift = bucket / SUB_BUCKETS - 1;
+    Value mantissa = bucket % SUB_BUCKETS + SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// operator<<
+/// @description Prints the summary of a histogram.
+/// @param out The stream to write to.
+/// @param histogram The histogram to summarize.
+/// @return The stream.
+///////////////////////////////////////////////////////////////////////////////
+std::ostream & operator<<(std::ostream & out, const CHistogram & histogram)
+{
+    histogram.Print(out);
+    return out;
+}
+
+} // namespace broker
+
+} // namespace freedm
@@ -37,9 +37,17 @@
 #include "CListener.hpp"
 #include "CConnectionManager.hpp"
 #include "CMessage.hpp"
+#include "CClock.hpp"
+#include "CGlobalConfiguration.hpp"
 #include "config.hpp"
+#include "CFailureDetector.hpp"
 #include "CLogger.hpp"
+#include "CMetricsRegistry.hpp"
+#include "CNetworkEmulator.hpp"
+#include "CPacketTimestamps.hpp"
 
+#include <cerrno>
+#include <cstring>
 #include <vector>
 
 #include <boost/bind.hpp>
@@ -54,6 +62,14 @@ namespace {
 /// This file's logger.
 CLocalLogger Logger(__FILE__);
 
+/// Datagrams read from the socket.
+CMetricsRegistry::Counter & ReceivedDatagrams =
+        CMetricsRegistry::instance().GetCounter("net.datagrams.received");
+
+/// Messages accepted by the protocols and handed to the dispatcher.
+CMetricsRegistry::Counter & ReceivedMessages =
+        CMetricsRegistry::instance().GetCounter("net.messages.received");
+
 }
         
 ///////////////////////////////////////////////////////////////////////////////
@@ -87,10 +103,24 @@ CListener::CListener(boost::asio::io_service& p_ioService,
 void CListener::Start()
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    GetSocket().async_receive_from(boost::asio::buffer(m_buffer, CReliableConnection::MAX_PACKET_SIZE),
-            m_endpoint, boost::bind(&CListener::HandleRead, this,
-            boost::asio::placeholders::error,
-            boost::asio::placeholders::bytes_transferred));
+    // Without kernel stamps the messages are stamped when they are read
+    CPacketTimestamps::EnableReceive(GetSocket().native_handle());
+    Listen();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CListener::Listen
+/// @description Waits for the socket to become readable. The datagram is
+///   read by HandleRead with recvmsg so the kernel receive stamp comes with
+///   it.
+/// @pre The socket is open.
+/// @post HandleRead will be called when a datagram is waiting.
+///////////////////////////////////////////////////////////////////////////////
+void CListener::Listen()
+{
+    GetSocket().async_receive(boost::asio::null_buffers(),
+            boost::bind(&CListener::HandleRead, this,
+            boost::asio::placeholders::error));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -110,22 +140,45 @@ void CListener::Stop()
 ///////////////////////////////////////////////////////////////////////////////
 /// @fn CListener::HandleRead
 /// @description The callback which accepts messages from the remote sender.
+///   The message is stamped with the time the kernel received it, or the
+///   time it was read if the kernel did not stamp it.
 /// @param e The errorcode if any associated.
-/// @param bytes_transferred The size of the datagram being read.
-/// @pre The connection has had start called and some message has been placed
-///   in the buffer by the recieve call.
+/// @pre The connection has had start called and the socket is readable.
 /// @post The message has been delivered. This means that write connections
 ///   have been notified of ACK and standard messages have been redirected to
 ///   their appropriate places by the dispatcher. The incoming sequence number
 ///   for the source UUID has been incremented appropriately.
 ///////////////////////////////////////////////////////////////////////////////
-#pragma GCC diagnostic ignored "-Wunused-label"
-void CListener::HandleRead(const boost::system::error_code& e, 
-                           std::size_t bytes_transferred)
+void CListener::HandleRead(const boost::system::error_code& e)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;       
+    CClock::instance().Tick();
+    // Taken before parsing so the clock readings do not include it
+    boost::posix_time::ptime received = CClock::instance().GetCachedDGITime();
     if (!e)
     {
+        std::size_t fromLength = m_endpoint.capacity();
+        boost::posix_time::ptime stamp;
+        ssize_t result = CPacketTimestamps::Receive(
+            GetSocket().native_handle(), m_buffer.data(), m_buffer.size(),
+            m_endpoint.data(), fromLength, stamp);
+        if(result < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                Logger.Warn << "Couldn't read datagram: "
+                        << std::strerror(errno) << std::endl;
+            }
+            Listen();
+            return;
+        }
+        std::size_t bytes_transferred = result;
+        m_endpoint.resize(fromLength);
+        if(!stamp.is_not_a_date_time())
+        {
+            received = stamp;
+        }
+        ReceivedDatagrams.fetch_add(1, boost::memory_order_relaxed);
         /// I'm removing request parser because it is an appalling heap of junk
         std::stringstream iss;
         std::ostreambuf_iterator<char> iss_it(iss);
@@ -135,14 +188,12 @@ void CListener::HandleRead(const boost::system::error_code& e,
         {
             Logger.Debug<<"Loading xml:"<<std::endl;
             m_message.Load(iss);
+            m_message.SetReceiveTimestamp(received);
         }
         catch(std::exception &e)
         {
             Logger.Error<<"Couldn't parse message XML: "<<e.what()<<std::endl;
-            GetSocket().async_receive_from(boost::asio::buffer(m_buffer, CReliableConnection::MAX_PACKET_SIZE),
-                m_endpoint, boost::bind(&CListener::HandleRead, this,
-                boost::asio::placeholders::error,
-                boost::asio::placeholders::bytes_transferred));
+            Listen();
             return;
         }
 
@@ -155,63 +206,96 @@ void CListener::HandleRead(const boost::system::error_code& e,
         CConnection::ConnectionPtr conn;
         conn = GetConnectionManager().GetConnectionByUUID(uuid);
         Logger.Debug<<"Fetched Connection"<<std::endl;
-#ifdef CUSTOMNETWORK
-        if((rand()%100) >= GetReliability())
-        {
-            Logger.Debug<<"Dropped datagram "<<m_message.GetHash()<<":"
-                          <<m_message.GetSequenceNumber()<<std::endl;
-            goto listen;
-        }
-#endif
-        if(m_message.GetStatus() == freedm::broker::CMessage::Accepted)
-        {
-            Logger.Debug<<"Processing Accept Message"<<std::endl;
-            ptree pp = m_message.GetProtocolProperties();
-            size_t hash = pp.get<size_t>("src.hash");
-            Logger.Debug<<"Recieved ACK"<<hash<<":"
-                            <<m_message.GetSequenceNumber()<<std::endl;
-            conn->RecieveACK(m_message);
-        }
-        else if(m_message.GetStatus() == freedm::broker::CMessage::ReadClock)
-        {
-            if(conn->Recieve(m_message))
-            {
-                Logger.Debug<<"Recieved Clock Request"<<std::endl;
-                // Generate a clock reading and reply immediately:
-                CMessage reply;
-                // Determine the requesting module:
-                std::string req = m_message.GetSubMessages().get<std::string>("req");
-                boost::posix_time::time_duration skew = CGlobalConfiguration::instance().GetClockSkew();
-                // Generate a message that is addressed to the requesting module
-                reply.SetHandler(req+".Clock");
-                reply.m_submessages.put(req+".value",boost::posix_time::microsec_clock::universal_time()+skew);
-                conn->Send(reply);
-            }
-        }
-        else if(conn->Recieve(m_message))
+        // Protocol state belongs to the connection, so the rest of the work is
+        // serialized on its strand. This lets the listener return to the
+        // socket while other threads process what has already arrived.
+        CNetworkEmulator::Action handle = boost::bind(
+            &CListener::HandleMessage, this, conn, m_message);
+        unsigned int copies = 1;
+        if(CNetworkEmulator::instance().IsEnabled())
         {
-            Logger.Debug<<"Accepted message "<<m_message.GetHash()<<":"
-                          <<m_message.GetSequenceNumber()<<std::endl;
-            GetDispatcher().HandleRequest(GetBroker(),m_message);
+            copies = CNetworkEmulator::instance().Deliver(
+                CNetworkEmulator::INCOMING, uuid, bytes_transferred,
+                conn->GetStrand(), handle);
         }
-        else if(m_message.GetStatus() != freedm::broker::CMessage::Created)
+        for(unsigned int i = 0; i < copies; i++)
         {
-            Logger.Debug<<"Rejected message "<<m_message.GetHash()<<":"
-                          <<m_message.GetSequenceNumber()<<std::endl;
+            conn->GetStrand().post(handle);
         }
-listen:
         Logger.Debug<<"Listening for next message"<<std::endl;
-        GetSocket().async_receive_from(boost::asio::buffer(m_buffer, CReliableConnection::MAX_PACKET_SIZE),
-                m_endpoint, boost::bind(&CListener::HandleRead, this,
-                boost::asio::placeholders::error,
-                boost::asio::placeholders::bytes_transferred));
+        Listen();
     }
     else
     {
         GetConnectionManager().Stop(CListener::ConnectionPtr(this));	
     }
 }
-#pragma GCC diagnostic warning "-Wunused-label"
+
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CListener::HandleMessage
+/// @description Delivers a parsed message: acknowledgements are handed to the
+///   sending protocol, clock requests are answered immediately, and accepted
+///   messages are passed on to the dispatcher. Whatever the message, its
+///   arrival is a heartbeat of the sender for the failure detector.
+/// @pre Called from within the strand of the connection conn.
+/// @post The message has been acknowledged, answered or dispatched.
+/// @param conn The connection to the node that sent the message.
+/// @param msg The message that was received.
+///////////////////////////////////////////////////////////////////////////////
+void CListener::HandleMessage(CConnection::ConnectionPtr conn, CMessage msg)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    CFailureDetector::instance().Heartbeat(msg.GetSourceUUID());
+    if(CNetworkEmulator::instance().IsEnabled())
+    {
+        // An emulated delay belongs to the network, so the message arrives now
+        msg.SetReceiveTimestamp(CClock::instance().GetDGITime());
+    }
+    if(msg.GetStatus() == freedm::broker::CMessage::Accepted)
+    {
+        Logger.Debug<<"Processing Accept Message"<<std::endl;
+        ptree pp = msg.GetProtocolProperties();
+        size_t hash = pp.get<size_t>("src.hash");
+        Logger.Debug<<"Recieved ACK"<<hash<<":"
+                        <<msg.GetSequenceNumber()<<std::endl;
+        conn->RecieveACK(msg);
+    }
+    else if(msg.GetStatus() == freedm::broker::CMessage::ReadClock)
+    {
+        if(conn->Recieve(msg))
+        {
+            Logger.Debug<<"Recieved Clock Request"<<std::endl;
+            // Generate a clock reading and reply immediately:
+            CMessage reply;
+            // Determine the requesting module:
+            std::string req = msg.GetSubMessages().get<std::string>("req");
+            // Generate a message that is addressed to the requesting module.
+            // With the time the request was sent and received, and the time
+            // of the reply, the requester can take out the network delay;
+            // the skew lets it compare readings taken before and after the
+            // skew changed.
+            reply.SetHandler(req+".Clock");
+            reply.m_submessages.put(req+".requested",msg.GetSendTimestamp());
+            reply.m_submessages.put(req+".received",msg.GetReceiveTimestamp());
+            reply.m_submessages.put(req+".skew",CGlobalConfiguration::instance().
+                GetClockSkew().total_microseconds());
+            reply.m_submessages.put(req+".value",CClock::instance().GetDGITime());
+            conn->Send(reply);
+        }
+    }
+    else if(conn->Recieve(msg))
+    {
+        Logger.Debug<<"Accepted message "<<msg.GetHash()<<":"
+                      <<msg.GetSequenceNumber()<<std::endl;
+        ReceivedMessages.fetch_add(1, boost::memory_order_relaxed);
+        GetDispatcher().HandleRequest(GetBroker(),msg);
+    }
+    else if(msg.GetStatus() != freedm::broker::CMessage::Created)
+    {
+        Logger.Debug<<"Rejected message "<<msg.GetHash()<<":"
+                      <<msg.GetSequenceNumber()<<std::endl;
+    }
+}
 
     } // namespace broker
 } // namespace freedm
@@ -22,9 +22,15 @@
 /// Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+
+#include <boost/bind.hpp>
 #include <boost/program_options/options_description.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "CLogger.hpp"
+#include "CClock.hpp"
 
 #define foreach BOOST_FOREACH
 
@@ -39,6 +45,217 @@ namespace {
 /// This file's logger.
 CLocalLogger Logger(__FILE__);
 
+/// How long the log writer sleeps when there is nothing to write.
+const boost::posix_time::time_duration WRITER_POLL =
+        boost::posix_time::milliseconds(5);
+
+/// Writes one record in the log's format.
+void WriteRecord(std::ostream & out, const ptime & time,
+        const unsigned int level, const std::string & name,
+        const char * const s, std::streamsize n)
+{
+    out << time << " : " << name << "(" << level << "):\n\t";
+    out.write(s, n);
+}
+
+/// Orders queued records by the time they were logged.
+template <typename Entry>
+bool CompareEntries(const Entry & a, const Entry & b)
+{
+    return a.first < b.first;
+}
+
+}
+
+/// The records queued by one thread: a single producer, single consumer ring.
+class CLogWriter::Ring : private boost::noncopyable
+{
+    public:
+        /// One queued log statement.
+        struct Record
+        {
+            /// When the statement was logged.
+            ptime time;
+            /// The level of the statement.
+            unsigned int level;
+            /// The name of the logger.
+            std::string name;
+            /// The formatted text of the statement.
+            std::string text;
+        };
+        /// Creates an empty ring.
+        Ring() : m_records(RING_SIZE), m_head(0), m_tail(0), m_retired(false) {}
+        /// The slots; their strings keep their capacity between laps.
+        std::vector<Record> m_records;
+        /// The next slot the owning thread fills.
+        boost::atomic<std::size_t> m_head;
+        /// The next slot the writer empties.
+        boost::atomic<std::size_t> m_tail;
+        /// Set when the owning thread has exited.
+        boost::atomic<bool> m_retired;
+};
+
+CLogWriter& CLogWriter::instance()
+{
+    static CLogWriter singleton;
+    return singleton;
+}
+CLogWriter::CLogWriter()
+: m_running(false), m_stopping(false), m_ostream(&std::clog),
+m_local(&CLogWriter::RetireRing), m_dropped(0), m_reported(0)
+{
+    //pass
+}
+CLogWriter::~CLogWriter()
+{
+    Stop();
+}
+void CLogWriter::Start(std::ostream * out)
+{
+    if (IsRunning())
+    {
+        return;
+    }
+    {
+        boost::lock_guard<boost::mutex> lock(m_outputMutex);
+        m_ostream = out;
+    }
+    m_stopping.store(false);
+    m_running.store(true, boost::memory_order_release);
+    m_thread.reset(new boost::thread(boost::bind(&CLogWriter::Run, this)));
+}
+void CLogWriter::Stop()
+{
+    if (!IsRunning())
+    {
+        return;
+    }
+    m_stopping.store(true);
+    m_thread->join();
+    m_thread.reset();
+    m_running.store(false, boost::memory_order_release);
+    Drain();
+}
+void CLogWriter::Write(const unsigned int level, const std::string & name,
+        const char * const s, std::streamsize n)
+{
+    if (!IsRunning())
+    {
+        boost::lock_guard<boost::mutex> lock(m_outputMutex);
+        WriteRecord(*m_ostream, CClock::instance().GetLocalTime(), level,
+                name, s, n);
+        return;
+    }
+    Ring & ring = GetRing();
+    std::size_t head = ring.m_head.load(boost::memory_order_relaxed);
+    if (head - ring.m_tail.load(boost::memory_order_acquire) == RING_SIZE)
+    {
+        m_dropped.fetch_add(1, boost::memory_order_relaxed);
+        return;
+    }
+    Ring::Record & record = ring.m_records[head & (RING_SIZE - 1)];
+    record.time = CClock::instance().GetLocalTime();
+    record.level = level;
+    record.name.assign(name);
+    record.text.assign(s, n);
+    ring.m_head.store(head + 1, boost::memory_order_release);
+}
+CLogWriter::Ring & CLogWriter::GetRing()
+{
+    Ring * ring = m_local.get();
+    if (ring == 0)
+    {
+        boost::shared_ptr<Ring> created(new Ring);
+        {
+            boost::lock_guard<boost::mutex> lock(m_ringsMutex);
+            m_rings.push_back(created);
+        }
+        ring = created.get();
+        m_local.reset(ring);
+    }
+    return *ring;
+}
+void CLogWriter::RetireRing(Ring * ring)
+{
+    // The writer owns the ring and frees it once it has been emptied.
+    ring->m_retired.store(true, boost::memory_order_release);
+}
+void CLogWriter::Run()
+{
+    while (!m_stopping.load())
+    {
+        if (!Drain())
+        {
+            boost::this_thread::sleep(WRITER_POLL);
+        }
+    }
+}
+bool CLogWriter::Drain()
+{
+    typedef std::pair<ptime, const Ring::Record *> Entry;
+    RingList rings;
+    {
+        boost::lock_guard<boost::mutex> lock(m_ringsMutex);
+        rings = m_rings;
+    }
+    std::vector<std::size_t> heads(rings.size());
+    std::vector<Entry> entries;
+    for (std::size_t i = 0; i < rings.size(); i++)
+    {
+        Ring & ring = *rings[i];
+        heads[i] = ring.m_head.load(boost::memory_order_acquire);
+        std::size_t tail = ring.m_tail.load(boost::memory_order_relaxed);
+        for (std::size_t pos = tail; pos != heads[i]; pos++)
+        {
+            const Ring::Record & record = ring.m_records[pos & (RING_SIZE - 1)];
+            entries.push_back(Entry(record.time, &record));
+        }
+    }
+    // Records of one thread are already in order; merge the threads by time.
+    std::stable_sort(entries.begin(), entries.end(), CompareEntries<Entry>);
+    {
+        boost::lock_guard<boost::mutex> lock(m_outputMutex);
+        foreach (const Entry & entry, entries)
+        {
+            const Ring::Record & record = *entry.second;
+            WriteRecord(*m_ostream, record.time, record.level, record.name,
+                    record.text.data(), record.text.size());
+        }
+        boost::uint64_t dropped = m_dropped.load();
+        if (dropped != m_reported)
+        {
+            std::string text = "Dropped " +
+                    boost::lexical_cast<std::string>(dropped - m_reported) +
+                    " log records because a ring was full.\n";
+            WriteRecord(*m_ostream, CClock::instance().GetLocalTime(), 3,
+                    Logger.GetName() + " : Warn", text.data(), text.size());
+            m_reported = dropped;
+        }
+        m_ostream->flush();
+    }
+    for (std::size_t i = 0; i < rings.size(); i++)
+    {
+        rings[i]->m_tail.store(heads[i], boost::memory_order_release);
+    }
+    {
+        // Forget the rings of finished threads once they are empty.
+        boost::lock_guard<boost::mutex> lock(m_ringsMutex);
+        RingList::iterator it = m_rings.begin();
+        while (it != m_rings.end())
+        {
+            Ring & ring = **it;
+            if (ring.m_retired.load(boost::memory_order_acquire) &&
+                ring.m_tail.load() == ring.m_head.load())
+            {
+                it = m_rings.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
+    }
+    return !entries.empty();
 }
 
 std::string basename(const std::string s)
@@ -49,8 +266,8 @@ std::string basename(const std::string s)
     return s.substr(idx + 1);
 }
 CLog::CLog(const CLoggerPointer p, const unsigned int level_,
-        std::string name_, std::ostream* const out_) :
-m_parent(p), m_level(level_), m_name(name_), m_ostream(out_)
+        std::string name_) :
+m_parent(p), m_level(level_), m_name(name_)
 {
     //pass
 }
@@ -58,10 +275,7 @@ std::streamsize CLog::write(const char* const s, std::streamsize n)
 {
     if (GetOutputLevel() >= m_level)
     {
-        *m_ostream << microsec_clock::local_time() << " : "
-                << m_name << "(" << m_level << "):\n\t";
-        boost::iostreams::write(*m_ostream, s, n);
-        //*m_ostream << std::endl;
+        CLogWriter::instance().Write(m_level, m_name, s, n);
     }
     return n;
 }
@@ -69,27 +283,54 @@ unsigned int CLog::GetOutputLevel() const
 {
     return m_parent->GetOutputLevel();
 }
+CLogStream::CLogStream(const CLoggerPointer p, const unsigned int level_,
+        const std::string name_) :
+m_parent(p), m_level(level_), m_name(name_)
+{
+    //pass
+}
+std::ostream & CLogStream::GetStream()
+{
+    StreamType * stream = m_stream.get();
+    if (stream == 0)
+    {
+        stream = new StreamType(CLog(m_parent, m_level, m_name));
+        m_stream.reset(stream);
+    }
+    return *stream;
+}
+CLogLine::operator std::ostream &()
+{
+    return m_stream ? *m_stream : CLogStream::NullStream();
+}
+std::ostream & CLogStream::NullStream()
+{
+    // Without a buffer the stream is bad, so nothing is ever formatted.
+    static std::ostream null(0);
+    return null;
+}
 CLocalLogger::CLocalLogger(const std::string loggername)
-: Trace(this, 8, basename(loggername) + " : Trace"),
-Debug(this, 7, basename(loggername) + " : Debug"),
-Info(this, 6, basename(loggername) + " : Info"),
-Notice(this, 5, basename(loggername) + " : Notice"),
-Status(this, 4, basename(loggername) + " : Status"),
-Warn(this, 3, basename(loggername) + " : Warn"),
-Error(this, 2, basename(loggername) + " : Error"),
-Alert(this, 1, basename(loggername) + " : Alert"),
-Fatal(this, 0, basename(loggername) + " : Fatal"),
-m_name(basename(loggername))
-{
-    CGlobalLogger::instance().RegisterLocalLogger(m_name);
+: Trace(this, basename(loggername) + " : Trace"),
+Debug(this, basename(loggername) + " : Debug"),
+Info(this, basename(loggername) + " : Info"),
+Notice(this, basename(loggername) + " : Notice"),
+Status(this, basename(loggername) + " : Status"),
+Warn(this, basename(loggername) + " : Warn"),
+Error(this, basename(loggername) + " : Error"),
+Alert(this, basename(loggername) + " : Alert"),
+Fatal(this, basename(loggername) + " : Fatal"),
+m_name(basename(loggername)),
+m_level(0)
+{
+    CGlobalLogger::instance().RegisterLocalLogger(this);
 }
-std::string CLocalLogger::GetName() const
+CLocalLogger::~CLocalLogger()
 {
-    return m_name;
+    CGlobalLogger::instance().UnregisterLocalLogger(this);
 }
-unsigned int CLocalLogger::GetOutputLevel() const
+std::string CLocalLogger::GetName() const
 {
-    return CGlobalLogger::instance().GetOutputLevel(m_name);
+    return m_name;
 }
 void CLocalLogger::SetOutputLevel(const unsigned int level)
 {
@@ -100,9 +341,34 @@ CGlobalLogger& CGlobalLogger::instance()
     static CGlobalLogger singleton;
     return singleton;
 }
-void CGlobalLogger::RegisterLocalLogger(const std::string logger)
+void CGlobalLogger::RegisterLocalLogger(CLocalLogger * logger)
+{
+    const std::string & name = logger->GetName();
+    m_loggers.insert(std::make_pair(name, m_default));
+    m_locals.insert(std::make_pair(name, logger));
+    logger->m_level.store(m_loggers[name], boost::memory_order_relaxed);
+}
+void CGlobalLogger::UnregisterLocalLogger(CLocalLogger * logger)
+{
+    LocalMap::iterator it = m_locals.lower_bound(logger->GetName());
+    for (; it != m_locals.end() && it->first == logger->GetName(); it++)
+    {
+        if (it->second == logger)
+        {
+            m_locals.erase(it);
+            return;
+        }
+    }
+}
+void CGlobalLogger::PushOutputLevel(const std::string logger)
 {
-    m_loggers.insert(std::make_pair(logger, m_default));
+    unsigned int level = m_loggers[logger];
+    std::pair<LocalMap::iterator, LocalMap::iterator> range =
+            m_locals.equal_range(logger);
+    for (LocalMap::iterator it = range.first; it != range.second; it++)
+    {
+        it->second->m_level.store(level, boost::memory_order_relaxed);
+    }
 }
 void CGlobalLogger::SetGlobalLevel(const unsigned int level)
 {
@@ -112,6 +378,7 @@ void CGlobalLogger::SetGlobalLevel(const unsigned int level)
     for (it = m_loggers.begin(); it != m_loggers.end(); it++)
     {
         ( *it ).second = level;
+        PushOutputLevel(it->first);
     }
     m_default = level;
 }
@@ -120,6 +387,7 @@ void CGlobalLogger::SetOutputLevel(const std::string logger,
 {
     //Fetch the specified logger and set its level to the one specified
     m_loggers[logger] = level;
+    PushOutputLevel(logger);
 }
 unsigned int CGlobalLogger::GetOutputLevel(const std::string logger) const
 {
@@ -172,6 +440,7 @@ void CGlobalLogger::SetInitialLoggerLevels(const std::string loggerCfgFile)
         if (!vm[pair.first].defaulted())
         {
             m_loggers[pair.first] = pair.second.as<unsigned int>( );
+            PushOutputLevel(pair.first);
         }
     }
 }
@@ -31,6 +31,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "CMessage.hpp"
+#include "CClock.hpp"
 #include "CLogger.hpp"
 
 #include <boost/foreach.hpp>
@@ -157,7 +158,8 @@ CMessage::CMessage( const CMessage &p_m ) :
     m_never_expires( p_m.m_never_expires ),
     m_sendtime( p_m.m_sendtime ),
     m_expiretime( p_m.m_expiretime ),
-    m_handler( p_m.m_handler )
+    m_handler( p_m.m_handler ),
+    m_receivetime( p_m.m_receivetime )
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
 }
@@ -176,6 +178,7 @@ CMessage& CMessage::operator = ( const CMessage &p_m )
     this->m_expiretime = p_m.m_expiretime;
     this->m_never_expires = p_m.m_never_expires;
     this->m_handler = p_m.m_handler;
+    this->m_receivetime = p_m.m_receivetime;
     return *this;
 }
 
@@ -243,7 +246,7 @@ void CMessage::SetStatus(StatusType status)
 /// Setter for the timestamp
 void CMessage::SetSendTimestampNow()
 {
-    m_sendtime = boost::posix_time::microsec_clock::universal_time();
+    m_sendtime = CClock::instance().GetDGITime();
 }
 
 /// Setter b for the timestamp
@@ -263,6 +266,18 @@ boost::posix_time::ptime CMessage::GetSendTimestamp() const
     return m_sendtime;
 }
 
+/// Setter for the time the message arrived
+void CMessage::SetReceiveTimestamp(boost::posix_time::ptime p)
+{
+    m_receivetime = p;
+}
+
+/// Getter for the time the message arrived
+boost::posix_time::ptime CMessage::GetReceiveTimestamp() const
+{
+    return m_receivetime;
+}
+
 /// Setter for the expiration time
 void CMessage::SetExpireTime(boost::posix_time::ptime p)
 {
@@ -296,7 +311,7 @@ void CMessage::SetNeverExpires(bool set)
 /// Setter b for the expiration time
 void CMessage::SetExpireTimeFromNow(boost::posix_time::time_duration t)
 {
-    m_expiretime = boost::posix_time::microsec_clock::universal_time();
+    m_expiretime = CClock::instance().GetDGITime();
     m_expiretime += t;
 }
 
@@ -309,7 +324,7 @@ boost::posix_time::ptime CMessage::GetExpireTime() const
 ///Test to see if a message is expired.
 bool CMessage::IsExpired() const
 {
-    return (m_expiretime < boost::posix_time::microsec_clock::universal_time());
+    return (m_expiretime < CClock::instance().GetCachedDGITime());
 }
 
 /// Set the protocol properties
@@ -0,0 +1,145 @@
+//////////////////////////////////////////////////////////
+/// @file         CMetricsRegistry.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Named counters and histograms shared by the whole broker
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CMetricsRegistry.hpp"
+
+#include <ostream>
+
+#include <boost/thread/locks.hpp>
+
+namespace freedm {
+
+namespace broker {
+
+///////////////////////////////////////////////////////////////////////////////
+/// CMetricsRegistry::instance
+/// @description Returns the registry, creating it on first use so that
+///     counters can be looked up during static initialization.
+/// @return The singleton instance of the registry.
+///////////////////////////////////////////////////////////////////////////////
+CMetricsRegistry& CMetricsRegistry::instance()
+{
+    static CMetricsRegistry registry;
+    return registry;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CMetricsRegistry::GetCounter
+/// @description Looks up a counter by name.
+/// @pre None
+/// @post The counter exists in the registry.
+/// @param name The dotted name of the counter.
+/// @return The counter, which stays valid for the life of the program.
+///////////////////////////////////////////////////////////////////////////////
+CMetricsRegistry::Counter & CMetricsRegistry::GetCounter(
+        const std::string & name)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    boost::shared_ptr<Counter> & counter = m_counters[name];
+    if(!counter)
+    {
+        counter.reset(new Counter(0));
+    }
+    return *counter;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CMetricsRegistry::GetHistogram
+/// @description Looks up a histogram by name.
+/// @pre None
+/// @post The histogram exists in the registry.
+/// @param name The dotted name of the histogram.
+/// @return The histogram, which stays valid for the life of the program.
+///////////////////////////////////////////////////////////////////////////////
+CMetricsRegistry::Histogram & CMetricsRegistry::GetHistogram(
+        const std::string & name)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    boost::shared_ptr<Histogram> & histogram = m_histograms[name];
+    if(!histogram)
+    {
+        histogram.reset(new Histogram);
+    }
+    return *histogram;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CMetricsRegistry::Print
+/// @description Writes the counters and then the histograms, each sorted by
+///     name. Every histogram is summarized by its count, mean, median, 99th
+///     percentile and maximum.
+/// @param out The stream to write to.
+///////////////////////////////////////////////////////////////////////////////
+void CMetricsRegistry::Print(std::ostream & out) const
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    CounterMap::const_iterator it;
+    for(it = m_counters.begin(); it != m_counters.end(); it++)
+    {
+        out << it->first << " " << it->second->load() << std::endl;
+    }
+    HistogramMap::const_iterator hit;
+    for(hit = m_histograms.begin(); hit != m_histograms.end(); hit++)
+    {
+        CHistogram h = hit->second->GetSnapshot();
+        out << hit->first << ".count " << h.GetCount() << std::endl
+            << hit->first << ".mean " << h.GetMean() << std::endl
+            << hit->first << ".p50 " << h.GetPercentile(50) << std::endl
+            << hit->first << ".p99 " << h.GetPercentile(99) << std::endl
+            << hit->first << ".max " << h.GetMax() << std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CMetricsRegistry::Histogram::Record
+/// @description Counts one occurrence of a value.
+/// @pre None
+/// @post The value is included in the next snapshot.
+/// @param value The value to record.
+///////////////////////////////////////////////////////////////////////////////
+void CMetricsRegistry::Histogram::Record(CHistogram::Value value)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_histogram.Record(value);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CMetricsRegistry::Histogram::GetSnapshot
+/// @return A copy of everything recorded so far.
+///////////////////////////////////////////////////////////////////////////////
+CHistogram CMetricsRegistry::Histogram::GetSnapshot() const
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_histogram;
+}
+
+} // namespace broker
+
+} // namespace freedm
@@ -0,0 +1,629 @@
+//////////////////////////////////////////////////////////
+/// @file         CNetworkEmulator.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Emulates delay, loss and other impairments of network links
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CNetworkEmulator.hpp"
+#include "CClock.hpp"
+#include "CLogger.hpp"
+#include "CMetricsRegistry.hpp"
+
+#include <algorithm>
+#include <exception>
+
+#include <sys/stat.h>
+
+#include <boost/asio/placeholders.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace freedm {
+
+namespace broker {
+
+namespace {
+
+/// This file's logger.
+CLocalLogger Logger(__FILE__);
+
+/// Datagrams the emulator has dropped.
+CMetricsRegistry::Counter & DroppedDatagrams =
+        CMetricsRegistry::instance().GetCounter("net.emulator.dropped");
+
+/// Datagrams the emulator has delivered twice.
+CMetricsRegistry::Counter & DuplicatedDatagrams =
+        CMetricsRegistry::instance().GetCounter("net.emulator.duplicated");
+
+/// Copies of datagrams the emulator has held back.
+CMetricsRegistry::Counter & DelayedDatagrams =
+        CMetricsRegistry::instance().GetCounter("net.emulator.delayed");
+
+/// The name of each direction in the settings file.
+const char * DIRECTION_NAMES[] = { "incoming", "outgoing" };
+
+///////////////////////////////////////////////////////////////////////////////
+/// ReadMilliseconds
+/// @description Reads an optional duration given in (fractional) milliseconds.
+/// @param pt The tree to read from.
+/// @param path The path of the value.
+/// @param fallback The duration to use if the value is missing.
+/// @return The duration.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::time_duration ReadMilliseconds(
+        const boost::property_tree::ptree & pt, const std::string & path,
+        boost::posix_time::time_duration fallback)
+{
+    double ms = pt.get<double>(path, fallback.total_microseconds() / 1000.0);
+    return boost::posix_time::microseconds(static_cast<long>(ms * 1000));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// GetModified
+/// @description Reads the modification time of a file.
+/// @param filename The file to check.
+/// @return The modification time, or 0 if the file does not exist.
+///////////////////////////////////////////////////////////////////////////////
+std::time_t GetModified(const std::string & filename)
+{
+    struct stat info;
+    if(stat(filename.c_str(), &info) != 0)
+    {
+        return 0;
+    }
+    return info.st_mtime;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::LinkSettings::LinkSettings
+/// @description Creates the settings of a link which is not impaired.
+/// @pre None
+/// @post Datagrams on the link are delivered at once, exactly once.
+///////////////////////////////////////////////////////////////////////////////
+CNetworkEmulator::LinkSettings::LinkSettings()
+    : delay(boost::posix_time::milliseconds(0)),
+      jitter(boost::posix_time::milliseconds(0)),
+      reorder(0),
+      duplicate(0),
+      bandwidth(0),
+      loss(0),
+      enter(0),
+      leave(1),
+      burstloss(1)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::LinkSettings::LinkSettings
+/// @description Reads the settings of a link. Anything not given keeps the
+///     value from the defaults. The reliability element of older network.xml
+///     files is the percentage of datagrams delivered in the good state.
+/// @pre None
+/// @post The settings hold the values from the tree.
+/// @param pt The element which describes the link.
+/// @param defaults The settings to use for missing values.
+///////////////////////////////////////////////////////////////////////////////
+CNetworkEmulator::LinkSettings::LinkSettings(
+        const boost::property_tree::ptree & pt, const LinkSettings & defaults)
+{
+    *this = defaults;
+    delay = ReadMilliseconds(pt, "delay", delay);
+    jitter = ReadMilliseconds(pt, "jitter", jitter);
+    reorder = pt.get<double>("reorder", reorder);
+    duplicate = pt.get<double>("duplicate", duplicate);
+    bandwidth = pt.get<double>("bandwidth", bandwidth);
+    if(pt.count("reliability") > 0)
+    {
+        loss = (100 - pt.get<double>("reliability")) / 100.0;
+    }
+    loss = pt.get<double>("loss", loss);
+    enter = pt.get<double>("burst.enter", enter);
+    leave = pt.get<double>("burst.leave", leave);
+    burstloss = pt.get<double>("burst.loss", burstloss);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::Link::Link
+/// @description Creates a link with the given settings.
+/// @pre None
+/// @post The link is in the good state and has nothing queued.
+/// @param s The settings of the link.
+///////////////////////////////////////////////////////////////////////////////
+CNetworkEmulator::Link::Link(const LinkSettings & s)
+    : settings(s),
+      bad(false)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::Pending::operator<
+/// @description Orders delayed copies for std::push_heap, which keeps the
+///     largest element first, so the comparison is reversed.
+/// @param other The copy to compare against.
+/// @return True if this copy is due after the other.
+///////////////////////////////////////////////////////////////////////////////
+bool CNetworkEmulator::Pending::operator<(const Pending & other) const
+{
+    if(due != other.due)
+    {
+        return due > other.due;
+    }
+    return sequence > other.sequence;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::instance
+/// @description Returns the emulator, creating it on first use.
+/// @return The singleton instance of the emulator.
+///////////////////////////////////////////////////////////////////////////////
+CNetworkEmulator& CNetworkEmulator::instance()
+{
+    static CNetworkEmulator emulator;
+    return emulator;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::CNetworkEmulator
+/// @description Creates a disabled emulator.
+/// @pre None
+/// @post Every datagram is delivered unchanged.
+///////////////////////////////////////////////////////////////////////////////
+CNetworkEmulator::CNetworkEmulator()
+    : m_enabled(false),
+      m_sequence(0),
+      m_modified(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::Start
+/// @description Reads the settings file, if it exists, and then checks it
+///     for changes at a fixed interval.
+/// @pre The io_service outlives the emulator, or Stop is called first.
+/// @post Delayed copies are delivered through the io_service.
+/// @param ios The io_service which runs the timers.
+/// @param filename The settings file.
+/// @param interval How often the file is checked for changes.
+///////////////////////////////////////////////////////////////////////////////
+void CNetworkEmulator::Start(boost::asio::io_service & ios,
+        const std::string & filename,
+        boost::posix_time::time_duration interval)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        m_filename = filename;
+        m_interval = interval;
+        m_timer.reset(new boost::asio::deadline_timer(ios));
+        m_watch.reset(new boost::asio::deadline_timer(ios));
+        m_watch->expires_from_now(m_interval);
+        m_watch->async_wait(boost::bind(&CNetworkEmulator::HandleWatch, this,
+                boost::asio::placeholders::error));
+    }
+    if(GetModified(filename) != 0)
+    {
+        Load(filename);
+    }
+    else
+    {
+        Logger.Notice << "Network emulation is off until " << filename
+                << " is created." << std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::Stop
+/// @description Cancels the timers and drops the delayed copies, which keep
+///     their connections alive.
+/// @pre None
+/// @post The emulator holds no timers or delayed copies.
+///////////////////////////////////////////////////////////////////////////////
+void CNetworkEmulator::Stop()
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_timer.reset();
+    m_watch.reset();
+    m_pending.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::Load
+/// @description Reads the settings from an XML file of the form
+///     <network><incoming>...</incoming><outgoing>...</outgoing></network>.
+///     Each direction holds the default settings of its links followed by
+///     <channel uuid="..."> elements for particular peers. The settings are
+///     delay and jitter in milliseconds, the reorder, duplicate and loss
+///     probabilities, bandwidth in bytes per second, and a burst element with
+///     the enter, leave and loss probabilities of the bad state. An optional
+///     <seed> makes the decisions repeatable.
+/// @pre None
+/// @post On success the emulator uses the new settings. On failure the old
+///     settings remain.
+/// @param filename The settings file.
+/// @return True if the file was read.
+///////////////////////////////////////////////////////////////////////////////
+bool CNetworkEmulator::Load(const std::string & filename)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    std::time_t modified = GetModified(filename);
+    boost::property_tree::ptree pt;
+    try
+    {
+        boost::property_tree::read_xml(filename, pt);
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        m_modified = modified;
+        Parse(pt);
+    }
+    catch(std::exception & e)
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        m_modified = modified;
+        Logger.Warn << "Could not load network emulation settings from "
+                << filename << ": " << e.what() << std::endl;
+        return false;
+    }
+    m_enabled.store(true, boost::memory_order_release);
+    Logger.Notice << "Loaded network emulation settings from " << filename
+            << std::endl;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::Disable
+/// @description Forgets the settings of every link.
+/// @pre None
+/// @post New datagrams are delivered unchanged. Copies which are already
+///     delayed are still delivered when due.
+///////////////////////////////////////////////////////////////////////////////
+void CNetworkEmulator::Disable()
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_enabled.store(false, boost::memory_order_release);
+    for(int i = 0; i < 2; i++)
+    {
+        m_defaults[i] = LinkSettings();
+        m_links[i].clear();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::Deliver
+/// @description Decides whether a datagram is lost, duplicated or delayed.
+///     Copies with no delay are left to the caller, so that an unimpaired
+///     link behaves exactly as if there were no emulator. Delayed copies are
+///     queued and run on the strand when they are due.
+/// @pre If the emulator was not started, delays are ignored.
+/// @post Delayed copies of the datagram are queued.
+/// @param dir Whether the datagram is being sent or was received.
+/// @param uuid The peer on the other end of the link.
+/// @param bytes The size of the datagram.
+/// @param strand The strand which delayed copies are delivered on.
+/// @param action Delivers one copy of the datagram.
+/// @return The number of copies the caller should deliver now.
+///////////////////////////////////////////////////////////////////////////////
+unsigned int CNetworkEmulator::Deliver(Direction dir, const std::string & uuid,
+        std::size_t bytes, boost::asio::io_service::strand & strand,
+        Action action)
+{
+    if(!IsEnabled())
+    {
+        return 1;
+    }
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    Link & link = GetLink(dir, uuid);
+    const LinkSettings & s = link.settings;
+    if(link.bad)
+    {
+        link.bad = !(Random() < s.leave);
+    }
+    else
+    {
+        link.bad = Random() < s.enter;
+    }
+    if(Random() < (link.bad ? s.burstloss : s.loss))
+    {
+        Logger.Info << "Dropped " << DIRECTION_NAMES[dir] << " datagram ("
+                << uuid << ")" << std::endl;
+        DroppedDatagrams.fetch_add(1, boost::memory_order_relaxed);
+        return 0;
+    }
+    unsigned int copies = 1;
+    if(Random() < s.duplicate)
+    {
+        DuplicatedDatagrams.fetch_add(1, boost::memory_order_relaxed);
+        copies = 2;
+    }
+    if(!m_timer)
+    {
+        return copies;
+    }
+    boost::posix_time::ptime now = CClock::instance().GetMonotonicTime();
+    unsigned int immediate = 0;
+    for(unsigned int i = 0; i < copies; i++)
+    {
+        boost::posix_time::time_duration delay = Delay(link, bytes, now);
+        if(delay <= boost::posix_time::time_duration())
+        {
+            immediate++;
+            continue;
+        }
+        Pending p;
+        p.due = now + delay;
+        p.sequence = m_sequence++;
+        p.action = strand.wrap(action);
+        m_pending.push_back(p);
+        std::push_heap(m_pending.begin(), m_pending.end());
+        DelayedDatagrams.fetch_add(1, boost::memory_order_relaxed);
+        if(m_pending.front().sequence == p.sequence)
+        {
+            ArmTimer();
+        }
+    }
+    return immediate;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::GetPending
+/// @description Counts the copies waiting in the delay queue.
+/// @return The number of delayed copies.
+///////////////////////////////////////////////////////////////////////////////
+std::size_t CNetworkEmulator::GetPending() const
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_pending.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::Parse
+/// @description Replaces the links with those described by a settings tree.
+/// @pre The caller holds m_mutex.
+/// @post Every link has been reset to its new settings.
+/// @param pt The parsed settings file.
+///////////////////////////////////////////////////////////////////////////////
+void CNetworkEmulator::Parse(const boost::property_tree::ptree & pt)
+{
+    LinkSettings defaults[2];
+    LinkMap links[2];
+    for(int i = 0; i < 2; i++)
+    {
+        std::string path = std::string("network.") + DIRECTION_NAMES[i];
+        boost::property_tree::ptree empty;
+        const boost::property_tree::ptree & dir =
+                pt.get_child(path, empty);
+        defaults[i] = LinkSettings(dir, LinkSettings());
+        BOOST_FOREACH(const boost::property_tree::ptree::value_type & child,
+                dir)
+        {
+            if(child.first != "channel")
+            {
+                continue;
+            }
+            std::string uuid = child.second.get<std::string>("<xmlattr>.uuid");
+            links[i].insert(LinkMap::value_type(uuid,
+                    Link(LinkSettings(child.second, defaults[i]))));
+        }
+    }
+    for(int i = 0; i < 2; i++)
+    {
+        m_defaults[i] = defaults[i];
+        m_links[i].swap(links[i]);
+    }
+    if(pt.count("network") > 0 && pt.get_child("network").count("seed") > 0)
+    {
+        m_random.seed(pt.get<boost::uint32_t>("network.seed"));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::GetLink
+/// @description Finds the link to a peer. Peers which the settings do not
+///     name get a link with the default settings of the direction.
+/// @pre The caller holds m_mutex.
+/// @post The link exists.
+/// @param dir The direction of the link.
+/// @param uuid The peer on the other end of the link.
+/// @return The link.
+///////////////////////////////////////////////////////////////////////////////
+CNetworkEmulator::Link & CNetworkEmulator::GetLink(Direction dir,
+        const std::string & uuid)
+{
+    LinkMap::iterator it = m_links[dir].find(uuid);
+    if(it == m_links[dir].end())
+    {
+        it = m_links[dir].insert(
+                LinkMap::value_type(uuid, Link(m_defaults[dir]))).first;
+    }
+    return it->second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::Random
+/// @description Draws a uniformly distributed number.
+/// @pre The caller holds m_mutex.
+/// @return A number in [0,1).
+///////////////////////////////////////////////////////////////////////////////
+double CNetworkEmulator::Random()
+{
+    return m_random() / 4294967296.0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::Delay
+/// @description Adds the time the datagram waits behind earlier datagrams
+///     and takes to transmit at the link's bandwidth to the link's delay
+///     and jitter. A reordered datagram skips the delay and jitter but not
+///     the bandwidth queue.
+/// @pre The caller holds m_mutex.
+/// @post The link is busy until the datagram has been transmitted.
+/// @param link The link the datagram is sent on.
+/// @param bytes The size of the datagram.
+/// @param now The current monotonic time.
+/// @return How long the datagram is held back.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::time_duration CNetworkEmulator::Delay(Link & link,
+        std::size_t bytes, boost::posix_time::ptime now)
+{
+    const LinkSettings & s = link.settings;
+    boost::posix_time::time_duration delay;
+    if(!(Random() < s.reorder))
+    {
+        delay = s.delay;
+        if(s.jitter.total_microseconds() > 0)
+        {
+            double offset = (2 * Random() - 1) * s.jitter.total_microseconds();
+            delay += boost::posix_time::microseconds(
+                    static_cast<long>(offset));
+        }
+        if(delay.is_negative())
+        {
+            delay = boost::posix_time::time_duration();
+        }
+    }
+    if(s.bandwidth > 0)
+    {
+        boost::posix_time::ptime start = now;
+        if(!link.busy.is_not_a_date_time() && link.busy > now)
+        {
+            start = link.busy;
+        }
+        link.busy = start + boost::posix_time::microseconds(
+                static_cast<long>(bytes * 1000000.0 / s.bandwidth));
+        delay += link.busy - now;
+    }
+    return delay;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::HandleTimer
+/// @description Takes every copy which is due off the queue and runs it on
+///     its strand.
+/// @pre None
+/// @post The timer is armed for the next copy, if there is one.
+/// @param err The reason the timer fired.
+///////////////////////////////////////////////////////////////////////////////
+void CNetworkEmulator::HandleTimer(const boost::system::error_code & err)
+{
+    if(err == boost::asio::error::operation_aborted)
+    {
+        return;
+    }
+    std::vector<Action> due;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        if(!m_timer)
+        {
+            return;
+        }
+        boost::posix_time::ptime now = CClock::instance().GetMonotonicTime();
+        while(!m_pending.empty() && m_pending.front().due <= now)
+        {
+            std::pop_heap(m_pending.begin(), m_pending.end());
+            due.push_back(m_pending.back().action);
+            m_pending.pop_back();
+        }
+        ArmTimer();
+    }
+    BOOST_FOREACH(Action & action, due)
+    {
+        action();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::ArmTimer
+/// @description Sets the timer to expire when the earliest copy is due,
+///     cancelling any earlier wait.
+/// @pre The caller holds m_mutex and the emulator has been started.
+/// @post HandleTimer will run when the earliest copy is due.
+///////////////////////////////////////////////////////////////////////////////
+void CNetworkEmulator::ArmTimer()
+{
+    if(m_pending.empty())
+    {
+        return;
+    }
+    boost::posix_time::ptime now = CClock::instance().GetMonotonicTime();
+    m_timer->expires_from_now(m_pending.front().due - now);
+    m_timer->async_wait(boost::bind(&CNetworkEmulator::HandleTimer, this,
+            boost::asio::placeholders::error));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CNetworkEmulator::HandleWatch
+/// @description Reloads the settings file if its modification time has
+///     changed, and disables the emulator if it has been removed.
+/// @pre None
+/// @post The watch timer is armed again.
+/// @param err The reason the timer fired.
+///////////////////////////////////////////////////////////////////////////////
+void CNetworkEmulator::HandleWatch(const boost::system::error_code & err)
+{
+    if(err == boost::asio::error::operation_aborted)
+    {
+        return;
+    }
+    std::string filename;
+    std::time_t previous;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        if(!m_watch)
+        {
+            return;
+        }
+        filename = m_filename;
+        previous = m_modified;
+        m_watch->expires_from_now(m_interval);
+        m_watch->async_wait(boost::bind(&CNetworkEmulator::HandleWatch, this,
+                boost::asio::placeholders::error));
+    }
+    std::time_t modified = GetModified(filename);
+    if(modified == previous)
+    {
+        return;
+    }
+    if(modified == 0)
+    {
+        Logger.Notice << filename << " was removed, network emulation is off."
+                << std::endl;
+        Disable();
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        m_modified = 0;
+        return;
+    }
+    Load(filename);
+}
+
+} // namespace broker
+
+} // namespace freedm
@@ -0,0 +1,294 @@
+//////////////////////////////////////////////////////////
+/// @file         CPacketTimestamps.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Kernel timestamps of the datagrams a socket sends and receives
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CPacketTimestamps.hpp"
+#include "CClock.hpp"
+#include "CLogger.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <sys/socket.h>
+#include <linux/net_tstamp.h>
+
+namespace freedm {
+    namespace broker {
+
+namespace {
+
+/// This file's logger.
+CLocalLogger Logger(__FILE__);
+
+/// Room for the control messages of a received datagram or a send stamp.
+const std::size_t CONTROL_SIZE = 512;
+
+/// A control buffer aligned for the control message headers.
+union ControlBuffer
+{
+    /// The raw buffer.
+    char data[CONTROL_SIZE];
+    /// Forces the alignment.
+    cmsghdr align;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// ToDGITime
+/// @description Converts a time read from the system clock to DGI time. The
+///     DGI time advances with the monotonic clock, so only the age of the
+///     stamp is taken from the system clock.
+/// @param ts The system time the kernel stamped a datagram with.
+/// @return The DGI time of the stamp.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::ptime ToDGITime(const timespec & ts)
+{
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    boost::posix_time::time_duration age =
+        boost::posix_time::seconds(now.tv_sec - ts.tv_sec) +
+        boost::posix_time::microseconds((now.tv_nsec - ts.tv_nsec) / 1000);
+    // A stamp from the future means the system clock was stepped back
+    if(age.is_negative())
+    {
+        age = boost::posix_time::time_duration();
+    }
+    return CClock::instance().GetDGITime() - age;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// ReadStamp
+/// @description Finds the software stamp among the control messages.
+/// @param msg The header filled in by recvmsg.
+/// @param stamp Set to the stamp, if there is one.
+/// @return True if a stamp was found.
+///////////////////////////////////////////////////////////////////////////////
+bool ReadStamp(msghdr & msg, boost::posix_time::ptime & stamp)
+{
+    for(cmsghdr * c = CMSG_FIRSTHDR(&msg); c != NULL; c = CMSG_NXTHDR(&msg, c))
+    {
+        if(c->cmsg_level != SOL_SOCKET)
+        {
+            continue;
+        }
+        timespec ts;
+#ifdef SO_TIMESTAMPING
+        if(c->cmsg_type == SCM_TIMESTAMPING)
+        {
+            // The software stamp comes first, then two hardware stamps
+            std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            if(ts.tv_sec != 0 || ts.tv_nsec != 0)
+            {
+                stamp = ToDGITime(ts);
+                return true;
+            }
+            continue;
+        }
+#endif
+#ifdef SO_TIMESTAMPNS
+        if(c->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            stamp = ToDGITime(ts);
+            return true;
+        }
+#endif
+    }
+    return false;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CPacketTimestamps::EnableReceive
+/// @description Asks the kernel to stamp received datagrams in software,
+///     falling back to the older nanosecond receive stamps.
+/// @pre fd is an open socket.
+/// @post Datagrams read with Receive carry a stamp, if the kernel allows it.
+/// @param fd The socket to stamp.
+/// @return True if received datagrams will be stamped.
+///////////////////////////////////////////////////////////////////////////////
+bool CPacketTimestamps::EnableReceive(int fd)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+#ifdef SO_TIMESTAMPING
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if(setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0)
+    {
+        return true;
+    }
+#endif
+#ifdef SO_TIMESTAMPNS
+    int on = 1;
+    if(setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0)
+    {
+        return true;
+    }
+#endif
+    Logger.Info << "Kernel receive timestamps are unavailable: "
+            << std::strerror(errno) << std::endl;
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CPacketTimestamps::EnableSend
+/// @description Lets the kernel report send stamps on the socket. Only the
+///     datagrams which Send writes ask for one, so other sends do not fill
+///     the error queue of the socket.
+/// @pre fd is an open socket.
+/// @post Send can read the stamps of its datagrams.
+/// @param fd The socket to stamp.
+/// @return True if the kernel accepted the request.
+///////////////////////////////////////////////////////////////////////////////
+bool CPacketTimestamps::EnableSend(int fd)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+#ifdef SO_TIMESTAMPING
+    int flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_TSONLY;
+    if(setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0)
+    {
+        return true;
+    }
+#endif
+    Logger.Info << "Kernel send timestamps are unavailable: "
+            << std::strerror(errno) << std::endl;
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CPacketTimestamps::Receive
+/// @description Reads one datagram without blocking.
+/// @pre fd is a datagram socket.
+/// @post The datagram has been taken from the socket.
+/// @param fd The socket to read.
+/// @param buffer Where to put the datagram.
+/// @param length The size of the buffer.
+/// @param from Where to put the address of the sender.
+/// @param fromLength The size of from, then the size of the address.
+/// @param stamp Set to the time the kernel received the datagram, if it
+///     stamped it.
+/// @return The size of the datagram, or -1 with errno set.
+///////////////////////////////////////////////////////////////////////////////
+ssize_t CPacketTimestamps::Receive(int fd, char * buffer, std::size_t length,
+        void * from, std::size_t & fromLength, boost::posix_time::ptime & stamp)
+{
+    iovec iov;
+    iov.iov_base = buffer;
+    iov.iov_len = length;
+    ControlBuffer control;
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_name = from;
+    msg.msg_namelen = fromLength;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data;
+    msg.msg_controllen = sizeof(control.data);
+
+    ssize_t result = recvmsg(fd, &msg, MSG_DONTWAIT);
+    if(result >= 0)
+    {
+        fromLength = msg.msg_namelen;
+        ReadStamp(msg, stamp);
+    }
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CPacketTimestamps::Send
+/// @description Writes a datagram which asks the kernel for a send stamp,
+///     then collects the stamp from the error queue of the socket. Stamps
+///     left over from earlier sends are discarded first so they cannot be
+///     mistaken for this one.
+/// @pre fd is a connected datagram socket and EnableSend succeeded on it.
+/// @post The datagram has been sent.
+/// @param fd The socket to write.
+/// @param buffer The datagram.
+/// @param length The size of the datagram.
+/// @param stamp Set to the time the kernel sent the datagram, if the stamp
+///     was ready when the send returned.
+/// @return The number of bytes sent, or -1 with errno set.
+///////////////////////////////////////////////////////////////////////////////
+ssize_t CPacketTimestamps::Send(int fd, const char * buffer,
+        std::size_t length, boost::posix_time::ptime & stamp)
+{
+    char discard;
+    iovec iov;
+    ControlBuffer control;
+    msghdr msg;
+
+    // Drain the stamps which arrived too late for their sends
+    do
+    {
+        std::memset(&msg, 0, sizeof(msg));
+        iov.iov_base = &discard;
+        iov.iov_len = sizeof(discard);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.data;
+        msg.msg_controllen = sizeof(control.data);
+    } while(recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) >= 0);
+
+    std::memset(&msg, 0, sizeof(msg));
+    iov.iov_base = const_cast<char *>(buffer);
+    iov.iov_len = length;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+#ifdef SO_TIMESTAMPING
+    msg.msg_control = control.data;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int));
+    cmsghdr * c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SO_TIMESTAMPING;
+    c->cmsg_len = CMSG_LEN(sizeof(int));
+    int flags = SOF_TIMESTAMPING_TX_SOFTWARE;
+    std::memcpy(CMSG_DATA(c), &flags, sizeof(flags));
+#endif
+    ssize_t result = sendmsg(fd, &msg, 0);
+    if(result < 0)
+    {
+        return result;
+    }
+
+    std::memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &discard;
+    iov.iov_len = sizeof(discard);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data;
+    msg.msg_controllen = sizeof(control.data);
+    if(recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) >= 0)
+    {
+        ReadStamp(msg, stamp);
+    }
+    return result;
+}
+
+    } // namespace broker
+} // namespace freedm
@@ -70,12 +70,12 @@ CLocalLogger Logger(__FILE__);
 CReliableConnection::CReliableConnection(boost::asio::io_service& p_ioService,
   CConnectionManager& p_manager, CBroker& p_broker, std::string uuid)
   : m_socket(p_ioService),
+    m_strand(p_ioService),
     m_connManager(p_manager),
     m_broker(p_broker),
     m_uuid(uuid)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    m_reliability = 100;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -120,17 +120,21 @@ boost::asio::io_service& CReliableConnection::GetIOService()
     return m_socket.get_io_service();
 }
 
-/// Set the connection reliability for DCUSTOMNETWORK
-void CReliableConnection::SetReliability(int r)
+///////////////////////////////////////////////////////////////////////////////
+/// @fn CReliableConnection::GetStrand
+/// @description Returns the strand used to serialize the handlers that touch
+///   this connection's protocol state. Receive processing, sends, and the
+///   protocol retransmit timers are all run through this strand so that the
+///   connection is safe to use when the broker runs on several threads.
+/// @pre None
+/// @post None
+/// @return A reference to the strand used by this connection.
+///////////////////////////////////////////////////////////////////////////////
+boost::asio::io_service::strand& CReliableConnection::GetStrand()
 {
-    m_reliability = r;
+    return m_strand;
 }
 
-/// Get the connection reliability for DCUSTOMNETWORK
-int CReliableConnection::GetReliability()
-{
-    return m_reliability;
-}
 
 
     } // namespace broker
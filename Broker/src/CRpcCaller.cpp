@@ -0,0 +1,222 @@
+//////////////////////////////////////////////////////////
+/// @file         CRpcCaller.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Sends calls to peers and completes them by reply or deadline
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CRpcCaller.hpp"
+#include "CClock.hpp"
+#include "CLogger.hpp"
+
+#include <set>
+
+#include <boost/asio/error.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace freedm {
+
+namespace broker {
+
+namespace {
+
+/// This file's logger.
+CLocalLogger Logger(__FILE__);
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRpcCaller::CRpcCaller
+/// @description Creates a caller with no calls and allocates its timer.
+/// @pre None
+/// @post The caller owns a timer of the module.
+/// @param broker The broker which runs the module.
+/// @param module The module whose thread runs the completions.
+/// @param send Sends each request; if empty, requests go by IPeerNode::Send.
+///////////////////////////////////////////////////////////////////////////////
+CRpcCaller::CRpcCaller(CBroker & broker, CBroker::ModuleIdent module,
+        Sender send)
+    : m_broker(broker)
+    , m_timer(broker.AllocateTimer(module))
+    , m_send(send)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRpcCaller::Call
+/// @description Opens a call, stamps its id on the request and sends the
+///     request to every peer. The call is open before the first request is
+///     sent, so no reply can arrive before it.
+/// @pre The request's handler is set.
+/// @post The completion runs once, when every peer has replied or once the
+///     timeout has passed.
+/// @param peers The peers to send the request to, by uuid.
+/// @param request The request to send.
+/// @param timeout How long to wait for the replies.
+/// @param done Runs with the replies and the peers which did not reply.
+/// @return The id of the call.
+///////////////////////////////////////////////////////////////////////////////
+CCallTable::CallID CRpcCaller::Call(
+        const std::map<std::string, PeerNodePtr> & peers, CMessage request,
+        boost::posix_time::time_duration timeout, CCallTable::Completion done)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    std::set<std::string> uuids;
+    std::map<std::string, PeerNodePtr>::const_iterator it;
+    for(it = peers.begin(); it != peers.end(); it++)
+    {
+        uuids.insert(it->first);
+    }
+    boost::posix_time::ptime deadline =
+            CClock::instance().GetMonotonicTime() + timeout;
+    CCallTable::CallID id = m_table.Open(uuids, deadline, done);
+    CCallTable::Stamp(request, id);
+    for(it = peers.begin(); it != peers.end(); it++)
+    {
+        if(m_send)
+        {
+            m_send(it->second, request);
+        }
+        else
+        {
+            it->second->Send(request);
+        }
+    }
+    Arm();
+    Logger.Debug << "Call " << id << " (" << request.GetHandler() << ") to "
+            << peers.size() << " peers" << std::endl;
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRpcCaller::Call
+/// @description Sends a request to a single peer.
+/// @pre The request's handler is set.
+/// @post The completion runs once, when the peer replies or once the timeout
+///     has passed.
+/// @param peer The peer to send the request to.
+/// @param request The request to send.
+/// @param timeout How long to wait for the reply.
+/// @param done Runs with the reply, or with the peer missing.
+/// @return The id of the call.
+///////////////////////////////////////////////////////////////////////////////
+CCallTable::CallID CRpcCaller::Call(PeerNodePtr peer, CMessage request,
+        boost::posix_time::time_duration timeout, CCallTable::Completion done)
+{
+    std::map<std::string, PeerNodePtr> peers;
+    peers[peer->GetUUID()] = peer;
+    return Call(peers, request, timeout, done);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRpcCaller::HandleReply
+/// @description Gives a reply to the call it names. The call's completion
+///     runs now if this was the last reply it was waiting for.
+/// @pre None
+/// @post The reply is part of its call's result, if the call was waiting.
+/// @param reply The reply received.
+/// @param peer The peer which sent it.
+/// @return False for a reply no call was waiting on, such as a late one.
+///////////////////////////////////////////////////////////////////////////////
+bool CRpcCaller::HandleReply(const CMessage & reply, PeerNodePtr peer)
+{
+    return m_table.Answer(reply, peer->GetUUID());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRpcCaller::Cancel
+/// @description Drops a call. Its completion will not run, and the timer is
+///     left alone since an early expiry finds nothing to complete.
+/// @pre None
+/// @post The call is not pending.
+/// @param id The call to drop.
+/// @return True if the call was pending.
+///////////////////////////////////////////////////////////////////////////////
+bool CRpcCaller::Cancel(CCallTable::CallID id)
+{
+    return m_table.Cancel(id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRpcCaller::IsPending
+/// @description Checks whether a call is still waiting on replies.
+/// @param id The call to check.
+/// @return True if the call has neither completed nor been cancelled.
+///////////////////////////////////////////////////////////////////////////////
+bool CRpcCaller::IsPending(CCallTable::CallID id) const
+{
+    return m_table.IsOpen(id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRpcCaller::Arm
+/// @description Sets the timer for the earliest deadline of a pending call,
+///     unless it is already set for that deadline or an earlier one.
+/// @pre None
+/// @post The timer will fire no later than the earliest deadline.
+///////////////////////////////////////////////////////////////////////////////
+void CRpcCaller::Arm()
+{
+    boost::posix_time::ptime next = m_table.GetNextDeadline();
+    boost::lock_guard<boost::mutex> lock(m_armMutex);
+    if(next.is_not_a_date_time() ||
+        (!m_armed.is_not_a_date_time() && m_armed <= next))
+    {
+        return;
+    }
+    m_armed = next;
+    m_broker.Schedule(m_timer, next - CClock::instance().GetMonotonicTime(),
+            boost::bind(&CRpcCaller::HandleDeadline, this,
+            boost::asio::placeholders::error));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRpcCaller::HandleDeadline
+/// @description Completes the calls which ran out of time and sets the timer
+///     for the next deadline.
+/// @pre None
+/// @post No pending call's deadline has passed.
+/// @param err operation_aborted if the timer was set for another deadline.
+///////////////////////////////////////////////////////////////////////////////
+void CRpcCaller::HandleDeadline(const boost::system::error_code & err)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    if(err == boost::asio::error::operation_aborted)
+    {
+        return;
+    }
+    {
+        boost::lock_guard<boost::mutex> lock(m_armMutex);
+        m_armed = boost::posix_time::not_a_date_time;
+    }
+    m_table.Expire(CClock::instance().GetMonotonicTime());
+    Arm();
+}
+
+} // namespace broker
+
+} // namespace freedm
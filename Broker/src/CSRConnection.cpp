@@ -35,6 +35,7 @@
 #include "CConnectionManager.hpp"
 #include "IProtocol.hpp"
 #include "CLogger.hpp"
+#include "CMetricsRegistry.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
@@ -53,6 +54,10 @@ namespace {
 /// This file's logger.
 CLocalLogger Logger(__FILE__);
 
+/// Datagrams written again by the resend timer.
+CMetricsRegistry::Counter & ResentDatagrams =
+        CMetricsRegistry::instance().GetCounter("net.datagrams.resent");
+
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -209,11 +214,12 @@ void CSRConnection::Resend(const boost::system::error_code& err)
             }
             Logger.Trace<<__PRETTY_FUNCTION__<<" Writing"<<std::endl;
             Write(m_window.front());
+            ResentDatagrams.fetch_add(1, boost::memory_order_relaxed);
             // Head of window can be killed.
             m_timeout.cancel();
             m_timeout.expires_from_now(boost::posix_time::milliseconds(REFIRE_TIME));
-            m_timeout.async_wait(boost::bind(&CSRConnection::Resend,shared_from_this(),
-                boost::asio::placeholders::error));
+            m_timeout.async_wait(GetConnection()->GetStrand().wrap(boost::bind(&CSRConnection::Resend,shared_from_this(),
+                boost::asio::placeholders::error)));
         }
     }
     Logger.Trace<<__PRETTY_FUNCTION__<<" Resend Finished"<<std::endl;
@@ -419,8 +425,8 @@ void CSRConnection::SendACK(const CMessage &msg)
     /// Hook into resend until the message expires.
     m_timeout.cancel();
     m_timeout.expires_from_now(boost::posix_time::milliseconds(REFIRE_TIME));
-    m_timeout.async_wait(boost::bind(&CSRConnection::Resend,shared_from_this(),
-        boost::asio::placeholders::error));
+    m_timeout.async_wait(GetConnection()->GetStrand().wrap(boost::bind(&CSRConnection::Resend,shared_from_this(),
+        boost::asio::placeholders::error)));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
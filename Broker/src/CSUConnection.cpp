@@ -36,6 +36,7 @@
 #include "CConnectionManager.hpp"
 #include "IProtocol.hpp"
 #include "CLogger.hpp"
+#include "CMetricsRegistry.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
@@ -54,6 +55,10 @@ namespace {
 /// This file's logger.
 CLocalLogger Logger(__FILE__);
 
+/// Datagrams written again by the resend timer.
+CMetricsRegistry::Counter & ResentDatagrams =
+        CMetricsRegistry::instance().GetCounter("net.datagrams.resent");
+
 }
 
 CSUConnection::CSUConnection(CConnection *  conn)
@@ -92,8 +97,8 @@ void CSUConnection::Send(CMessage msg)
         Write(msg);
         m_timeout.cancel();
         m_timeout.expires_from_now(boost::posix_time::milliseconds(50));
-        m_timeout.async_wait(boost::bind(&CSUConnection::Resend,this,
-            boost::asio::placeholders::error)); 
+        m_timeout.async_wait(GetConnection()->GetStrand().wrap(boost::bind(&CSUConnection::Resend,this,
+            boost::asio::placeholders::error))); 
     }
 }
 
@@ -110,6 +115,7 @@ void CSUConnection::Resend(const boost::system::error_code& err)
             if(f.ret > 0 && writes < static_cast<int>(WINDOW_SIZE))
             {        
                 Write(f.msg);
+                ResentDatagrams.fetch_add(1, boost::memory_order_relaxed);
                 writes++;
                 f.ret--;
             }
@@ -127,8 +133,8 @@ void CSUConnection::Resend(const boost::system::error_code& err)
         {
             m_timeout.cancel();
             m_timeout.expires_from_now(boost::posix_time::milliseconds(50));
-            m_timeout.async_wait(boost::bind(&CSUConnection::Resend,this,
-                boost::asio::placeholders::error));
+            m_timeout.async_wait(GetConnection()->GetStrand().wrap(boost::bind(&CSUConnection::Resend,this,
+                boost::asio::placeholders::error)));
         }
     }
 }
@@ -0,0 +1,223 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file      EventDecoder.cpp
+///
+/// @project   FREEDM DGI
+///
+/// @description
+///     Prints the binary event logs written with --event-log as text or CSV.
+///     Several logs, one per node, are merged into a single timeline.
+///
+/// @copyright
+///     These source code files were created at Missouri University of Science
+///     and Technology, and are intended for use in teaching or research. They
+///     may be freely copied, modified, and redistributed as long as modified
+///     versions are clearly marked as such and this notice is not removed.
+///     Neither the authors nor Missouri S&T make any warranty, express or
+///     implied, nor assume any legal responsibility for the accuracy,
+///     completeness, or usefulness of these files or any information
+///     distributed with these files.
+///
+///     Suggested modifications or questions about these files can be directed
+///     to Dr. Bruce McMillin, Department of Computer Science, Missouri
+///     University of Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+#include "CEventLog.hpp"
+
+using namespace freedm;
+using namespace broker;
+
+namespace {
+
+/// One record and the node which wrote it.
+struct Entry
+{
+    /// The record.
+    CEventLog::Record s_record;
+    /// The UUID of the node which wrote it.
+    std::string s_node;
+};
+
+/// Orders entries by time; stable sorting keeps each file's order on ties.
+bool EarlierEntry(const Entry & a, const Entry & b)
+{
+    return a.s_record.s_time < b.s_record.s_time;
+}
+
+/// The start of the time scale of the records.
+const boost::posix_time::ptime EPOCH(boost::gregorian::date(1970, 1, 1));
+
+///////////////////////////////////////////////////////////////////////////////
+/// ToMicroseconds
+/// @param time A time such as "2012-06-01 13:45:00.5", or "" for none.
+/// @param none The value returned for "".
+/// @return The time in microseconds since 1970.
+///////////////////////////////////////////////////////////////////////////////
+boost::int64_t ToMicroseconds(const std::string & time, boost::int64_t none)
+{
+    if(time.empty())
+    {
+        return none;
+    }
+    return (boost::posix_time::time_from_string(time) - EPOCH)
+            .total_microseconds();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Print
+/// @description Writes one entry as a text line or a CSV row.
+/// @param out The stream to write to.
+/// @param entry The entry to write.
+/// @param csv True for a CSV row.
+///////////////////////////////////////////////////////////////////////////////
+void Print(std::ostream & out, const Entry & entry, bool csv)
+{
+    const CEventLog::Record & r = entry.s_record;
+    const CEventLog::EventInfo * info = CEventLog::Describe(r.s_event);
+    std::string name = info ? info->s_name : "unknown";
+    boost::posix_time::ptime time =
+            EPOCH + boost::posix_time::microseconds(r.s_time);
+    if(csv)
+    {
+        out << r.s_time << ',' << entry.s_node << ','
+            << CEventLog::ModuleName(r.s_module) << ',' << name << ','
+            << r.s_sequence;
+        for(unsigned int i = 0; i < CEventLog::MAX_ARGS; i++)
+        {
+            out << ',';
+            if(i < r.s_argc)
+            {
+                out << r.s_args[i];
+            }
+        }
+        out << std::endl;
+        return;
+    }
+    out << boost::posix_time::to_simple_string(time) << ' '
+        << entry.s_node.substr(0, 8) << ' ' << name;
+    for(unsigned int i = 0; i < r.s_argc; i++)
+    {
+        out << ' ';
+        if(info && i < info->s_argc)
+        {
+            out << info->s_args[i] << '=';
+        }
+        out << r.s_args[i];
+    }
+    out << std::endl;
+}
+
+}
+
+/// Decoder entry point
+int main(int argc, char* argv[])
+{
+    po::options_description opts("Event Decoder Options");
+    po::positional_options_description posOpts;
+    po::variables_map vm;
+    std::vector<std::string> files;
+    std::string since, until, event, uuid;
+
+    try
+    {
+        opts.add_options()
+                ( "help,h", "print usage help (this screen)" )
+                ( "csv", "print comma separated values instead of text" )
+                ( "since",
+                po::value<std::string>( &since )->default_value(""),
+                "skip events before this time (YYYY-MM-DD HH:MM:SS)" )
+                ( "until",
+                po::value<std::string>( &until )->default_value(""),
+                "skip events after this time (YYYY-MM-DD HH:MM:SS)" )
+                ( "event",
+                po::value<std::string>( &event )->default_value(""),
+                "only print events with this name, such as gm.state" )
+                ( "hash",
+                po::value<std::string>( &uuid ),
+                "print the number which stands for this peer UUID and exit" )
+                ( "input-file",
+                po::value<std::vector<std::string> >( &files ),
+                "event log to print (may be repeated)" );
+        posOpts.add("input-file", -1);
+        po::store(po::command_line_parser(argc, argv)
+                .options(opts).positional(posOpts).run(), vm);
+        po::notify(vm);
+    }
+    catch(std::exception & e)
+    {
+        std::cerr << e.what() << std::endl << opts << std::endl;
+        return 1;
+    }
+    std::cout << std::setprecision(std::numeric_limits<double>::digits10);
+    if(vm.count("hash"))
+    {
+        std::cout << CEventLog::Hash(uuid) << std::endl;
+        return 0;
+    }
+    if(vm.count("help") || files.empty())
+    {
+        std::cout << "Usage: " << argv[0] << " [options] event-log..."
+                  << std::endl << opts << std::endl;
+        return vm.count("help") ? 0 : 1;
+    }
+
+    std::vector<Entry> entries;
+    boost::int64_t from, to;
+    try
+    {
+        from = ToMicroseconds(since,
+                std::numeric_limits<boost::int64_t>::min());
+        to = ToMicroseconds(until, std::numeric_limits<boost::int64_t>::max());
+        for(unsigned int i = 0; i < files.size(); i++)
+        {
+            std::vector<CEventLog::Record> records;
+            CEventLog::Header header = CEventLog::Read(files[i], records);
+            Entry entry;
+            entry.s_node = header.s_uuid;
+            for(unsigned int j = 0; j < records.size(); j++)
+            {
+                entry.s_record = records[j];
+                entries.push_back(entry);
+            }
+        }
+    }
+    catch(std::exception & e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::stable_sort(entries.begin(), entries.end(), &EarlierEntry);
+
+    bool csv = vm.count("csv") > 0;
+    if(csv)
+    {
+        std::cout << "time,node,module,event,sequence,"
+                  << "arg1,arg2,arg3,arg4,arg5,arg6" << std::endl;
+    }
+    Entry bound;
+    bound.s_record.s_time = from;
+    std::vector<Entry>::const_iterator it = std::lower_bound(
+            entries.begin(), entries.end(), bound, &EarlierEntry);
+    for(; it != entries.end() && it->s_record.s_time <= to; it++)
+    {
+        const CEventLog::EventInfo * info =
+                CEventLog::Describe(it->s_record.s_event);
+        if(event.empty() || (info && event == info->s_name))
+        {
+            Print(std::cout, *it, csv);
+        }
+    }
+    return 0;
+}
@@ -33,11 +33,15 @@
 #include "IProtocol.hpp"
 #include "CConnection.hpp"
 #include "CLogger.hpp"
+#include "CMetricsRegistry.hpp"
+#include "CNetworkEmulator.hpp"
 #include "CReliableConnection.hpp"
 #include "config.hpp"
 
 #include <exception>
 
+#include <boost/bind.hpp>
+
 namespace freedm {
     namespace broker {
         
@@ -46,6 +50,32 @@ namespace {
 /// This file's logger.
 CLocalLogger Logger(__FILE__);
 
+/// Datagrams written to the socket.
+CMetricsRegistry::Counter & SentDatagrams =
+        CMetricsRegistry::instance().GetCounter("net.datagrams.sent");
+
+///////////////////////////////////////////////////////////////////////////////
+/// SendDelayed
+/// @description Sends a copy of a datagram which the network emulator held
+///     back. Failures are left for the protocol's resends to recover from.
+/// @pre Called on the strand of the connection.
+/// @param conn The connection to send on.
+/// @param raw The contents of the datagram.
+///////////////////////////////////////////////////////////////////////////////
+void SendDelayed(CReliableConnection::ConnectionPtr conn, std::string raw)
+{
+    try
+    {
+        conn->GetSocket().send(boost::asio::buffer(raw));
+        SentDatagrams.fetch_add(1, boost::memory_order_relaxed);
+    }
+    catch(boost::system::system_error &e)
+    {
+        Logger.Debug << "Writing Delayed Datagram Failed: " << e.what()
+                << std::endl;
+    }
+}
+
 }
 
 void IProtocol::Write(CMessage msg)
@@ -87,24 +117,39 @@ void IProtocol::Write(CMessage msg)
     
     Logger.Debug<<"Writing "<<raw.length()<<" bytes to channel"<<std::endl;
 
-    #ifdef CUSTOMNETWORK
-    if((rand()%100) >= GetConnection()->GetReliability()) 
+    unsigned int copies = 1;
+    if(CNetworkEmulator::instance().IsEnabled())
     {
-        Logger.Info<<"Outgoing Packet Dropped ("<<GetConnection()->GetReliability()
-                      <<") -> "<<GetConnection()->GetUUID()<<std::endl;
-        return;
+        CConnection * conn = GetConnection();
+        copies = CNetworkEmulator::instance().Deliver(
+                CNetworkEmulator::OUTGOING, conn->GetUUID(), raw.length(),
+                conn->GetStrand(),
+                boost::bind(&SendDelayed, conn->shared_from_this(), raw));
     }
-    #endif
     // The length of the contents placed in the buffer should be the same length as
     // The string that was written into it.
-    try
-    {
-        GetConnection()->GetSocket().send(boost::asio::buffer(m_buffer,raw.length()));
-    }
-    catch(boost::system::system_error &e)
+    for(unsigned int i = 0; i < copies; i++)
     {
-        Logger.Debug << "Writing Failed: " << e.what() << std::endl;
-        GetConnection()->Stop(); 
+        try
+        {
+            if(i == 0 && msg.GetStatus() == CMessage::ReadClock)
+            {
+                GetConnection()->SendClockRequest(m_buffer.data(),
+                    raw.length(), msg.GetSendTimestamp());
+            }
+            else
+            {
+                GetConnection()->GetSocket().send(
+                    boost::asio::buffer(m_buffer,raw.length()));
+            }
+            SentDatagrams.fetch_add(1, boost::memory_order_relaxed);
+        }
+        catch(boost::system::system_error &e)
+        {
+            Logger.Debug << "Writing Failed: " << e.what() << std::endl;
+            GetConnection()->Stop(); 
+            break;
+        }
     }
 }
 
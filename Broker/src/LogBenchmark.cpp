@@ -0,0 +1,260 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file      LogBenchmark.cpp
+///
+/// @project   FREEDM DGI
+///
+/// @description
+///     Measures what logging costs two hot paths of the broker: building and
+///     parsing messages, and the RTDS adapter's exchange loop with a mock
+///     FPGA. Build with different -DCOMPILED_LOG_LEVEL values (and run with
+///     different -v levels) to compare.
+///
+/// @copyright
+///     These source code files were created at Missouri University of Science
+///     and Technology, and are intended for use in teaching or research. They
+///     may be freely copied, modified, and redistributed as long as modified
+///     versions are clearly marked as such and this notice is not removed.
+///     Neither the authors nor Missouri S&T make any warranty, express or
+///     implied, nor assume any legal responsibility for the accuracy,
+///     completeness, or usefulness of these files or any information
+///     distributed with these files.
+///
+///     Suggested modifications or questions about these files can be directed
+///     to Dr. Bruce McMillin, Department of Computer Science, Missouri
+///     University of Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace po = boost::program_options;
+
+#include "CClock.hpp"
+#include "CLogger.hpp"
+#include "CMessage.hpp"
+#include "config.hpp"
+#include "device/CRtdsAdapter.hpp"
+
+using namespace freedm;
+using namespace broker;
+
+namespace {
+
+/// This file's logger.
+CLocalLogger Logger(__FILE__);
+
+/// The number of values in each direction of the mock FPGA's tables.
+const unsigned int TABLE_SIZE = 32;
+
+/// The name of the table specification written for the RTDS adapter.
+const char * const FPGA_FILE = "LogBenchmarkFPGA.xml";
+
+///////////////////////////////////////////////////////////////////////////////
+/// Elapsed
+/// @param start When the measurement started.
+/// @return The seconds since start.
+///////////////////////////////////////////////////////////////////////////////
+double Elapsed(boost::posix_time::ptime start)
+{
+    return (CClock::instance().GetMonotonicTime() - start).total_microseconds()
+            / 1e6;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// BenchMessages
+/// @description Builds, serializes and parses messages like those the
+///     modules exchange for a fixed time.
+/// @param seconds How long to run.
+/// @return Messages per second.
+///////////////////////////////////////////////////////////////////////////////
+double BenchMessages(double seconds)
+{
+    boost::posix_time::ptime start = CClock::instance().GetMonotonicTime();
+    unsigned long count = 0;
+    double elapsed;
+    do
+    {
+        for(int i = 0; i < 100; i++, count++)
+        {
+            CMessage m;
+            m.SetHandler("gm.AreYouCoordinator");
+            m.SetSourceUUID("1b7e4b20-8e3c-11e1-b0c4-0800200c9a66");
+            m.SetSequenceNumber(count);
+            m.SetSendTimestampNow();
+            m.GetSubMessages().put("gm.groupid", count);
+            m.GetSubMessages().put("gm.groupleader", "leader");
+            std::stringstream ss;
+            m.Save(ss);
+            CMessage r;
+            r.Load(ss);
+        }
+        elapsed = Elapsed(start);
+    } while(elapsed < seconds);
+    return count / elapsed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// WriteTables
+/// @description Writes a table specification with one state and one command
+///     value for each of TABLE_SIZE devices.
+///////////////////////////////////////////////////////////////////////////////
+void WriteTables()
+{
+    std::ofstream out(FPGA_FILE);
+    out << "<root>";
+    const char * tables[] = { "state", "command" };
+    for(int t = 0; t < 2; t++)
+    {
+        out << "<" << tables[t] << ">";
+        for(unsigned int i = 1; i <= TABLE_SIZE; i++)
+        {
+            out << "<entry index=\"" << i << "\"><device>dev" << i
+                << "</device><key>" << tables[t] << "</key></entry>";
+        }
+        out << "</" << tables[t] << ">";
+    }
+    out << "</root>" << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// ServeFPGA
+/// @description Plays the FPGA: answers every command buffer with a state
+///     buffer until the adapter disconnects.
+/// @param ios The service which runs the acceptor.
+/// @param acceptor The socket the adapter connects to.
+/// @param exchanges Incremented for every exchange.
+///////////////////////////////////////////////////////////////////////////////
+void ServeFPGA(boost::asio::io_service * ios,
+        boost::asio::ip::tcp::acceptor * acceptor, unsigned long * exchanges)
+{
+    boost::asio::ip::tcp::socket socket(*ios);
+    acceptor->accept(socket);
+    std::vector<char> buffer(4 * TABLE_SIZE);
+    boost::system::error_code error;
+    while(true)
+    {
+        boost::asio::read(socket, boost::asio::buffer(buffer), error);
+        if(error)
+        {
+            return;
+        }
+        boost::asio::write(socket, boost::asio::buffer(buffer), error);
+        if(error)
+        {
+            return;
+        }
+        (*exchanges)++;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// BenchRtds
+/// @description Runs the RTDS adapter against a mock FPGA on the loopback
+///     interface for a fixed time, reading and writing every table entry
+///     between exchanges as the devices would.
+/// @param seconds How long to run.
+/// @return Exchanges per second.
+///////////////////////////////////////////////////////////////////////////////
+double BenchRtds(double seconds)
+{
+    boost::asio::io_service serverios;
+    boost::asio::ip::tcp::acceptor acceptor(serverios,
+            boost::asio::ip::tcp::endpoint(
+                boost::asio::ip::address_v4::loopback(), 0));
+    unsigned long exchanges = 0;
+    boost::thread server(boost::bind(&ServeFPGA, &serverios, &acceptor,
+            &exchanges));
+
+    WriteTables();
+    boost::asio::io_service ios;
+    device::CRtdsAdapter::Pointer adapter =
+            device::CRtdsAdapter::Create(ios, FPGA_FILE, "root");
+    adapter->Connect("127.0.0.1", boost::lexical_cast<std::string>(
+            acceptor.local_endpoint().port()));
+
+    std::vector<std::string> devices;
+    for(unsigned int i = 1; i <= TABLE_SIZE; i++)
+    {
+        devices.push_back("dev" + boost::lexical_cast<std::string>(i));
+    }
+    boost::posix_time::ptime start = CClock::instance().GetMonotonicTime();
+    double elapsed;
+    adapter->Run();
+    do
+    {
+        ios.run_one();
+        for(unsigned int i = 0; i < devices.size(); i++)
+        {
+            adapter->Set(devices[i], "command",
+                    adapter->Get(devices[i], "state"));
+        }
+        elapsed = Elapsed(start);
+    } while(elapsed < seconds);
+    adapter->Quit();
+    server.join();
+    std::remove(FPGA_FILE);
+    return exchanges / elapsed;
+}
+
+}
+
+/// Benchmark entry point
+int main(int argc, char* argv[])
+{
+    CGlobalLogger::instance().SetGlobalLevel(3);
+    po::options_description opts("Log Benchmark Options");
+    po::variables_map vm;
+    double seconds;
+    unsigned int verbosity;
+
+    try
+    {
+        opts.add_options()
+                ( "help,h", "print usage help (this screen)" )
+                ( "seconds,s",
+                po::value<double>( &seconds )->default_value(3),
+                "how long to run each benchmark" )
+                ( "verbose,v",
+                po::value<unsigned int>( &verbosity )->default_value(5),
+                "runtime log level (the broker's default is 5)" );
+        po::store(po::parse_command_line(argc, argv, opts), vm);
+        po::notify(vm);
+    }
+    catch(std::exception & e)
+    {
+        std::cerr << e.what() << std::endl << opts << std::endl;
+        return 1;
+    }
+    if(vm.count("help"))
+    {
+        std::cout << opts << std::endl;
+        return 0;
+    }
+    CGlobalLogger::instance().SetGlobalLevel(verbosity);
+
+    std::cout << "compiled log level " << COMPILED_LOG_LEVEL
+              << ", runtime log level " << verbosity << std::endl;
+    try
+    {
+        std::cout << "messages:      " << BenchMessages(seconds)
+                  << " per second" << std::endl;
+        std::cout << "rtds exchanges: " << BenchRtds(seconds)
+                  << " per second" << std::endl;
+    }
+    catch(std::exception & e)
+    {
+        Logger.Error << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
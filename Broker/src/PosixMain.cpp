@@ -26,6 +26,8 @@
 
 #ifdef __unix__
 
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <string>
@@ -47,14 +49,19 @@ namespace po = boost::program_options;
 #include "CBroker.hpp"
 #include "CConnectionManager.hpp"
 #include "CDispatcher.hpp"
+#include "CEventLog.hpp"
+#include "CFailureDetector.hpp"
 #include "CGlobalConfiguration.hpp"
 #include "CLogger.hpp"
+#include "CMetricsRegistry.hpp"
+#include "CNetworkEmulator.hpp"
 #include "CUuid.hpp"
 #include "config.hpp"
 #include "device/CPhysicalDeviceManager.hpp"
 #include "device/CDeviceFactory.hpp"
 #include "device/PhysicalDeviceTypes.hpp"
 #include "gm/GroupManagement.hpp"
+#include "gm/SwimMembership.hpp"
 #include "lb/LoadBalance.hpp"
 #include "sc/StateCollection.hpp"
 #include "version.h"
@@ -67,6 +74,45 @@ namespace {
 /// This file's logger.
 CLocalLogger Logger(__FILE__);
 
+///////////////////////////////////////////////////////////////////////////////
+/// WriteStats
+/// @description Writes the broker's counters and the scheduler statistics of
+///     each module as "name value" lines, for the cluster benchmark. The
+///     lines go to a temporary file which then replaces the old one, so a
+///     scraper reading it while the broker runs never sees half of it.
+/// @param filename The file to (over)write.
+/// @param broker The broker whose scheduler statistics are written.
+/// @param modules The modules registered with the broker.
+///////////////////////////////////////////////////////////////////////////////
+void WriteStats(const std::string & filename, CBroker & broker,
+        const std::vector<std::string> & modules)
+{
+    std::string partial = filename + ".tmp";
+    std::ofstream out(partial.c_str());
+    if(!out)
+    {
+        Logger.Error << "Unable to write stats file: " << partial << std::endl;
+        return;
+    }
+    CMetricsRegistry::instance().Print(out);
+    foreach(const std::string & module, modules)
+    {
+        CBroker::ModuleMetrics mm = broker.GetMetrics(module);
+        std::string prefix = "scheduler." + module + ".";
+        out << prefix << "tasks " << mm.tasks << std::endl
+            << prefix << "phases " << mm.phases << std::endl
+            << prefix << "deferred " << mm.deferred << std::endl
+            << prefix << "overruns " << mm.overruns << std::endl
+            << prefix << "latency.p99 " << mm.latency.GetPercentile(99)
+            << std::endl;
+    }
+    out.close();
+    if(std::rename(partial.c_str(), filename.c_str()) != 0)
+    {
+        Logger.Error << "Unable to replace stats file: " << filename << std::endl;
+    }
+}
+
 }
 
 /// The copyright year for this DGI release.
@@ -93,12 +139,19 @@ int main(int argc, char* argv[])
     po::positional_options_description posOpts;
     po::variables_map vm;
     std::ifstream ifs;
-    std::string cfgFile, loggerCfgFile, fpgaCfgFile;
+    std::string cfgFile, loggerCfgFile, fpgaCfgFile, statsFile, networkCfgFile;
+    std::string logFile, eventLogFile, gmMode, gmCheckpointFile;
+    std::ofstream logStream;
     std::string listenIP, port, uuidString, hostname, uuidgenerator;
     // Line/RTDS Client options
     std::string interHost;
     std::string interPort;
     unsigned int globalVerbosity;
+    unsigned int threads;
+    unsigned int batchBudget;
+    unsigned int eventLogRecords;
+    double failureThreshold;
+    unsigned int failurePause;
     CUuid uuid;
 
     // Load Config Files
@@ -141,11 +194,58 @@ int main(int argc, char* argv[])
                 po::value<std::string > ( &fpgaCfgFile )->
                 default_value("./config/FPGA.xml"),
                 "filename of the FPGA message specification" )
+                ( "network-config",
+                po::value<std::string > ( &networkCfgFile )->default_value(""),
+                "filename of the network emulation settings (reloaded when "
+                "it changes)" )
                 ( "list-loggers", "Print all the available loggers and exit" )
+                ( "log-file",
+                po::value<std::string > ( &logFile )->default_value(""),
+                "file the log is written to (standard error if not given)" )
+                ( "event-log",
+                po::value<std::string > ( &eventLogFile )->default_value(""),
+                "file to record binary events to (see PosixEventDecoder)" )
+                ( "event-log-records",
+                po::value<unsigned int>( &eventLogRecords )->
+                default_value(65536),
+                "events the event log holds before it overwrites the oldest" )
+                ( "failure-threshold",
+                po::value<double>( &failureThreshold )->default_value(8),
+                "suspicion (phi) at which group management drops a silent "
+                "peer; 0 leaves it to the fixed timeouts" )
+                ( "failure-pause",
+                po::value<unsigned int>( &failurePause )->default_value(1000),
+                "milliseconds a peer may be quieter than usual before it is "
+                "suspected" )
+                ( "gm-mode",
+                po::value<std::string > ( &gmMode )->
+                default_value("invitation"),
+                "group management to run: invitation (the Garcia-Molina "
+                "election), fast-merge (the election without the priority "
+                "wait) or swim (randomized probing and gossip)" )
+                ( "gm-checkpoint",
+                po::value<std::string > ( &gmCheckpointFile )->
+                default_value(""),
+                "file group management saves its group to, and rejoins "
+                "that group from when restarted" )
                 ( "logger-config",
                 po::value<std::string > ( &loggerCfgFile )->
                 default_value("./config/logger.cfg"),
                 "name of the logger verbosity configuration file" )
+                ( "threads,t",
+                po::value<unsigned int>( &threads )->default_value(1),
+                "number of threads used to run the broker" )
+                ( "batch-budget",
+                po::value<unsigned int>( &batchBudget )->
+                default_value(BATCH_BUDGET),
+                "milliseconds the scheduler may run tasks before yielding" )
+                ( "stats-file",
+                po::value<std::string > ( &statsFile )->default_value(""),
+                "file to write the broker's counters to on shutdown and "
+                "on SIGUSR1" )
+                ( "adaptive-phases",
+                "let modules without work give the rest of their phase to "
+                "the next module" )
                 ( "verbose,v",
                 po::value<unsigned int>( &globalVerbosity )->
                 implicit_value(5)->default_value(5),
@@ -218,16 +318,24 @@ int main(int argc, char* argv[])
             return 0;
         }
 
-        if (vm.count("uuid"))
+        if (gmMode != "invitation" && gmMode != "fast-merge"
+                && gmMode != "swim")
+        {
+            Logger.Error << "Unknown group management mode: " << gmMode
+                    << std::endl;
+            return -1;
+        }
+
+        // Try to resolve the host's dns name
+        hostname = boost::asio::ip::host_name();
+        Logger.Info << "Hostname: " << hostname << std::endl;
+        if (vm.count("setuuid"))
         {
             uuid = static_cast<CUuid> ( uuidString );
             Logger.Info << "Loaded UUID: " << uuid << std::endl;
         }
         else
         {
-            // Try to resolve the host's dns name
-            hostname = boost::asio::ip::host_name();
-            Logger.Info << "Hostname: " << hostname << std::endl;
             uuid = CUuid::from_dns(hostname,port);
             Logger.Info << "Generated UUID: " << uuid << std::endl;
         }
@@ -239,6 +347,22 @@ int main(int argc, char* argv[])
             CGlobalLogger::instance().ListLoggers();
             return 0;
         }
+        // From here on a background thread writes the log.
+        if (!logFile.empty())
+        {
+            logStream.open(logFile.c_str(), std::ios::app);
+            if (!logStream)
+            {
+                Logger.Error << "Unable to open log file: " << logFile
+                        << std::endl;
+                return -1;
+            }
+            CLogWriter::instance().Start(&logStream);
+        }
+        else
+        {
+            CLogWriter::instance().Start(&std::clog);
+        }
 
         std::stringstream ss2;
         std::string uuidstr2;
@@ -251,12 +375,32 @@ int main(int argc, char* argv[])
         CGlobalConfiguration::instance().SetListenAddress(listenIP);
         CGlobalConfiguration::instance().SetClockSkew(
                 boost::posix_time::milliseconds(0));
+        if (failureThreshold > 0)
+        {
+            CFailureDetector::instance().SetDetector(
+                    boost::shared_ptr<IFailureDetector>(new CPhiAccrualDetector(
+                        boost::posix_time::milliseconds(failurePause))),
+                    failureThreshold);
+        }
+        if (!eventLogFile.empty())
+        {
+            CEventLog::instance().Open(eventLogFile, uuidstr2,
+                    eventLogRecords);
+        }
+        // The io_service is declared first so that it outlives every socket
+        // and timer created on it.
+        boost::asio::io_service ios;
         //constructors for initial mapping
         CConnectionManager conManager;
         device::CPhysicalDeviceManager::Pointer 
             phyManager(new broker::device::CPhysicalDeviceManager());
         ConnectionPtr newConnection;
-        boost::asio::io_service ios;
+
+        if (!networkCfgFile.empty())
+        {
+            CNetworkEmulator::instance().Start(ios, networkCfgFile,
+                    boost::posix_time::seconds(1));
+        }
 
         // configure the device factory
         // interHost is the hostname of the machine that runs the simulation
@@ -282,6 +426,8 @@ int main(int argc, char* argv[])
         //dispatch_.RegisterWriteHandler( "any", &uuidHandler_ );
         // Run server in background thread
         CBroker broker(listenIP, port, dispatch, ios, conManager);
+        broker.SetBatchBudget(boost::posix_time::milliseconds(batchBudget));
+        broker.SetAdaptivePhases(vm.count("adaptive-phases") > 0);
         // Load the UUID into string
         std::stringstream ss;
         std::string uuidstr;
@@ -289,8 +435,18 @@ int main(int argc, char* argv[])
         ss >> uuidstr;
         // Instantiate and register the group management module
         gm::GMAgent GM(uuidstr, broker, phyManager);
+        gm::SwimAgent Swim(uuidstr, broker, phyManager);
+        GM.SetFastMerge(gmMode == "fast-merge");
+        GM.SetCheckpointFile(gmCheckpointFile);
         broker.RegisterModule("gm",boost::posix_time::milliseconds(200));
-        dispatch.RegisterReadHandler("gm", "any", &GM);
+        if (gmMode == "swim")
+        {
+            dispatch.RegisterReadHandler("gm", "any", &Swim);
+        }
+        else
+        {
+            dispatch.RegisterReadHandler("gm", "any", &GM);
+        }
         // Instantiate and register the state collection module
         sc::SCAgent SC(uuidstr, broker, phyManager);
         broker.RegisterModule("sc",boost::posix_time::milliseconds(400));
@@ -341,14 +497,37 @@ int main(int argc, char* argv[])
         conManager.PutHostname(uuidstr, "localhost", port);
 
         Logger.Debug << "Starting thread of Modules" << std::endl;
-        broker.Schedule("gm", boost::bind(&gm::GMAgent::Run, &GM), false);
+        if (gmMode == "swim")
+        {
+            broker.Schedule("gm", boost::bind(&gm::SwimAgent::Run, &Swim),
+                    false);
+        }
+        else
+        {
+            broker.Schedule("gm", boost::bind(&gm::GMAgent::Run, &GM), false);
+        }
         broker.Schedule("lb", boost::bind(&lb::LBAgent::Run, &LB), false);
-        broker.Run();
+        std::vector<std::string> modules =
+                boost::assign::list_of<std::string>("gm")("sc")("lb");
+        if (!statsFile.empty())
+        {
+            // Lets a local scraper ask for the counters with SIGUSR1
+            broker.SetMetricsReporter(boost::bind(&WriteStats, statsFile,
+                    boost::ref(broker), modules));
+        }
+        broker.Run(threads);
+        CNetworkEmulator::instance().Stop();
+        CEventLog::instance().Close();
+        if (!statsFile.empty())
+        {
+            WriteStats(statsFile, broker, modules);
+        }
     }
     catch (std::exception& e)
     {
         Logger.Error << "Exception caught in main:" << e.what() << std::endl;
     }
+    CLogWriter::instance().Stop();
 
     return 0;
 }
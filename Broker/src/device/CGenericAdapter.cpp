@@ -100,7 +100,38 @@ void CGenericAdapter::Set(const Identifier device, const SettingKey key,
         const SettingValue value)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    m_registry[device][key] = value;
+    SettingValue & setting = m_registry[device][key];
+    if (setting == value)
+    {
+        return;
+    }
+    setting = value;
+
+    std::pair<WatchMap::iterator, WatchMap::iterator> watchers =
+            m_watchers.equal_range(std::make_pair(device, key));
+    for (WatchMap::iterator it = watchers.first; it != watchers.second; it++)
+    {
+        it->second(device, key, value);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @function CGenericAdapter::Watch(const Identifier, const SettingKey,
+///     ChangeHandler)
+///
+/// @description Calls the handler from Set whenever the setting changes.
+///
+/// @param device the unique identifier of the target device.
+/// @param key the desired setting on the target device.
+/// @param handler the function to call with the new value.
+/// @return true, since every change passes through Set.
+////////////////////////////////////////////////////////////////////////////////
+bool CGenericAdapter::Watch(const Identifier device, const SettingKey key,
+        ChangeHandler handler)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    m_watchers.insert(std::make_pair(std::make_pair(device, key), handler));
+    return true;
 }
 
 }
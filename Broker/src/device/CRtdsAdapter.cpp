@@ -236,16 +236,39 @@ void CRtdsAdapter::Run()
     }
 
 #endif
+    //the watched values that changed, with their new values
+    std::vector<std::pair<Watcher, float> > changes;
     {
         boost::unique_lock<boost::shared_mutex> lockWrite(m_stateTable.m_mutex);
         Logger.Debug << "Client_RTDS - obtained mutex as writer" << std::endl;
 
+        {
+            boost::mutex::scoped_lock lockWatch(m_watchMutex);
+            for (size_t i = 0; i < m_watchers.size(); i++)
+            {
+                float value;
+                memcpy(&value, &m_rxBuffer[4 * m_watchers[i].index],
+                        sizeof (float));
+                if (value != m_stateTable.m_data[m_watchers[i].index])
+                {
+                    changes.push_back(std::make_pair(m_watchers[i], value));
+                }
+            }
+        }
+
         //write to stateTable
         memcpy(m_stateTable.m_data, m_rxBuffer, m_rxBufSize);
 
         Logger.Debug << "Client_RTDS - released writer mutex" << std::endl;
     } //scope is needed for mutex to auto release
 
+    //handlers may read the state table, so they run after it is released
+    for (size_t i = 0; i < changes.size(); i++)
+    {
+        const Watcher & w = changes[i].first;
+        w.handler(w.device, w.key, changes[i].second);
+    }
+
     //Start the timer; on timeout, this function is called again
     m_GlobalTimer.expires_from_now(boost::posix_time::microseconds(TIMESTEP));
     m_GlobalTimer.async_wait(boost::bind(&CRtdsAdapter::Run, this));
@@ -341,6 +364,64 @@ SettingValue CRtdsAdapter::Get(const Identifier device,
     }
 }
 
+////////////////////////////////////////////////////////////////////////////
+/// Watch
+///
+/// @description
+///     Registers a handler which Run calls whenever a state table value
+///     differs from the one received in the previous time step.
+///
+/// @Error_Handling
+///     Throws an exception if the device/key pair does not exist in the table.
+///
+/// @pre
+///     none
+///
+/// @post
+///     The handler is called from the io_service thread, after the state
+///     table has been updated, for each change of the value.
+///
+/// @param
+///     device is the unique identifier of a physical device
+///
+///     key is the reading of the device to watch
+///
+///     handler is the function to call with the new value
+///
+/// @return
+///     true, since every reading passes through Run
+///
+/// @limitations
+///     A change which reverts within one time step is not seen.
+///
+////////////////////////////////////////////////////////////////////////////
+bool CRtdsAdapter::Watch(const Identifier device, const SettingKey key,
+        ChangeHandler handler)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+
+    Watcher w;
+    try
+    {
+        w.index = m_stateTable.m_structure.FindIndex(
+                CDeviceKeyCoupled(device, key));
+    }
+    catch (std::out_of_range & e)
+    {
+        std::stringstream ss;
+        ss << "RTDS attempted to watch device/key pair " << device << "/"
+                << key << ", but this pair does not exist.";
+        throw std::runtime_error(ss.str());
+    }
+    w.device = device;
+    w.key = key;
+    w.handler = handler;
+
+    boost::mutex::scoped_lock lock(m_watchMutex);
+    m_watchers.push_back(w);
+    return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////
 /// Quit
 ///
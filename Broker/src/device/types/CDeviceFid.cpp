@@ -75,6 +75,20 @@ bool CDeviceFid::IsActive() const
     return Get("state") == 1.0;  // if not exactly 1, then something is wrong.
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// CDeviceFid::WatchState(IPhysicalAdapter::ChangeHandler)
+///
+/// @description Asks to be told when the state of this FID changes.
+///
+/// @param handler The function to call with the new state.
+/// @return False if the state cannot be watched and must be polled.
+////////////////////////////////////////////////////////////////////////////////
+bool CDeviceFid::WatchState(IPhysicalAdapter::ChangeHandler handler)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    return Watch("state", handler);
+}
+
 }
 }
 }
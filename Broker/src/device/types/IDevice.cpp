@@ -90,6 +90,23 @@ void IDevice::Set(const SettingKey key, const SettingValue value)
     m_adapter->Set(m_identifier, key, value);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// IDevice::Watch(const SettingKey, IPhysicalAdapter::ChangeHandler)
+/// @description Asks the adapter to report changes to a device setting
+/// @pre None
+/// @post If the adapter reports changes, the handler is called from the
+///     adapter's thread each time the setting changes
+/// @param key The key of the device setting to watch
+/// @param handler The function to call with the new value
+/// @return False if the adapter cannot report changes and must be polled
+////////////////////////////////////////////////////////////////////////////////
+bool IDevice::Watch(const SettingKey key,
+        IPhysicalAdapter::ChangeHandler handler)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    return m_adapter->Watch(m_identifier, key, handler);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// IDevice::Lock()
 /// @description Obtains a lock over the device mutex
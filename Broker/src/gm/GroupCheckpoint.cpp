@@ -0,0 +1,145 @@
+//////////////////////////////////////////////////////////
+/// @file         GroupCheckpoint.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  The group state group management keeps across restarts
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+
+#include "GroupCheckpoint.hpp"
+
+#include <cstdio>
+#include <exception>
+#include <fstream>
+
+#include <boost/foreach.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#define foreach BOOST_FOREACH
+
+using boost::property_tree::ptree;
+
+namespace freedm {
+
+namespace broker {
+
+namespace gm {
+
+///////////////////////////////////////////////////////////////////////////////
+/// GroupCheckpoint::operator==
+/// @description Compares the group, leader and members of two checkpoints.
+/// @param other The checkpoint to compare with.
+/// @return True if saving either would write the same file.
+///////////////////////////////////////////////////////////////////////////////
+bool GroupCheckpoint::operator==(const GroupCheckpoint & other) const
+{
+    return group == other.group && leader == other.leader &&
+        members == other.members;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// GroupCheckpoint::Load
+/// @description Reads a checkpoint written by Save.
+/// @pre None
+/// @post On success this checkpoint holds the file's contents. On failure it
+///     is unchanged.
+/// @param filename The checkpoint file.
+/// @return False if the file is missing or is not a checkpoint.
+///////////////////////////////////////////////////////////////////////////////
+bool GroupCheckpoint::Load(const std::string & filename)
+{
+    GroupCheckpoint loaded;
+    try
+    {
+        ptree pt;
+        boost::property_tree::read_xml(filename, pt);
+        loaded.group = pt.get<unsigned int>("checkpoint.group");
+        loaded.leader = pt.get<std::string>("checkpoint.leader");
+        if(pt.get_child_optional("checkpoint.members"))
+        {
+            foreach(const ptree::value_type & v,
+                pt.get_child("checkpoint.members"))
+            {
+                loaded.members.push_back(Member(
+                    v.second.get<std::string>("uuid"),
+                    v.second.get<std::string>("host"),
+                    v.second.get<std::string>("port")));
+            }
+        }
+    }
+    catch(std::exception &)
+    {
+        return false;
+    }
+    *this = loaded;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// GroupCheckpoint::Save
+/// @description Writes the checkpoint to a temporary file which then
+///     replaces the old one, so the file always holds a whole checkpoint.
+/// @pre None
+/// @post On success the file holds this checkpoint.
+/// @param filename The checkpoint file.
+/// @return False if the file could not be written.
+///////////////////////////////////////////////////////////////////////////////
+bool GroupCheckpoint::Save(const std::string & filename) const
+{
+    ptree pt;
+    pt.put("checkpoint.group", group);
+    pt.put("checkpoint.leader", leader);
+    foreach(const Member & member, members)
+    {
+        ptree sub_pt;
+        sub_pt.put("uuid", member.uuid);
+        sub_pt.put("host", member.host);
+        sub_pt.put("port", member.port);
+        pt.add_child("checkpoint.members.member", sub_pt);
+    }
+    std::string partial = filename + ".tmp";
+    {
+        std::ofstream out(partial.c_str());
+        if(!out)
+        {
+            return false;
+        }
+        boost::property_tree::write_xml(out, pt);
+        out.close();
+        if(!out)
+        {
+            return false;
+        }
+    }
+    return std::rename(partial.c_str(), filename.c_str()) == 0;
+}
+
+} // namespace gm
+
+} // namespace broker
+
+} // namespace freedm
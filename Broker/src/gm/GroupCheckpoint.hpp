@@ -0,0 +1,103 @@
+//////////////////////////////////////////////////////////
+/// @file         GroupCheckpoint.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  The group state group management keeps across restarts
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+
+#ifndef GROUPCHECKPOINT_HPP_
+#define GROUPCHECKPOINT_HPP_
+
+#include <string>
+#include <vector>
+
+namespace freedm {
+
+namespace broker {
+
+namespace gm {
+
+/// The group a node was last part of, as saved for its next start.
+struct GroupCheckpoint
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Records the group, its leader and the other members
+    ///     with their endpoints, so a restarted node can ask its old leader
+    ///     to take it back without knowing any more than its add-host list.
+    ///     The file is replaced whole, so a crash while saving leaves the
+    ///     previous checkpoint.
+    ///
+    /// @limitations Not thread safe; the group management module owns it.
+    ///////////////////////////////////////////////////////////////////////////
+
+    /// A member of the group and where it listens.
+    struct Member
+    {
+        /// Creates a member.
+        Member(std::string u = "", std::string h = "", std::string p = "")
+            : uuid(u), host(h), port(p) { }
+        /// True if the two are the same member at the same endpoint.
+        bool operator==(const Member & other) const
+        {
+            return uuid == other.uuid && host == other.host &&
+                port == other.port;
+        }
+        /// The member's uuid
+        std::string uuid;
+        /// The host the member listens on
+        std::string host;
+        /// The port the member listens on
+        std::string port;
+    };
+
+    /// Creates a checkpoint of no group.
+    GroupCheckpoint() : group(0) { }
+
+    /// True if the two checkpoints record the same group.
+    bool operator==(const GroupCheckpoint & other) const;
+
+    /// Reads the checkpoint from a file, returning false if it cannot.
+    bool Load(const std::string & filename);
+
+    /// Replaces the file with this checkpoint, returning false on failure.
+    bool Save(const std::string & filename) const;
+
+    /// The group's identifier
+    unsigned int group;
+    /// The uuid of the group's leader
+    std::string leader;
+    /// The other members of the group, the leader included
+    std::vector<Member> members;
+};
+
+} // namespace gm
+
+} // namespace broker
+
+} // namespace freedm
+
+#endif
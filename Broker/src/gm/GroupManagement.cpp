@@ -74,7 +74,11 @@
 
 #include "CConnection.hpp"
 #include "CBroker.hpp"
+#include "CClock.hpp"
+#include "CEventLog.hpp"
+#include "CFailureDetector.hpp"
 #include "CLogger.hpp"
+#include "CMetricsRegistry.hpp"
 
 #include <boost/property_tree/ptree.hpp>
 using boost::property_tree::ptree;
@@ -91,6 +95,83 @@ namespace {
 /// This file's logger.
 CLocalLogger Logger(__FILE__);
 
+/// Times this node has moved to a different group.
+CMetricsRegistry::Counter & GroupChanges =
+        CMetricsRegistry::instance().GetCounter("gm.group.changes");
+
+/// Silent peers kept because the failure detector still trusted them.
+CMetricsRegistry::Counter & DetectorTrusted =
+        CMetricsRegistry::instance().GetCounter("gm.detector.trusted");
+
+/// Groups this node has formed as leader.
+CMetricsRegistry::Counter & GroupsFormed =
+        CMetricsRegistry::instance().GetCounter("gm.groups.formed");
+
+/// Times this node's group broke under it.
+CMetricsRegistry::Counter & GroupsBroken =
+        CMetricsRegistry::instance().GetCounter("gm.groups.broken");
+
+/// Groups this node has joined as a member.
+CMetricsRegistry::Counter & GroupsJoined =
+        CMetricsRegistry::instance().GetCounter("gm.groups.joined");
+
+/// Checks which found other coordinators to merge with.
+CMetricsRegistry::Counter & Elections =
+        CMetricsRegistry::instance().GetCounter("gm.elections");
+
+/// Total size of the group over all membership checks.
+CMetricsRegistry::Counter & Membership =
+        CMetricsRegistry::instance().GetCounter("gm.membership.total");
+
+/// Number of membership checks.
+CMetricsRegistry::Counter & MembershipChecks =
+        CMetricsRegistry::instance().GetCounter("gm.membership.checks");
+
+/// Restarts which asked the saved group's leader to take this node back.
+CMetricsRegistry::Counter & Rejoins =
+        CMetricsRegistry::instance().GetCounter("gm.rejoins");
+
+/// Rejoins the saved group's leader refused.
+CMetricsRegistry::Counter & RejoinsRefused =
+        CMetricsRegistry::instance().GetCounter("gm.rejoins.refused");
+
+/// Microseconds spent in each state, in the order GMAgent numbers them.
+CMetricsRegistry::Counter * StateTime[] = {
+        &CMetricsRegistry::instance().GetCounter("gm.state.normal.us"),
+        &CMetricsRegistry::instance().GetCounter("gm.state.down.us"),
+        &CMetricsRegistry::instance().GetCounter("gm.state.recovery.us"),
+        &CMetricsRegistry::instance().GetCounter("gm.state.reorganization.us"),
+        &CMetricsRegistry::instance().GetCounter("gm.state.election.us") };
+
+/// Microseconds from a merge this node led to the new group's announcement.
+CMetricsRegistry::Histogram & ElectionLed =
+        CMetricsRegistry::instance().GetHistogram("gm.election.led.us");
+
+/// Microseconds from accepting an invitation to the leader's announcement.
+CMetricsRegistry::Histogram & ElectionJoined =
+        CMetricsRegistry::instance().GetHistogram("gm.election.joined.us");
+
+/// The microseconds between two times, or zero if they are out of order.
+CHistogram::Value Microseconds(const boost::posix_time::ptime & from,
+        const boost::posix_time::ptime & to)
+{
+    boost::posix_time::time_duration elapsed = to - from;
+    return elapsed.is_negative() ? 0 : elapsed.total_microseconds();
+}
+
+/// True if two peer sets hold the same peers.
+bool SameMembers(const GMAgent::PeerSet & a, const GMAgent::PeerSet & b)
+{
+    if(a.size() != b.size())
+        return false;
+    for(GMAgent::PeerSet::const_iterator it = a.begin(); it != a.end(); it++)
+    {
+        if(b.count(it->first) == 0)
+            return false;
+    }
+    return true;
+}
+
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -114,21 +195,23 @@ GMAgent::GMAgent(std::string p_uuid, CBroker &broker,
     SKEW_TIMEOUT(boost::posix_time::seconds(2)),
     RESPONSE_TIMEOUT(boost::posix_time::milliseconds(75)),
     m_broker(broker),
-    m_phyDevManager(devmanager)
+    m_phyDevManager(devmanager),
+    m_calls(broker, "gm", boost::bind(&GMAgent::SendToPeer, this, _1, _2))
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
     AddPeer(GetUUID());
-    m_groupsformed = 0;
-    m_groupsbroken = 0;
-    m_groupselection = 0;
-    m_groupsjoined = 0;
-    m_membership = 0;
-    m_membershipchecks = 0;
+    m_status = GMAgent::DOWN;
+    m_stateEntered = CClock::instance().GetMonotonicTime();
     m_timer = broker.AllocateTimer("gm");
     m_fidtimer = broker.AllocateTimer("gm");
     m_skewtimer = broker.AllocateTimer("gm");
     m_fidsclosed = true;   
+    m_fastmerge = false;
+    m_check = 0;
+    m_ayt = 0;
     m_GrpCounter = rand();
+    m_pushedGroup = 0;
+    m_peerListVersion = 0;
  
     PrehandleFunctor f = boost::bind(&GMAgent::Prehandler, this, _1, _2, _3);    
     RegisterSubhandle("any.PeerList",
@@ -151,6 +234,10 @@ GMAgent::GMAgent(std::string p_uuid, CBroker &broker,
         PrehandlerHelper(f,boost::bind(&GMAgent::HandleClockSkew, this, _1, _2)));
     RegisterSubhandle("gm.PeerListQuery",
         PrehandlerHelper(f,boost::bind(&GMAgent::HandlePeerListQuery, this, _1, _2)));
+    RegisterSubhandle("gm.Rejoin",
+        PrehandlerHelper(f,boost::bind(&GMAgent::HandleRejoin, this, _1, _2)));
+    RegisterSubhandle("gm.Response.Rejoin",
+        PrehandlerHelper(f,boost::bind(&GMAgent::HandleResponseRejoin, this, _1, _2)));
     RegisterSubhandle("any",
         PrehandlerHelper(f,boost::bind(&GMAgent::HandleAny, this, _1, _2)));
     #ifdef RANDOM_PREMERGE
@@ -169,8 +256,6 @@ GMAgent::~GMAgent()
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
     m_UpNodes.clear();
     m_Coordinators.clear();
-    m_AYCResponse.clear();
-    m_AYTResponse.clear();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -289,6 +374,25 @@ CMessage GMAgent::AreYouThere()
     return m_;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::Rejoin
+/// @description Creates a request for the leader of the group this node was
+///     in before a restart to take it back.
+/// @pre This node has restored the group it was in.
+/// @post No Change.
+/// @return A CMessage with the contents of a Rejoin message
+///////////////////////////////////////////////////////////////////////////////
+CMessage GMAgent::Rejoin()
+{
+    CMessage m_;
+    m_.SetHandler("gm.Rejoin");
+    m_.m_submessages.put("gm.source", GetUUID());
+    m_.m_submessages.put("gm.groupid",m_GroupID);
+    m_.m_submessages.put("gm.groupleader",m_GroupLeader);
+    m_.SetExpireTimeFromNow(GLOBAL_TIMEOUT);
+    return m_;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// GMAgent::ClockRequest
 /// @description Generates a request for a node to read and report their clock
@@ -306,7 +410,7 @@ CMessage GMAgent::ClockRequest()
 
 ///////////////////////////////////////////////////////////////////////////////
 /// GMAgent::ClockSkew
-/// @description Generates a message with the group's clock skew
+/// @description Generates a message with the skew a member should use
 /// @pre This node is in a group.
 /// @post No Change.
 /// @return A CMessage with the contents of an AreYouThere message
@@ -335,6 +439,8 @@ CMessage GMAgent::PeerList(std::string requester)
     ptree me_pt;
 	m_.m_submessages.put("any.source", GetUUID());
     m_.m_submessages.put("any.coordinator",Coordinator());
+    m_.m_submessages.put("any.groupid",m_GroupID);
+    m_.m_submessages.put("any.version",m_peerListVersion);
 	m_.SetHandler(requester+".PeerList");
 	foreach( PeerNodePtr peer, m_UpNodes | boost::adaptors::map_values)
     {
@@ -352,6 +458,42 @@ CMessage GMAgent::PeerList(std::string requester)
     return m_;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::PeerListDelta
+/// @description Packs the changes to the group list since the previous
+///     version in a CMessage. Members which hold the previous version apply
+///     it with ProcessPeerList; any other member asks for the full list.
+/// @pre This node is a leader and m_peerListVersion is the new version.
+/// @post No Change.
+/// @param added The members which joined since the previous version.
+/// @param removed The members which left since the previous version.
+/// @return A CMessage with the changes to the group membership
+///////////////////////////////////////////////////////////////////////////////
+CMessage GMAgent::PeerListDelta(const PeerSet & added, const PeerSet & removed)
+{
+    CMessage m_;
+    m_.m_submessages.put("any.source", GetUUID());
+    m_.m_submessages.put("any.coordinator",Coordinator());
+    m_.m_submessages.put("any.groupid",m_GroupID);
+    m_.m_submessages.put("any.version",m_peerListVersion);
+    m_.m_submessages.put("any.base",m_peerListVersion-1);
+    m_.SetHandler("any.PeerList");
+    foreach( PeerNodePtr peer, added | boost::adaptors::map_values)
+    {
+        ptree sub_pt;
+        sub_pt.add("uuid",peer->GetUUID());
+        sub_pt.add("host",peer->GetHostname());
+        sub_pt.add("port",peer->GetPort());
+        m_.m_submessages.add_child("any.added.peer",sub_pt);
+    }
+    foreach( PeerNodePtr peer, removed | boost::adaptors::map_values)
+    {
+        m_.m_submessages.add("any.removed.peer",peer->GetUUID());
+    }
+    m_.SetNeverExpires();
+    return m_;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// GMAgent::PeerListQuery
 /// @description Generates a CMessage that can be used to query the peerlist
@@ -391,12 +533,20 @@ void GMAgent::SendToPeer(PeerNodePtr peer, CMessage msg)
 
 ///////////////////////////////////////////////////////////////////////////////
 /// GMAgent::SystemState
-/// @description Puts the system state to the logger.
+/// @description Puts the system state to the logger, if its Status level is
+///     enabled, and brings the time in the current state up to date.
 /// @pre None
 /// @post None
 ///////////////////////////////////////////////////////////////////////////////
 void GMAgent::SystemState()
 {
+    CEventLog::instance().Write(CEventLog::GM, CEventLog::GM_STATE, m_GroupID,
+            CEventLog::Hash(Coordinator()), m_UpNodes.size(),
+            m_phyDevManager->CountActiveFids());
+    UpdateStateTime();
+    // The report walks every known peer, so skip it when nobody reads it
+    if(!Logger.Status.IsEnabled())
+        return;
     //SYSTEM STATE OUTPUT
     std::stringstream nodestatus;
     nodestatus<<"- SYSTEM STATE"<<std::endl
@@ -439,7 +589,28 @@ void GMAgent::SystemState()
 void GMAgent::PushPeerList()
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    CMessage m_ = PeerList();
+    // Within a group only the changes are sent; a new group gets a full list
+    PeerSet added, removed;
+    bool delta = (m_peerListVersion > 0 && m_pushedGroup == m_GroupID);
+    if(delta)
+    {
+        foreach( PeerNodePtr peer, m_UpNodes | boost::adaptors::map_values)
+        {
+            if(CountInPeerSet(m_pushedPeers,peer) == 0)
+                InsertInPeerSet(added,peer);
+        }
+        foreach( PeerNodePtr peer, m_pushedPeers | boost::adaptors::map_values)
+        {
+            if(CountInPeerSet(m_UpNodes,peer) == 0)
+                InsertInPeerSet(removed,peer);
+        }
+    }
+    m_peerListVersion++;
+    m_pushedPeers = m_UpNodes;
+    m_pushedGroup = m_GroupID;
+    CMessage m_ = delta ? PeerListDelta(added,removed) : PeerList();
+    Logger.Info<<"SEND: Peer list version "<<m_peerListVersion<<(delta ?
+        " (changes only)" : " (full)")<<std::endl;
     foreach( PeerNodePtr peer, m_UpNodes | boost::adaptors::map_values)
     {
         Logger.Debug<<"Send group list to all members of this group containing "
@@ -472,9 +643,14 @@ void GMAgent::Recovery()
         if( peer->GetUUID() == GetUUID())
             continue;
     }
+    GroupChanges.fetch_add(1, boost::memory_order_relaxed);
+    CEventLog::instance().Write(CEventLog::GM, CEventLog::GM_GROUP_CHANGED,
+            m_GroupID, CEventLog::Hash(m_GroupLeader));
     Logger.Notice << "Changed group: "<< m_GroupID<<" ("<< m_GroupLeader <<")"<<std::endl;
     // Empties the UpList
     m_UpNodes.clear();
+    // Whether the old leader still counts us in is moot now.
+    m_calls.Cancel(m_ayt);
     SetStatus(GMAgent::REORGANIZATION);
     Logger.Notice << "+ State Change REORGANIZATION : "<<__LINE__<<std::endl;
     // Perform work assignments, etc here.
@@ -496,29 +672,134 @@ void GMAgent::Recovery()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// GMAgent::FIDCheck
-/// @description: Checks the open and close status of all FIDs attached to this
-///     Node.
-/// @pre None
-/// @post: If all FIDs are open this node stops responding to messages.
+/// GMAgent::Resume
+/// @description Returns to the group saved before a restart rather than
+///     waiting for the checks to find it. A member asks its old leader to
+///     take it back, which costs one round trip if the group is intact, and
+///     falls back to Recovery if the leader refuses or does not answer. A
+///     leader starts solo and invites its old members at once.
+/// @pre The checkpoint was saved by this node.
+/// @post This node waits for its leader's peer list, or leads an election.
+/// @param saved The group this node was in.
 ///////////////////////////////////////////////////////////////////////////////
-void GMAgent::FIDCheck( const boost::system::error_code& err)
+void GMAgent::Resume(const GroupCheckpoint & saved)
 {
-    if(!err)
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    PeerSet members;
+    foreach(const GroupCheckpoint::Member & member, saved.members)
     {
-        int attachedFIDs = m_phyDevManager->GetDevicesOfType<device::CDeviceFid>().size();
-        unsigned int FIDState = m_phyDevManager->CountActiveFids();
-        if(m_fidsclosed == true && attachedFIDs  > 0 && FIDState == 0)
+        if(member.uuid == GetUUID())
+            continue;
+        PeerNodePtr p = GetPeer(member.uuid);
+        if(!p)
         {
-            Logger.Status<<"All FIDs offline. Entering Recovery State"<<std::endl;
-            Recovery();
-            m_fidsclosed = false;
+            GetConnectionManager().PutHostname(member.uuid, member.host, member.port);
+            p = AddPeer(member.uuid);
         }
-        else if(m_fidsclosed == false && attachedFIDs > 0 && FIDState > 0)
+        InsertInPeerSet(members,p);
+    }
+    if(saved.leader == GetUUID())
+    {
+        Recovery();
+        if(members.size() > 0)
         {
-            Logger.Status<<"All FIDs Online. Checking for Peers"<<std::endl;
-            m_fidsclosed = true;
+            Logger.Notice << "Inviting the " << members.size()
+                << " members of saved group " << saved.group << std::endl;
+            m_UpNodes = members;
+            Merge(boost::system::error_code());
+            // Their connections to this node resync before they can accept,
+            // which outlasts the usual wait; the last accept ends it early.
+            m_Invited = members;
+            Logger.Info << "TIMER: Setting TimeoutTimer (Reorganize) : " << __LINE__ << std::endl;
+            m_timerMutex.lock();
+            m_broker.Schedule(m_timer, TIMEOUT_TIMEOUT,
+                boost::bind(&GMAgent::Reorganize, this, boost::asio::placeholders::error));
+            m_timerMutex.unlock();
         }
+        return;
+    }
+    PeerNodePtr leader = GetPeer(saved.leader);
+    if(!leader)
+    {
+        Logger.Warn << "Saved leader " << saved.leader << " is unknown" << std::endl;
+        Recovery();
+        return;
+    }
+    m_electionStarted = CClock::instance().GetMonotonicTime();
+    SetStatus(GMAgent::REORGANIZATION);
+    Logger.Notice << "+ State Change REORGANIZATION : "<<__LINE__<<std::endl;
+    m_GroupID = saved.group;
+    m_GroupLeader = saved.leader;
+    Rejoins.fetch_add(1, boost::memory_order_relaxed);
+    GroupChanges.fetch_add(1, boost::memory_order_relaxed);
+    CEventLog::instance().Write(CEventLog::GM, CEventLog::GM_GROUP_CHANGED,
+            m_GroupID, CEventLog::Hash(m_GroupLeader));
+    Logger.Notice << "Changed group: " << m_GroupID << " (" << m_GroupLeader << ") " << std::endl;
+    Logger.Info << "SEND: Rejoin to " << m_GroupLeader << std::endl;
+    SendToPeer(leader,Rejoin());
+    // As after accepting an invitation, the leader's peer list replaces this
+    Logger.Info << "TIMER: Setting TimeoutTimer (Recovery) : " << __LINE__ << std::endl;
+    m_timerMutex.lock();
+    m_broker.Schedule(m_timer, TIMEOUT_TIMEOUT,
+        boost::bind(&GMAgent::Recovery, this, boost::asio::placeholders::error));
+    m_timerMutex.unlock();
+    m_timerMutex.lock();
+    m_broker.Schedule(m_skewtimer, SKEW_TIMEOUT,
+        boost::bind(&GMAgent::ComputeSkew, this, boost::asio::placeholders::error));
+    m_timerMutex.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::Checkpoint
+/// @description Saves the group, its leader and its members to the
+///     checkpoint file, so a restart can return to them with Resume. Check
+///     and Timeout call this every round; the file is only written when the
+///     group has changed since the last save.
+/// @pre None
+/// @post The checkpoint file holds the current group if this node is in the
+///     NORMAL state and a file was set.
+///////////////////////////////////////////////////////////////////////////////
+void GMAgent::Checkpoint()
+{
+    if(m_checkpointFile.empty() || GetStatus() != GMAgent::NORMAL)
+        return;
+    GroupCheckpoint current;
+    current.group = m_GroupID;
+    current.leader = Coordinator();
+    foreach(PeerNodePtr peer, m_UpNodes | boost::adaptors::map_values)
+    {
+        if(peer->GetUUID() == GetUUID())
+            continue;
+        current.members.push_back(GroupCheckpoint::Member(peer->GetUUID(),
+            peer->GetHostname(), peer->GetPort()));
+    }
+    if(current == m_checkpoint)
+        return;
+    if(current.Save(m_checkpointFile))
+    {
+        Logger.Info << "Saved group " << m_GroupID << " to "
+            << m_checkpointFile << std::endl;
+        m_checkpoint = current;
+    }
+    else
+    {
+        Logger.Warn << "Unable to write checkpoint file: " << m_checkpointFile
+            << std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::FIDCheck
+/// @description: Polls the FIDs attached to this node, for devices which
+///     cannot report their changes.
+/// @pre None
+/// @post: The FID state is current and the next poll is scheduled.
+///////////////////////////////////////////////////////////////////////////////
+void GMAgent::FIDCheck( const boost::system::error_code& err)
+{
+    if(!err)
+    {
+        UpdateFIDState();
         m_timerMutex.lock();
         m_broker.Schedule(m_fidtimer, FID_TIMEOUT, 
             boost::bind(&GMAgent::FIDCheck, this, boost::asio::placeholders::error));
@@ -526,13 +807,63 @@ void GMAgent::FIDCheck( const boost::system::error_code& err)
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::HandleFIDChange
+/// @description: Called by a device adapter, on its own thread, when an FID
+///     attached to this node opens or closes.
+/// @pre The FID was watched in Run.
+/// @post The FID state will be updated within the group management phase.
+///////////////////////////////////////////////////////////////////////////////
+void GMAgent::HandleFIDChange(const device::Identifier,
+        const device::SettingKey, const device::SettingValue)
+{
+    m_broker.Schedule("gm", boost::bind(&GMAgent::UpdateFIDState, this));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::UpdateFIDState
+/// @description: Checks the open and close status of all FIDs attached to this
+///     Node.
+/// @pre None
+/// @post: If all FIDs are open this node stops responding to messages.
+///////////////////////////////////////////////////////////////////////////////
+void GMAgent::UpdateFIDState()
+{
+    if(m_fids.empty())
+    {
+        return;
+    }
+    unsigned int FIDState = 0;
+    foreach(device::CDeviceFid::Pointer fid, m_fids)
+    {
+        if(fid->IsActive())
+        {
+            FIDState++;
+        }
+    }
+    if(m_fidsclosed == true && FIDState == 0)
+    {
+        Logger.Status<<"All FIDs offline. Entering Recovery State"<<std::endl;
+        Recovery();
+        m_fidsclosed = false;
+    }
+    else if(m_fidsclosed == false && FIDState > 0)
+    {
+        Logger.Status<<"All FIDs Online. Checking for Peers"<<std::endl;
+        m_fidsclosed = true;
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// GMAgent::ComputeSkew
-/// @description Performs the Berkeley clock synchronization algorithm at a
-///     a specified interval.
+/// @description Aligns the group's clocks with the leader's at a specified
+///     interval. Each clock reply gives an NTP style measurement of how far
+///     the member's clock is from this one, and the measurement with the
+///     least network delay in the recent window is used to tell the member
+///     the skew that puts its clock on the leader's.
 /// @pre The node calling this is the leader
-/// @post The node solicits clock measurements from its group members and then
-///     computes a clock skew for each of them which it reports back.
+/// @post The members are sent their new skews and a new round of clock
+///     requests is sent.
 ///////////////////////////////////////////////////////////////////////////////
 void GMAgent::ComputeSkew( const boost::system::error_code& err)
 {
@@ -542,48 +873,27 @@ void GMAgent::ComputeSkew( const boost::system::error_code& err)
     if(!err)
     {
         CMessage m;
-        ClockRepliesMap::iterator it;
-        boost::posix_time::ptime true_clock = m_clocks[GetUUID()];
-        boost::posix_time::time_duration tmp, sum;
-        int good_clocks = 1;
-        Logger.Debug<<"Computing Skew from "<<m_clocks.size()<<" responses"<<std::endl;
-        /// First find the sum of the skew from me.
-        for(it = m_clocks.begin(); it != m_clocks.end(); it++)
+        ClockFilterMap::iterator it;
+        boost::posix_time::time_duration skew =
+            CGlobalConfiguration::instance().GetClockSkew();
+        Logger.Debug<<"Computing Skew for "<<m_clockFilters.size()<<" peers"<<std::endl;
+        for(it = m_clockFilters.begin(); it != m_clockFilters.end(); it++)
         {
-            if((*it).first == GetUUID())
+            CClockFilter::Sample best;
+            if(m_UpNodes.find(it->first) == m_UpNodes.end()
+                || !it->second.GetBest(best))
                 continue;
-            tmp = true_clock - (*it).second;
-            if(-MAX_SKEW < tmp.total_milliseconds() && tmp.total_milliseconds() < MAX_SKEW)
-            {
-                sum += tmp;
-                good_clocks += 1;
-            }
-        }
-        // Find the average skew off of true;
-        sum /= good_clocks;
-        Logger.Debug<<"Computed an average skew off of me of: "<<sum<<std::endl;
-        for(it = m_clocks.begin(); it != m_clocks.end(); it++)
-        {
-            if((*it).first == GetUUID())
-                continue; // My skew is always off by sum.
-            tmp = (true_clock - (*it).second) + sum;
-            // tmp is now the skew to report, author messages to report that skew.
+            // The offset is between the unskewed clocks, so the member's
+            // skew must make up that difference and follow mine
+            boost::posix_time::time_duration tmp = skew - best.offset;
             m = ClockSkew(tmp);
-            if(m_UpNodes.find(it->first) != m_UpNodes.end())
-            {
-                Logger.Debug<<"Telling "<<(*it).first<<" skew is "<<tmp<<std::endl;
-                SendToPeer(GetPeer((*it).first),m);
-            }
+            Logger.Debug<<"Telling "<<it->first<<" skew is "<<tmp<<" (+/- "
+                <<best.delay/2<<")"<<std::endl;
+            SendToPeer(GetPeer(it->first),m);
         }
-        // Set my skew
-        CGlobalConfiguration::instance().SetClockSkew(sum);
         m = ClockRequest();
         /// Initiate a new round of clocks
-        tmp = CGlobalConfiguration::instance().GetClockSkew();
         Logger.Debug<<"Starting New Skew Computation"<<std::endl;
-        m_clocks.clear();
-        /// Report my clock with our computed skew
-        m_clocks[GetUUID()] = boost::posix_time::microsec_clock::universal_time()+tmp;
         /// Send to all up nodes
         foreach( PeerNodePtr peer, CGlobalPeerList::instance().PeerList() | boost::adaptors::map_values)
         {
@@ -613,7 +923,7 @@ void GMAgent::Recovery( const boost::system::error_code& err )
     Logger.Info << "RECOVERY CALL" << std::endl;
     if(!err)
     {
-        m_groupsbroken++;
+        GroupsBroken.fetch_add(1, boost::memory_order_relaxed);
         Recovery();
     }
     else if(boost::asio::error::operation_aborted == err )
@@ -652,29 +962,27 @@ void GMAgent::Check( const boost::system::error_code& err )
     if( !err )
     {
         SystemState();
+        Checkpoint();
         // Only run if this is the group leader and in normal state
         if((GMAgent::NORMAL == GetStatus()) && (IsCoordinator()))
         {
             // Reset and find all group leaders
             m_Coordinators.clear();
-            m_AYCResponse.clear();
-            CMessage m_ = AreYouCoordinator();
-            Logger.Info <<"SEND: Sending out AYC"<<std::endl;
+            m_CoordinatorMembers.clear();
+            m_calls.Cancel(m_check);
+            PeerSet peers;
             foreach( PeerNodePtr peer, CGlobalPeerList::instance().PeerList() | boost::adaptors::map_values)
             {
                 if( peer->GetUUID() == GetUUID())
                     continue;
-                SendToPeer(peer,m_);
-                InsertInPeerSet(m_AYCResponse,peer);
+                InsertInPeerSet(peers,peer);
             }
-            // The AlivePeers set is no longer good, we should clear it and make them
-            // Send us new messages
-            // Wait for responses
-            Logger.Info << "TIMER: Setting GlobalTimer (Premerge): " << __LINE__ << std::endl;
-            m_timerMutex.lock();
-            m_broker.Schedule(m_timer, RESPONSE_TIMEOUT,
-                boost::bind(&GMAgent::Premerge, this, boost::asio::placeholders::error));
-            m_timerMutex.unlock();
+            // Premerge runs when everyone has answered, or at the timeout
+            // with those who have not.
+            Logger.Info <<"SEND: Sending out AYC"<<std::endl;
+            m_checkSent = CClock::instance().GetMonotonicTime();
+            m_check = m_calls.Call(peers, AreYouCoordinator(), RESPONSE_TIMEOUT,
+                boost::bind(&GMAgent::Premerge, this, _1));
         } // End if
     }
     else if(boost::asio::error::operation_aborted == err )
@@ -695,89 +1003,127 @@ void GMAgent::Check( const boost::system::error_code& err )
 ///             nodes. This node is a Coordinator.
 /// @post A timer has been set based on this node's UUID to break up ties
 ///                before merging.
-/// @param err An error associated with the clling timer.
+/// @param result The answers to the check and the peers which did not answer.
 /// @citation GroupManagement (Merge)
 ///////////////////////////////////////////////////////////////////////////////
-void GMAgent::Premerge( const boost::system::error_code &err )
+void GMAgent::Premerge( const CCallTable::Result & result )
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
     if(!IsCoordinator())
         return;
-    if( !err || (boost::asio::error::operation_aborted == err ))
-    { 
-        // Timer expired
-        // Everyone who is alive should have responded to are you Coordinator.
-        // Remove everyone who didn't respond (Nodes that are still in AYCResponse)
-        // From the upnodes list.
-        bool list_change = false;
-        foreach( PeerNodePtr peer, m_AYCResponse | boost::adaptors::map_values)
+    typedef std::map<std::string, CMessage>::value_type Reply;
+    foreach( Reply reply, result.replies )
+    {
+        ptree pt = reply.second.GetSubMessages();
+        PeerNodePtr peer = GetPeer(reply.first);
+        if(!peer || pt.get<std::string>("gm.payload") != "yes")
+            continue;
+        InsertInPeerSet(m_Coordinators,peer);
+        if(pt.get_child_optional("gm.members"))
         {
-            if(CountInPeerSet(m_UpNodes,peer) && CountInPeerSet(m_AlivePeers,peer) == 0)
+            PeerSet members = ReadPeers(pt.get_child("gm.members"),GetConnectionManager());
+            foreach( PeerNodePtr member, members | boost::adaptors::map_values)
             {
-                list_change = true;
-                EraseInPeerSet(m_UpNodes,peer);
-                Logger.Info << "No response from peer: "<<peer->GetUUID()<<std::endl;
+                if(member->GetUUID() != GetUUID())
+                    InsertInPeerSet(m_CoordinatorMembers,member);
             }
         }
-        m_AlivePeers.clear();
-        if(list_change)
+    }
+    // Everyone who is alive should have responded to are you Coordinator.
+    // Remove everyone who didn't respond from the upnodes list, unless
+    // the failure detector still trusts them.
+    bool list_change = false;
+    foreach( const std::string & uuid, result.missing )
+    {
+        PeerNodePtr peer = GetPeer(uuid);
+        if(peer && CountInPeerSet(m_UpNodes,peer) && !IsAlive(peer))
         {
-            PushPeerList();
-            m_membership += m_UpNodes.size()+1;
-            m_membershipchecks++;
+            list_change = true;
+            EraseInPeerSet(m_UpNodes,peer);
+            Logger.Info << "No response from peer: "<<peer->GetUUID()
+                <<" (suspicion "<<CFailureDetector::instance().GetSuspicion(
+                    peer->GetUUID())<<")"<<std::endl;
         }
-        // Clear the expected responses    
-        m_AYCResponse.clear();
-        if( 0 < m_Coordinators.size() )
+    }
+    m_AlivePeers.clear();
+    if(list_change)
+    {
+        PushPeerList();
+        Membership.fetch_add(m_UpNodes.size()+1, boost::memory_order_relaxed);
+        MembershipChecks.fetch_add(1, boost::memory_order_relaxed);
+    }
+    if( 0 < m_Coordinators.size() && m_fastmerge )
+    {
+        Elections.fetch_add(1, boost::memory_order_relaxed);
+        // Every coordinator seen in this round asked the others too, so
+        // the one they all rank highest merges them and the rest wait.
+        unsigned int higher = 0;
+        foreach( PeerNodePtr peer, m_Coordinators | boost::adaptors::map_values)
         {
-            m_groupselection++;
-            //This uses appleby's MurmurHash2 to make a unsigned int of the uuid
-            //This becomes that nodes priority.
-            boost::hash<std::string> string_hash;
-            unsigned int myPriority = string_hash(GetUUID());
-            unsigned int maxPeer_ = 0;
-            foreach( PeerNodePtr peer, m_Coordinators | boost::adaptors::map_values)
-            {
-                unsigned int temp = string_hash(peer->GetUUID());
-                if(temp > maxPeer_)
-                {
-                    maxPeer_ = temp;
-                }
-            }
-            float wait_val_;
-            int maxWait = 75; /* The longest a node would have to wait to Merge */
-            int minWait = 10;
-            int granularity = 5; /* How finely it can slip in */
-            int delta = ((maxWait-minWait)*1.0)/(granularity*1.0);
-            if( myPriority < maxPeer_ )
-                wait_val_ = (((maxPeer_ - myPriority)%(granularity+1))*1.0)*delta+minWait;
-            else
-                wait_val_ = 0;
-            #ifdef RANDOM_PREMERGE
-            wait_val_ = (rand() % 20) + 10;
-            #endif
-            boost::posix_time::milliseconds proportional_Timeout( wait_val_ );
-            /* Set deadline timer to call Merge() */
-            Logger.Notice << "TIMER: Waiting for Merge(): " << wait_val_ << " ms." << std::endl;
-            m_timerMutex.lock();
-            m_broker.Schedule(m_timer, proportional_Timeout,
-                boost::bind(&GMAgent::Merge, this, boost::asio::placeholders::error));
-            m_timerMutex.unlock();
+            if(!Outranks(peer))
+                higher++;
+        }
+        if(higher == 0)
+        {
+            Logger.Notice << "Merging at once: highest priority of "
+                << m_Coordinators.size()+1 << " coordinators" << std::endl;
+            Merge(boost::system::error_code());
         }
         else
-        {    // We didn't find any other Coordinators, go back to work
-            Logger.Info << "TIMER: Setting CheckTimer (Check): " << __LINE__ << std::endl;
+        {
+            // The invitation replaces this timer, so this only checks
+            // again if the higher coordinator missed our question.
+            Logger.Notice << "Leaving the merge to " << higher
+                << " higher priority coordinators" << std::endl;
             m_timerMutex.lock();
-            m_broker.Schedule(m_timer, CHECK_TIMEOUT,
+            m_broker.Schedule(m_timer, RESPONSE_TIMEOUT + RESPONSE_TIMEOUT,
                 boost::bind(&GMAgent::Check, this, boost::asio::placeholders::error));
             m_timerMutex.unlock();
         }
     }
+    else if( 0 < m_Coordinators.size() )
+    {
+        Elections.fetch_add(1, boost::memory_order_relaxed);
+        //This uses appleby's MurmurHash2 to make a unsigned int of the uuid
+        //This becomes that nodes priority.
+        boost::hash<std::string> string_hash;
+        unsigned int myPriority = string_hash(GetUUID());
+        unsigned int maxPeer_ = 0;
+        foreach( PeerNodePtr peer, m_Coordinators | boost::adaptors::map_values)
+        {
+            unsigned int temp = string_hash(peer->GetUUID());
+            if(temp > maxPeer_)
+            {
+                maxPeer_ = temp;
+            }
+        }
+        float wait_val_;
+        int maxWait = 75; /* The longest a node would have to wait to Merge */
+        int minWait = 10;
+        int granularity = 5; /* How finely it can slip in */
+        int delta = ((maxWait-minWait)*1.0)/(granularity*1.0);
+        if( myPriority < maxPeer_ )
+            wait_val_ = (((maxPeer_ - myPriority)%(granularity+1))*1.0)*delta+minWait;
+        else
+            wait_val_ = 0;
+        #ifdef RANDOM_PREMERGE
+        wait_val_ = (rand() % 20) + 10;
+        #endif
+        boost::posix_time::milliseconds proportional_Timeout( wait_val_ );
+        /* Set deadline timer to call Merge() */
+        Logger.Notice << "TIMER: Waiting for Merge(): " << wait_val_ << " ms." << std::endl;
+        m_timerMutex.lock();
+        m_broker.Schedule(m_timer, proportional_Timeout,
+            boost::bind(&GMAgent::Merge, this, boost::asio::placeholders::error));
+        m_timerMutex.unlock();
+    }
     else
-    { 
-        // Unexpected error
-        Logger.Error << err << std::endl;
-        throw boost::system::system_error(err);
+    {    // We didn't find any other Coordinators, go back to work
+        Logger.Info << "TIMER: Setting CheckTimer (Check): " << __LINE__ << std::endl;
+        m_timerMutex.lock();
+        m_broker.Schedule(m_timer, CHECK_TIMEOUT,
+            boost::bind(&GMAgent::Check, this, boost::asio::placeholders::error));
+        m_timerMutex.unlock();
     }
 }
 
@@ -809,12 +1155,16 @@ void GMAgent::Merge( const boost::system::error_code& err )
     if( !err )
     {
         // This proc forms a new group by inviting Coordinators in CoordinatorSet
+        m_electionStarted = CClock::instance().GetMonotonicTime();
         SetStatus(GMAgent::ELECTION);
         Logger.Notice << "+ State Change ELECTION : "<<__LINE__<<std::endl;
         // Update GroupID
         m_GrpCounter++;
         m_GroupID = m_GrpCounter;
         m_GroupLeader = GetUUID();
+        GroupChanges.fetch_add(1, boost::memory_order_relaxed);
+        CEventLog::instance().Write(CEventLog::GM, CEventLog::GM_GROUP_CHANGED,
+                m_GroupID, CEventLog::Hash(m_GroupLeader));
         Logger.Notice << "Changed group: " << m_GroupID << " (" << m_GroupLeader << ")" << std::endl;
         // m_UpNodes are the members of my group.
         PeerSet tempSet_ = m_UpNodes;
@@ -829,6 +1179,21 @@ void GMAgent::Merge( const boost::system::error_code& err )
                 continue;
             SendToPeer(peer,m_);
         }
+        // The members of the other groups are invited along with their
+        // coordinators rather than after them.
+        if(m_fastmerge)
+        {
+            foreach( PeerNodePtr peer, m_CoordinatorMembers | boost::adaptors::map_values)
+            {
+                if(!CountInPeerSet(m_Coordinators,peer))
+                    InsertInPeerSet(tempSet_,peer);
+            }
+            m_Invited = tempSet_;
+            foreach( PeerNodePtr peer, m_Coordinators | boost::adaptors::map_values)
+            {
+                InsertInPeerSet(m_Invited,peer);
+            }
+        }
         // Previously, this set the global timer and waited for GLOBAL_TIMEOUT
         // Before inviting group nodes. However, looking at the original text of the
         // Group management paper, I believe this is not the correct thing to do.
@@ -909,18 +1274,21 @@ void GMAgent::Reorganize( const boost::system::error_code& err )
     {
         SetStatus(GMAgent::REORGANIZATION);
         Logger.Notice << "+ State change: REORGANIZATION: " << __LINE__    << std::endl; 
+        m_Invited.clear();
         // Send Ready msg to all up nodes in this group
         CMessage m_ = Ready();
         Logger.Info <<"SEND: Sending out Ready"<<std::endl;
         // Send new membership list to group members 
         // PeerList is the new READY
         PushPeerList();
-        m_membership += m_UpNodes.size()+1;
-        m_membershipchecks++;
+        Membership.fetch_add(m_UpNodes.size()+1, boost::memory_order_relaxed);
+        MembershipChecks.fetch_add(1, boost::memory_order_relaxed);
         // sufficiently_long_Timeout; maybe Reorganize if something blows up
         SetStatus(GMAgent::NORMAL);
         Logger.Notice << "+ State change: NORMAL: " << __LINE__ << std::endl;
-        m_groupsformed++;
+        GroupsFormed.fetch_add(1, boost::memory_order_relaxed);
+        ElectionLed.Record(Microseconds(m_electionStarted,
+            CClock::instance().GetMonotonicTime()));
         Logger.Notice << "Upnodes size: "<<m_UpNodes.size()<<std::endl;
         // Back to work
         Logger.Info << "TIMER: Setting CheckTimer (Check): " << __LINE__ << std::endl;
@@ -929,6 +1297,10 @@ void GMAgent::Reorganize( const boost::system::error_code& err )
             boost::bind(&GMAgent::Check, this, boost::asio::placeholders::error));
         m_timerMutex.unlock();
     }
+    else if(err == boost::asio::error::operation_aborted)
+    {
+        // Everyone invited accepted, so HandleAccept reorganized early.
+    }
     else
     {
         Logger.Error << err << std::endl;
@@ -936,12 +1308,58 @@ void GMAgent::Reorganize( const boost::system::error_code& err )
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::IsAlive
+/// @description Decides whether a peer which may not have answered is still
+///     up. A peer heard from by group management since the last check is.
+///     Otherwise the failure detector, which hears all of the peer's
+///     traffic, decides; without a detector the peer is not.
+/// @param peer The peer to judge.
+/// @return True if the peer should be kept.
+///////////////////////////////////////////////////////////////////////////////
+bool GMAgent::IsAlive(PeerNodePtr peer)
+{
+    if(CountInPeerSet(m_AlivePeers, peer) > 0)
+    {
+        return true;
+    }
+    CFailureDetector & detector = CFailureDetector::instance();
+    if(detector.IsTrusted(peer->GetUUID()))
+    {
+        Logger.Info << "Still trusting silent peer " << peer->GetUUID()
+                    << " (suspicion " << detector.GetSuspicion(peer->GetUUID())
+                    << ")" << std::endl;
+        DetectorTrusted.fetch_add(1, boost::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::Outranks
+/// @description Compares merge priorities, the hashes Premerge waits by.
+///     Equal hashes are ordered by UUID so every node ranks alike.
+/// @pre None
+/// @post None
+/// @param peer The node to compare with.
+/// @return True if this node has the higher priority.
+///////////////////////////////////////////////////////////////////////////////
+bool GMAgent::Outranks(PeerNodePtr peer) const
+{
+    boost::hash<std::string> string_hash;
+    unsigned int myPriority = string_hash(GetUUID());
+    unsigned int peerPriority = string_hash(peer->GetUUID());
+    if(myPriority != peerPriority)
+        return myPriority > peerPriority;
+    return GetUUID() > peer->GetUUID();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// GMAgent::Timeout
-/// @description Sends an AreYouThere message to the coordinator and sets a timer
-///                            if the timer expires, this node goes into recovery.
+/// @description Sends an AreYouThere message to the coordinator; Confirm acts
+///                            on the answer or on its absence.
 /// @pre The node is a member of a group, but not the leader
-/// @post A timer for recovery is set.
+/// @post The AYT is waiting on the leader.
 /// @citation Group Managment Timeout
 ///////////////////////////////////////////////////////////////////////////////
 void GMAgent::Timeout( const boost::system::error_code& err )
@@ -951,37 +1369,26 @@ void GMAgent::Timeout( const boost::system::error_code& err )
     if( !err )
     {
         SystemState(); 
+        Checkpoint();
         /* If we are the group leader, we don't need to run this */
-        CMessage m_ = AreYouThere();
         peer = GetPeer(Coordinator());
-        m_AYTResponse.clear();
-        m_aytoptional = false;
         if(!IsCoordinator())
         {
+            // If the leader has not been heard from, Confirm recovers unless
+            // it answers yes in time. Otherwise the answer is optional and
+            // only a no, which means we were dropped, needs acting on.
+            bool optional = IsAlive(peer);
+            m_calls.Cancel(m_ayt);
             Logger.Info << "SEND: Sending AreYouThere messages." << std::endl;
-            if( CountInPeerSet(m_AlivePeers, peer) == 0 )
-            {
-                if(peer->GetUUID() != GetUUID())
-                {
-                    SendToPeer(peer,m_);
-                    Logger.Info << "Expecting response from "<<peer->GetUUID()<<std::endl;
-                    InsertInPeerSet(m_AYTResponse,peer);
-                }
-                Logger.Info << "TIMER: Setting TimeoutTimer (Recovery):" << __LINE__ << std::endl;
-                m_timerMutex.lock();
-                m_broker.Schedule(m_timer, RESPONSE_TIMEOUT,
-                    boost::bind(&GMAgent::Recovery, this, boost::asio::placeholders::error));
-                m_timerMutex.unlock();
-            }
-            else
+            Logger.Info << "Expecting response from "<<peer->GetUUID()<<std::endl;
+            m_aytSent = CClock::instance().GetMonotonicTime();
+            m_ayt = m_calls.Call(peer, AreYouThere(), RESPONSE_TIMEOUT,
+                boost::bind(&GMAgent::Confirm, this, _1, optional));
+            if(optional)
             {
-                //We'll still check to see if we are considered a part of that group:
-                SendToPeer(peer,m_);
-                Logger.Info << "Expecting response from "<<peer->GetUUID()<<std::endl;
-                InsertInPeerSet(m_AYTResponse,peer);
                 m_AlivePeers.clear();
-                m_aytoptional = true;
                 Logger.Info << "TIMER: Setting TimeoutTimer (Timeout): " << __LINE__ << std::endl;
+                m_timerMutex.lock();
                 m_broker.Schedule(m_timer, TIMEOUT_TIMEOUT,
                     boost::bind(&GMAgent::Timeout, this, boost::asio::placeholders::error));
                 m_timerMutex.unlock();
@@ -1000,6 +1407,47 @@ void GMAgent::Timeout( const boost::system::error_code& err )
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::Confirm
+/// @description Acts on the leader's answer to AreYouThere. A yes starts the
+///     next Timeout. A no means this node was dropped from the group, and so
+///     does no answer at all when the leader was not otherwise heard from.
+/// @pre Timeout asked the leader whether this node is still in its group.
+/// @post The node has entered recovery if it is no longer in the group.
+/// @param result The leader's answer, or the leader missing if it did not
+///     answer in time.
+/// @param optional True if the leader has been heard from recently.
+/// @citation Group Managment Timeout
+///////////////////////////////////////////////////////////////////////////////
+void GMAgent::Confirm( const CCallTable::Result & result, bool optional )
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    std::map<std::string, CMessage>::const_iterator it =
+        result.replies.find(Coordinator());
+    std::string answer;
+    if(it != result.replies.end())
+    {
+        CMessage reply = it->second;
+        answer = reply.GetSubMessages().get<std::string>("gm.payload");
+    }
+    if(answer == "yes")
+    {
+        Logger.Info << "TIMER: Setting TimeoutTimer (Timeout): " << __LINE__ << std::endl;
+        m_timerMutex.lock();
+        m_broker.Schedule(m_timer, TIMEOUT_TIMEOUT,
+            boost::bind(&GMAgent::Timeout, this, boost::asio::placeholders::error));
+        m_timerMutex.unlock();
+    }
+    else if(answer == "no" || !optional)
+    {
+        if(!optional)
+        {
+            GroupsBroken.fetch_add(1, boost::memory_order_relaxed);
+        }
+        Recovery();
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// GMAgent::ProcessPeerList
 /// @description Provides a utility function for correctly handling incoming
@@ -1011,10 +1459,103 @@ void GMAgent::Timeout( const boost::system::error_code& err )
 GMAgent::PeerSet GMAgent::ProcessPeerList(CMessage msg, CConnectionManager& connmgr)
 {
     // Note: The group leader inserts himself into the peer list.
-    PeerSet tmp;
     ptree pt = msg.GetSubMessages();
+    return ReadPeers(pt.get_child("any.peers"),connmgr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::ProcessPeerList
+/// @description Applies an incoming peer list, full or incremental, to the
+///     membership a module keeps. A full list replaces the membership. A
+///     list of changes is applied only if it follows the version the module
+///     applied last from the same leader and group; otherwise the module
+///     should send a PeerListQuery to the leader for the full list.
+/// @param msg The message to parse
+/// @param connmgr A connection manager to use for constructing unrecognized peers.
+/// @param applied The last version applied, updated when this one applies.
+/// @param members The membership to update.
+/// @param added Set to the peers which were added to the membership.
+/// @param removed Set to the peers which were removed from the membership.
+/// @return False if the changes could not be applied.
+///////////////////////////////////////////////////////////////////////////////
+bool GMAgent::ProcessPeerList(CMessage msg, CConnectionManager& connmgr,
+    PeerListVersion & applied, PeerSet & members, PeerSet & added,
+    PeerSet & removed)
+{
+    ptree pt = msg.GetSubMessages();
+    PeerListVersion incoming;
+    incoming.leader = pt.get<std::string>("any.coordinator");
+    incoming.group = pt.get<unsigned int>("any.groupid",0);
+    incoming.version = pt.get<unsigned int>("any.version",0);
+    added.clear();
+    removed.clear();
+    if(pt.get_child_optional("any.peers"))
+    {
+        PeerSet full = ReadPeers(pt.get_child("any.peers"),connmgr);
+        foreach(PeerNodePtr p, full | boost::adaptors::map_values)
+        {
+            if(CountInPeerSet(members,p) == 0)
+                InsertInPeerSet(added,p);
+        }
+        foreach(PeerNodePtr p, members | boost::adaptors::map_values)
+        {
+            if(CountInPeerSet(full,p) == 0)
+                InsertInPeerSet(removed,p);
+        }
+        members = full;
+        applied = incoming;
+        return true;
+    }
+    bool same = (incoming.leader == applied.leader
+        && incoming.group == applied.group);
+    if(same && incoming.version <= applied.version)
+    {
+        Logger.Debug<<"Ignoring old peer list changes"<<std::endl;
+        return true;
+    }
+    if(!same || pt.get<unsigned int>("any.base") != applied.version)
+    {
+        Logger.Notice<<"Missed a peer list version (have "<<applied.version
+            <<", got changes to "<<incoming.version<<")"<<std::endl;
+        return false;
+    }
+    if(pt.get_child_optional("any.added"))
+    {
+        added = ReadPeers(pt.get_child("any.added"),connmgr);
+    }
+    if(pt.get_child_optional("any.removed"))
+    {
+        foreach(ptree::value_type &v, pt.get_child("any.removed"))
+        {
+            PeerSet::iterator it = members.find(v.second.data());
+            if(it != members.end())
+            {
+                InsertInPeerSet(removed,it->second);
+                members.erase(it);
+            }
+        }
+    }
+    foreach(PeerNodePtr p, added | boost::adaptors::map_values)
+    {
+        InsertInPeerSet(members,p);
+    }
+    applied = incoming;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::ReadPeers
+/// @description Reads the peers listed in a peer list message, creating any
+///     which are not yet known.
+/// @param peers The node of the message which lists the peers
+/// @param connmgr A connection manager to use for constructing unrecognized peers.
+/// @return A PeerSet with the listed peers.
+///////////////////////////////////////////////////////////////////////////////
+GMAgent::PeerSet GMAgent::ReadPeers(const ptree & peers, CConnectionManager& connmgr)
+{
+    PeerSet tmp;
     Logger.Debug<<"Looping Peer List"<<std::endl;
-    foreach(ptree::value_type &v, pt.get_child("any.peers"))
+    foreach(const ptree::value_type &v, peers)
     {
         Logger.Debug<<"Peer Item"<<std::endl;
         ptree sub_pt = v.second;
@@ -1088,12 +1629,14 @@ void GMAgent::HandleAny(CMessage msg, PeerNodePtr peer)
 void GMAgent::HandlePeerList(CMessage msg, PeerNodePtr peer)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    ptree pt = msg.GetSubMessages();
+    PeerSet added, removed;
     if(peer->GetUUID() == m_GroupLeader && GetStatus() == GMAgent::REORGANIZATION)
     {
         SetStatus(GMAgent::NORMAL);
         Logger.Notice << "+ State change: NORMAL: " << __LINE__ << std::endl;
-        m_groupsjoined++;
+        GroupsJoined.fetch_add(1, boost::memory_order_relaxed);
+        ElectionJoined.Record(Microseconds(m_electionStarted,
+            CClock::instance().GetMonotonicTime()));
         // We are no longer the Coordinator, we must run Timeout()
         Logger.Info << "TIMER: Canceling TimeoutTimer : " << __LINE__ << std::endl;
         m_timerMutex.lock();
@@ -1103,19 +1646,27 @@ void GMAgent::HandlePeerList(CMessage msg, PeerNodePtr peer)
             boost::bind(&GMAgent::Timeout, this, boost::asio::placeholders::error));
         m_timerMutex.unlock();
         Logger.Info << "RECV: PeerList (Ready) message from " <<peer->GetUUID() << std::endl;
-        m_UpNodes.clear();
-        m_UpNodes = ProcessPeerList(msg,GetConnectionManager());
-        m_membership += m_UpNodes.size();
-        m_membershipchecks++;
+        if(!ProcessPeerList(msg,GetConnectionManager(),m_peerListApplied,
+            m_UpNodes,added,removed))
+        {
+            peer->Send(PeerListQuery("any"));
+            return;
+        }
+        Membership.fetch_add(m_UpNodes.size(), boost::memory_order_relaxed);
+        MembershipChecks.fetch_add(1, boost::memory_order_relaxed);
         m_UpNodes.erase(GetUUID());
         Logger.Notice<<"Updated Peer Set."<<std::endl;
     }
     else if(peer->GetUUID() == m_GroupLeader && GetStatus() == GMAgent::NORMAL)
     {
-        m_UpNodes.clear();
-        m_UpNodes = ProcessPeerList(msg,GetConnectionManager());
-        m_membership = m_UpNodes.size()+1;
-        m_membershipchecks++;
+        if(!ProcessPeerList(msg,GetConnectionManager(),m_peerListApplied,
+            m_UpNodes,added,removed))
+        {
+            peer->Send(PeerListQuery("any"));
+            return;
+        }
+        Membership.fetch_add(m_UpNodes.size()+1, boost::memory_order_relaxed);
+        MembershipChecks.fetch_add(1, boost::memory_order_relaxed);
         m_UpNodes.erase(GetUUID());
         Logger.Notice<<"Updated peer set (UPDATE)"<<std::endl;
     }
@@ -1145,6 +1696,16 @@ void GMAgent::HandleAccept(CMessage msg, PeerNodePtr peer)
         InsertInPeerSet(m_UpNodes,peer);
         // XXX I am not sure if the client should get some sort of ACK
         // or perhaps this comes in the means of the Ready msg
+        bool invited = CountInPeerSet(m_Invited,peer) > 0;
+        EraseInPeerSet(m_Invited,peer);
+        if(invited && m_Invited.size() == 0)
+        {
+            Logger.Info << "TIMER: Everyone accepted (Reorganize) : " << __LINE__ << std::endl;
+            m_timerMutex.lock();
+            m_broker.Schedule(m_timer, boost::posix_time::milliseconds(0),
+                boost::bind(&GMAgent::Reorganize, this, boost::asio::placeholders::error));
+            m_timerMutex.unlock();
+        }
     }
     else
     {
@@ -1170,13 +1731,35 @@ void GMAgent::HandleAreYouCoordinator(CMessage msg, PeerNodePtr peer)
         // We are the group Coordinator AND we are at normal operation
         Logger.Info << "SEND: AYC Response (YES) to "<<peer->GetUUID()<<std::endl;
         CMessage m_ = Response("yes","AreYouCoordinator",msg.GetExpireTime());
+        CCallTable::Correlate(msg, m_);
+        if(m_fastmerge)
+        {
+            // Lets the merging coordinator invite my group directly
+            foreach( PeerNodePtr member, m_UpNodes | boost::adaptors::map_values)
+            {
+                ptree sub_pt;
+                sub_pt.add("uuid",member->GetUUID());
+                sub_pt.add("host",member->GetHostname());
+                sub_pt.add("port",member->GetPort());
+                m_.m_submessages.add_child("gm.members.peer",sub_pt);
+            }
+        }
         SendToPeer(peer,m_);
+        // Only coordinators ask. If I outrank this one, the merge is mine to
+        // lead, so look for the other coordinators now.
+        if(m_fastmerge && !m_calls.IsPending(m_check) && !CountInPeerSet(m_UpNodes,peer)
+            && Outranks(peer))
+        {
+            Logger.Info << "Checking at once for "<<peer->GetUUID()<<std::endl;
+            Check(boost::system::error_code());
+        }
     }
     else
     {
         // We are not the Coordinator OR we are not at normal operation
         Logger.Info << "SEND: AYC Response (NO) to "<<peer->GetUUID()<<std::endl;
         CMessage m_ = Response("no","AreYouCoordinator",msg.GetExpireTime());
+        CCallTable::Correlate(msg, m_);
         SendToPeer(peer,m_);
     }
 }
@@ -1201,6 +1784,7 @@ void GMAgent::HandleAreYouThere(CMessage msg, PeerNodePtr peer)
         Logger.Info << "SEND: AYT Response (YES) to "<<peer->GetUUID()<<std::endl;
         // We are Coordinator, peer is in our group, and peer is up
         CMessage m_ = Response("yes","AreYouThere",msg.GetExpireTime());
+        CCallTable::Correlate(msg, m_);
         SendToPeer(peer,m_);
     }
     else
@@ -1208,6 +1792,7 @@ void GMAgent::HandleAreYouThere(CMessage msg, PeerNodePtr peer)
         Logger.Info << "SEND: AYT Response (NO) to "<<peer->GetUUID()<<std::endl;
         // We are not Coordinator OR peer is not in our groups OR peer is down
         CMessage m_ = Response("no","AreYouThere",msg.GetExpireTime());
+        CCallTable::Correlate(msg, m_);
         SendToPeer(peer,m_);
     }
 }
@@ -1235,11 +1820,15 @@ void GMAgent::HandleInvite(CMessage msg, PeerNodePtr peer)
         // STOP ALL JOBS.
         coord_ = Coordinator();
         tempSet_ = m_UpNodes;
+        m_electionStarted = CClock::instance().GetMonotonicTime();
         SetStatus(GMAgent::ELECTION);
         Logger.Notice << "+ State Change ELECTION : "<<__LINE__<<std::endl;
         
         m_GroupID = pt.get<unsigned int>("gm.groupid");
         m_GroupLeader = pt.get<std::string>("gm.groupleader");
+        GroupChanges.fetch_add(1, boost::memory_order_relaxed);
+        CEventLog::instance().Write(CEventLog::GM, CEventLog::GM_GROUP_CHANGED,
+                m_GroupID, CEventLog::Hash(m_GroupLeader));
         Logger.Notice << "Changed group: " << m_GroupID << " (" << m_GroupLeader << ") " << std::endl;
         if(coord_ == GetUUID())
         {
@@ -1273,6 +1862,10 @@ void GMAgent::HandleInvite(CMessage msg, PeerNodePtr peer)
         SendToPeer(p,m_);
         SetStatus(GMAgent::REORGANIZATION);
         Logger.Notice << "+ State Change REORGANIZATION : "<<__LINE__<<std::endl;
+        // Any check under way is over, and the recovery timer is set, so
+        // neither a late AYC answer nor a late AYT "no" may act.
+        m_calls.Cancel(m_check);
+        m_calls.Cancel(m_ayt);
         Logger.Info << "TIMER: Setting TimeoutTimer (Recovery) : " << __LINE__ << std::endl;
         m_timerMutex.lock();
         m_broker.Schedule(m_timer, TIMEOUT_TIMEOUT,
@@ -1290,10 +1883,10 @@ void GMAgent::HandleInvite(CMessage msg, PeerNodePtr peer)
 /// GMAgent::HandleResponseAYC
 /// @description Handles recieving the Response
 /// @key gm.Response.AreYouCoordinator
-/// @pre The timer for the AYC request batch the original request was a part
-///     of has not expired
-/// @post The response from the sender is noted, if yes, the groups will attempt
-///     to merge in the future.
+/// @pre None
+/// @post The response is part of the check it answers, if that check is still
+///     waiting on the sender; if yes, the groups will attempt to merge once
+///     the check completes. A no teaches this node the sender's leader.
 /// @peers A node the AYC request was sent to.
 ///////////////////////////////////////////////////////////////////////////////
 void GMAgent::HandleResponseAYC(CMessage msg, PeerNodePtr peer)
@@ -1302,34 +1895,26 @@ void GMAgent::HandleResponseAYC(CMessage msg, PeerNodePtr peer)
     ptree pt = msg.GetSubMessages();
     std::string answer = pt.get<std::string>("gm.payload");
     Logger.Info << "RECV: Response (AYC) ("<<answer<<") from " <<peer->GetUUID() << std::endl;
-    Logger.Debug << "Checking expected responses." << std::endl;
-    bool expected = CountInPeerSet(m_AYCResponse,peer);
-    EraseInPeerSet(m_AYCResponse,peer);
-    if(expected == true && pt.get<std::string>("gm.payload") == "yes")
-    {
-        InsertInPeerSet(m_Coordinators,peer);
-        if(m_AYCResponse.size() == 0)
-        {
-            Logger.Info << "TIMER: Canceling GlobalTimer : " << __LINE__ << std::endl;
-            m_timerMutex.lock();
-            //Before, we just cleared this timer. Now I'm going to set it to start another check cycle
-            m_broker.Schedule(m_timer, TIMEOUT_TIMEOUT,
-                boost::bind(&GMAgent::Check, this, boost::asio::placeholders::error));
-            m_timerMutex.unlock();
-        }
-    }
-    else if(pt.get<std::string>("gm.payload") == "no")
+    boost::posix_time::ptime now = CClock::instance().GetMonotonicTime();
+    if(pt.get<std::string>("gm.payload") == "no")
     {
+        // Even a late answer names a leader worth knowing about.
         std::string nuuid = pt.get<std::string>("gm.ldruuid");
         std::string nhost = pt.get<std::string>("gm.ldrhost");
         std::string nport = pt.get<std::string>("gm.ldrport");
         GetConnectionManager().PutHostname(nuuid, nhost, nport);
         AddPeer(nuuid);
-        EraseInPeerSet(m_Coordinators,peer);
+    }
+    // The check's Premerge runs here if this was the last answer it needed.
+    if(m_calls.HandleReply(msg, peer))
+    {
+        CMetricsRegistry::instance().GetHistogram("gm.peer."+peer->GetUUID()+
+            ".ayc.us").Record(Microseconds(m_checkSent, now));
     }
     else
     {
-        Logger.Warn<< "Unsolicited AreYouCoordinator response from "<<peer->GetUUID()<< std::endl;
+        Logger.Info << "Late or unsolicited AreYouCoordinator response from "
+            <<peer->GetUUID()<< std::endl;
     }
 }
 
@@ -1337,11 +1922,8 @@ void GMAgent::HandleResponseAYC(CMessage msg, PeerNodePtr peer)
 /// GMAgent::HandleResponseAYT
 /// @description Handles recieving the Response
 /// @key gm.Response.AreYouThere
-/// @pre The timer for the AYT request batch (typically 1) the original request
-///     was a part of has not expired
-/// @post The response from the sender is noted. If the answer is no, then this
-///     node will enter recovery, if the recovery timer has not already been
-///     set, otherwise we will allow it to expire.
+/// @pre None
+/// @post If the AYT it answers is still waiting, Confirm acts on the answer.
 ///////////////////////////////////////////////////////////////////////////////
 void GMAgent::HandleResponseAYT(CMessage msg, PeerNodePtr peer)
 {
@@ -1349,45 +1931,57 @@ void GMAgent::HandleResponseAYT(CMessage msg, PeerNodePtr peer)
     ptree pt = msg.GetSubMessages();
     std::string answer = pt.get<std::string>("gm.payload");
     Logger.Info << "RECV: Response (AYT) ("<<answer<<") from " <<peer->GetUUID() << std::endl;
-    Logger.Debug << "Checking expected responses." << std::endl;
-    bool expected = CountInPeerSet(m_AYTResponse,peer);
-    EraseInPeerSet(m_AYTResponse,peer);
-    if(expected == true && pt.get<std::string>("gm.payload") == "yes")
-    {
-        m_timerMutex.lock();
-        Logger.Info << "TIMER: Setting TimeoutTimer (Timeout): " << __LINE__ << std::endl;
-        m_broker.Schedule(m_timer, TIMEOUT_TIMEOUT,
-            boost::bind(&GMAgent::Timeout, this, boost::asio::placeholders::error));
-        m_timerMutex.unlock();
-    }
-    else if(pt.get<std::string>("gm.payload") == "no")
+    boost::posix_time::ptime now = CClock::instance().GetMonotonicTime();
+    if(m_calls.HandleReply(msg, peer))
     {
-        // We've been removed from the group. if m_aytoptional is set, then we should
-        // recover (m_aytoptional == True iff the recovery timer is not already set.
-        if(m_aytoptional && peer->GetUUID() == Coordinator())
-        {
-            Recovery();
-        }    
+        CMetricsRegistry::instance().GetHistogram("gm.peer."+peer->GetUUID()+
+            ".ayt.us").Record(Microseconds(m_aytSent, now));
     }
     else
     {
-        Logger.Warn<< "Unsolicited AreYouThere response from "<<peer->GetUUID()<<std::endl;
+        Logger.Info << "Late or unsolicited AreYouThere response from "
+            <<peer->GetUUID()<<std::endl;
     }
 }
     
 ///////////////////////////////////////////////////////////////////////////////
 /// GMAgent::HandleClock
-/// @description HAndles recieving the resultant clock values.
+/// @description Handles recieving the resultant clock values. The reply
+///     carries when the request was sent and received and when the reply
+///     was sent; with when it arrived here they measure the peer's clock.
 /// @key gm.Clock
 /// @pre None
-/// @post The clocks table is updated with the reading from the peer.
+/// @post The peer's clock filter holds the measurement unless it was slow.
 ///////////////////////////////////////////////////////////////////////////////
 void GMAgent::HandleClock(CMessage msg, PeerNodePtr peer)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
     ptree pt = msg.GetSubMessages();
     Logger.Info<<"Clock Reading From "<<peer->GetUUID()<<std::endl;
-    m_clocks[peer->GetUUID()] = pt.get<boost::posix_time::ptime>("gm.value");
+    boost::posix_time::ptime requested =
+        pt.get<boost::posix_time::ptime>("gm.requested");
+    // The request was stamped when it was queued; the kernel knows when it
+    // actually left, which keeps the send window out of the round trip.
+    peer->GetConnection()->GetClockRequestSent(requested, requested);
+    CClockFilter::Sample s = CClockFilter::Measure(
+        requested,
+        pt.get<boost::posix_time::ptime>("gm.received"),
+        pt.get<boost::posix_time::ptime>("gm.value"),
+        msg.GetReceiveTimestamp());
+    // Both clocks were read with their skews; take them out so measurements
+    // from before and after a skew changed can be compared.
+    s.offset += CGlobalConfiguration::instance().GetClockSkew()
+        - boost::posix_time::microseconds(pt.get<long>("gm.skew"));
+    ClockFilterMap::iterator it = m_clockFilters.find(peer->GetUUID());
+    if(it == m_clockFilters.end())
+    {
+        it = m_clockFilters.insert(ClockFilterMap::value_type(peer->GetUUID(),
+            CClockFilter(boost::posix_time::milliseconds(MAX_CLOCK_DELAY)))).first;
+    }
+    if(!it->second.Add(s))
+    {
+        Logger.Info<<"Dropped clock reading with delay "<<s.delay<<std::endl;
+    }
 }    
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1407,9 +2001,8 @@ void GMAgent::HandleClockSkew(CMessage msg, PeerNodePtr peer)
     {
         Logger.Debug<<"Raw Skew Value "<<pt.get<std::string>("gm.clockskew")<<std::endl;
         boost::posix_time::time_duration t = boost::posix_time::microseconds(pt.get<long>("gm.clockskew"));
-        // We are actually making adjustments on the skew with each iteration
+        // The coordinator sends the whole skew, not an adjustment to it
         Logger.Debug<<"Loaded time duration from Ptree"<<std::endl;
-        t = t + CGlobalConfiguration::instance().GetClockSkew();
         Logger.Notice<<"Adjusting My Skew To "<<t<<std::endl;
         CGlobalConfiguration::instance().SetClockSkew(t);
     }
@@ -1428,9 +2021,77 @@ void GMAgent::HandlePeerListQuery(CMessage msg, PeerNodePtr peer)
 {
     ptree pt = msg.GetSubMessages();
     std::string requester = pt.get<std::string>("gm.requester");
+    // Announce any change first so the full list carries a version whose
+    // successors are computed from exactly these members
+    if(IsCoordinator() && m_pushedGroup == m_GroupID
+        && !SameMembers(m_pushedPeers,m_UpNodes))
+    {
+        PushPeerList();
+    }
     peer->Send(PeerList(requester));
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::HandleRejoin
+/// @description Handles a restarted member asking to be taken back.
+/// @key gm.Rejoin
+/// @pre None
+/// @post If this node still leads the group the sender was in, the sender is
+///     a member again and has been sent the full peer list; otherwise it is
+///     told no.
+/// @peers Any node which was a member of a group this node led.
+///////////////////////////////////////////////////////////////////////////////
+void GMAgent::HandleRejoin(CMessage msg, PeerNodePtr peer)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    ptree pt = msg.GetSubMessages();
+    unsigned int msg_group = pt.get<unsigned int>("gm.groupid");
+    Logger.Info << "RECV: Rejoin message from " << peer->GetUUID() << std::endl;
+    if(GetStatus() == GMAgent::NORMAL && IsCoordinator() && msg_group == m_GroupID)
+    {
+        // The full list goes first, so the changes pushed after it apply
+        if(m_pushedGroup == m_GroupID && !SameMembers(m_pushedPeers,m_UpNodes))
+        {
+            PushPeerList();
+        }
+        Logger.Info << "SEND: Peer list to rejoining "<<peer->GetUUID()<<std::endl;
+        SendToPeer(peer,PeerList());
+        if(!CountInPeerSet(m_UpNodes,peer))
+        {
+            InsertInPeerSet(m_UpNodes,peer);
+            PushPeerList();
+            Membership.fetch_add(m_UpNodes.size()+1, boost::memory_order_relaxed);
+            MembershipChecks.fetch_add(1, boost::memory_order_relaxed);
+        }
+    }
+    else
+    {
+        Logger.Info << "SEND: Rejoin Response (NO) to "<<peer->GetUUID()<<std::endl;
+        CMessage m_ = Response("no","Rejoin",msg.GetExpireTime());
+        SendToPeer(peer,m_);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::HandleResponseRejoin
+/// @description Handles the leader of the saved group refusing a rejoin.
+/// @key gm.Response.Rejoin
+/// @pre This node is waiting to rejoin the group it was in before a restart.
+/// @post The node forms a group on its own with Recovery.
+/// @peers The leader of the saved group.
+///////////////////////////////////////////////////////////////////////////////
+void GMAgent::HandleResponseRejoin(CMessage, PeerNodePtr peer)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    Logger.Info << "RECV: Rejoin Response (NO) from " << peer->GetUUID() << std::endl;
+    if(GetStatus() == GMAgent::REORGANIZATION && peer->GetUUID() == m_GroupLeader)
+    {
+        RejoinsRefused.fetch_add(1, boost::memory_order_relaxed);
+        Logger.Notice << "Saved group " << m_GroupID << " is gone" << std::endl;
+        Recovery();
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// GMAgent::AddPeer
 /// @description Adds a peer to allpeers by uuid.
@@ -1499,12 +2160,38 @@ int GMAgent::Run()
         Logger.Notice << "! " <<p_->GetUUID() << " added to peer set" <<std::endl;
     }
     Logger.Notice<<"All listed added"<<std::endl;
-    m_timerMutex.lock();
-    m_broker.Schedule(m_fidtimer, FID_TIMEOUT, 
-        boost::bind(&GMAgent::FIDCheck, this, boost::asio::placeholders::error));
-    m_timerMutex.unlock();
+    // FIDs which report their changes are not polled
+    m_fids = m_phyDevManager->GetDevicesOfType<device::CDeviceFid>();
+    bool watched = true;
+    foreach(device::CDeviceFid::Pointer fid, m_fids)
+    {
+        if(!fid->WatchState(boost::bind(&GMAgent::HandleFIDChange, this,
+            _1, _2, _3)))
+        {
+            watched = false;
+        }
+    }
+    if(!watched)
+    {
+        Logger.Notice<<"Polling FIDs every "<<FID_TIMEOUT<<std::endl;
+        m_timerMutex.lock();
+        m_broker.Schedule(m_fidtimer, FID_TIMEOUT, 
+            boost::bind(&GMAgent::FIDCheck, this, boost::asio::placeholders::error));
+        m_timerMutex.unlock();
+    }
     Logger.Notice<<"Starting Elections"<<std::endl;
-    Recovery();
+    GroupCheckpoint saved;
+    if(!m_checkpointFile.empty() && saved.Load(m_checkpointFile))
+    {
+        Logger.Notice<<"Resuming group "<<saved.group<<" ("<<saved.leader
+            <<") from "<<m_checkpointFile<<std::endl;
+        Resume(saved);
+    }
+    else
+    {
+        Recovery();
+    }
+    UpdateFIDState();
     return 0;
 }
 
@@ -1532,9 +2219,29 @@ int GMAgent::GetStatus() const
 void GMAgent::SetStatus(int status)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    UpdateStateTime();
     m_status = status;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// GMAgent::UpdateStateTime
+/// @description Adds the time since the last update to the total of the
+///     current state, so the totals are current after every state change
+///     and every SystemState.
+/// @pre None
+/// @post The gm.state counter of the current state has been advanced.
+///////////////////////////////////////////////////////////////////////////////
+void GMAgent::UpdateStateTime()
+{
+    boost::posix_time::ptime now = CClock::instance().GetMonotonicTime();
+    if(m_status >= NORMAL && m_status <= ELECTION)
+    {
+        StateTime[m_status]->fetch_add(Microseconds(m_stateEntered, now),
+            boost::memory_order_relaxed);
+    }
+    m_stateEntered = now;
+}
+
 } // namespace gm
 
 } // namespace broker
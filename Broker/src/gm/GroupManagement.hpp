@@ -47,15 +47,19 @@ using boost::property_tree::ptree;
 #include <boost/progress.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 
+#include "CCallTable.hpp"
+#include "CClockFilter.hpp"
 #include "CMessage.hpp"
 #include "CGlobalPeerList.hpp"
 #include "IPeerNode.hpp"
 #include "IAgent.hpp"
 #include "IHandler.hpp"
 #include "CUuid.hpp"
+#include "GroupCheckpoint.hpp"
 #include "CDispatcher.hpp"
 #include "CConnectionManager.hpp"
 #include "CConnection.hpp"
+#include "CRpcCaller.hpp"
 #include "remotehost.hpp"
 #include "device/CPhysicalDeviceManager.hpp"
 #include "device/PhysicalDeviceTypes.hpp"
@@ -80,6 +84,18 @@ class GMAgent
   public:
     /// Module states    
     enum { NORMAL,DOWN,RECOVERY,REORGANIZATION,ELECTION };
+    /// The last membership announcement a module applied.
+    struct PeerListVersion
+    {
+        /// Starts before any announcement.
+        PeerListVersion() : group(0), version(0) { }
+        /// The leader which announced the membership
+        std::string leader;
+        /// The group the membership is for
+        unsigned int group;
+        /// The version of the membership
+        unsigned int version;
+    };
     /// Constructor for using this object as a module.
     GMAgent(std::string uuid_, CBroker &broker, device::CPhysicalDeviceManager::Pointer devmanager);
     /// Module destructor
@@ -90,6 +106,15 @@ class GMAgent
     void Recovery();
     /// Returns true if this node considers itself a coordinator
     bool IsCoordinator() const { return (Coordinator() == GetUUID()); };
+    /// True if the peer was heard from or is still trusted by the detector
+    bool IsAlive(PeerNodePtr peer);
+    /// Chooses between the priority wait and the fast merge
+    void SetFastMerge(bool fast) { m_fastmerge = fast; }
+    /// True if this node's merge priority is above the peer's
+    bool Outranks(PeerNodePtr peer) const;
+    /// Sets the file the group is saved to and restored from on a restart
+    void SetCheckpointFile(const std::string & filename)
+        { m_checkpointFile = filename; }
 
     // Handlers
     /// A set of common code to be run before every message
@@ -116,10 +141,20 @@ class GMAgent
     void HandleClockSkew(CMessage msg,PeerNodePtr peer);
     /// Handles recieving peerlist requests
     void HandlePeerListQuery(CMessage msg, PeerNodePtr peer);
+    /// Handles recieving requests to rejoin after a restart
+    void HandleRejoin(CMessage msg, PeerNodePtr peer);
+    /// Handles recieving refusals of a rejoin
+    void HandleResponseRejoin(CMessage msg, PeerNodePtr peer);
 
     // Processors
     /// Handles Processing a PeerList
     static PeerSet ProcessPeerList(CMessage msg, CConnectionManager& connmgr);
+    /// Applies a full or incremental PeerList to a membership set
+    static bool ProcessPeerList(CMessage msg, CConnectionManager& connmgr,
+        PeerListVersion & applied, PeerSet & members, PeerSet & added,
+        PeerSet & removed);
+    /// Reads the peers listed under a node of a PeerList
+    static PeerSet ReadPeers(const ptree & peers, CConnectionManager& connmgr);
     
     //Routines
     /// Checks for other up leaders
@@ -129,11 +164,17 @@ class GMAgent
     /// Handles no response from timeout message
     void Recovery( const boost::system::error_code& err );
     /// Waits a time period determined by UUID for merge
-    void Premerge( const boost::system::error_code &err );
+    void Premerge( const CCallTable::Result & result );
+    /// Recovers if the leader says, or shows, that this node left its group
+    void Confirm( const CCallTable::Result & result, bool optional );
     /// Sends invitations to all known nodes.
     void Merge( const boost::system::error_code& err );
     /// Sends the peer list to all group members.
     void PushPeerList();
+    /// Returns to the group saved before a restart
+    void Resume(const GroupCheckpoint & saved);
+    /// Saves the group to the checkpoint file if it has changed
+    void Checkpoint();
     
     // Sending Tools
     /// Sends messages to remote peers if FIDs are closed.
@@ -155,8 +196,12 @@ class GMAgent
     CMessage AreYouThere();
     /// Generates a peer list
     CMessage PeerList(std::string requester="any");
+    /// Generates the changes to the peer list since a previous version
+    CMessage PeerListDelta(const PeerSet & added, const PeerSet & removed);
     /// Generates a request to read the remote clock
     CMessage ClockRequest();
+    /// Creates a request to rejoin the group after a restart
+    CMessage Rejoin();
     /// Generates a message informing a node of their new clock skew
     CMessage ClockSkew(boost::posix_time::time_duration t);
     /// Generates a CMessage that can be used to query for the group
@@ -185,12 +230,19 @@ class GMAgent
     void Reorganize( const boost::system::error_code& err );
     /// Outputs information about the current state to the logger.
     void SystemState();
+    /// Adds the time since it was last counted to the current state's total
+    void UpdateStateTime();
     /// Start the monitor after transient is over
     void StartMonitor(const boost::system::error_code& err);
     /// Returns the coordinators uuid.
     std::string Coordinator() const { return m_GroupLeader; }
-    /// Checks the status of the FIDs
+    /// Polls the status of the FIDs
     void FIDCheck(const boost::system::error_code& err);
+    /// Notes that an FID opened or closed
+    void HandleFIDChange(const device::Identifier device,
+        const device::SettingKey key, const device::SettingValue value);
+    /// Acts on the status of the FIDs
+    void UpdateFIDState();
     /// Checks the skew on the clock
     void ComputeSkew(const boost::system::error_code& err);
     
@@ -198,12 +250,13 @@ class GMAgent
     PeerSet	m_UpNodes;
     /// Known Coordinators
     PeerSet m_Coordinators;
-    /// Nodes expecting AYC response from
-    PeerSet m_AYCResponse;
-    /// Nodes expecting AYT response from
-    PeerSet m_AYTResponse;
     /// Nodes that I need to inspect in the future
     PeerSet m_AlivePeers;   
+    /// Members of the groups of the coordinators found by the last check
+    PeerSet m_CoordinatorMembers;
+    /// Nodes invited by a fast merge or a resumed leader which have not
+    /// accepted yet
+    PeerSet m_Invited;
  
     // Mutex for protecting the m_UpNodes above
     boost::mutex pList_Mutex;
@@ -214,6 +267,14 @@ class GMAgent
     std::string  m_GroupLeader;
     /// The number of groups being formed
     unsigned int m_GrpCounter;
+    /// The membership this node last announced as leader
+    PeerSet m_pushedPeers;
+    /// The group this node last announced a membership for
+    unsigned int m_pushedGroup;
+    /// The version of the membership this node last announced
+    unsigned int m_peerListVersion;
+    /// The last membership announcement applied to m_UpNodes
+    PeerListVersion m_peerListApplied;
     
     /* IO and Timers */
     /// The io_service used.
@@ -227,11 +288,11 @@ class GMAgent
     /// Timer for checking clock shew
     CBroker::TimerHandle m_skewtimer;
     
-    /// Type for replies map
-    typedef std::map<std::string,boost::posix_time::ptime> ClockRepliesMap;
+    /// Type for the clock measurements of each peer
+    typedef std::map<std::string,CClockFilter> ClockFilterMap;
    
-    /// Respondants to clock requests 
-    ClockRepliesMap m_clocks;
+    /// Recent clock measurements of the peers which answered clock requests
+    ClockFilterMap m_clockFilters;
 
     // Timeouts
     /// How long between AYC checks
@@ -247,8 +308,8 @@ class GMAgent
     /// How long to wait for responses from other nodes.
     boost::posix_time::time_duration RESPONSE_TIMEOUT;
 
-    ///Maximum clock skew in milliseconds;
-    static const int MAX_SKEW = 100;
+    ///Maximum round trip of a clock measurement in milliseconds
+    static const int MAX_CLOCK_DELAY = 100;
 
     ///The broker!
     CBroker& m_broker;
@@ -256,24 +317,33 @@ class GMAgent
     ///The device manager!
     device::CPhysicalDeviceManager::Pointer m_phyDevManager;
 
-    /// Number of groups formed
-    int m_groupsformed ;
-    /// Number of groups broken
-    int m_groupsbroken ;
-    /// Number of elections started
-    int m_groupselection;
-    /// Number of accepts sent
-    int m_groupsjoined;
-    /// Total size of groups after all checks.
-    int m_membership;
-    /// Number of membership checks
-    int m_membershipchecks;
+    /// The AYC and AYT requests waiting on answers
+    CRpcCaller m_calls;
+    /// The AYC round of the last check
+    CCallTable::CallID m_check;
+    /// The last AYT sent to the leader
+    CCallTable::CallID m_ayt;
+
+    /// When the time in the current state was last counted
+    boost::posix_time::ptime m_stateEntered;
+    /// When this node began the merge it leads or accepted an invitation
+    boost::posix_time::ptime m_electionStarted;
+    /// When the last AreYouCoordinator round was sent
+    boost::posix_time::ptime m_checkSent;
+    /// When the last AreYouThere was sent
+    boost::posix_time::ptime m_aytSent;
+    /// The file the group is checkpointed to, if any
+    std::string m_checkpointFile;
+    /// The group last written to the checkpoint file
+    GroupCheckpoint m_checkpoint;
     /// A store for the status of this node
     int m_status;
+    /// The FIDs attached to this node
+    std::vector<device::CDeviceFid::Pointer> m_fids;
     /// A store for if all the fids are closed
     bool m_fidsclosed;
-    /// A store for if the response for the AYT is optional?
-    bool m_aytoptional;
+    /// True if the highest priority coordinator merges without waiting
+    bool m_fastmerge;
 };
 
 } // namespace gm
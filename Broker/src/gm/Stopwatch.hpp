@@ -1,6 +1,8 @@
 #ifndef STOPWATCH_HPP
 #define STOPWATCH_HPP
 
+#include "CClock.hpp"
+
 #include "boost/date_time/posix_time/posix_time.hpp"
 #include <iostream>
 
@@ -21,14 +23,14 @@ class Stopwatch
         void Start()
         {
             if(timer_running == true) return;
-            timer_start = boost::posix_time::microsec_clock::universal_time();
+            timer_start = CClock::instance().GetMonotonicTime();
             timer_running = true;
         }
         void Stop()
         {
             if(timer_running == false) return;
             boost::posix_time::time_duration x;
-            x = boost::posix_time::microsec_clock::universal_time()-timer_start;
+            x = CClock::instance().GetMonotonicTime()-timer_start;
             elapsed += x;
             timer_running = false;
         }
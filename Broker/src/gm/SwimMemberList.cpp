@@ -0,0 +1,272 @@
+//////////////////////////////////////////////////////////
+/// @file         SwimMemberList.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  The membership table of the SWIM group management mode
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "SwimMemberList.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace freedm {
+
+namespace broker {
+
+namespace gm {
+
+namespace {
+
+/// Orders gossip so the changes sent the fewest times come first.
+bool FewestSent(const std::pair<std::string, unsigned int> & a,
+        const std::pair<std::string, unsigned int> & b)
+{
+    return a.second > b.second;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimMemberList::SwimMemberList
+/// @description Creates a table in which only this node is known.
+/// @param self The uuid of this node.
+///////////////////////////////////////////////////////////////////////////////
+SwimMemberList::SwimMemberList(const std::string & self)
+    : m_self(self)
+{
+    Set(Update(self, ALIVE, 0), boost::posix_time::ptime());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimMemberList::Apply
+/// @description Applies news about a node if it overrides what is believed.
+///     News that this node is suspected or dead is refuted by raising this
+///     node's incarnation past it and gossiping that it is alive.
+/// @pre None
+/// @post The table and the gossip queue reflect the news if it applied.
+/// @param update The news.
+/// @param now The time the news arrived.
+/// @return True if the table changed.
+///////////////////////////////////////////////////////////////////////////////
+bool SwimMemberList::Apply(const Update & update, boost::posix_time::ptime now)
+{
+    if(update.uuid == m_self)
+    {
+        if(update.state == ALIVE || update.incarnation < GetIncarnation())
+        {
+            return false;
+        }
+        Set(Update(m_self, ALIVE, update.incarnation + 1), now);
+        return true;
+    }
+    std::map<std::string, Member>::const_iterator it =
+            m_members.find(update.uuid);
+    bool apply = (it == m_members.end());
+    if(!apply)
+    {
+        const Member & known = it->second;
+        switch(update.state)
+        {
+        case ALIVE:
+            apply = update.incarnation > known.incarnation;
+            break;
+        case SUSPECT:
+            apply = update.incarnation > known.incarnation ||
+                (update.incarnation == known.incarnation &&
+                 known.state == ALIVE);
+            break;
+        case DEAD:
+            apply = update.incarnation > known.incarnation ||
+                (update.incarnation == known.incarnation &&
+                 known.state != DEAD);
+            break;
+        }
+    }
+    if(apply)
+    {
+        Set(update, now);
+    }
+    return apply;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimMemberList::Expire
+/// @description Declares dead every node suspected for longer than the
+///     timeout without refuting it.
+/// @pre None
+/// @post The expired nodes are dead and their deaths queued to be gossiped.
+/// @param now The current time.
+/// @param timeout How long a node may stay suspected.
+/// @return The nodes declared dead.
+///////////////////////////////////////////////////////////////////////////////
+std::vector<std::string> SwimMemberList::Expire(boost::posix_time::ptime now,
+        boost::posix_time::time_duration timeout)
+{
+    std::vector<std::string> expired;
+    std::map<std::string, Member>::const_iterator it;
+    for(it = m_members.begin(); it != m_members.end(); it++)
+    {
+        if(it->second.state == SUSPECT && now - it->second.since > timeout)
+        {
+            expired.push_back(it->first);
+        }
+    }
+    for(unsigned int i = 0; i < expired.size(); i++)
+    {
+        Set(Update(expired[i], DEAD, m_members[expired[i]].incarnation), now);
+    }
+    return expired;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimMemberList::Gossip
+/// @description Takes the changes to piggyback on an outgoing message,
+///     preferring those sent the fewest times. Each change is dropped from
+///     the queue once it has been sent enough times to have reached the
+///     whole group with high probability.
+/// @pre None
+/// @post The send counts of the returned changes are reduced.
+/// @param max The most changes to take.
+/// @return The current news about each node taken.
+///////////////////////////////////////////////////////////////////////////////
+std::vector<SwimMemberList::Update> SwimMemberList::Gossip(unsigned int max)
+{
+    std::vector< std::pair<std::string, unsigned int> > queued(
+            m_gossip.begin(), m_gossip.end());
+    std::stable_sort(queued.begin(), queued.end(), FewestSent);
+    std::vector<Update> result;
+    for(unsigned int i = 0; i < queued.size() && i < max; i++)
+    {
+        result.push_back(Get(queued[i].first));
+        if(--m_gossip[queued[i].first] == 0)
+        {
+            m_gossip.erase(queued[i].first);
+        }
+    }
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimMemberList::IsKnown
+/// @param uuid The node to look for.
+/// @return True if any news about the node has been applied.
+///////////////////////////////////////////////////////////////////////////////
+bool SwimMemberList::IsKnown(const std::string & uuid) const
+{
+    return m_members.count(uuid) > 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimMemberList::IsMember
+/// @param uuid The node to look for.
+/// @return True if the node is believed alive or only suspected.
+///////////////////////////////////////////////////////////////////////////////
+bool SwimMemberList::IsMember(const std::string & uuid) const
+{
+    std::map<std::string, Member>::const_iterator it = m_members.find(uuid);
+    return it != m_members.end() && it->second.state != DEAD;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimMemberList::Get
+/// @param uuid The node to look for.
+/// @return What is believed about the node.
+/// @ErrorHandling Throws a std::out_of_range if the node is not known.
+///////////////////////////////////////////////////////////////////////////////
+SwimMemberList::Update SwimMemberList::Get(const std::string & uuid) const
+{
+    std::map<std::string, Member>::const_iterator it = m_members.find(uuid);
+    if(it == m_members.end())
+    {
+        throw std::out_of_range("Unknown SWIM member: " + uuid);
+    }
+    return Update(uuid, it->second.state, it->second.incarnation);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimMemberList::GetMembers
+/// @return The alive and suspected nodes, this one included, in uuid order.
+///////////////////////////////////////////////////////////////////////////////
+std::vector<std::string> SwimMemberList::GetMembers() const
+{
+    std::vector<std::string> members;
+    std::map<std::string, Member>::const_iterator it;
+    for(it = m_members.begin(); it != m_members.end(); it++)
+    {
+        if(it->second.state != DEAD)
+        {
+            members.push_back(it->first);
+        }
+    }
+    return members;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimMemberList::GetLeader
+/// @description Every node which holds the same members picks the same
+///     leader, so no election is needed.
+/// @return The member with the greatest uuid.
+///////////////////////////////////////////////////////////////////////////////
+std::string SwimMemberList::GetLeader() const
+{
+    return GetMembers().back();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimMemberList::GetIncarnation
+/// @return The incarnation this node currently gossips for itself.
+///////////////////////////////////////////////////////////////////////////////
+unsigned int SwimMemberList::GetIncarnation() const
+{
+    return m_members.find(m_self)->second.incarnation;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimMemberList::Set
+/// @description Records news and queues it to be gossiped 3 log2(n+1) times
+///     for a group of n members.
+/// @param update The news to record.
+/// @param now The time of the change.
+///////////////////////////////////////////////////////////////////////////////
+void SwimMemberList::Set(const Update & update, boost::posix_time::ptime now)
+{
+    Member & m = m_members[update.uuid];
+    m.state = update.state;
+    m.incarnation = update.incarnation;
+    m.since = now;
+    double n = GetMembers().size();
+    m_gossip[update.uuid] =
+            3 * static_cast<unsigned int>(std::ceil(std::log(n + 1) / std::log(2.0)));
+}
+
+} // namespace gm
+
+} // namespace broker
+
+} // namespace freedm
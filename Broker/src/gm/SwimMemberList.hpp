@@ -0,0 +1,138 @@
+//////////////////////////////////////////////////////////
+/// @file         SwimMemberList.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  The membership table of the SWIM group management mode
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef SWIMMEMBERLIST_HPP_
+#define SWIMMEMBERLIST_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace freedm {
+
+namespace broker {
+
+namespace gm {
+
+/// What one node believes about the members of a SWIM group.
+class SwimMemberList
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Holds the state and incarnation of every node heard of
+    ///     and the rules of Das et al. for which news overrides which: news
+    ///     with a newer incarnation always wins, a suspicion overrides an
+    ///     alive member of the same incarnation, and a death overrides both.
+    ///     Only a node may raise its own incarnation, which it does to refute
+    ///     news that it is suspected or dead. Every change is queued to be
+    ///     gossiped a number of times that grows with the log of the group
+    ///     size, newest changes first.
+    ///
+    /// @limitations Not thread safe; the group management module owns it.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// What is believed about a node.
+    enum State { ALIVE, SUSPECT, DEAD };
+
+    /// News about one node, as gossiped between nodes.
+    struct Update
+    {
+        /// Creates the news that a node is in a state.
+        Update(std::string u = "", State s = ALIVE, unsigned int i = 0)
+            : uuid(u), state(s), incarnation(i) { }
+        /// The node the news is about
+        std::string uuid;
+        /// The state the node is in
+        State state;
+        /// The incarnation of the node the news is about
+        unsigned int incarnation;
+    };
+
+    /// Creates a table in which only this node is alive.
+    explicit SwimMemberList(const std::string & self);
+
+    /// Applies news about a node, returning true if it changed the table.
+    bool Apply(const Update & update, boost::posix_time::ptime now);
+
+    /// Declares dead the nodes suspected for longer than the timeout.
+    std::vector<std::string> Expire(boost::posix_time::ptime now,
+            boost::posix_time::time_duration timeout);
+
+    /// Takes up to max updates to piggyback on an outgoing message.
+    std::vector<Update> Gossip(unsigned int max);
+
+    /// True if the node has been heard of.
+    bool IsKnown(const std::string & uuid) const;
+
+    /// True if the node is alive or suspected, and so still a member.
+    bool IsMember(const std::string & uuid) const;
+
+    /// What is believed about a node; the node must be known.
+    Update Get(const std::string & uuid) const;
+
+    /// The alive and suspected nodes, this one included, in uuid order.
+    std::vector<std::string> GetMembers() const;
+
+    /// The member which leads the group: the one with the greatest uuid.
+    std::string GetLeader() const;
+
+    /// This node's current incarnation.
+    unsigned int GetIncarnation() const;
+private:
+    /// What is believed about one node.
+    struct Member
+    {
+        /// The believed state
+        State state;
+        /// The incarnation the state is for
+        unsigned int incarnation;
+        /// When the state last changed
+        boost::posix_time::ptime since;
+    };
+
+    /// Records a change and queues it to be gossiped.
+    void Set(const Update & update, boost::posix_time::ptime now);
+
+    /// This node's uuid.
+    std::string m_self;
+    /// Every node heard of, this one included.
+    std::map<std::string, Member> m_members;
+    /// The changes still to gossip and how many more times to send each.
+    std::map<std::string, unsigned int> m_gossip;
+};
+
+} // namespace gm
+
+} // namespace broker
+
+} // namespace freedm
+
+#endif
@@ -0,0 +1,778 @@
+//////////////////////////////////////////////////////////
+/// @file         SwimMembership.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Group management by SWIM style probing and gossip
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "SwimMembership.hpp"
+
+#include "CClock.hpp"
+#include "CConnectionManager.hpp"
+#include "CEventLog.hpp"
+#include "CGlobalPeerList.hpp"
+#include "CLogger.hpp"
+#include "CMetricsRegistry.hpp"
+#include "remotehost.hpp"
+#include "device/PhysicalDeviceTypes.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <sstream>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#define foreach         BOOST_FOREACH
+
+using boost::property_tree::ptree;
+
+namespace freedm {
+
+namespace broker {
+
+namespace gm {
+
+namespace {
+
+/// This file's logger.
+CLocalLogger Logger(__FILE__);
+
+/// Times this node has moved to a different group.
+CMetricsRegistry::Counter & GroupChanges =
+        CMetricsRegistry::instance().GetCounter("gm.group.changes");
+
+/// Members this node has suspected after no one heard from them.
+CMetricsRegistry::Counter & Suspicions =
+        CMetricsRegistry::instance().GetCounter("gm.swim.suspicions");
+
+/// Members this node has declared dead after their suspicion timed out.
+CMetricsRegistry::Counter & Deaths =
+        CMetricsRegistry::instance().GetCounter("gm.swim.deaths");
+
+/// Draws indices for std::random_shuffle from a generator.
+struct RandomIndex
+{
+    /// Draws from the given generator.
+    explicit RandomIndex(boost::random::mt19937 & g) : gen(g) { }
+    /// A random index below n.
+    std::ptrdiff_t operator()(std::ptrdiff_t n)
+    {
+        return boost::random::uniform_int_distribution<std::ptrdiff_t>(
+                0, n - 1)(gen);
+    }
+    /// The generator drawn from
+    boost::random::mt19937 & gen;
+};
+
+/// The name of a member state for the logs.
+const char * StateName(SwimMemberList::State state)
+{
+    switch(state)
+    {
+    case SwimMemberList::ALIVE:
+        return "Alive";
+    case SwimMemberList::SUSPECT:
+        return "Suspect";
+    default:
+        return "Dead";
+    }
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::SwimAgent
+/// @description Constructor for the SWIM group management module.
+/// @pre None
+/// @post Object initialized and ready to enter run state.
+/// @param p_uuid: This object's uuid.
+/// @param broker: The broker which schedules this module.
+/// @param devmanager: The device manager used to check the FIDs.
+///////////////////////////////////////////////////////////////////////////////
+SwimAgent::SwimAgent(std::string p_uuid, CBroker &broker,
+        device::CPhysicalDeviceManager::Pointer devmanager)
+    : IPeerNode(p_uuid,broker.GetConnectionManager()),
+    m_members(p_uuid),
+    m_probeSeq(0),
+    m_probeAcked(true),
+    m_seq(0),
+    m_random(boost::hash<std::string>()(p_uuid)),
+    m_GroupID(0),
+    m_peerListVersion(0),
+    PING_TIMEOUT(boost::posix_time::seconds(2)),
+    SUSPECT_TIMEOUT(boost::posix_time::seconds(8)),
+    m_broker(broker),
+    m_phyDevManager(devmanager),
+    m_fidsclosed(true)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    CGlobalPeerList::instance().Create(GetUUID(),GetConnectionManager());
+    m_timer = broker.AllocateTimer("gm");
+
+    PrehandleFunctor f = boost::bind(&SwimAgent::Prehandler, this, _1, _2, _3);
+    RegisterSubhandle("gm.Ping",
+        PrehandlerHelper(f,boost::bind(&SwimAgent::HandlePing, this, _1, _2)));
+    RegisterSubhandle("gm.PingRequest",
+        PrehandlerHelper(f,boost::bind(&SwimAgent::HandlePingRequest, this, _1, _2)));
+    RegisterSubhandle("gm.Ack",
+        PrehandlerHelper(f,boost::bind(&SwimAgent::HandleAck, this, _1, _2)));
+    RegisterSubhandle("any.PeerList",
+        PrehandlerHelper(f,boost::bind(&SwimAgent::HandlePeerList, this, _1, _2)));
+    RegisterSubhandle("gm.PeerListQuery",
+        PrehandlerHelper(f,boost::bind(&SwimAgent::HandlePeerListQuery, this, _1, _2)));
+    RegisterSubhandle("any",
+        PrehandlerHelper(f,boost::bind(&SwimAgent::HandleAny, this, _1, _2)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::Run
+/// @description Adds the configured peers and starts probing them.
+/// @pre connections to peers should be instantiated
+/// @post This node leads a group of itself and the first probe is sent.
+///////////////////////////////////////////////////////////////////////////////
+int SwimAgent::Run()
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    std::map<std::string, remotehost>::iterator it;
+    for(it = GetConnectionManager().GetHostnamesBegin();
+        it != GetConnectionManager().GetHostnamesEnd(); ++it)
+    {
+        Logger.Notice<<"Registering Peer"<<it->first<<std::endl;
+        CGlobalPeerList::instance().Create(it->first,GetConnectionManager());
+    }
+    Logger.Notice<<"Starting SWIM probes of "
+        <<CGlobalPeerList::instance().PeerList().size()-1<<" peers"<<std::endl;
+    UpdateGroup();
+    Probe(boost::system::error_code());
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::Ping
+/// @description Creates a ping, which the recipient acks to the sender.
+/// @param seq The sequence number the ack should carry.
+/// @return A CMessage with the contents of a ping.
+///////////////////////////////////////////////////////////////////////////////
+CMessage SwimAgent::Ping(unsigned int seq)
+{
+    CMessage m_;
+    m_.SetHandler("gm.Ping");
+    m_.m_submessages.put("gm.source", GetUUID());
+    m_.m_submessages.put("gm.seq", seq);
+    m_.SetExpireTimeFromNow(PING_TIMEOUT);
+    return m_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::PingRequest
+/// @description Creates a request for another member to ping a member which
+///     did not answer this node, and to relay the ack.
+/// @param seq The sequence number the relayed ack should carry.
+/// @param target The member to ping.
+/// @return A CMessage with the contents of a ping request.
+///////////////////////////////////////////////////////////////////////////////
+CMessage SwimAgent::PingRequest(unsigned int seq, std::string target)
+{
+    CMessage m_;
+    m_.SetHandler("gm.PingRequest");
+    m_.m_submessages.put("gm.source", GetUUID());
+    m_.m_submessages.put("gm.seq", seq);
+    m_.m_submessages.put("gm.target", target);
+    m_.SetExpireTimeFromNow(PING_TIMEOUT);
+    return m_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::Ack
+/// @description Creates an acknowledgement that a node answered a ping.
+/// @param seq The sequence number of the ping.
+/// @param target The node which answered.
+/// @return A CMessage with the contents of an ack.
+///////////////////////////////////////////////////////////////////////////////
+CMessage SwimAgent::Ack(unsigned int seq, std::string target)
+{
+    CMessage m_;
+    m_.SetHandler("gm.Ack");
+    m_.m_submessages.put("gm.source", GetUUID());
+    m_.m_submessages.put("gm.seq", seq);
+    m_.m_submessages.put("gm.target", target);
+    m_.SetExpireTimeFromNow(PING_TIMEOUT);
+    return m_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::PeerList
+/// @description Packs the announced membership in the same CMessage that
+///     GMAgent sends, so GMAgent::ProcessPeerList reads it.
+/// @pre This node is the leader.
+/// @post No Change.
+/// @param requester The module the list is addressed to.
+/// @return A CMessage with the contents of group membership
+///////////////////////////////////////////////////////////////////////////////
+CMessage SwimAgent::PeerList(std::string requester)
+{
+    CMessage m_;
+    m_.m_submessages.put("any.source", GetUUID());
+    m_.m_submessages.put("any.coordinator", m_leader);
+    m_.m_submessages.put("any.groupid", m_GroupID);
+    m_.m_submessages.put("any.version", m_peerListVersion);
+    m_.SetHandler(requester+".PeerList");
+    foreach(const std::string & uuid, m_pushedPeers)
+    {
+        PeerNodePtr peer = CGlobalPeerList::instance().GetPeer(uuid);
+        ptree sub_pt;
+        sub_pt.add("uuid",peer->GetUUID());
+        sub_pt.add("host",peer->GetHostname());
+        sub_pt.add("port",peer->GetPort());
+        m_.m_submessages.add_child("any.peers.peer",sub_pt);
+    }
+    m_.SetNeverExpires();
+    return m_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::AddGossip
+/// @description Piggybacks this node's incarnation and queued membership
+///     changes on an outgoing message. A recipient which this node believes
+///     suspected or dead is always told so first, so it can refute it.
+/// @param msg The message to add to.
+/// @param recipient The node the message is for.
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::AddGossip(CMessage & msg, const std::string & recipient)
+{
+    std::vector<SwimMemberList::Update> updates;
+    if(m_members.IsKnown(recipient)
+        && m_members.Get(recipient).state != SwimMemberList::ALIVE)
+    {
+        updates.push_back(m_members.Get(recipient));
+    }
+    std::vector<SwimMemberList::Update> gossip = m_members.Gossip(MAX_GOSSIP);
+    updates.insert(updates.end(), gossip.begin(), gossip.end());
+
+    msg.m_submessages.put("gm.incarnation", m_members.GetIncarnation());
+    foreach(const SwimMemberList::Update & u, updates)
+    {
+        ptree sub_pt;
+        sub_pt.add("uuid",u.uuid);
+        sub_pt.add("state",static_cast<int>(u.state));
+        sub_pt.add("incarnation",u.incarnation);
+        if(CGlobalPeerList::instance().Count(u.uuid) > 0)
+        {
+            PeerNodePtr peer = CGlobalPeerList::instance().GetPeer(u.uuid);
+            sub_pt.add("host",peer->GetHostname());
+            sub_pt.add("port",peer->GetPort());
+        }
+        msg.m_submessages.add_child("gm.updates.update",sub_pt);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::ReadGossip
+/// @description Applies the news on an incoming message: that its sender is
+///     alive, and the membership changes it carries.
+/// @param msg The incoming message.
+/// @param peer The peer who sent it.
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::ReadGossip(const CMessage & msg, PeerNodePtr peer)
+{
+    boost::posix_time::ptime now = CClock::instance().GetMonotonicTime();
+    const ptree & pt = msg.m_submessages;
+    bool changed = m_members.Apply(SwimMemberList::Update(peer->GetUUID(),
+            SwimMemberList::ALIVE, pt.get<unsigned int>("gm.incarnation",0)),
+            now);
+    if(pt.get_child_optional("gm.updates"))
+    {
+        foreach(const ptree::value_type & v, pt.get_child("gm.updates"))
+        {
+            SwimMemberList::Update u(v.second.get<std::string>("uuid"),
+                static_cast<SwimMemberList::State>(v.second.get<int>("state")),
+                v.second.get<unsigned int>("incarnation"));
+            if(!FindPeer(u.uuid, v.second.get<std::string>("host",""),
+                    v.second.get<std::string>("port","")))
+            {
+                continue;
+            }
+            if(m_members.Apply(u, now))
+            {
+                Logger.Info<<"Learned "<<u.uuid<<" is "<<StateName(u.state)
+                    <<" (incarnation "<<u.incarnation<<")"<<std::endl;
+                changed = true;
+            }
+        }
+    }
+    if(changed)
+    {
+        UpdateGroup();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::FindPeer
+/// @description Finds the peer for a uuid. A peer this node has not heard of
+///     is added to the connection manager from the host and port gossiped
+///     with it, as GMAgent::ReadPeers does.
+/// @param uuid The peer's uuid.
+/// @param host The peer's hostname, or empty if not known.
+/// @param port The peer's port, or empty if not known.
+/// @return The peer, or a null pointer if it could not be found or created.
+///////////////////////////////////////////////////////////////////////////////
+SwimAgent::PeerNodePtr SwimAgent::FindPeer(const std::string & uuid,
+        const std::string & host, const std::string & port)
+{
+    if(CGlobalPeerList::instance().Count(uuid) > 0)
+    {
+        return CGlobalPeerList::instance().GetPeer(uuid);
+    }
+    if(host.empty() || port.empty())
+    {
+        return PeerNodePtr();
+    }
+    Logger.Notice<<"Learned of new peer "<<uuid<<" ("<<host<<":"<<port<<")"
+        <<std::endl;
+    GetConnectionManager().PutHostname(uuid, host, port);
+    return CGlobalPeerList::instance().Create(uuid,GetConnectionManager());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::UpdateGroup
+/// @description Follows the leader of the current membership. A node which
+///     becomes the leader starts a new group, and the leader announces the
+///     full membership to the members and to the other modules of this node
+///     each time it changes.
+/// @pre None
+/// @post If this node leads, the members hold its current membership.
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::UpdateGroup()
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    std::vector<std::string> members = m_members.GetMembers();
+    std::string leader = m_members.GetLeader();
+    if(leader != m_leader)
+    {
+        m_leader = leader;
+        GroupChanges.fetch_add(1, boost::memory_order_relaxed);
+        if(leader == GetUUID())
+        {
+            m_GroupID = m_random();
+            m_peerListVersion = 0;
+            m_pushedPeers.clear();
+            CEventLog::instance().Write(CEventLog::GM,
+                    CEventLog::GM_GROUP_CHANGED, m_GroupID,
+                    CEventLog::Hash(m_leader));
+        }
+        Logger.Notice<<"Changed group: "<<m_leader<<" leads"<<std::endl;
+    }
+    if(leader != GetUUID() || members == m_pushedPeers)
+    {
+        return;
+    }
+    m_pushedPeers = members;
+    m_peerListVersion++;
+    CMessage m_ = PeerList();
+    Logger.Info<<"SEND: Peer list version "<<m_peerListVersion<<" of "
+        <<members.size()<<" members"<<std::endl;
+    foreach(const std::string & uuid, members)
+    {
+        if(uuid != GetUUID())
+        {
+            SendToPeer(CGlobalPeerList::instance().GetPeer(uuid),m_);
+        }
+    }
+    CGlobalPeerList::instance().GetPeer(GetUUID())->Send(m_);
+    SystemState();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::Probe
+/// @description Starts a protocol period: declares dead the members whose
+///     suspicion has timed out and pings the next peer in a shuffled round
+///     robin of every known peer. Peers which are not members are pinged
+///     too, so that nodes which start late or recover are found.
+/// @pre None
+/// @post A ping is sent and ProbeIndirect is scheduled.
+/// @param err The reason this was called, non-zero if the timer was
+///     cancelled.
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::Probe(const boost::system::error_code& err)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    if(!err)
+    {
+        FIDCheck();
+        std::vector<std::string> dead = m_members.Expire(
+                CClock::instance().GetMonotonicTime(), SUSPECT_TIMEOUT);
+        foreach(const std::string & uuid, dead)
+        {
+            Logger.Notice<<"Declaring "<<uuid<<" dead"<<std::endl;
+            Deaths.fetch_add(1, boost::memory_order_relaxed);
+        }
+        if(!dead.empty())
+        {
+            UpdateGroup();
+        }
+        if(m_probeOrder.empty())
+        {
+            foreach(CGlobalPeerList::PeerSet::value_type & p,
+                    CGlobalPeerList::instance().PeerList())
+            {
+                if(p.first != GetUUID())
+                    m_probeOrder.push_back(p.first);
+            }
+            RandomIndex index(m_random);
+            std::random_shuffle(m_probeOrder.begin(), m_probeOrder.end(), index);
+        }
+        m_timerMutex.lock();
+        if(m_probeOrder.empty())
+        {
+            m_broker.Schedule(m_timer, PING_TIMEOUT + PING_TIMEOUT,
+                boost::bind(&SwimAgent::Probe, this, boost::asio::placeholders::error));
+            m_timerMutex.unlock();
+            return;
+        }
+        m_probeTarget = m_probeOrder.back();
+        m_probeOrder.pop_back();
+        m_probeSeq = ++m_seq;
+        m_probeAcked = false;
+        CMessage m_ = Ping(m_probeSeq);
+        AddGossip(m_, m_probeTarget);
+        SendToPeer(CGlobalPeerList::instance().GetPeer(m_probeTarget),m_);
+        m_broker.Schedule(m_timer, PING_TIMEOUT,
+            boost::bind(&SwimAgent::ProbeIndirect, this, boost::asio::placeholders::error));
+        m_timerMutex.unlock();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::ProbeIndirect
+/// @description Asks a few random members to ping a member which did not
+///     answer, so a lossy link between two nodes is not taken for a failure.
+/// @pre Probe pinged m_probeTarget.
+/// @post Ping requests are sent if needed and ProbeEnd is scheduled.
+/// @param err The reason this was called, non-zero if the timer was
+///     cancelled.
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::ProbeIndirect(const boost::system::error_code& err)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    if(!err)
+    {
+        if(!m_probeAcked && m_members.IsMember(m_probeTarget))
+        {
+            std::vector<std::string> helpers;
+            foreach(const std::string & uuid, m_members.GetMembers())
+            {
+                if(uuid != GetUUID() && uuid != m_probeTarget)
+                    helpers.push_back(uuid);
+            }
+            RandomIndex index(m_random);
+            std::random_shuffle(helpers.begin(), helpers.end(), index);
+            helpers.resize(std::min<std::size_t>(helpers.size(), INDIRECT_PROBES));
+            Logger.Info<<"No ack from "<<m_probeTarget<<", asking "
+                <<helpers.size()<<" members to ping it"<<std::endl;
+            foreach(const std::string & uuid, helpers)
+            {
+                CMessage m_ = PingRequest(m_probeSeq, m_probeTarget);
+                AddGossip(m_, uuid);
+                SendToPeer(CGlobalPeerList::instance().GetPeer(uuid),m_);
+            }
+        }
+        m_timerMutex.lock();
+        m_broker.Schedule(m_timer, PING_TIMEOUT,
+            boost::bind(&SwimAgent::ProbeEnd, this, boost::asio::placeholders::error));
+        m_timerMutex.unlock();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::ProbeEnd
+/// @description Ends a protocol period. A member which answered neither the
+///     ping nor the ping requests is suspected, then the next period starts.
+/// @pre ProbeIndirect ran for the current probe.
+/// @post The next protocol period has started.
+/// @param err The reason this was called, non-zero if the timer was
+///     cancelled.
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::ProbeEnd(const boost::system::error_code& err)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    if(!err)
+    {
+        if(!m_probeAcked && m_members.IsMember(m_probeTarget))
+        {
+            SwimMemberList::Update u = m_members.Get(m_probeTarget);
+            if(u.state == SwimMemberList::ALIVE)
+            {
+                u.state = SwimMemberList::SUSPECT;
+                m_members.Apply(u, CClock::instance().GetMonotonicTime());
+                Logger.Notice<<"Suspecting "<<m_probeTarget<<std::endl;
+                Suspicions.fetch_add(1, boost::memory_order_relaxed);
+                SystemState();
+            }
+        }
+        Probe(err);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::Prehandler
+/// @description Drops every message while all the FIDs are open.
+/// @param f the handler that will be applied after the prehandler
+/// @param msg The message being send
+/// @param peer The peer who sent the message
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::Prehandler(SubhandleFunctor f, CMessage msg, PeerNodePtr peer)
+{
+    if(m_fidsclosed == false)
+    {
+        Logger.Debug<<"Dropping message, all FIDs open"<<std::endl;
+        return;
+    }
+    f(msg,peer);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::HandlePing
+/// @description Acks a ping with the sequence number it carried.
+/// @key gm.Ping
+/// @pre None
+/// @post An ack is sent to the peer.
+/// @peers Any node in SWIM mode.
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::HandlePing(CMessage msg, PeerNodePtr peer)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    ReadGossip(msg, peer);
+    CMessage m_ = Ack(msg.m_submessages.get<unsigned int>("gm.seq"), GetUUID());
+    AddGossip(m_, peer->GetUUID());
+    SendToPeer(peer,m_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::HandlePingRequest
+/// @description Pings a member on behalf of the peer, remembering to relay
+///     the ack.
+/// @key gm.PingRequest
+/// @pre None
+/// @post A ping is sent to the target.
+/// @peers Members whose own ping of the target went unanswered.
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::HandlePingRequest(CMessage msg, PeerNodePtr peer)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    ReadGossip(msg, peer);
+    std::string target = msg.m_submessages.get<std::string>("gm.target");
+    if(CGlobalPeerList::instance().Count(target) == 0)
+    {
+        Logger.Info<<"Asked to ping unknown peer "<<target<<std::endl;
+        return;
+    }
+    // Relays are answered within a period, so only the newest are kept
+    while(m_relays.size() >= 4 * INDIRECT_PROBES)
+    {
+        m_relays.erase(m_relays.begin());
+    }
+    m_relays[++m_seq] = std::make_pair(peer->GetUUID(),
+            msg.m_submessages.get<unsigned int>("gm.seq"));
+    CMessage m_ = Ping(m_seq);
+    AddGossip(m_, target);
+    SendToPeer(CGlobalPeerList::instance().GetPeer(target),m_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::HandleAck
+/// @description Completes the current probe, or relays the ack to the
+///     member which asked for the ping.
+/// @key gm.Ack
+/// @pre None
+/// @post The probe is answered, or the ack relayed.
+/// @peers Pinged nodes, and members relaying their acks.
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::HandleAck(CMessage msg, PeerNodePtr peer)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    ReadGossip(msg, peer);
+    unsigned int seq = msg.m_submessages.get<unsigned int>("gm.seq");
+    std::string target = msg.m_submessages.get<std::string>("gm.target");
+    if(seq == m_probeSeq && target == m_probeTarget)
+    {
+        m_probeAcked = true;
+        return;
+    }
+    std::map<unsigned int, std::pair<std::string, unsigned int> >::iterator it;
+    it = m_relays.find(seq);
+    if(it != m_relays.end() && CGlobalPeerList::instance().Count(it->second.first) > 0)
+    {
+        CMessage m_ = Ack(it->second.second, target);
+        AddGossip(m_, it->second.first);
+        SendToPeer(CGlobalPeerList::instance().GetPeer(it->second.first),m_);
+        m_relays.erase(it);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::HandlePeerList
+/// @description Notes the group of the leader's peer lists; the lists
+///     themselves are for the other modules.
+/// @key any.PeerList
+/// @pre None
+/// @post The group id of a follower is that of its leader.
+/// @peers The leader, and this node.
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::HandlePeerList(CMessage msg, PeerNodePtr peer)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    unsigned int group = msg.m_submessages.get<unsigned int>("any.groupid",0);
+    if(peer->GetUUID() != GetUUID() && peer->GetUUID() == m_leader
+        && group != m_GroupID)
+    {
+        m_GroupID = group;
+        CEventLog::instance().Write(CEventLog::GM, CEventLog::GM_GROUP_CHANGED,
+                m_GroupID, CEventLog::Hash(m_leader));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::HandlePeerListQuery
+/// @description Sends the announced membership to a module which asked.
+/// @key gm.PeerListQuery
+/// @pre None
+/// @post The leader replies with its peer list.
+/// @peers Modules of the group's members.
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::HandlePeerListQuery(CMessage msg, PeerNodePtr peer)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    if(m_leader != GetUUID())
+    {
+        Logger.Debug<<"Not the leader, ignoring peer list query"<<std::endl;
+        return;
+    }
+    peer->Send(PeerList(msg.m_submessages.get<std::string>("gm.requester")));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::HandleAny
+/// @description Drops group management messages of the invitation election,
+///     which a node in SWIM mode cannot take part in.
+/// @key any
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::HandleAny(CMessage msg, PeerNodePtr peer)
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    if(msg.GetHandler().find("gm") == 0)
+    {
+        Logger.Warn<<"Dropping "<<msg.GetHandler()<<" from "<<peer->GetUUID()
+            <<"; is it running the same group management mode?"<<std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::SendToPeer
+/// @description Wrapper for peer->Send that checks to see if the FIDs are
+///     closed before sending
+/// @param peer the peer to send to
+/// @param msg the message to send
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::SendToPeer(PeerNodePtr peer, CMessage msg)
+{
+    if(m_fidsclosed == true)
+    {
+        peer->Send(msg);
+    }
+    else
+    {
+        Logger.Debug << "Message not send (FIDs open)"<<std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::FIDCheck
+/// @description Checks the open and close status of all FIDs attached to this
+///     node once a protocol period. While all of them are open this node
+///     neither sends nor answers, so the others declare it dead and it ends
+///     up leading a group of itself.
+/// @pre None
+/// @post m_fidsclosed is false if every attached FID is open.
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::FIDCheck()
+{
+    int attachedFIDs = m_phyDevManager->GetDevicesOfType<device::CDeviceFid>().size();
+    unsigned int FIDState = m_phyDevManager->CountActiveFids();
+    if(m_fidsclosed == true && attachedFIDs > 0 && FIDState == 0)
+    {
+        Logger.Status<<"All FIDs offline. Isolating this node"<<std::endl;
+        m_fidsclosed = false;
+    }
+    else if(m_fidsclosed == false && attachedFIDs > 0 && FIDState > 0)
+    {
+        Logger.Status<<"All FIDs Online. Checking for Peers"<<std::endl;
+        m_fidsclosed = true;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// SwimAgent::SystemState
+/// @description Puts the system state to the logger.
+/// @pre None
+/// @post None
+///////////////////////////////////////////////////////////////////////////////
+void SwimAgent::SystemState()
+{
+    std::stringstream nodestatus;
+    nodestatus<<"- SYSTEM STATE"<<std::endl
+              <<"Me: "<<GetUUID()<<", Group: "<<m_GroupID<<" Leader:"<<m_leader
+              <<" Incarnation: "<<m_members.GetIncarnation()<<std::endl
+              <<"SYSTEM NODES"<<std::endl;
+    foreach(CGlobalPeerList::PeerSet::value_type & p,
+            CGlobalPeerList::instance().PeerList())
+    {
+        nodestatus<<"Node: "<<p.first<<" State: ";
+        if(!m_members.IsKnown(p.first))
+        {
+            nodestatus<<"Unknown"<<std::endl;
+            continue;
+        }
+        SwimMemberList::Update u = m_members.Get(p.first);
+        nodestatus<<StateName(u.state)<<" ("<<u.incarnation;
+        if(p.first == GetUUID())
+            nodestatus<<", Me";
+        if(p.first == m_leader)
+            nodestatus<<", Coordinator";
+        nodestatus<<")"<<std::endl;
+    }
+    nodestatus<<"FID state: "<< m_phyDevManager->CountActiveFids();
+    Logger.Status<<nodestatus.str()<<std::endl;
+}
+
+} // namespace gm
+
+} // namespace broker
+
+} // namespace freedm
@@ -0,0 +1,192 @@
+//////////////////////////////////////////////////////////
+/// @file         SwimMembership.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  Group management by SWIM style probing and gossip
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef SWIMMEMBERSHIP_HPP_
+#define SWIMMEMBERSHIP_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "CBroker.hpp"
+#include "CMessage.hpp"
+#include "IAgent.hpp"
+#include "IHandler.hpp"
+#include "IPeerNode.hpp"
+#include "SwimMemberList.hpp"
+#include "device/CPhysicalDeviceManager.hpp"
+
+namespace freedm {
+
+namespace broker {
+
+namespace gm {
+
+/// Group management by SWIM style randomized probing and gossip.
+class SwimAgent
+  : public IReadHandler, public IPeerNode,
+    public IAgent< boost::shared_ptr<IPeerNode> >
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description An alternative to the invitation election of GMAgent,
+    ///     after Das, Gupta and Motivala. Each protocol period a node pings
+    ///     one peer, taken in a shuffled round robin of every peer it knows.
+    ///     A member which does not answer is pinged through a few others,
+    ///     and if none of them hears from it either it is suspected; a
+    ///     suspicion which is not refuted in time becomes a death. Changes
+    ///     to the membership ride on the pings and acks, so each node sends
+    ///     the same few messages a period whatever the size of the group,
+    ///     and a failed member is detected within two rounds of the peers
+    ///     plus the suspicion timeout. The member with the greatest uuid
+    ///     leads, and sends the full membership as the same any.PeerList
+    ///     that GMAgent sends, so the other modules work unchanged.
+    ///
+    /// @limitations Nodes in this mode do not talk to GMAgent nodes, and the
+    ///     group's clocks are not synchronized.
+    ///////////////////////////////////////////////////////////////////////////
+  public:
+    /// Constructor for using this object as a module.
+    SwimAgent(std::string uuid_, CBroker &broker,
+            device::CPhysicalDeviceManager::Pointer devmanager);
+
+    /// Called to start the system
+    int Run();
+
+    // Handlers
+    /// A set of common code to be run before every message
+    void Prehandler(SubhandleFunctor f, CMessage msg, PeerNodePtr peer);
+    /// Handles direct pings
+    void HandlePing(CMessage msg, PeerNodePtr peer);
+    /// Handles requests to ping a node on another's behalf
+    void HandlePingRequest(CMessage msg, PeerNodePtr peer);
+    /// Handles acknowledgements of pings
+    void HandleAck(CMessage msg, PeerNodePtr peer);
+    /// Handles this node's own peer lists
+    void HandlePeerList(CMessage msg, PeerNodePtr peer);
+    /// Handles recieving peerlist requests
+    void HandlePeerListQuery(CMessage msg, PeerNodePtr peer);
+    /// Handles any other message
+    void HandleAny(CMessage msg, PeerNodePtr peer);
+
+    // Routines
+    /// Starts a protocol period by pinging the next peer
+    void Probe(const boost::system::error_code& err);
+    /// Asks other members to ping a peer which did not answer
+    void ProbeIndirect(const boost::system::error_code& err);
+    /// Suspects a member which no one heard from
+    void ProbeEnd(const boost::system::error_code& err);
+
+    // Messages
+    /// Creates a ping
+    CMessage Ping(unsigned int seq);
+    /// Creates a request for another member to ping the target
+    CMessage PingRequest(unsigned int seq, std::string target);
+    /// Creates an acknowledgement that the target answered a ping
+    CMessage Ack(unsigned int seq, std::string target);
+    /// Generates a peer list
+    CMessage PeerList(std::string requester="any");
+  private:
+    /// Adds the news this node has to gossip to an outgoing message
+    void AddGossip(CMessage & msg, const std::string & recipient);
+    /// Applies the news on an incoming message
+    void ReadGossip(const CMessage & msg, PeerNodePtr peer);
+    /// Finds the peer for a uuid, creating it from a host and port if needed
+    PeerNodePtr FindPeer(const std::string & uuid, const std::string & host,
+            const std::string & port);
+    /// Announces the membership if this node leads and it has changed
+    void UpdateGroup();
+    /// Sends a message unless every attached FID is open
+    void SendToPeer(PeerNodePtr peer, CMessage msg);
+    /// Checks whether every attached FID is open
+    void FIDCheck();
+    /// Outputs information about the current state to the logger
+    void SystemState();
+
+    /// What this node believes about every node.
+    SwimMemberList m_members;
+    /// The peers left to ping this round, in the order to ping them.
+    std::vector<std::string> m_probeOrder;
+    /// The peer being probed this period.
+    std::string m_probeTarget;
+    /// The sequence number of the current probe.
+    unsigned int m_probeSeq;
+    /// True once the current probe has been answered.
+    bool m_probeAcked;
+    /// The last sequence number used.
+    unsigned int m_seq;
+    /// The pings sent for others, by sequence number: requester and its own
+    /// sequence number.
+    std::map<unsigned int, std::pair<std::string, unsigned int> > m_relays;
+    /// Picks the probe order and the members asked to probe indirectly.
+    boost::random::mt19937 m_random;
+
+    /// The leader of the group this node is in.
+    std::string m_leader;
+    /// The ID number of the group this node leads
+    unsigned int m_GroupID;
+    /// The membership this node last announced as leader
+    std::vector<std::string> m_pushedPeers;
+    /// The version of the membership this node last announced
+    unsigned int m_peerListVersion;
+
+    /// A mutex to make the timers threadsafe
+    boost::interprocess::interprocess_mutex m_timerMutex;
+    /// A timer for stepping through the protocol period
+    CBroker::TimerHandle m_timer;
+
+    /// How long to wait for an ack before probing indirectly
+    boost::posix_time::time_duration PING_TIMEOUT;
+    /// How long a member may be suspected before it is declared dead
+    boost::posix_time::time_duration SUSPECT_TIMEOUT;
+    /// How many members are asked to probe an unanswering member
+    static const unsigned int INDIRECT_PROBES = 3;
+    /// How many membership changes ride on each message
+    static const unsigned int MAX_GOSSIP = 6;
+
+    ///The broker!
+    CBroker& m_broker;
+    ///The device manager!
+    device::CPhysicalDeviceManager::Pointer m_phyDevManager;
+    /// A store for if all the fids are closed
+    bool m_fidsclosed;
+};
+
+} // namespace gm
+
+} // namespace broker
+
+} // namespace freedm
+
+#endif
@@ -81,6 +81,7 @@
 #include <boost/property_tree/ptree.hpp>
 using boost::property_tree::ptree;
 
+#include "CEventLog.hpp"
 #include "CLogger.hpp"
 #include "device/DeviceMath.hpp"
 
@@ -118,7 +119,7 @@ LBAgent::LBAgent(std::string uuid_,
     m_broker(broker)
 {
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    PeerNodePtr self_(this);
+    PeerNodePtr self_(new IPeerNode(GetUUID(), GetConnectionManager()));
     InsertInPeerSet(m_AllPeers, self_);
     m_Leader = GetUUID();
     m_Normal = 0;
@@ -470,6 +471,16 @@ void LBAgent::LoadTable()
     {
         m_Status = LBAgent::NORM;
     }
+    // LoadManage rebuilds the table continuously; only record changes
+    double loadEvent[] = { m_Status, m_Gen, m_Storage, m_Load, m_Gateway,
+            m_Normal };
+    if(m_loadEvent.size() != CEventLog::MAX_ARGS
+        || !std::equal(m_loadEvent.begin(), m_loadEvent.end(), loadEvent))
+    {
+        CEventLog::instance().WriteArray(CEventLog::LB,
+                CEventLog::LB_LOAD_TABLE, CEventLog::MAX_ARGS, loadEvent);
+        m_loadEvent.assign(loadEvent, loadEvent + CEventLog::MAX_ARGS);
+    }
 
     //Update info about this node in the load table based on above computation
     foreach( PeerNodePtr self_, m_AllPeers | boost::adaptors::map_values)
@@ -593,7 +604,6 @@ void LBAgent::HandlePeerList(CMessage msg, PeerNodePtr peer)
     // identify your new group members
     // --------------------------------------------------------------
     Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
-    PeerSet temp;
     Logger.Notice << "\nPeer List received from Group Leader: " << peer->GetUUID() <<std::endl;
     m_Leader = peer->GetUUID();
 
@@ -603,28 +613,30 @@ void LBAgent::HandlePeerList(CMessage msg, PeerNodePtr peer)
         //CollectState();
     }
 
-    //Update the PeerNode lists accordingly
-    //TODO:Not sure if similar loop is needed to erase each peerset 
-    //individually. peerset.clear() doesn`t work for obvious reasons
-    foreach( PeerNodePtr p_, m_AllPeers | boost::adaptors::map_values)
+    //Update the PeerNode lists with the changes to the group
+    PeerSet added, removed;
+    if(!gm::GMAgent::ProcessPeerList(msg,GetConnectionManager(),
+        m_peerListApplied,m_AllPeers,added,removed))
+    {
+        peer->Send(gm::GMAgent::PeerListQuery("any"));
+        return;
+    }
+    foreach( PeerNodePtr p_, removed | boost::adaptors::map_values)
     {
         if( p_->GetUUID() == GetUUID())
         {
+            InsertInPeerSet(m_AllPeers,p_);
             continue;
-        }          
-        EraseInPeerSet(m_AllPeers,p_);
-        //Assuming that any node in m_AllPeers exists in one of the following
+        }
         EraseInPeerSet(m_HiNodes,p_);
         EraseInPeerSet(m_LoNodes,p_);
         EraseInPeerSet(m_NoNodes,p_);
     }
-    temp = gm::GMAgent::ProcessPeerList(msg,GetConnectionManager());
-    foreach( PeerNodePtr p_, temp | boost::adaptors::map_values )
+    foreach( PeerNodePtr p_, added | boost::adaptors::map_values )
     {
-        PeerNodePtr p = GetPeer(p_->GetUUID());
-        if(CountInPeerSet(m_AllPeers,p_) == 0)
+        if( p_->GetUUID() != GetUUID())
         {
-            AddPeer(p_);
+            InsertInPeerSet(m_NoNodes,p_);
         }
     }
 }
@@ -825,6 +837,9 @@ void LBAgent::HandleDrafting(CMessage msg, PeerNodePtr peer)
                 Logger.Info << "Couldn't Send Message To Peer" << std::endl;
             }
 
+            CEventLog::instance().Write(CEventLog::LB,
+                    CEventLog::LB_MIGRATION, CEventLog::Hash(peer->GetUUID()),
+                    m_DemandVal, false);
             // Make necessary power setting accordingly to allow power migration
             // !!!NOTE: You may use Step_PStar() or PStar(m_DemandVal) currently
             if (m_sstExists)
@@ -861,6 +876,8 @@ void LBAgent::HandleAccept(CMessage msg, PeerNodePtr peer)
     {
         // Make necessary power setting accordingly to allow power migration
         Logger.Warn<<"Migrating power on request from: "<< peer->GetUUID() << std::endl;
+        CEventLog::instance().Write(CEventLog::LB, CEventLog::LB_MIGRATION,
+                CEventLog::Hash(peer->GetUUID()), DemValue, true);
 	// !!!NOTE: You may use Step_PStar() or PStar(DemandValue) currently
         if (m_sstExists)
            Step_PStar();
@@ -61,6 +61,7 @@ using boost::property_tree::ptree;
 #include <boost/shared_ptr.hpp>
 
 #include "CMessage.hpp"
+#include "gm/GroupManagement.hpp"
 #include "IPeerNode.hpp"
 #include "IAgent.hpp"
 #include "CUuid.hpp"
@@ -177,6 +178,8 @@ class LBAgent
         EStatus   m_Status;
         /// Previous demand state of this node before state change
         EStatus   m_prevStatus;  
+        /// The arguments of the last load table event that was recorded
+        std::vector<double> m_loadEvent;
    
         // Peer lists
         /// Set of known peers in Demand State
@@ -187,6 +190,8 @@ class LBAgent
         PeerSet     m_LoNodes;
         /// Set of all the known peers 
         PeerSet     m_AllPeers;
+        /// The last membership announcement applied to m_AllPeers
+        gm::GMAgent::PeerListVersion m_peerListApplied;
 
         // Instance of physical device manager
         device::CPhysicalDeviceManager::Pointer 
@@ -89,6 +89,7 @@
 #include <boost/property_tree/ptree.hpp>
 using boost::property_tree::ptree;
 
+#include "CEventLog.hpp"
 #include "CLogger.hpp"
 #include "device/DeviceMath.hpp"
 
@@ -302,6 +303,7 @@ void SCAgent::StateResponse()
         //prepare collect states
         Logger.Info << "Sending requested state back to " << m_module << " module" << std::endl;
         m_.SetHandler(m_module+".CollectedState");
+        unsigned int states = 0, intransit = 0;
         
         for (it = collectstate.begin(); it != collectstate.end(); it++)
         {   
@@ -312,14 +314,18 @@ void SCAgent::StateResponse()
                     Logger.Status << (*it).first.first << "+++" << (*it).first.second << "    "                      
                                   << (*it).second.get<std::string>("sc.value") << std::endl;
                     m_.m_submessages.add("CollectedState.state.value", (*it).second.get<std::string>("sc.value"));
+                    states++;
                 }
                 else if ((*it).second.get<std::string>("sc.type")== "Message")
                 {
                     Logger.Status << (*it).second.get<std::string>("sc.transit.value") << std::endl;
                     m_.m_submessages.add("CollectedState.intransit.value", (*it).second.get<std::string>("sc.transit.value"));
+                    intransit++;
                 }
             }
         }//end for
+        CEventLog::instance().Write(CEventLog::SC, CEventLog::SC_COLLECTED,
+                states, intransit);
         
         //send collected states to the request module
         if (GetPeer(GetUUID()) != NULL)
@@ -383,6 +389,8 @@ void SCAgent::TakeSnapshot(std::string deviceType, std::string valueType)
     //Logger.Status << "&&&&&&&&&&&&&&&&&&&&&& call NetValue funciton &&&&&&&&&&&&&&" << std::endl;  
     PowerValue = m_phyDevManager->GetValue(deviceType, valueType, &device::SumValues);
     Logger.Status << "&&&&&&&&&&&&&&&         " << PowerValue << "       &&&&&&&&&&&&" << std::endl;
+    CEventLog::instance().Write(CEventLog::SC, CEventLog::SC_SNAPSHOT,
+            PowerValue);
     //save state 
     m_curstate.put("sc.type", valueType);
     m_curstate.put("sc.value", PowerValue);
@@ -628,7 +636,13 @@ void SCAgent::HandlePeerList(CMessage msg, PeerNodePtr peer)
     m_scleader = peer->GetUUID();
     Logger.Info << "Peer List received from Group Leader: " << peer->GetUUID() <<std::endl;
     // Process the peer list.
-    m_AllPeers = gm::GMAgent::ProcessPeerList(msg,GetConnectionManager());
+    PeerSet added, removed;
+    if(!gm::GMAgent::ProcessPeerList(msg,GetConnectionManager(),
+        m_peerListApplied,m_AllPeers,added,removed))
+    {
+        peer->Send(gm::GMAgent::PeerListQuery("any"));
+        return;
+    }
     
     //if only one node left
     if (m_AllPeers.size()==1)
@@ -48,6 +48,7 @@ using boost::property_tree::ptree;
 #include <boost/progress.hpp>
 
 #include "CMessage.hpp"
+#include "gm/GroupManagement.hpp"
 #include "IPeerNode.hpp"
 //#include "ExtensibleLineProtocol.hpp"
 #include "IAgent.hpp"
@@ -165,6 +166,8 @@ class SCAgent : public IReadHandler, public IPeerNode,
         device::CPhysicalDeviceManager::Pointer m_phyDevManager;
         ///all known peers
         PeerSet m_AllPeers;
+        ///last membership announcement applied to m_AllPeers
+        gm::GMAgent::PeerListVersion m_peerListApplied;
         
         ///Timeout Timer
         CBroker::TimerHandle m_TimeoutTimer;
@@ -0,0 +1,965 @@
+//////////////////////////////////////////////////////////
+/// @file         CSimGMAgent.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  A model of group management for the simulator
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CSimGMAgent.hpp"
+#include "CLogger.hpp"
+#include "CUuid.hpp"
+
+#include <sstream>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
+
+#define foreach BOOST_FOREACH
+
+namespace freedm {
+
+namespace broker {
+
+namespace sim {
+
+namespace {
+
+/// This file's logger.
+CLocalLogger Logger(__FILE__);
+
+/// The timeouts of GMAgent.
+const boost::posix_time::time_duration CHECK_TIMEOUT =
+        boost::posix_time::seconds(3);
+const boost::posix_time::time_duration TIMEOUT_TIMEOUT =
+        boost::posix_time::seconds(3);
+const boost::posix_time::time_duration GLOBAL_TIMEOUT =
+        boost::posix_time::seconds(1);
+const boost::posix_time::time_duration RESPONSE_TIMEOUT =
+        boost::posix_time::milliseconds(75);
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::CSimGMAgent
+/// @description Derives the UUID from a host name unique to the node, so the
+///     priorities are spread the way they are on a real deployment.
+/// @pre The agents vector will hold this agent at index id.
+/// @post The agent is idle until Start is called.
+/// @param id The index of this node.
+/// @param simulation The simulation this node runs in.
+/// @param network The network this node is attached to.
+/// @param agents Every node of the simulation.
+///////////////////////////////////////////////////////////////////////////////
+CSimGMAgent::CSimGMAgent(unsigned int id, CSimulation & simulation,
+        CSimNetwork & network, const std::vector<CSimGMAgent *> & agents)
+    : m_id(id),
+      m_simulation(simulation),
+      m_network(network),
+      m_agents(agents),
+      m_round(0, 0, 0),
+      m_phase(0, 0, 0),
+      m_status(NORMAL),
+      m_groupid(0),
+      m_counter(0),
+      m_leader(id),
+      m_aytoptional(false),
+      m_fastmerge(false),
+      m_checking(false),
+      m_scoped(false),
+      m_lower(0),
+      m_checktimeout(CHECK_TIMEOUT),
+      m_generation(0),
+      m_timerpending(false),
+      m_merges(0),
+      m_groupsformed(0),
+      m_groupsbroken(0),
+      m_groupsjoined(0)
+{
+    std::stringstream host, uuid;
+    host << "sim" << id;
+    uuid << CUuid::from_dns(host.str(), "1870");
+    m_uuid = uuid.str();
+    m_priority = boost::hash<std::string>()(m_uuid);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::SetPhase
+/// @description Models the broker's phases: tasks which become ready outside
+///     of the first length of a round wait for the next round.
+/// @pre length <= round
+/// @post Tasks only run during the group management phase.
+/// @param round The length of a round, or 0 to run every task immediately.
+/// @param length The length of the group management phase.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::SetPhase(boost::posix_time::time_duration round,
+        boost::posix_time::time_duration length)
+{
+    m_round = round;
+    m_phase = length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Start
+/// @description Queues Run for the group management phase, as the broker
+///     does with GMAgent::Run.
+/// @pre None
+/// @post The node will become the NORMAL leader of its own group.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Start()
+{
+    Post(boost::bind(&CSimGMAgent::Run, this));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::SetScope
+/// @description Restricts the coordinator checks to the given peers, as the
+///     zone agent of a hierarchy checks only its zone.
+/// @pre None
+/// @post Check only asks the peers in the set.
+/// @param peers The peers to check; this node may be among them.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::SetScope(const PeerSet & peers)
+{
+    m_scoped = true;
+    m_scope = peers;
+    m_scope.erase(m_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::SetLower
+/// @description Makes this agent the upper tier of a hierarchy. It takes
+///     part in elections while the zone agent of its node leads, and its
+///     checks ask one contact per other zone, starting with the first node
+///     of each zone. It checks half as often as the zones do, so that the
+///     zones have formed before their leaders look for each other.
+/// @pre lower runs on the same node; zones holds the zone of every node.
+/// @post The agent elects among zone leaders and tells lower the group.
+/// @param lower The zone agent of this node.
+/// @param zones The zone of each node, numbered from 0.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::SetLower(CSimGMAgent * lower,
+        const std::vector<unsigned int> & zones)
+{
+    m_lower = lower;
+    m_zoneof = zones;
+    m_checktimeout = CHECK_TIMEOUT * 2;
+    m_contacts.clear();
+    for(unsigned int i = 0; i < zones.size(); i++)
+    {
+        if(zones[i] >= m_contacts.size())
+        {
+            m_contacts.resize(zones[i] + 1, i);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::SetGroup
+/// @description Adopts the members of the hierarchy. A leading zone agent
+///     sends them to its zone when they change.
+/// @param group Every node of the zones under the top leader.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::SetGroup(const PeerSet & group)
+{
+    if(group == m_group)
+    {
+        return;
+    }
+    m_group = group;
+    if(m_status == NORMAL && IsCoordinator())
+    {
+        PushPeerList();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Run
+/// @description Draws the first group number and forms a group of one.
+/// @pre None
+/// @post The node is the NORMAL leader of its own group.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Run()
+{
+    Logger.Trace << __PRETTY_FUNCTION__ << std::endl;
+    m_counter = m_simulation.Random(1u << 30);
+    Recovery();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Post
+/// @description Queues a task as the broker would: it runs now if the
+///     group management phase is active and at the start of the next round
+///     otherwise.
+/// @param task The task to run.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Post(CSimulation::Event task)
+{
+    boost::posix_time::ptime when = m_simulation.GetTime();
+    if(m_round.ticks() > 0)
+    {
+        boost::int64_t into = m_simulation.GetElapsed().ticks() %
+                m_round.ticks();
+        if(into >= m_phase.ticks())
+        {
+            when += m_round - boost::posix_time::microseconds(into);
+        }
+    }
+    m_simulation.ScheduleAt(when, task);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Schedule
+/// @description Restarts the timer. As with the broker's timers, a callback
+///     which was still waiting is run with aborted set.
+/// @param delay When the timer should expire.
+/// @param handler The callback for the new expiry.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Schedule(boost::posix_time::time_duration delay,
+        TimerHandler handler)
+{
+    if(m_timerpending)
+    {
+        Post(boost::bind(m_timerhandler, true));
+    }
+    m_generation++;
+    m_timerpending = true;
+    m_timerhandler = handler;
+    m_simulation.Schedule(delay,
+            boost::bind(&CSimGMAgent::Expire, this, m_generation));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Expire
+/// @description Queues the timer's callback unless the timer was restarted.
+/// @param generation The value of m_generation when the timer was started.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Expire(unsigned long generation)
+{
+    if(generation != m_generation || !m_timerpending)
+    {
+        return;
+    }
+    m_timerpending = false;
+    Post(boost::bind(m_timerhandler, false));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Send
+/// @description Puts a message on the network.
+/// @param peer The index of the receiver.
+/// @param msg The message to send.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Send(unsigned int peer, const SimGMMessage & msg)
+{
+    m_network.Send(m_id, peer, msg.expires,
+            boost::bind(&CSimGMAgent::Deliver, m_agents[peer], msg));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Message
+/// @description Fills in the fields every message carries.
+/// @param type The kind of message.
+/// @return A message from this node about its group that never expires.
+///////////////////////////////////////////////////////////////////////////////
+SimGMMessage CSimGMAgent::Message(SimGMMessage::Type type) const
+{
+    SimGMMessage msg;
+    msg.type = type;
+    msg.source = m_id;
+    msg.yes = false;
+    msg.groupid = m_groupid;
+    msg.leader = m_leader;
+    msg.zoneleader = m_lower ? m_lower->GetLeader() : m_leader;
+    return msg;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::PushPeerList
+/// @description Sends the membership, including this node, to each member,
+///     with the members of the hierarchy.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::PushPeerList()
+{
+    if(m_lower)
+    {
+        UpdateGroup();
+    }
+    SimGMMessage msg = Message(SimGMMessage::PEER_LIST);
+    msg.peers.assign(m_upnodes.begin(), m_upnodes.end());
+    msg.peers.push_back(m_id);
+    msg.group.assign(m_group.begin(), m_group.end());
+    foreach(unsigned int peer, m_upnodes)
+    {
+        Send(peer, msg);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::IsActive
+/// @return False for an upper tier agent whose node does not lead its zone.
+///////////////////////////////////////////////////////////////////////////////
+bool CSimGMAgent::IsActive() const
+{
+    return m_lower == 0 || m_lower->IsCoordinator();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Outranks
+/// @description Compares priorities as GMAgent::Outranks does, with equal
+///     priorities ordered by UUID.
+/// @param peer The node to compare with.
+/// @return True if this node has the higher priority.
+///////////////////////////////////////////////////////////////////////////////
+bool CSimGMAgent::Outranks(unsigned int peer) const
+{
+    const CSimGMAgent & other = *m_agents[peer];
+    if(m_priority != other.GetPriority())
+    {
+        return m_priority > other.GetPriority();
+    }
+    return m_uuid > other.GetUUID();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::GetZone
+/// @pre m_lower is set.
+/// @return The members of the zone agent's group, including it.
+///////////////////////////////////////////////////////////////////////////////
+CSimGMAgent::PeerSet CSimGMAgent::GetZone() const
+{
+    PeerSet zone = m_lower->GetUpNodes();
+    zone.insert(m_id);
+    return zone;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::UpdateGroup
+/// @description An active upper tier leader combines its own zone with the
+///     zones its members reported and passes the result down.
+/// @pre m_lower is set.
+/// @post m_group holds every node under this leader.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::UpdateGroup()
+{
+    if(!IsActive() || !IsCoordinator())
+    {
+        return;
+    }
+    m_members[m_id] = GetZone();
+    PeerSet group = m_members[m_id];
+    foreach(unsigned int peer, m_upnodes)
+    {
+        group.insert(m_members[peer].begin(), m_members[peer].end());
+    }
+    m_group = group;
+    m_lower->SetGroup(m_group);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::NextContact
+/// @param peer A node.
+/// @return The next node of peer's zone, wrapping around.
+///////////////////////////////////////////////////////////////////////////////
+unsigned int CSimGMAgent::NextContact(unsigned int peer) const
+{
+    unsigned int next = peer;
+    do
+    {
+        next = (next + 1) % m_zoneof.size();
+    } while(m_zoneof[next] != m_zoneof[peer]);
+    return next;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Deliver
+/// @description Queues an arriving message for the group management phase.
+/// @param msg The message which arrived.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Deliver(SimGMMessage msg)
+{
+    Post(boost::bind(&CSimGMAgent::Prehandler, this, msg));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Prehandler
+/// @description Notes that a member is alive, then dispatches on the type.
+///     In the upper tier only a member which still leads its zone counts.
+/// @param msg The message to handle.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Prehandler(SimGMMessage msg)
+{
+    if(msg.source != m_id && m_upnodes.count(msg.source) > 0 &&
+            (!m_lower || msg.zoneleader == msg.source))
+    {
+        m_alivepeers.insert(msg.source);
+    }
+    switch(msg.type)
+    {
+        case SimGMMessage::ARE_YOU_COORDINATOR:
+            HandleAreYouCoordinator(msg);
+            break;
+        case SimGMMessage::RESPONSE_AYC:
+            HandleResponseAYC(msg);
+            break;
+        case SimGMMessage::ARE_YOU_THERE:
+            HandleAreYouThere(msg);
+            break;
+        case SimGMMessage::RESPONSE_AYT:
+            HandleResponseAYT(msg);
+            break;
+        case SimGMMessage::INVITE:
+            HandleInvite(msg);
+            break;
+        case SimGMMessage::ACCEPT:
+            HandleAccept(msg);
+            break;
+        case SimGMMessage::PEER_LIST:
+            HandlePeerList(msg);
+            break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Recovery
+/// @description Forms a group of one and starts checking for coordinators.
+/// @post The node is the NORMAL leader of a new group.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Recovery()
+{
+    Logger.Debug << m_id << " recovers" << std::endl;
+    m_groupid = ++m_counter;
+    m_leader = m_id;
+    m_upnodes.clear();
+    m_status = NORMAL;
+    PushPeerList();
+    Schedule(m_checktimeout, boost::bind(&CSimGMAgent::Check, this, _1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Recovery
+/// @description Recovers when the timer expires. A member whose recovery
+///     timer was replaced checks on its leader instead.
+/// @param aborted True if the timer was rescheduled.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Recovery(bool aborted)
+{
+    if(!aborted)
+    {
+        m_groupsbroken++;
+        Recovery();
+    }
+    else if(!IsCoordinator())
+    {
+        Schedule(TIMEOUT_TIMEOUT, boost::bind(&CSimGMAgent::Timeout, this, _1));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Check
+/// @description A NORMAL leader asks every peer in its scope whether it is
+///     a coordinator. An upper tier leader asks its members and the contact
+///     of every other zone instead, and only while its node leads its zone.
+/// @param aborted True if the timer was rescheduled.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Check(bool aborted)
+{
+    if(aborted || m_status != NORMAL || !IsCoordinator())
+    {
+        return;
+    }
+    if(!IsActive())
+    {
+        if(!m_upnodes.empty())
+        {
+            Recovery();
+            return;
+        }
+        Schedule(m_checktimeout, boost::bind(&CSimGMAgent::Check, this, _1));
+        return;
+    }
+    PeerSet targets;
+    if(m_lower)
+    {
+        if(m_members[m_id] != GetZone())
+        {
+            PushPeerList();
+        }
+        targets = m_upnodes;
+        for(unsigned int zone = 0; zone < m_contacts.size(); zone++)
+        {
+            if(zone != m_zoneof[m_id])
+            {
+                targets.insert(m_contacts[zone]);
+            }
+        }
+    }
+    else if(m_scoped)
+    {
+        targets = m_scope;
+    }
+    else
+    {
+        for(unsigned int peer = 0; peer < m_agents.size(); peer++)
+        {
+            if(peer != m_id)
+            {
+                targets.insert(peer);
+            }
+        }
+    }
+    m_coordinators.clear();
+    m_coordinatormembers.clear();
+    m_aycresponse.clear();
+    m_checking = true;
+    SimGMMessage msg = Message(SimGMMessage::ARE_YOU_COORDINATOR);
+    msg.expires = m_simulation.GetTime() + GLOBAL_TIMEOUT;
+    foreach(unsigned int peer, targets)
+    {
+        Send(peer, msg);
+        m_aycresponse.insert(peer);
+    }
+    Schedule(RESPONSE_TIMEOUT, boost::bind(&CSimGMAgent::Premerge, this, _1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Premerge
+/// @description Removes members which were not heard from and, if other
+///     coordinators answered, waits in proportion to the priority gap to
+///     the highest of them before merging. With the fast merge the highest
+///     priority coordinator merges at once; the others check again if its
+///     invitation has not come after two response timeouts.
+///     An upper tier agent moves on to the next node of a zone whose contact
+///     did not answer.
+/// @param aborted True if the timer was rescheduled; this still proceeds.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Premerge(bool)
+{
+    m_checking = false;
+    if(!IsCoordinator())
+    {
+        return;
+    }
+    bool changed = false;
+    foreach(unsigned int peer, m_aycresponse)
+    {
+        if(m_upnodes.count(peer) > 0 && m_alivepeers.count(peer) == 0)
+        {
+            m_upnodes.erase(peer);
+            changed = true;
+        }
+        if(m_lower && m_contacts[m_zoneof[peer]] == peer)
+        {
+            m_contacts[m_zoneof[peer]] = NextContact(peer);
+        }
+    }
+    m_alivepeers.clear();
+    if(changed)
+    {
+        PushPeerList();
+    }
+    m_aycresponse.clear();
+    if(!m_coordinators.empty() && m_fastmerge)
+    {
+        bool highest = true;
+        foreach(unsigned int peer, m_coordinators)
+        {
+            highest = highest && Outranks(peer);
+        }
+        if(highest)
+        {
+            Merge(false);
+        }
+        else
+        {
+            // The invitation replaces this timer; asking again is a fallback.
+            Schedule(RESPONSE_TIMEOUT + RESPONSE_TIMEOUT,
+                    boost::bind(&CSimGMAgent::Check, this, _1));
+        }
+    }
+    else if(!m_coordinators.empty())
+    {
+        unsigned int highest = 0;
+        foreach(unsigned int peer, m_coordinators)
+        {
+            if(m_agents[peer]->GetPriority() > highest)
+            {
+                highest = m_agents[peer]->GetPriority();
+            }
+        }
+        // The same proportional wait as GMAgent::Premerge.
+        const unsigned int minWait = 10, granularity = 5, delta = 13;
+        unsigned int wait = 0;
+        if(m_priority < highest)
+        {
+            wait = ((highest - m_priority) % (granularity + 1)) * delta +
+                    minWait;
+        }
+        Schedule(boost::posix_time::milliseconds(wait),
+                boost::bind(&CSimGMAgent::Merge, this, _1));
+    }
+    else
+    {
+        Schedule(m_checktimeout, boost::bind(&CSimGMAgent::Check, this, _1));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Merge
+/// @description Starts a new group and invites the coordinators and the
+///     members of the old group to it. The fast merge also invites the
+///     members of the coordinators' groups.
+/// @param aborted True if the timer was rescheduled.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Merge(bool aborted)
+{
+    if(!IsCoordinator() || aborted)
+    {
+        return;
+    }
+    Logger.Debug << m_id << " merges " << m_coordinators.size()
+            << " coordinators" << std::endl;
+    m_merges++;
+    m_status = ELECTION;
+    m_groupid = ++m_counter;
+    m_leader = m_id;
+    PeerSet old = m_upnodes;
+    m_upnodes.clear();
+    SimGMMessage msg = Message(SimGMMessage::INVITE);
+    msg.expires = m_simulation.GetTime() + GLOBAL_TIMEOUT;
+    foreach(unsigned int peer, m_coordinators)
+    {
+        Send(peer, msg);
+    }
+    if(m_fastmerge)
+    {
+        old.insert(m_coordinatormembers.begin(), m_coordinatormembers.end());
+        m_invited = old;
+        m_invited.insert(m_coordinators.begin(), m_coordinators.end());
+    }
+    foreach(unsigned int peer, old)
+    {
+        if(m_coordinators.count(peer) == 0)
+        {
+            Send(peer, msg);
+        }
+    }
+    Schedule(RESPONSE_TIMEOUT, boost::bind(&CSimGMAgent::Reorganize, this, _1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Reorganize
+/// @description Announces the nodes which accepted as the new group.
+/// @param aborted True if the timer was rescheduled (GMAgent throws here
+///     unless a fast merge reorganized early).
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Reorganize(bool aborted)
+{
+    if(aborted)
+    {
+        if(!m_fastmerge)
+        {
+            Logger.Warn << m_id << " had its Reorganize timer replaced"
+                    << std::endl;
+        }
+        return;
+    }
+    m_status = REORGANIZATION;
+    PushPeerList();
+    m_status = NORMAL;
+    m_groupsformed++;
+    Schedule(m_checktimeout, boost::bind(&CSimGMAgent::Check, this, _1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::Timeout
+/// @description A member asks its leader whether it is still in the group.
+///     If the leader was heard from recently the answer is optional;
+///     otherwise the node recovers unless the answer comes in time.
+/// @param aborted True if the timer was rescheduled.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::Timeout(bool aborted)
+{
+    if(aborted)
+    {
+        return;
+    }
+    if(!IsActive())
+    {
+        // The node no longer leads its zone, so it leaves the upper tier.
+        Recovery();
+        return;
+    }
+    SimGMMessage msg = Message(SimGMMessage::ARE_YOU_THERE);
+    msg.expires = m_simulation.GetTime() + TIMEOUT_TIMEOUT;
+    if(m_lower)
+    {
+        PeerSet zone = GetZone();
+        msg.peers.assign(zone.begin(), zone.end());
+    }
+    m_aytresponse.clear();
+    m_aytoptional = false;
+    if(IsCoordinator())
+    {
+        return;
+    }
+    Send(m_leader, msg);
+    m_aytresponse.insert(m_leader);
+    if(m_alivepeers.count(m_leader) == 0)
+    {
+        Schedule(RESPONSE_TIMEOUT, boost::bind(&CSimGMAgent::Recovery, this, _1));
+    }
+    else
+    {
+        m_alivepeers.clear();
+        m_aytoptional = true;
+        Schedule(TIMEOUT_TIMEOUT, boost::bind(&CSimGMAgent::Timeout, this, _1));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::HandleAreYouCoordinator
+/// @description Answers yes if this node is an active NORMAL leader. With
+///     the fast merge the answer lists the group, and a question from a
+///     lower priority coordinator outside the group starts a check at once.
+/// @param msg The question.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::HandleAreYouCoordinator(const SimGMMessage & msg)
+{
+    SimGMMessage reply = Message(SimGMMessage::RESPONSE_AYC);
+    reply.yes = (m_status == NORMAL && IsCoordinator() && IsActive());
+    reply.expires = msg.expires;
+    if(reply.yes && m_fastmerge)
+    {
+        reply.peers.assign(m_upnodes.begin(), m_upnodes.end());
+    }
+    Send(msg.source, reply);
+    if(reply.yes && m_fastmerge && !m_checking &&
+            m_upnodes.count(msg.source) == 0 && Outranks(msg.source))
+    {
+        Check(false);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::HandleResponseAYC
+/// @description Records the coordinators. Once every peer has answered, the
+///     timer is restarted, which runs Premerge straight away; without the
+///     fast merge only if the last answer was yes, with it only while the
+///     check is under way. In the upper
+///     tier an answer from a node which does not lead its zone is not
+///     counted; the leader it names becomes the zone's contact and is asked.
+/// @param msg The answer.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::HandleResponseAYC(const SimGMMessage & msg)
+{
+    if(m_lower && msg.zoneleader != msg.source)
+    {
+        unsigned int zone = m_zoneof[msg.source];
+        if(m_aycresponse.count(msg.source) > 0 && msg.zoneleader != m_id &&
+                m_aycresponse.count(msg.zoneleader) == 0)
+        {
+            m_contacts[zone] = msg.zoneleader;
+            SimGMMessage ayc = Message(SimGMMessage::ARE_YOU_COORDINATOR);
+            ayc.expires = msg.expires;
+            Send(msg.zoneleader, ayc);
+            m_aycresponse.insert(msg.zoneleader);
+        }
+        return;
+    }
+    bool expected = m_aycresponse.erase(msg.source) > 0;
+    if(expected && msg.yes)
+    {
+        m_coordinators.insert(msg.source);
+        m_coordinatormembers.insert(msg.peers.begin(), msg.peers.end());
+        m_coordinatormembers.erase(m_id);
+        if(m_aycresponse.empty() && !m_fastmerge)
+        {
+            Schedule(TIMEOUT_TIMEOUT, boost::bind(&CSimGMAgent::Check, this, _1));
+        }
+    }
+    else if(!msg.yes)
+    {
+        m_coordinators.erase(msg.source);
+    }
+    if(expected && m_fastmerge && m_checking && m_aycresponse.empty())
+    {
+        Schedule(TIMEOUT_TIMEOUT, boost::bind(&CSimGMAgent::Check, this, _1));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::HandleAreYouThere
+/// @description Answers yes if the sender is a member of this node's group.
+///     An upper tier leader also notes the member's zone and sends the new
+///     membership if it changed.
+/// @param msg The question.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::HandleAreYouThere(const SimGMMessage & msg)
+{
+    SimGMMessage reply = Message(SimGMMessage::RESPONSE_AYT);
+    reply.yes = IsCoordinator() && IsActive() && msg.groupid == m_groupid &&
+            m_upnodes.count(msg.source) > 0;
+    reply.expires = msg.expires;
+    Send(msg.source, reply);
+    if(reply.yes && m_lower)
+    {
+        PeerSet zone(msg.peers.begin(), msg.peers.end());
+        if(m_members[msg.source] != zone)
+        {
+            m_members[msg.source] = zone;
+            if(m_status == NORMAL)
+            {
+                PushPeerList();
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::HandleResponseAYT
+/// @description Keeps checking on a leader which said yes; recovers if the
+///     leader said no to an optional check.
+/// @param msg The answer.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::HandleResponseAYT(const SimGMMessage & msg)
+{
+    bool expected = m_aytresponse.erase(msg.source) > 0;
+    if(expected && msg.yes)
+    {
+        Schedule(TIMEOUT_TIMEOUT, boost::bind(&CSimGMAgent::Timeout, this, _1));
+    }
+    else if(!msg.yes && m_aytoptional && msg.source == m_leader)
+    {
+        Recovery();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::HandleInvite
+/// @description A NORMAL node joins the inviting group; a leader forwards
+///     the invitation to its members first. An upper tier agent accepts
+///     with its zone, and only while its node leads the zone.
+/// @param msg The invitation.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::HandleInvite(const SimGMMessage & msg)
+{
+    if(m_status != NORMAL || !IsActive())
+    {
+        return;
+    }
+    bool wasleader = IsCoordinator();
+    PeerSet old = m_upnodes;
+    m_status = ELECTION;
+    m_groupid = msg.groupid;
+    m_leader = msg.leader;
+    if(wasleader)
+    {
+        // The forwarded invitation appears to come from the new leader.
+        SimGMMessage invite = Message(SimGMMessage::INVITE);
+        invite.source = m_leader;
+        invite.expires = msg.expires;
+        foreach(unsigned int peer, old)
+        {
+            Send(peer, invite);
+        }
+    }
+    SimGMMessage accept = Message(SimGMMessage::ACCEPT);
+    accept.expires = m_simulation.GetTime() + TIMEOUT_TIMEOUT;
+    if(m_lower)
+    {
+        PeerSet zone = GetZone();
+        accept.peers.assign(zone.begin(), zone.end());
+    }
+    Send(m_leader, accept);
+    m_status = REORGANIZATION;
+    m_checking = false;
+    m_aytoptional = false;
+    Schedule(TIMEOUT_TIMEOUT, boost::bind(&CSimGMAgent::Recovery, this, _1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::HandleAccept
+/// @description Adds the sender, and in the upper tier its zone, to the
+///     group this node is forming. A fast merge reorganizes as soon as
+///     everyone invited has accepted.
+/// @param msg The acceptance.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::HandleAccept(const SimGMMessage & msg)
+{
+    if(m_status == ELECTION && msg.groupid == m_groupid && IsCoordinator())
+    {
+        m_upnodes.insert(msg.source);
+        if(m_lower)
+        {
+            m_members[msg.source] = PeerSet(msg.peers.begin(), msg.peers.end());
+        }
+        m_invited.erase(msg.source);
+        if(m_fastmerge && m_invited.empty())
+        {
+            Schedule(boost::posix_time::milliseconds(0),
+                    boost::bind(&CSimGMAgent::Reorganize, this, _1));
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimGMAgent::HandlePeerList
+/// @description Adopts the leader's membership and the members of the
+///     hierarchy, which an active upper tier agent passes down to its zone.
+///     A node waiting for its new group to form becomes NORMAL and starts
+///     checking on the leader.
+/// @param msg The membership.
+///////////////////////////////////////////////////////////////////////////////
+void CSimGMAgent::HandlePeerList(const SimGMMessage & msg)
+{
+    if(msg.source != m_leader ||
+            (m_status != REORGANIZATION && m_status != NORMAL))
+    {
+        return;
+    }
+    if(m_status == REORGANIZATION)
+    {
+        m_status = NORMAL;
+        m_groupsjoined++;
+        Schedule(TIMEOUT_TIMEOUT, boost::bind(&CSimGMAgent::Timeout, this, _1));
+    }
+    m_upnodes.clear();
+    m_upnodes.insert(msg.peers.begin(), msg.peers.end());
+    m_upnodes.erase(m_id);
+    m_group.clear();
+    m_group.insert(msg.group.begin(), msg.group.end());
+    if(m_lower && IsActive())
+    {
+        m_lower->SetGroup(m_group);
+    }
+}
+
+} // namespace sim
+
+} // namespace broker
+
+} // namespace freedm
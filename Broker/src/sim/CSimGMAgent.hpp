@@ -0,0 +1,339 @@
+//////////////////////////////////////////////////////////
+/// @file         CSimGMAgent.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  A model of group management for the simulator
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CSIMGMAGENT_HPP
+#define CSIMGMAGENT_HPP
+
+#include "CSimNetwork.hpp"
+#include "CSimulation.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace freedm {
+    namespace broker {
+        namespace sim {
+
+/// A group management message between simulated nodes.
+struct SimGMMessage
+{
+    /// The kinds of message, named after the GMAgent handlers.
+    enum Type { ARE_YOU_COORDINATOR, RESPONSE_AYC, ARE_YOU_THERE,
+            RESPONSE_AYT, INVITE, ACCEPT, PEER_LIST };
+
+    /// The kind of message.
+    Type type;
+    /// The node the message appears to come from.
+    unsigned int source;
+    /// The payload of a response.
+    bool yes;
+    /// The group the message refers to.
+    unsigned int groupid;
+    /// The leader of that group.
+    unsigned int leader;
+    /// The leader of the sender's zone, in a hierarchy.
+    unsigned int zoneleader;
+    /// The members of the group, for a peer list or a fast merge AreYouCoordinator
+    /// answer, or of the sender's zone, for an upper tier acceptance or
+    /// AreYouThere.
+    std::vector<unsigned int> peers;
+    /// The members of every zone under the top leader, for a peer list.
+    std::vector<unsigned int> group;
+    /// When the message expires, or not_a_date_time for never.
+    boost::posix_time::ptime expires;
+};
+
+/// The group management module of one simulated node.
+class CSimGMAgent : private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description A step for step model of GMAgent's invitation election:
+    ///     the same states, timeouts, messages and tie breaking priorities,
+    ///     with the same single timer whose callbacks see a cancellation
+    ///     when the timer is rescheduled. Peers are the indices of the other
+    ///     agents, messages travel through a CSimNetwork, and every handler
+    ///     and timer callback waits for the group management phase of the
+    ///     broker round before it runs. The phases of all nodes are aligned.
+    ///
+    ///     In a hierarchy each node runs two agents. The zone agent checks
+    ///     only the peers of its zone. The upper tier agent takes part while
+    ///     its zone agent leads and runs the same election among the zone
+    ///     leaders: it asks one contact per other zone, which redirects it
+    ///     to that zone's leader, and collects the zone of each member. The
+    ///     top leader's union of the zones is passed down to the zone
+    ///     leaders and from them to their members.
+    ///
+    /// @limitations Clock skew and FID checks are not modelled; nodes never
+    ///     crash. The agents must outlive the simulation's events.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// The states of the election, in the order GMAgent numbers them.
+    enum { NORMAL, DOWN, RECOVERY, REORGANIZATION, ELECTION };
+
+    /// A set of peers, by index.
+    typedef std::set<unsigned int> PeerSet;
+
+    /// Creates the agent for node id of agents.
+    CSimGMAgent(unsigned int id, CSimulation & simulation,
+            CSimNetwork & network, const std::vector<CSimGMAgent *> & agents);
+
+    /// Restricts the agent to the first length of every round.
+    void SetPhase(boost::posix_time::time_duration round,
+            boost::posix_time::time_duration length);
+
+    /// Starts the election, as GMAgent::Run does.
+    void Start();
+
+    /// Restricts the coordinator checks to a set of peers.
+    void SetScope(const PeerSet & peers);
+
+    /// Makes this agent the upper tier above the zone agent of its node.
+    void SetLower(CSimGMAgent * lower, const std::vector<unsigned int> & zones);
+
+    /// Chooses between the priority wait and the fast merge.
+    void SetFastMerge(bool fast) { m_fastmerge = fast; }
+
+    /// The index of this node.
+    unsigned int GetID() const { return m_id; }
+
+    /// The UUID the priority of this node is derived from.
+    const std::string & GetUUID() const { return m_uuid; }
+
+    /// The tie breaking priority used before a merge.
+    unsigned int GetPriority() const { return m_priority; }
+
+    /// The state of the election.
+    int GetStatus() const { return m_status; }
+
+    /// The leader of this node's group.
+    unsigned int GetLeader() const { return m_leader; }
+
+    /// True if this node leads its group.
+    bool IsCoordinator() const { return m_leader == m_id; }
+
+    /// The other members of this node's group.
+    const PeerSet & GetUpNodes() const { return m_upnodes; }
+
+    /// The members of every zone of this node's hierarchy.
+    const PeerSet & GetGroup() const { return m_group; }
+
+    /// Adopts the members of the hierarchy and tells the zone about them.
+    void SetGroup(const PeerSet & group);
+
+    /// The number of merges this node has led.
+    unsigned int GetMergeCount() const { return m_merges; }
+
+    /// The number of groups this node has formed.
+    unsigned int GetGroupsFormed() const { return m_groupsformed; }
+
+    /// The number of times this node's group broke.
+    unsigned int GetGroupsBroken() const { return m_groupsbroken; }
+
+    /// The number of groups this node has joined.
+    unsigned int GetGroupsJoined() const { return m_groupsjoined; }
+private:
+    /// A timer callback, told whether the timer was rescheduled.
+    typedef boost::function<void (bool)> TimerHandler;
+
+    /// Draws the first group number and forms a group of one.
+    void Run();
+
+    /// Runs a task in the next group management phase.
+    void Post(CSimulation::Event task);
+
+    /// (Re)starts the timer, cancelling the pending callback.
+    void Schedule(boost::posix_time::time_duration delay, TimerHandler handler);
+
+    /// Called by the simulation when the timer expires.
+    void Expire(unsigned long generation);
+
+    /// Sends a message to a peer.
+    void Send(unsigned int peer, const SimGMMessage & msg);
+
+    /// Creates a message of this node.
+    SimGMMessage Message(SimGMMessage::Type type) const;
+
+    /// Sends the group membership to the group.
+    void PushPeerList();
+
+    /// True unless this is an upper tier agent whose zone has another leader.
+    bool IsActive() const;
+
+    /// True if this node's merge priority is above the peer's.
+    bool Outranks(unsigned int peer) const;
+
+    /// The zone led by the zone agent below, including that agent.
+    PeerSet GetZone() const;
+
+    /// Recomputes the union of the zones of an upper tier leader.
+    void UpdateGroup();
+
+    /// The node after peer in its zone, to try when peer does not answer.
+    unsigned int NextContact(unsigned int peer) const;
+
+    /// Called by the network when a message arrives.
+    void Deliver(SimGMMessage msg);
+
+    /// Notes live peers and hands the message to its handler.
+    void Prehandler(SimGMMessage msg);
+
+    /// Forms a group of one.
+    void Recovery();
+
+    /// Timer callback of Recovery.
+    void Recovery(bool aborted);
+
+    /// Looks for other coordinators.
+    void Check(bool aborted);
+
+    /// Drops silent members and waits by priority before merging.
+    void Premerge(bool aborted);
+
+    /// Invites the other coordinators and the old group.
+    void Merge(bool aborted);
+
+    /// Makes the accepted nodes the new group.
+    void Reorganize(bool aborted);
+
+    /// Checks that the leader is still there.
+    void Timeout(bool aborted);
+
+    /// Replies to an AreYouCoordinator.
+    void HandleAreYouCoordinator(const SimGMMessage & msg);
+
+    /// Notes whether a peer is a coordinator.
+    void HandleResponseAYC(const SimGMMessage & msg);
+
+    /// Replies to an AreYouThere.
+    void HandleAreYouThere(const SimGMMessage & msg);
+
+    /// Notes whether this node is still in its leader's group.
+    void HandleResponseAYT(const SimGMMessage & msg);
+
+    /// Joins the group of the inviting leader.
+    void HandleInvite(const SimGMMessage & msg);
+
+    /// Adds the sender to the group being formed.
+    void HandleAccept(const SimGMMessage & msg);
+
+    /// Adopts the membership sent by the leader.
+    void HandlePeerList(const SimGMMessage & msg);
+
+    /// The index of this node.
+    unsigned int m_id;
+    /// The UUID of this node.
+    std::string m_uuid;
+    /// The tie breaking priority of this node.
+    unsigned int m_priority;
+    /// The simulation this node runs in.
+    CSimulation & m_simulation;
+    /// The network this node is attached to.
+    CSimNetwork & m_network;
+    /// Every node of the simulation.
+    const std::vector<CSimGMAgent *> & m_agents;
+    /// The length of a broker round, or 0 to run tasks immediately.
+    boost::posix_time::time_duration m_round;
+    /// The length of the group management phase.
+    boost::posix_time::time_duration m_phase;
+
+    /// The state of the election.
+    int m_status;
+    /// This node's group.
+    unsigned int m_groupid;
+    /// The source of new group numbers.
+    unsigned int m_counter;
+    /// The leader of this node's group.
+    unsigned int m_leader;
+    /// The other members of this node's group.
+    PeerSet m_upnodes;
+    /// Coordinators which answered the last check.
+    PeerSet m_coordinators;
+    /// The members of those coordinators' groups.
+    PeerSet m_coordinatormembers;
+    /// Nodes invited by a fast merge which have not accepted yet.
+    PeerSet m_invited;
+    /// Peers which have not answered the last check.
+    PeerSet m_aycresponse;
+    /// Peers which have not answered the last AreYouThere.
+    PeerSet m_aytresponse;
+    /// Members heard from since the last check.
+    PeerSet m_alivepeers;
+    /// True if a negative AreYouThere answer should start recovery.
+    bool m_aytoptional;
+    /// True if the highest priority coordinator merges without waiting.
+    bool m_fastmerge;
+    /// True from a check until its Premerge.
+    bool m_checking;
+
+    /// True if the checks are restricted to m_scope.
+    bool m_scoped;
+    /// The peers a restricted agent checks.
+    PeerSet m_scope;
+    /// The zone agent below an upper tier agent, or NULL.
+    CSimGMAgent * m_lower;
+    /// The time between coordinator checks.
+    boost::posix_time::time_duration m_checktimeout;
+    /// The zone of each node, for an upper tier agent.
+    std::vector<unsigned int> m_zoneof;
+    /// The node asked about each zone.
+    std::vector<unsigned int> m_contacts;
+    /// The zone of each member of an upper tier group, by its leader.
+    std::map<unsigned int, PeerSet> m_members;
+    /// The members of every zone of the hierarchy.
+    PeerSet m_group;
+
+    /// Bumped whenever the timer is (re)started.
+    unsigned long m_generation;
+    /// True while the timer runs.
+    bool m_timerpending;
+    /// The callback of the running timer.
+    TimerHandler m_timerhandler;
+
+    /// The number of merges this node has led.
+    unsigned int m_merges;
+    /// The number of groups this node has formed.
+    unsigned int m_groupsformed;
+    /// The number of times this node's group broke.
+    unsigned int m_groupsbroken;
+    /// The number of groups this node has joined.
+    unsigned int m_groupsjoined;
+};
+
+        } // namespace sim
+    } // namespace broker
+} // namespace freedm
+
+#endif // CSIMGMAGENT_HPP
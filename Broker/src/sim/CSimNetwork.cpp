@@ -0,0 +1,242 @@
+//////////////////////////////////////////////////////////
+/// @file         CSimNetwork.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  A simulated network with latency, loss and partitions
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CSimNetwork.hpp"
+
+#include <stdexcept>
+
+namespace freedm {
+
+namespace broker {
+
+namespace sim {
+
+namespace {
+
+/// Milliseconds between resends, as in CSRConnection.
+const long RESEND_TIME = 25;
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimNetwork::CSimNetwork
+/// @description Creates a lossless network with no delay, which resends as
+///     often as CSRConnection does.
+/// @pre None
+/// @post Every node is in partition 0.
+/// @param simulation The simulation which delivers the messages.
+/// @param nodes The number of nodes on the network.
+///////////////////////////////////////////////////////////////////////////////
+CSimNetwork::CSimNetwork(CSimulation & simulation, unsigned int nodes)
+    : m_simulation(simulation),
+      m_nodes(nodes),
+      m_latency(0, 0, 0),
+      m_jitter(0, 0, 0),
+      m_resend(boost::posix_time::milliseconds(RESEND_TIME)),
+      m_loss(0),
+      m_partitions(nodes, 0),
+      m_arrivals(nodes * nodes),
+      m_messages(0),
+      m_datagrams(0),
+      m_lost(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimNetwork::SetLatency
+/// @description Sets the delay of the datagrams sent from now on.
+/// @pre Neither duration is negative.
+/// @post Each datagram takes between latency and latency + jitter to arrive.
+/// @param latency The smallest one way delay.
+/// @param jitter The largest extra delay.
+///////////////////////////////////////////////////////////////////////////////
+void CSimNetwork::SetLatency(boost::posix_time::time_duration latency,
+        boost::posix_time::time_duration jitter)
+{
+    if(latency.is_negative() || jitter.is_negative())
+    {
+        throw std::runtime_error("Network delays cannot be negative");
+    }
+    m_latency = latency;
+    m_jitter = jitter;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimNetwork::SetLoss
+/// @description Sets the loss rate of the datagrams sent from now on.
+/// @pre 0 <= probability <= 1
+/// @post Each datagram is lost with the given probability.
+/// @param probability The chance that a datagram is lost.
+///////////////////////////////////////////////////////////////////////////////
+void CSimNetwork::SetLoss(double probability)
+{
+    if(probability < 0 || probability > 1)
+    {
+        throw std::runtime_error("Loss must be a probability");
+    }
+    m_loss = probability;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimNetwork::SetResendTime
+/// @description Sets the resend interval of the messages sent from now on.
+/// @pre The interval is positive.
+/// @post Lost datagrams are sent again after the interval.
+/// @param resend The time between resends.
+///////////////////////////////////////////////////////////////////////////////
+void CSimNetwork::SetResendTime(boost::posix_time::time_duration resend)
+{
+    if(resend.is_negative() || resend.ticks() == 0)
+    {
+        throw std::runtime_error("The resend time must be positive");
+    }
+    m_resend = resend;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimNetwork::SetPartition
+/// @description Moves a node into a partition; nodes can only reach nodes in
+///     the same partition.
+/// @pre The node exists.
+/// @post Messages sent from now on respect the new partition.
+/// @param node The node to move.
+/// @param partition Any number naming the partition.
+///////////////////////////////////////////////////////////////////////////////
+void CSimNetwork::SetPartition(unsigned int node, unsigned int partition)
+{
+    m_partitions.at(node) = partition;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimNetwork::GetPartition
+/// @description Looks up the partition of a node.
+/// @pre The node exists.
+/// @param node The node to look up.
+/// @return The partition the node is in.
+///////////////////////////////////////////////////////////////////////////////
+unsigned int CSimNetwork::GetPartition(unsigned int node) const
+{
+    return m_partitions.at(node);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimNetwork::Heal
+/// @description Removes every partition.
+/// @pre None
+/// @post Every node can reach every other node.
+///////////////////////////////////////////////////////////////////////////////
+void CSimNetwork::Heal()
+{
+    m_partitions.assign(m_nodes, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimNetwork::IsReachable
+/// @description Checks whether two nodes are in the same partition.
+/// @pre Both nodes exist.
+/// @param source The sending node.
+/// @param destination The receiving node.
+/// @return True if messages can get from source to destination.
+///////////////////////////////////////////////////////////////////////////////
+bool CSimNetwork::IsReachable(unsigned int source,
+        unsigned int destination) const
+{
+    return m_partitions.at(source) == m_partitions.at(destination);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimNetwork::Send
+/// @description Draws the fate of each datagram of the message in turn.
+///     The first one that is not lost is scheduled to arrive after the
+///     latency and jitter, kept behind earlier arrivals on the channel.
+/// @pre Both nodes exist.
+/// @post The delivery is scheduled unless every datagram was lost, the
+///     nodes are partitioned or the message would arrive after it expires.
+/// @param source The sending node.
+/// @param destination The receiving node.
+/// @param expires When the message expires, or not_a_date_time for never.
+/// @param delivery Called when the message arrives.
+///////////////////////////////////////////////////////////////////////////////
+void CSimNetwork::Send(unsigned int source, unsigned int destination,
+        boost::posix_time::ptime expires, Delivery delivery)
+{
+    m_messages++;
+    bool expiring = !expires.is_not_a_date_time();
+    if(!IsReachable(source, destination))
+    {
+        // The sender keeps trying until the message expires.
+        unsigned long attempts = 1;
+        if(expiring && expires > m_simulation.GetTime())
+        {
+            attempts += (expires - m_simulation.GetTime()).ticks() /
+                    m_resend.ticks();
+        }
+        m_datagrams += attempts;
+        m_lost++;
+        return;
+    }
+    boost::posix_time::ptime sent = m_simulation.GetTime();
+    for(unsigned int attempt = 0; attempt < MAX_ATTEMPTS; attempt++)
+    {
+        if(expiring && sent > expires)
+        {
+            break;
+        }
+        m_datagrams++;
+        if(m_simulation.Random() < m_loss)
+        {
+            sent += m_resend;
+            continue;
+        }
+        boost::posix_time::ptime arrival = sent + m_latency +
+                boost::posix_time::microseconds(static_cast<long>(
+                m_simulation.Random() * m_jitter.total_microseconds()));
+        boost::posix_time::ptime & last =
+                m_arrivals[source * m_nodes + destination];
+        if(!last.is_not_a_date_time() && arrival < last)
+        {
+            arrival = last;
+        }
+        if(expiring && arrival > expires)
+        {
+            break;
+        }
+        last = arrival;
+        m_simulation.ScheduleAt(arrival, delivery);
+        return;
+    }
+    m_lost++;
+}
+
+} // namespace sim
+
+} // namespace broker
+
+} // namespace freedm
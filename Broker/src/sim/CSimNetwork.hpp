@@ -0,0 +1,133 @@
+//////////////////////////////////////////////////////////
+/// @file         CSimNetwork.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  A simulated network with latency, loss and partitions
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CSIMNETWORK_HPP
+#define CSIMNETWORK_HPP
+
+#include "CSimulation.hpp"
+
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace freedm {
+    namespace broker {
+        namespace sim {
+
+/// Carries messages between the nodes of a simulation.
+class CSimNetwork : private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description Models the sequenced reliable protocol the broker uses:
+    ///     each datagram is lost with a fixed probability and is resent
+    ///     every resend interval until one copy gets through or the message
+    ///     expires. A copy which gets through arrives after the latency plus
+    ///     a uniform jitter, but never before an earlier message on the same
+    ///     channel. Nodes in different partitions cannot reach each other.
+    ///
+    /// @limitations Whether a message gets through is decided when it is
+    ///     sent, so a partition or heal does not affect messages already in
+    ///     flight. Acknowledgements are not modelled.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// Hands a message to its destination.
+    typedef CSimulation::Event Delivery;
+
+    /// Creates a fully connected network between a number of nodes.
+    CSimNetwork(CSimulation & simulation, unsigned int nodes);
+
+    /// Sets the one way delay of every datagram.
+    void SetLatency(boost::posix_time::time_duration latency,
+            boost::posix_time::time_duration jitter);
+
+    /// Sets the probability that a datagram is lost.
+    void SetLoss(double probability);
+
+    /// Sets how long the sender waits before sending a datagram again.
+    void SetResendTime(boost::posix_time::time_duration resend);
+
+    /// Moves a node into a partition.
+    void SetPartition(unsigned int node, unsigned int partition);
+
+    /// The partition a node is in.
+    unsigned int GetPartition(unsigned int node) const;
+
+    /// Puts every node back into partition 0.
+    void Heal();
+
+    /// True if the two nodes are in the same partition.
+    bool IsReachable(unsigned int source, unsigned int destination) const;
+
+    /// Sends a message which is delivered by calling delivery.
+    void Send(unsigned int source, unsigned int destination,
+            boost::posix_time::ptime expires, Delivery delivery);
+
+    /// The number of messages which have been sent.
+    unsigned long GetMessageCount() const { return m_messages; }
+
+    /// The number of datagrams (including resends) which have been sent.
+    unsigned long GetDatagramCount() const { return m_datagrams; }
+
+    /// The number of messages which were never delivered.
+    unsigned long GetLostCount() const { return m_lost; }
+private:
+    /// The most times a message which never expires is sent.
+    static const unsigned int MAX_ATTEMPTS = 1000;
+
+    /// The simulation which delivers the messages.
+    CSimulation & m_simulation;
+    /// The number of nodes on the network.
+    unsigned int m_nodes;
+    /// The smallest one way delay.
+    boost::posix_time::time_duration m_latency;
+    /// The largest extra delay added to the latency.
+    boost::posix_time::time_duration m_jitter;
+    /// The time between resends.
+    boost::posix_time::time_duration m_resend;
+    /// The probability a datagram is lost.
+    double m_loss;
+    /// The partition of each node.
+    std::vector<unsigned int> m_partitions;
+    /// The last arrival time on each channel, indexed source * nodes + dest.
+    std::vector<boost::posix_time::ptime> m_arrivals;
+    /// The number of messages which have been sent.
+    unsigned long m_messages;
+    /// The number of datagrams which have been sent.
+    unsigned long m_datagrams;
+    /// The number of messages which were never delivered.
+    unsigned long m_lost;
+};
+
+        } // namespace sim
+    } // namespace broker
+} // namespace freedm
+
+#endif // CSIMNETWORK_HPP
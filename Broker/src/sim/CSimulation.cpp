@@ -0,0 +1,202 @@
+//////////////////////////////////////////////////////////
+/// @file         CSimulation.cpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  A discrete event simulation driven by a virtual clock
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#include "CSimulation.hpp"
+
+#include <boost/date_time/gregorian/gregorian_types.hpp>
+
+namespace freedm {
+
+namespace broker {
+
+namespace sim {
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimulation::CSimulation
+/// @description Starts the virtual clock at a fixed date so that logs and
+///     results do not depend on when the simulation was run.
+/// @pre None
+/// @post The queue is empty and the clock reads the start time.
+/// @param seed The seed of the random generator.
+///////////////////////////////////////////////////////////////////////////////
+CSimulation::CSimulation(unsigned int seed)
+    : m_start(boost::gregorian::date(2012, 1, 1)),
+      m_now(m_start),
+      m_sequence(0),
+      m_executed(0),
+      m_stopped(false),
+      m_random(seed)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimulation::GetMonotonicTime
+/// @description Reports the virtual time to CClock.
+/// @return The virtual time.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::ptime CSimulation::GetMonotonicTime()
+{
+    return m_now;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimulation::GetWallTime
+/// @description Reports the virtual time to CClock.
+/// @return The virtual time.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::ptime CSimulation::GetWallTime()
+{
+    return m_now;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimulation::GetElapsed
+/// @description Measures the virtual time since construction.
+/// @return The time which has been simulated.
+///////////////////////////////////////////////////////////////////////////////
+boost::posix_time::time_duration CSimulation::GetElapsed() const
+{
+    return m_now - m_start;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimulation::Schedule
+/// @description Queues an event relative to the virtual time.
+/// @pre None
+/// @post The event will run after every event due before it.
+/// @param delay How long to wait; negative delays run the event now.
+/// @param event The event to run.
+///////////////////////////////////////////////////////////////////////////////
+void CSimulation::Schedule(boost::posix_time::time_duration delay, Event event)
+{
+    if(delay.is_negative())
+    {
+        delay = boost::posix_time::time_duration(0, 0, 0);
+    }
+    ScheduleAt(m_now + delay, event);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimulation::ScheduleAt
+/// @description Queues an event at a point of the virtual time.
+/// @pre None
+/// @post The event will run after every event due before it. Times in the
+///     past are treated as now.
+/// @param when When the event is due.
+/// @param event The event to run.
+///////////////////////////////////////////////////////////////////////////////
+void CSimulation::ScheduleAt(boost::posix_time::ptime when, Event event)
+{
+    Pending pending;
+    pending.when = (when < m_now) ? m_now : when;
+    pending.sequence = m_sequence++;
+    pending.event = event;
+    m_queue.push(pending);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimulation::Run
+/// @description Pops and runs the earliest event, advancing the clock to its
+///     due time, until the queue is empty or the limit is reached.
+/// @pre None
+/// @post The clock reads the start time plus limit, unless the simulation
+///     was stopped or ran out of events first.
+/// @param limit The total virtual time to simulate, counted from construction.
+///////////////////////////////////////////////////////////////////////////////
+void CSimulation::Run(boost::posix_time::time_duration limit)
+{
+    boost::posix_time::ptime end = m_start + limit;
+    m_stopped = false;
+    while(!m_stopped && !m_queue.empty() && m_queue.top().when <= end)
+    {
+        Pending next = m_queue.top();
+        m_queue.pop();
+        m_now = next.when;
+        m_executed++;
+        next.event();
+    }
+    if(!m_stopped && m_now < end)
+    {
+        m_now = end;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimulation::Stop
+/// @description Ends Run once the current event returns. Queued events are
+///     kept and a later call to Run continues with them.
+/// @pre None
+/// @post Run will return.
+///////////////////////////////////////////////////////////////////////////////
+void CSimulation::Stop()
+{
+    m_stopped = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimulation::Random
+/// @description Draws from the seeded generator.
+/// @return A number in [0, 1).
+///////////////////////////////////////////////////////////////////////////////
+double CSimulation::Random()
+{
+    return m_random() / (static_cast<double>(m_random.max()) + 1.0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimulation::Random
+/// @description Draws from the seeded generator.
+/// @param range The number of possible results.
+/// @return An integer in [0, range), or 0 if the range is empty.
+///////////////////////////////////////////////////////////////////////////////
+unsigned int CSimulation::Random(unsigned int range)
+{
+    return range ? static_cast<unsigned int>(Random() * range) : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CSimulation::Later::operator()
+/// @description Compares due times, then the order of scheduling.
+/// @return True if a should run after b.
+///////////////////////////////////////////////////////////////////////////////
+bool CSimulation::Later::operator()(const Pending & a, const Pending & b) const
+{
+    if(a.when != b.when)
+    {
+        return a.when > b.when;
+    }
+    return a.sequence > b.sequence;
+}
+
+} // namespace sim
+
+} // namespace broker
+
+} // namespace freedm
@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////
+/// @file         CSimulation.hpp
+///
+/// @compiler     C++
+///
+/// @project      FREEDM DGI
+///
+/// @description  A discrete event simulation driven by a virtual clock
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+///
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes
+/// can be directed to Dr. Bruce McMillin, Department of
+/// Computer Science, Missouri University of Science and
+/// Technology, Rolla, MO  65409 (ff@mst.edu).
+/////////////////////////////////////////////////////////
+
+#ifndef CSIMULATION_HPP
+#define CSIMULATION_HPP
+
+#include "CClock.hpp"
+
+#include <queue>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/random/mersenne_twister.hpp>
+
+namespace freedm {
+    namespace broker {
+        namespace sim {
+
+/// Runs events in the order of a virtual clock.
+class CSimulation : public IClockSource, private boost::noncopyable
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// @description The simulation keeps a queue of events ordered by the
+    ///     virtual time they are due, and runs them one after another. The
+    ///     clock jumps straight to the next event, so an idle second costs
+    ///     nothing. Events due at the same time run in the order they were
+    ///     scheduled, and every random choice is drawn from one generator
+    ///     seeded at construction; two runs with the same seed are
+    ///     therefore identical.
+    ///
+    ///     The simulation is also a clock source, so it can be installed in
+    ///     CClock to make broker code read the virtual time.
+    ///
+    /// @limitations Single threaded. Events must not block.
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    /// Something to do at a point of the virtual time.
+    typedef boost::function<void ()> Event;
+
+    /// Creates a simulation whose random choices are drawn from seed.
+    explicit CSimulation(unsigned int seed);
+
+    /// The virtual time.
+    virtual boost::posix_time::ptime GetMonotonicTime();
+
+    /// The virtual time; the simulation has no separate wall clock.
+    virtual boost::posix_time::ptime GetWallTime();
+
+    /// The virtual time.
+    boost::posix_time::ptime GetTime() const { return m_now; }
+
+    /// The virtual time which has passed since the simulation was created.
+    boost::posix_time::time_duration GetElapsed() const;
+
+    /// Runs an event after some virtual time has passed.
+    void Schedule(boost::posix_time::time_duration delay, Event event);
+
+    /// Runs an event at a point of the virtual time.
+    void ScheduleAt(boost::posix_time::ptime when, Event event);
+
+    /// Runs events until none are left, Stop is called or the time is up.
+    void Run(boost::posix_time::time_duration limit);
+
+    /// Makes Run return after the current event.
+    void Stop();
+
+    /// Draws a number uniformly from [0, 1).
+    double Random();
+
+    /// Draws an integer uniformly from [0, range).
+    unsigned int Random(unsigned int range);
+
+    /// The number of events which have been run.
+    unsigned long GetEventCount() const { return m_executed; }
+private:
+    /// An event waiting in the queue.
+    struct Pending
+    {
+        /// When the event is due.
+        boost::posix_time::ptime when;
+        /// Breaks ties between events due at the same time.
+        unsigned long sequence;
+        /// What to do.
+        Event event;
+    };
+
+    /// Orders the queue so the earliest event is on top.
+    struct Later
+    {
+        /// True if a is due after b.
+        bool operator()(const Pending & a, const Pending & b) const;
+    };
+
+    /// The events which have not been run yet.
+    std::priority_queue<Pending, std::vector<Pending>, Later> m_queue;
+    /// The virtual time when the simulation was created.
+    boost::posix_time::ptime m_start;
+    /// The virtual time.
+    boost::posix_time::ptime m_now;
+    /// The sequence number of the next scheduled event.
+    unsigned long m_sequence;
+    /// The number of events which have been run.
+    unsigned long m_executed;
+    /// True once Stop has been called.
+    bool m_stopped;
+    /// The source of every random choice.
+    boost::mt19937 m_random;
+};
+
+        } // namespace sim
+    } // namespace broker
+} // namespace freedm
+
+#endif // CSIMULATION_HPP
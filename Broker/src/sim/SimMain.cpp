@@ -0,0 +1,774 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file      SimMain.cpp
+///
+/// @project   FREEDM DGI
+///
+/// @description
+///     Entry point of the group management simulator, which runs many DGI
+///     nodes in one process on a virtual clock and reports how quickly and
+///     with how many messages their groups converge.
+///
+/// @copyright
+///     These source code files were created at Missouri University of Science
+///     and Technology, and are intended for use in teaching or research. They
+///     may be freely copied, modified, and redistributed as long as modified
+///     versions are clearly marked as such and this notice is not removed.
+///     Neither the authors nor Missouri S&T make any warranty, express or
+///     implied, nor assume any legal responsibility for the accuracy,
+///     completeness, or usefulness of these files or any information
+///     distributed with these files.
+///
+///     Suggested modifications or questions about these files can be directed
+///     to Dr. Bruce McMillin, Department of Computer Science, Missouri
+///     University of Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/program_options.hpp>
+#include <boost/shared_ptr.hpp>
+
+#define foreach BOOST_FOREACH
+
+namespace po = boost::program_options;
+
+#include "CClock.hpp"
+#include "CHistogram.hpp"
+#include "CLogger.hpp"
+#include "sim/CSimGMAgent.hpp"
+#include "sim/CSimNetwork.hpp"
+#include "sim/CSimulation.hpp"
+
+using namespace freedm;
+using namespace broker;
+using namespace broker::sim;
+
+namespace {
+
+/// This file's logger.
+CLocalLogger Logger(__FILE__);
+
+/// How often the simulation checks whether the groups have converged.
+const boost::posix_time::time_duration MONITOR_INTERVAL =
+        boost::posix_time::milliseconds(10);
+
+/// The settings of a simulation run.
+struct Settings
+{
+    /// The number of nodes.
+    unsigned int nodes;
+    /// The nodes in each zone of a hierarchy, or 0 for one flat group.
+    unsigned int zoneSize;
+    /// True if the agents use the fast merge instead of the priority wait.
+    bool fastMerge;
+    /// The longest a node waits to start, in milliseconds.
+    unsigned int spread;
+    /// The one way network delay, in milliseconds.
+    double latency;
+    /// The largest extra network delay, in milliseconds.
+    double jitter;
+    /// The probability a datagram is lost.
+    double loss;
+    /// The length of a broker round, in milliseconds.
+    unsigned int round;
+    /// The length of the group management phase, in milliseconds.
+    unsigned int phase;
+    /// When to partition the network, in seconds (0 for never).
+    double partitionAt;
+    /// When to heal the partition, in seconds (0 for never).
+    double healAt;
+    /// The number of nodes cut off by the partition.
+    unsigned int minority;
+    /// The most virtual time to simulate, in seconds.
+    double duration;
+};
+
+/// A disturbance of the system and how the groups recovered from it.
+struct Episode
+{
+    /// What happened.
+    std::string name;
+    /// When it happened.
+    boost::posix_time::ptime start;
+    /// The message count when it happened.
+    unsigned long messages;
+    /// The datagram count when it happened.
+    unsigned long datagrams;
+    /// The number of merges when it happened.
+    unsigned long merges;
+    /// True once the groups matched the partitions.
+    bool converged;
+    /// The time to converge.
+    boost::posix_time::time_duration elapsed;
+};
+
+/// One run of the simulation.
+class CRun
+{
+public:
+    /// Prepares a run of the settings with the given seed.
+    CRun(const Settings & settings, unsigned int seed);
+
+    /// Deletes the agents.
+    ~CRun();
+
+    /// Simulates until the last episode converges or the time is up.
+    void Execute();
+
+    /// The episodes of the run, in order.
+    const std::vector<Episode> & GetEpisodes() const { return m_episodes; }
+
+    /// The number of messages each episode took to converge.
+    unsigned long GetMessages(unsigned int episode) const;
+
+    /// The number of merges each episode took to converge.
+    unsigned long GetMerges(unsigned int episode) const;
+
+    /// The number of events the simulation ran.
+    unsigned long GetEventCount() const;
+private:
+    /// Records the start of an episode.
+    void Begin(const std::string & name);
+
+    /// Cuts the minority off from the rest of the nodes.
+    void Partition();
+
+    /// Removes the partition.
+    void Heal();
+
+    /// Checks for convergence of the current episode.
+    void Monitor();
+
+    /// True if every partition is one NORMAL group with full membership.
+    bool IsConverged() const;
+
+    /// A partition, or the part of a zone within a partition.
+    typedef std::pair<unsigned int, unsigned int> Cell;
+
+    /// True if the nodes of each cell are one NORMAL group of the agents.
+    bool IsGrouped(const std::vector<CSimGMAgent *> & agents,
+            const std::map<Cell, std::vector<unsigned int> > & cells) const;
+
+    /// The total number of merges of all agents.
+    unsigned long CountMerges() const;
+
+    /// The settings of the run.
+    const Settings & m_settings;
+    /// The simulation.
+    boost::shared_ptr<CSimulation> m_simulation;
+    /// The network between the agents.
+    CSimNetwork m_network;
+    /// The nodes, or the zone agents of a hierarchy.
+    std::vector<CSimGMAgent *> m_agents;
+    /// The upper tier agents of a hierarchy.
+    std::vector<CSimGMAgent *> m_tiers;
+    /// The zone of each node.
+    std::vector<unsigned int> m_zones;
+    /// The episodes so far.
+    std::vector<Episode> m_episodes;
+    /// Message and merge totals at convergence, per episode.
+    std::vector<unsigned long> m_endMessages, m_endMerges;
+    /// The number of disturbances still to come.
+    unsigned int m_remaining;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::CRun
+/// @description Creates the network and agents and schedules the starts and
+///     disturbances of the run. With a zone size, consecutive nodes form
+///     the zones and every node also runs an upper tier agent.
+/// @param settings The settings of the run.
+/// @param seed The seed of the random choices.
+///////////////////////////////////////////////////////////////////////////////
+CRun::CRun(const Settings & settings, unsigned int seed)
+    : m_settings(settings),
+      m_simulation(new CSimulation(seed)),
+      m_network(*m_simulation, settings.nodes),
+      m_remaining(0)
+{
+    m_network.SetLatency(
+            boost::posix_time::microseconds(long(settings.latency * 1000)),
+            boost::posix_time::microseconds(long(settings.jitter * 1000)));
+    m_network.SetLoss(settings.loss);
+    for(unsigned int i = 0; i < settings.nodes; i++)
+    {
+        m_zones.push_back(settings.zoneSize ? i / settings.zoneSize : 0);
+        m_agents.push_back(new CSimGMAgent(i, *m_simulation, m_network,
+                m_agents));
+        m_agents[i]->SetPhase(boost::posix_time::milliseconds(settings.round),
+                boost::posix_time::milliseconds(settings.phase));
+        m_agents[i]->SetFastMerge(settings.fastMerge);
+    }
+    for(unsigned int i = 0; settings.zoneSize > 0 && i < settings.nodes; i++)
+    {
+        CSimGMAgent::PeerSet zone;
+        for(unsigned int j = 0; j < settings.nodes; j++)
+        {
+            if(m_zones[j] == m_zones[i])
+            {
+                zone.insert(j);
+            }
+        }
+        m_agents[i]->SetScope(zone);
+        m_tiers.push_back(new CSimGMAgent(i, *m_simulation, m_network,
+                m_tiers));
+        m_tiers[i]->SetPhase(boost::posix_time::milliseconds(settings.round),
+                boost::posix_time::milliseconds(settings.phase));
+        m_tiers[i]->SetLower(m_agents[i], m_zones);
+        m_tiers[i]->SetFastMerge(settings.fastMerge);
+    }
+    for(unsigned int i = 0; i < m_agents.size(); i++)
+    {
+        boost::posix_time::time_duration delay =
+                boost::posix_time::milliseconds(
+                    m_simulation->Random(settings.spread + 1));
+        m_simulation->Schedule(delay,
+                boost::bind(&CSimGMAgent::Start, m_agents[i]));
+        if(!m_tiers.empty())
+        {
+            m_simulation->Schedule(delay,
+                    boost::bind(&CSimGMAgent::Start, m_tiers[i]));
+        }
+    }
+    if(settings.partitionAt > 0)
+    {
+        m_remaining++;
+        m_simulation->Schedule(boost::posix_time::microseconds(
+                long(settings.partitionAt * 1e6)),
+                boost::bind(&CRun::Partition, this));
+    }
+    if(settings.healAt > 0)
+    {
+        m_remaining++;
+        m_simulation->Schedule(boost::posix_time::microseconds(
+                long(settings.healAt * 1e6)), boost::bind(&CRun::Heal, this));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::~CRun
+/// @description Deletes the agents.
+///////////////////////////////////////////////////////////////////////////////
+CRun::~CRun()
+{
+    foreach(CSimGMAgent * agent, m_agents)
+    {
+        delete agent;
+    }
+    foreach(CSimGMAgent * agent, m_tiers)
+    {
+        delete agent;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::Execute
+/// @description Makes broker code read the virtual time and runs the
+///     simulation from the start episode on.
+///////////////////////////////////////////////////////////////////////////////
+void CRun::Execute()
+{
+    CClock::instance().SetSource(m_simulation);
+    Begin("start");
+    m_simulation->Schedule(MONITOR_INTERVAL, boost::bind(&CRun::Monitor, this));
+    m_simulation->Run(boost::posix_time::microseconds(
+            long(m_settings.duration * 1e6)));
+    CClock::instance().SetSource(boost::shared_ptr<IClockSource>());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::GetMessages
+/// @param episode The index of the episode.
+/// @return The messages sent between the start and the convergence.
+///////////////////////////////////////////////////////////////////////////////
+unsigned long CRun::GetMessages(unsigned int episode) const
+{
+    return m_endMessages[episode] - m_episodes[episode].messages;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::GetMerges
+/// @param episode The index of the episode.
+/// @return The merges led between the start and the convergence.
+///////////////////////////////////////////////////////////////////////////////
+unsigned long CRun::GetMerges(unsigned int episode) const
+{
+    return m_endMerges[episode] - m_episodes[episode].merges;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::GetEventCount
+/// @return The number of events the simulation ran.
+///////////////////////////////////////////////////////////////////////////////
+unsigned long CRun::GetEventCount() const
+{
+    return m_simulation->GetEventCount();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::Begin
+/// @description Snapshots the counters at the start of an episode.
+/// @param name What happened.
+///////////////////////////////////////////////////////////////////////////////
+void CRun::Begin(const std::string & name)
+{
+    Episode episode;
+    episode.name = name;
+    episode.start = m_simulation->GetTime();
+    episode.messages = m_network.GetMessageCount();
+    episode.datagrams = m_network.GetDatagramCount();
+    episode.merges = CountMerges();
+    episode.converged = false;
+    m_episodes.push_back(episode);
+    m_endMessages.push_back(episode.messages);
+    m_endMerges.push_back(episode.merges);
+    Logger.Notice << "Episode " << name << " begins" << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::Partition
+/// @description Moves the first nodes into a partition of their own.
+///////////////////////////////////////////////////////////////////////////////
+void CRun::Partition()
+{
+    for(unsigned int i = 0; i < m_settings.minority && i < m_agents.size(); i++)
+    {
+        m_network.SetPartition(i, 1);
+    }
+    m_remaining--;
+    Begin("partition");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::Heal
+/// @description Reconnects every node.
+///////////////////////////////////////////////////////////////////////////////
+void CRun::Heal()
+{
+    m_network.Heal();
+    m_remaining--;
+    Begin("heal");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::Monitor
+/// @description Records the convergence of the current episode. Once the
+///     last episode has converged the simulation is stopped.
+///////////////////////////////////////////////////////////////////////////////
+void CRun::Monitor()
+{
+    Episode & episode = m_episodes.back();
+    if(!episode.converged && IsConverged())
+    {
+        episode.converged = true;
+        episode.elapsed = m_simulation->GetTime() - episode.start;
+        m_endMessages.back() = m_network.GetMessageCount();
+        m_endMerges.back() = CountMerges();
+        Logger.Notice << "Episode " << episode.name << " converged after "
+                << episode.elapsed << std::endl;
+        if(m_remaining == 0)
+        {
+            m_simulation->Stop();
+            return;
+        }
+    }
+    m_simulation->Schedule(MONITOR_INTERVAL, boost::bind(&CRun::Monitor, this));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::IsConverged
+/// @description Every partition must be one group. In a hierarchy the part
+///     of each zone within a partition must be one zone group, the leaders
+///     of those parts one upper tier group, and every node must have been
+///     told all the nodes of its partition.
+/// @return True if the groups match the partitions.
+///////////////////////////////////////////////////////////////////////////////
+bool CRun::IsConverged() const
+{
+    std::map<Cell, std::vector<unsigned int> > cells;
+    for(unsigned int i = 0; i < m_agents.size(); i++)
+    {
+        cells[Cell(m_network.GetPartition(i), m_zones[i])].push_back(i);
+    }
+    if(!IsGrouped(m_agents, cells))
+    {
+        return false;
+    }
+    if(m_tiers.empty())
+    {
+        return true;
+    }
+    std::map<Cell, std::vector<unsigned int> > tiers;
+    std::map<unsigned int, CSimGMAgent::PeerSet> partitions;
+    std::map<Cell, std::vector<unsigned int> >::const_iterator it;
+    for(it = cells.begin(); it != cells.end(); it++)
+    {
+        tiers[Cell(it->first.first, 0)].push_back(
+                m_agents[it->second.front()]->GetLeader());
+        partitions[it->first.first].insert(it->second.begin(),
+                it->second.end());
+    }
+    if(!IsGrouped(m_tiers, tiers))
+    {
+        return false;
+    }
+    for(unsigned int i = 0; i < m_agents.size(); i++)
+    {
+        if(m_agents[i]->GetGroup() != partitions[m_network.GetPartition(i)])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::IsGrouped
+/// @description Every agent of a cell must be NORMAL and follow the one
+///     leader of its cell, the leader's group must be exactly the rest of
+///     the cell, and every member must have been told the full group.
+/// @param agents The agents to check.
+/// @param cells The nodes which should form each group.
+/// @return True if the groups match the cells.
+///////////////////////////////////////////////////////////////////////////////
+bool CRun::IsGrouped(const std::vector<CSimGMAgent *> & agents,
+        const std::map<Cell, std::vector<unsigned int> > & cells) const
+{
+    std::map<Cell, std::vector<unsigned int> >::const_iterator it;
+    for(it = cells.begin(); it != cells.end(); it++)
+    {
+        const std::vector<unsigned int> & members = it->second;
+        CSimGMAgent::PeerSet cell(members.begin(), members.end());
+        unsigned int leader = agents[members.front()]->GetLeader();
+        if(cell.count(leader) == 0)
+        {
+            return false;
+        }
+        foreach(unsigned int i, members)
+        {
+            const CSimGMAgent & agent = *agents[i];
+            if(agent.GetStatus() != CSimGMAgent::NORMAL ||
+                    agent.GetLeader() != leader ||
+                    agent.GetUpNodes().size() != members.size() - 1)
+            {
+                return false;
+            }
+        }
+        foreach(unsigned int i, agents[leader]->GetUpNodes())
+        {
+            if(cell.count(i) == 0)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// CRun::CountMerges
+/// @return The total number of merges led by all agents of both tiers.
+///////////////////////////////////////////////////////////////////////////////
+unsigned long CRun::CountMerges() const
+{
+    unsigned long merges = 0;
+    foreach(CSimGMAgent * agent, m_agents)
+    {
+        merges += agent->GetMergeCount();
+    }
+    foreach(CSimGMAgent * agent, m_tiers)
+    {
+        merges += agent->GetMergeCount();
+    }
+    return merges;
+}
+
+/// The means of one episode of one configuration over its runs.
+struct Summary
+{
+    /// The number of nodes.
+    unsigned int nodes;
+    /// The zone size, or 0 for flat.
+    unsigned int zoneSize;
+    /// True for the fast merge.
+    bool fastMerge;
+    /// The episode.
+    std::string name;
+    /// The runs which did not converge.
+    unsigned int failures;
+    /// The mean time to converge, in milliseconds.
+    double time;
+    /// The mean number of messages to converge.
+    double messages;
+    /// The mean number of merges to converge.
+    double merges;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// Simulate
+/// @description Runs one configuration with consecutive seeds, printing each
+///     run and the distributions of its episodes.
+/// @param settings The configuration.
+/// @param seed The seed of the first run.
+/// @param runs The number of runs.
+/// @param summaries Receives the means of each episode.
+///////////////////////////////////////////////////////////////////////////////
+void Simulate(const Settings & settings, unsigned int seed, unsigned int runs,
+        std::vector<Summary> & summaries)
+{
+    std::map<std::string, CHistogram> times, messages, merges;
+    std::map<std::string, unsigned int> failures;
+    std::vector<std::string> order;
+    std::clock_t cpu = std::clock();
+    unsigned long events = 0;
+
+    for(unsigned int run = 0; run < runs; run++)
+    {
+        CRun sim(settings, seed + run);
+        sim.Execute();
+        events += sim.GetEventCount();
+        for(unsigned int i = 0; i < sim.GetEpisodes().size(); i++)
+        {
+            const Episode & episode = sim.GetEpisodes()[i];
+            if(times.count(episode.name) == 0)
+            {
+                order.push_back(episode.name);
+            }
+            std::cout << "seed " << seed + run << " " << episode.name;
+            if(!episode.converged)
+            {
+                failures[episode.name]++;
+                times[episode.name];
+                std::cout << ": did not converge" << std::endl;
+                continue;
+            }
+            times[episode.name].Record(
+                    episode.elapsed.total_milliseconds());
+            messages[episode.name].Record(sim.GetMessages(i));
+            merges[episode.name].Record(sim.GetMerges(i));
+            std::cout << ": converged in "
+                    << episode.elapsed.total_milliseconds() << " ms, "
+                    << sim.GetMessages(i) << " messages, "
+                    << sim.GetMerges(i) << " merges" << std::endl;
+        }
+    }
+
+    std::cout << std::endl << settings.nodes << " nodes";
+    if(settings.zoneSize > 0)
+    {
+        std::cout << " in zones of " << settings.zoneSize;
+    }
+    if(settings.fastMerge)
+    {
+        std::cout << " with the fast merge";
+    }
+    std::cout << ", " << runs << " runs:" << std::endl;
+    foreach(const std::string & name, order)
+    {
+        std::cout << name << ": " << failures[name]
+                << " runs did not converge" << std::endl;
+        std::cout << "  time (ms)  " << times[name] << std::endl;
+        std::cout << "  messages   " << messages[name] << std::endl;
+        std::cout << "  merges     " << merges[name] << std::endl;
+
+        Summary summary;
+        summary.nodes = settings.nodes;
+        summary.zoneSize = settings.zoneSize;
+        summary.fastMerge = settings.fastMerge;
+        summary.name = name;
+        summary.failures = failures[name];
+        summary.time = times[name].GetMean();
+        summary.messages = messages[name].GetMean();
+        summary.merges = merges[name].GetMean();
+        summaries.push_back(summary);
+    }
+    std::cout << events << " events in " << std::fixed
+            << std::setprecision(2)
+            << double(std::clock() - cpu) / CLOCKS_PER_SEC
+            << " s of processor time" << std::endl << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// PrintSummaries
+/// @description Prints the mean time and messages of every episode of every
+///     configuration, one configuration per row.
+/// @param summaries The means of each episode.
+///////////////////////////////////////////////////////////////////////////////
+void PrintSummaries(const std::vector<Summary> & summaries)
+{
+    std::cout << std::setw(6) << "nodes" << std::setw(6) << "zone"
+            << std::setw(6) << "merge" << std::setw(12) << "episode" << std::setw(8) << "failed"
+            << std::setw(12) << "time (ms)" << std::setw(12) << "messages"
+            << std::setw(8) << "merges" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    foreach(const Summary & summary, summaries)
+    {
+        std::cout << std::setw(6) << summary.nodes << std::setw(6);
+        if(summary.zoneSize > 0)
+        {
+            std::cout << summary.zoneSize;
+        }
+        else
+        {
+            std::cout << "flat";
+        }
+        std::cout << std::setw(6) << (summary.fastMerge ? "fast" : "wait")
+                << std::setw(12) << summary.name
+                << std::setw(8) << summary.failures
+                << std::setw(12) << summary.time
+                << std::setw(12) << summary.messages
+                << std::setw(8) << summary.merges << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+}
+
+/// Simulator entry point
+int main(int argc, char* argv[])
+{
+    CGlobalLogger::instance().SetGlobalLevel(3);
+    po::options_description opts("Simulator Options");
+    po::variables_map vm;
+    Settings settings;
+    std::vector<unsigned int> nodes, zones;
+    std::vector<std::string> merges;
+    unsigned int seed, runs, verbosity, minority;
+
+    try
+    {
+        opts.add_options()
+                ( "help,h", "print usage help (this screen)" )
+                ( "nodes,n",
+                po::value<std::vector<unsigned int> >( &nodes )->multitoken()->
+                default_value(std::vector<unsigned int>(1, 50), "50"),
+                "number of simulated nodes (several to compare)" )
+                ( "zone-size,z",
+                po::value<std::vector<unsigned int> >( &zones )->multitoken()->
+                default_value(std::vector<unsigned int>(1, 0), "0"),
+                "nodes per zone of a two tier hierarchy, 0 for a flat group "
+                "(several to compare)" )
+                ( "merge",
+                po::value<std::vector<std::string> >( &merges )->multitoken()->
+                default_value(std::vector<std::string>(1, "wait"), "wait"),
+                "wait (merge after the priority wait) or fast (the highest "
+                "priority coordinator merges at once; several to compare)" )
+                ( "seed,s",
+                po::value<unsigned int>( &seed )->default_value(1),
+                "seed of the first run" )
+                ( "runs,r",
+                po::value<unsigned int>( &runs )->default_value(1),
+                "number of runs, with consecutive seeds" )
+                ( "duration",
+                po::value<double>( &settings.duration )->default_value(300),
+                "seconds of virtual time to simulate at most" )
+                ( "start-spread",
+                po::value<unsigned int>( &settings.spread )->
+                default_value(1000),
+                "milliseconds over which the nodes start" )
+                ( "latency",
+                po::value<double>( &settings.latency )->default_value(1),
+                "one way network delay in milliseconds" )
+                ( "jitter",
+                po::value<double>( &settings.jitter )->default_value(1),
+                "largest extra network delay in milliseconds" )
+                ( "loss",
+                po::value<double>( &settings.loss )->default_value(0),
+                "probability that a datagram is lost" )
+                ( "round",
+                po::value<unsigned int>( &settings.round )->
+                default_value(1000),
+                "milliseconds in a broker round (0 to ignore phases)" )
+                ( "gm-phase",
+                po::value<unsigned int>( &settings.phase )->
+                default_value(200),
+                "milliseconds of each round given to group management" )
+                ( "partition-at",
+                po::value<double>( &settings.partitionAt )->default_value(0),
+                "second at which to partition the network" )
+                ( "heal-at",
+                po::value<double>( &settings.healAt )->default_value(0),
+                "second at which to heal the partition" )
+                ( "minority",
+                po::value<unsigned int>( &minority )->default_value(0),
+                "nodes cut off by the partition (default half)" )
+                ( "verbose,v",
+                po::value<unsigned int>( &verbosity )->
+                implicit_value(5)->default_value(3),
+                "enable verbose output (optionally specify level)" );
+        po::store(po::parse_command_line(argc, argv, opts), vm);
+        po::notify(vm);
+    }
+    catch(std::exception & e)
+    {
+        std::cerr << e.what() << std::endl << opts << std::endl;
+        return 1;
+    }
+
+    if(vm.count("help"))
+    {
+        std::cerr << opts << std::endl;
+        return 0;
+    }
+    foreach(unsigned int count, nodes)
+    {
+        if(count == 0)
+        {
+            std::cerr << "Need at least one node." << std::endl;
+            return 1;
+        }
+    }
+    foreach(const std::string & merge, merges)
+    {
+        if(merge != "wait" && merge != "fast")
+        {
+            std::cerr << "Unknown merge: " << merge << std::endl;
+            return 1;
+        }
+    }
+    if(settings.phase > settings.round)
+    {
+        std::cerr << "Need a phase within the round." << std::endl;
+        return 1;
+    }
+    CGlobalLogger::instance().SetGlobalLevel(verbosity);
+
+    try
+    {
+        std::vector<Summary> summaries;
+        foreach(unsigned int count, nodes)
+        {
+            foreach(unsigned int zone, zones)
+            {
+                foreach(const std::string & merge, merges)
+                {
+                    settings.nodes = count;
+                    settings.zoneSize = zone;
+                    settings.fastMerge = (merge == "fast");
+                    settings.minority = minority ? minority : count / 2;
+                    Simulate(settings, seed, runs, summaries);
+                }
+            }
+        }
+        if(nodes.size() * zones.size() * merges.size() > 1)
+        {
+            PrintSummaries(summaries);
+        }
+    }
+    catch(std::exception & e)
+    {
+        Logger.Error << "Exception caught in main:" << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
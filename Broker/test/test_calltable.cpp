@@ -0,0 +1,191 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_calltable.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for matching replies to the calls waiting on them
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+///////////////////////////////////////////////////////////////////////////////
+
+
+#include "CCallTable.hpp"
+#include "CMessage.hpp"
+#include "unit_test.hpp"
+
+#include <set>
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace boost::posix_time;
+using freedm::broker::CCallTable;
+using freedm::broker::CMessage;
+
+namespace {
+
+/// Keeps the result of the last call completed and counts completions.
+struct Recorder
+{
+    Recorder() : completions(0) { }
+    void Done(const CCallTable::Result & r) { result = r; completions++; }
+    CCallTable::Result result;
+    unsigned int completions;
+};
+
+/// Makes a request with a call id, as a caller would send it.
+CMessage Request(CCallTable::CallID id)
+{
+    CMessage m;
+    m.SetHandler("gm.AreYouCoordinator");
+    CCallTable::Stamp(m, id);
+    return m;
+}
+
+/// Makes the reply a peer sends to a request.
+CMessage Reply(const CMessage & request, const std::string & payload)
+{
+    CMessage m;
+    m.SetHandler("gm.Response.AreYouCoordinator");
+    m.m_submessages.put("gm.payload", payload);
+    CCallTable::Correlate(request, m);
+    return m;
+}
+
+/// The set of peers a and b.
+std::set<std::string> PeersAB()
+{
+    std::set<std::string> peers;
+    peers.insert("a");
+    peers.insert("b");
+    return peers;
+}
+
+}
+
+void test_completes_when_all_reply()
+{
+    CCallTable table;
+    Recorder r;
+    ptime now(from_iso_string("20120101T000000"));
+
+    CCallTable::CallID id = table.Open(PeersAB(), now + seconds(1),
+            boost::bind(&Recorder::Done, &r, _1));
+    CMessage request = Request(id);
+    BOOST_CHECK_EQUAL( CCallTable::GetCallID(request), id );
+
+    BOOST_CHECK( table.Answer(Reply(request, "yes"), "a") );
+    // The same peer answering again, or a peer never asked, is refused.
+    BOOST_CHECK( !table.Answer(Reply(request, "yes"), "a") );
+    BOOST_CHECK( !table.Answer(Reply(request, "no"), "c") );
+    BOOST_CHECK_EQUAL( r.completions, 0u );
+    BOOST_CHECK( table.IsOpen(id) );
+
+    // The last reply completes the call before its deadline.
+    BOOST_CHECK( table.Answer(Reply(request, "no"), "b") );
+    BOOST_CHECK_EQUAL( r.completions, 1u );
+    BOOST_CHECK( !table.IsOpen(id) );
+    BOOST_CHECK( r.result.missing.empty() );
+    BOOST_REQUIRE_EQUAL( r.result.replies.size(), 2u );
+    BOOST_CHECK_EQUAL( r.result.replies["a"].GetSubMessages().get<std::string>(
+            "gm.payload"), "yes" );
+    BOOST_CHECK( table.GetNextDeadline().is_not_a_date_time() );
+
+    // Nothing is left for the deadline to complete.
+    table.Expire(now + seconds(2));
+    BOOST_CHECK_EQUAL( r.completions, 1u );
+}
+
+void test_deadline_completes_with_missing()
+{
+    CCallTable table;
+    Recorder first, second;
+    ptime now(from_iso_string("20120101T000000"));
+
+    CCallTable::CallID late = table.Open(PeersAB(), now + seconds(2),
+            boost::bind(&Recorder::Done, &second, _1));
+    CCallTable::CallID soon = table.Open(PeersAB(), now + seconds(1),
+            boost::bind(&Recorder::Done, &first, _1));
+    BOOST_CHECK( late != soon );
+    BOOST_CHECK_EQUAL( table.GetNextDeadline(), now + seconds(1) );
+
+    // A reply names its own call, not just the latest one.
+    BOOST_CHECK( table.Answer(Reply(Request(late), "yes"), "b") );
+
+    table.Expire(now + milliseconds(999));
+    BOOST_CHECK_EQUAL( first.completions, 0u );
+    table.Expire(now + seconds(1));
+    BOOST_CHECK_EQUAL( first.completions, 1u );
+    BOOST_CHECK( first.result.replies.empty() );
+    BOOST_CHECK_EQUAL( first.result.missing.size(), 2u );
+    BOOST_CHECK_EQUAL( table.GetNextDeadline(), now + seconds(2) );
+
+    // A reply after the deadline is late.
+    BOOST_CHECK( !table.Answer(Reply(Request(soon), "yes"), "a") );
+
+    table.Expire(now + seconds(3));
+    BOOST_CHECK_EQUAL( second.completions, 1u );
+    BOOST_CHECK_EQUAL( second.result.replies.size(), 1u );
+    BOOST_CHECK_EQUAL( second.result.missing.count("a"), 1u );
+}
+
+void test_cancel_and_empty_calls()
+{
+    CCallTable table;
+    Recorder r;
+    ptime now(from_iso_string("20120101T000000"));
+
+    CCallTable::CallID id = table.Open(PeersAB(), now + seconds(1),
+            boost::bind(&Recorder::Done, &r, _1));
+    BOOST_CHECK( table.Cancel(id) );
+    BOOST_CHECK( !table.Cancel(id) );
+    BOOST_CHECK( !table.Answer(Reply(Request(id), "yes"), "a") );
+    table.Expire(now + seconds(2));
+    BOOST_CHECK_EQUAL( r.completions, 0u );
+
+    // A call to nobody has nothing to wait for.
+    id = table.Open(std::set<std::string>(), now + seconds(1),
+            boost::bind(&Recorder::Done, &r, _1));
+    BOOST_CHECK_EQUAL( r.completions, 1u );
+    BOOST_CHECK( !table.IsOpen(id) );
+
+    // A message which was not sent for a call carries no id.
+    CMessage plain;
+    plain.SetHandler("gm.Response.AreYouThere");
+    CCallTable::Correlate(plain, plain);
+    BOOST_CHECK_EQUAL( CCallTable::GetCallID(plain), 0u );
+    BOOST_CHECK( !table.Answer(plain, "a") );
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("Call Table Tests");
+
+    test->add(BOOST_TEST_CASE(&test_completes_when_all_reply));
+    test->add(BOOST_TEST_CASE(&test_deadline_completes_with_missing));
+    test->add(BOOST_TEST_CASE(&test_cancel_and_empty_calls));
+
+    return test;
+}
@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_clock.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for the broker clock service
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CClock.hpp"
+#include "CGlobalConfiguration.hpp"
+#include "unit_test.hpp"
+
+using namespace boost::posix_time;
+using freedm::broker::CClock;
+using freedm::broker::CGlobalConfiguration;
+using freedm::broker::IClockSource;
+
+/// A clock whose readings are set by the test.
+class CFakeClockSource : public IClockSource
+{
+public:
+    CFakeClockSource()
+        : monotonic(from_time_t(1000)), wall(from_time_t(1300000000)) {}
+    virtual ptime GetMonotonicTime() { return monotonic; }
+    virtual ptime GetWallTime() { return wall; }
+    ptime monotonic;
+    ptime wall;
+};
+
+void test_dgi_time_follows_monotonic()
+{
+    boost::shared_ptr<CFakeClockSource> fake(new CFakeClockSource);
+    CClock::instance().SetSource(fake);
+    CGlobalConfiguration::instance().SetClockSkew(milliseconds(0));
+    ptime start = fake->wall;
+
+    BOOST_CHECK( CClock::instance().GetDGITime() == start );
+    fake->monotonic += seconds(5);
+    // A step of the wall clock must not move the DGI time.
+    fake->wall -= hours(1);
+    BOOST_CHECK( CClock::instance().GetDGITime() == start + seconds(5) );
+    CGlobalConfiguration::instance().SetClockSkew(milliseconds(-20));
+    BOOST_CHECK( CClock::instance().GetDGITime() ==
+        start + seconds(5) - milliseconds(20) );
+    CGlobalConfiguration::instance().SetClockSkew(milliseconds(0));
+    CClock::instance().SetSource(boost::shared_ptr<IClockSource>());
+}
+
+void test_cached_time_changes_on_tick()
+{
+    boost::shared_ptr<CFakeClockSource> fake(new CFakeClockSource);
+    CClock::instance().SetSource(fake);
+    ptime before = CClock::instance().GetCachedTime();
+
+    fake->monotonic += milliseconds(250);
+    BOOST_CHECK( CClock::instance().GetCachedTime() == before );
+    BOOST_CHECK( CClock::instance().GetMonotonicTime() ==
+        before + milliseconds(250) );
+    CClock::instance().Tick();
+    BOOST_CHECK( CClock::instance().GetCachedTime() ==
+        before + milliseconds(250) );
+    BOOST_CHECK( CClock::instance().GetCachedDGITime() ==
+        fake->wall + milliseconds(250) );
+    CClock::instance().SetSource(boost::shared_ptr<IClockSource>());
+}
+
+void test_system_clock_is_monotonic()
+{
+    ptime last = CClock::instance().GetMonotonicTime();
+    for(int i = 0; i < 1000; i++)
+    {
+        ptime now = CClock::instance().GetMonotonicTime();
+        BOOST_REQUIRE( now >= last );
+        last = now;
+    }
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("Clock Tests");
+
+    test->add(BOOST_TEST_CASE(&test_dgi_time_follows_monotonic));
+    test->add(BOOST_TEST_CASE(&test_cached_time_changes_on_tick));
+    test->add(BOOST_TEST_CASE(&test_system_clock_is_monotonic));
+
+    return test;
+}
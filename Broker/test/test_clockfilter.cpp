@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_clockfilter.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for the NTP style clock offset filter
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CClockFilter.hpp"
+#include "unit_test.hpp"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace boost::posix_time;
+using freedm::broker::CClockFilter;
+
+/// Measures a remote clock ahead by offset over legs with the given delays.
+CClockFilter::Sample Exchange(ptime t1, time_duration offset,
+        time_duration there, time_duration back)
+{
+    ptime t2 = t1 + there + offset;
+    ptime t3 = t2 + milliseconds(1);
+    ptime t4 = t3 - offset + back;
+    return CClockFilter::Measure(t1, t2, t3, t4);
+}
+
+void test_measure_removes_symmetric_delay()
+{
+    ptime t1(from_iso_string("20120101T000000"));
+
+    CClockFilter::Sample s = Exchange(t1, milliseconds(40),
+            milliseconds(5), milliseconds(5));
+    BOOST_CHECK_EQUAL( s.offset, milliseconds(40) );
+    BOOST_CHECK_EQUAL( s.delay, milliseconds(10) );
+
+    s = Exchange(t1, milliseconds(-25), milliseconds(3), milliseconds(3));
+    BOOST_CHECK_EQUAL( s.offset, milliseconds(-25) );
+
+    // An uneven delay is off by half the difference of the legs
+    s = Exchange(t1, milliseconds(0), milliseconds(30), milliseconds(2));
+    BOOST_CHECK_EQUAL( s.offset, milliseconds(14) );
+    BOOST_CHECK_EQUAL( s.delay, milliseconds(32) );
+}
+
+void test_filter_trusts_least_delay()
+{
+    ptime t1(from_iso_string("20120101T000000"));
+    CClockFilter f(milliseconds(100), 3);
+    CClockFilter::Sample best;
+
+    BOOST_CHECK( !f.GetBest(best) );
+    BOOST_CHECK( f.Add(Exchange(t1, milliseconds(10), milliseconds(40),
+            milliseconds(2))) );
+    BOOST_CHECK( f.Add(Exchange(t1, milliseconds(10), milliseconds(1),
+            milliseconds(1))) );
+    BOOST_CHECK( f.Add(Exchange(t1, milliseconds(10), milliseconds(2),
+            milliseconds(20))) );
+    BOOST_REQUIRE( f.GetBest(best) );
+    BOOST_CHECK_EQUAL( best.offset, milliseconds(10) );
+    BOOST_CHECK_EQUAL( best.delay, milliseconds(2) );
+
+    // A slow measurement is dropped...
+    BOOST_CHECK( !f.Add(Exchange(t1, milliseconds(10), milliseconds(90),
+            milliseconds(90))) );
+    // ...and the best one leaves the window once it is old.
+    f.Add(Exchange(t1, milliseconds(12), milliseconds(4), milliseconds(4)));
+    f.Add(Exchange(t1, milliseconds(12), milliseconds(5), milliseconds(5)));
+    f.Add(Exchange(t1, milliseconds(12), milliseconds(6), milliseconds(6)));
+    BOOST_REQUIRE( f.GetBest(best) );
+    BOOST_CHECK_EQUAL( best.offset, milliseconds(12) );
+    BOOST_CHECK_EQUAL( best.delay, milliseconds(8) );
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("Clock Filter Tests");
+
+    test->add(BOOST_TEST_CASE(&test_measure_removes_symmetric_delay));
+    test->add(BOOST_TEST_CASE(&test_filter_trusts_least_delay));
+
+    return test;
+}
@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_eventlog.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for the binary event log
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CEventLog.hpp"
+#include "unit_test.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using freedm::broker::CEventLog;
+
+namespace {
+
+const char * const FILE_NAME = "test_eventlog.bin";
+
+}
+
+void test_write_and_read()
+{
+    CEventLog & log = CEventLog::instance();
+    std::vector<CEventLog::Record> records;
+
+    log.Open(FILE_NAME, "node-uuid", 16);
+    BOOST_CHECK( log.IsOpen() );
+    log.Write(CEventLog::GM, CEventLog::GM_GROUP_CHANGED, 7, 1234);
+    log.Write(CEventLog::LB, CEventLog::LB_LOAD_TABLE, 1, 2, 3, 4, 5, 6);
+    log.Close();
+    BOOST_CHECK( !log.IsOpen() );
+    // Closed logs discard events.
+    log.Write(CEventLog::SC, CEventLog::SC_SNAPSHOT, 1);
+
+    CEventLog::Header header = CEventLog::Read(FILE_NAME, records);
+    BOOST_CHECK( std::string(header.s_uuid) == "node-uuid" );
+    BOOST_CHECK( header.s_capacity == 16 );
+    BOOST_REQUIRE( records.size() == 2 );
+    BOOST_CHECK( records[0].s_sequence == 1 );
+    BOOST_CHECK( records[0].s_event == CEventLog::GM_GROUP_CHANGED );
+    BOOST_CHECK( records[0].s_module == CEventLog::GM );
+    BOOST_CHECK( records[0].s_argc == 2 );
+    BOOST_CHECK( records[0].s_args[1] == 1234 );
+    BOOST_CHECK( records[1].s_argc == 6 );
+    BOOST_CHECK( records[1].s_args[5] == 6 );
+    BOOST_CHECK( records[0].s_time <= records[1].s_time );
+    std::remove(FILE_NAME);
+}
+
+void test_ring_keeps_newest()
+{
+    CEventLog & log = CEventLog::instance();
+    std::vector<CEventLog::Record> records;
+
+    log.Open(FILE_NAME, "node-uuid", 4);
+    for(int i = 0; i < 10; i++)
+    {
+        log.Write(CEventLog::SC, CEventLog::SC_SNAPSHOT, i);
+    }
+    log.Close();
+
+    CEventLog::Read(FILE_NAME, records);
+    BOOST_REQUIRE( records.size() == 4 );
+    for(int i = 0; i < 4; i++)
+    {
+        BOOST_CHECK( records[i].s_sequence == 7u + i );
+        BOOST_CHECK( records[i].s_args[0] == 6 + i );
+    }
+    std::remove(FILE_NAME);
+}
+
+void test_rejects_other_files()
+{
+    std::vector<CEventLog::Record> records;
+    {
+        std::ofstream out(FILE_NAME);
+        out << "this is a text log, not an event log" << std::endl;
+    }
+    BOOST_CHECK_THROW( CEventLog::Read(FILE_NAME, records),
+            std::runtime_error );
+    std::remove(FILE_NAME);
+}
+
+void test_describe()
+{
+    const CEventLog::EventInfo * info =
+            CEventLog::Describe(CEventLog::LB_MIGRATION);
+
+    BOOST_REQUIRE( info != 0 );
+    BOOST_CHECK( std::string(info->s_name) == "lb.migration" );
+    BOOST_CHECK( info->s_argc == 3 );
+    BOOST_CHECK( CEventLog::Describe(0) == 0 );
+    BOOST_CHECK( CEventLog::Describe(CEventLog::EVENT_COUNT) == 0 );
+    BOOST_CHECK( std::string(CEventLog::ModuleName(CEventLog::SC)) == "sc" );
+    // FNV-1a of the empty string is its offset basis.
+    BOOST_CHECK( CEventLog::Hash("") == 2166136261.0 );
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("Event Log Tests");
+
+    test->add(BOOST_TEST_CASE(&test_write_and_read));
+    test->add(BOOST_TEST_CASE(&test_ring_keeps_newest));
+    test->add(BOOST_TEST_CASE(&test_rejects_other_files));
+    test->add(BOOST_TEST_CASE(&test_describe));
+
+    return test;
+}
@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_failuredetector.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for the phi accrual failure detector
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CFailureDetector.hpp"
+#include "unit_test.hpp"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
+
+using namespace boost::posix_time;
+using freedm::broker::CFailureDetector;
+using freedm::broker::CPhiAccrualDetector;
+using freedm::broker::IFailureDetector;
+
+/// Sends a heartbeat every interval, count times, starting at start.
+ptime Beat(CPhiAccrualDetector & d, ptime start, time_duration interval,
+        unsigned int count)
+{
+    for(unsigned int i = 0; i < count; i++)
+    {
+        d.Heartbeat("peer", start + interval * i);
+    }
+    return start + interval * (count - 1);
+}
+
+void test_unknown_peer_suspected()
+{
+    CPhiAccrualDetector d(milliseconds(0));
+    ptime now(from_iso_string("20120101T000000"));
+
+    BOOST_CHECK( d.GetSuspicion("peer", now) > 1e6 );
+    d.Heartbeat("peer", now);
+    BOOST_CHECK( d.GetSuspicion("peer", now) < 0.1 );
+    BOOST_CHECK( d.GetSuspicion("other", now) > 1e6 );
+}
+
+void test_suspicion_grows_with_silence()
+{
+    CPhiAccrualDetector d(milliseconds(0));
+    ptime last = Beat(d, ptime(from_iso_string("20120101T000000")),
+            milliseconds(100), 200);
+
+    double on_time = d.GetSuspicion("peer", last + milliseconds(100));
+    double late = d.GetSuspicion("peer", last + milliseconds(300));
+    double later = d.GetSuspicion("peer", last + milliseconds(800));
+    BOOST_CHECK( on_time < 1 );
+    BOOST_CHECK( late > on_time );
+    BOOST_CHECK( later > late );
+    BOOST_CHECK( later > 8 );
+}
+
+void test_pause_and_irregular_peers_tolerated()
+{
+    // The same silence is less suspicious for a peer allowed a pause...
+    ptime start(from_iso_string("20120101T000000"));
+    CPhiAccrualDetector strict(milliseconds(0)), lenient(milliseconds(500));
+    ptime last = Beat(strict, start, milliseconds(100), 50);
+    Beat(lenient, start, milliseconds(100), 50);
+    BOOST_CHECK( lenient.GetSuspicion("peer", last + milliseconds(500)) <
+            strict.GetSuspicion("peer", last + milliseconds(500)) );
+
+    // ...and for a peer whose messages have always come irregularly.
+    CPhiAccrualDetector regular(milliseconds(0)), irregular(milliseconds(0));
+    ptime regularLast = Beat(regular, start, milliseconds(200), 50);
+    ptime irregularLast = start;
+    for(unsigned int i = 0; i < 50; i++)
+    {
+        irregularLast += milliseconds(i % 2 ? 50 : 350);
+        irregular.Heartbeat("peer", irregularLast);
+    }
+    BOOST_CHECK( irregular.GetSuspicion("peer", irregularLast +
+            milliseconds(600)) <
+            regular.GetSuspicion("peer", regularLast + milliseconds(600)) );
+}
+
+void test_singleton_without_detector()
+{
+    CFailureDetector & fd = CFailureDetector::instance();
+
+    fd.Heartbeat("peer");
+    BOOST_CHECK( fd.GetSuspicion("peer") == 0 );
+    BOOST_CHECK( !fd.IsTrusted("peer") );
+    fd.SetDetector(boost::shared_ptr<IFailureDetector>(
+            new CPhiAccrualDetector(seconds(1))), 8);
+    BOOST_CHECK( !fd.IsTrusted("peer") );
+    fd.Heartbeat("peer");
+    BOOST_CHECK( fd.IsTrusted("peer") );
+    fd.SetDetector(boost::shared_ptr<IFailureDetector>(), 0);
+    BOOST_CHECK( !fd.IsTrusted("peer") );
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("Failure Detector Tests");
+
+    test->add(BOOST_TEST_CASE(&test_unknown_peer_suspected));
+    test->add(BOOST_TEST_CASE(&test_suspicion_grows_with_silence));
+    test->add(BOOST_TEST_CASE(&test_pause_and_irregular_peers_tolerated));
+    test->add(BOOST_TEST_CASE(&test_singleton_without_detector));
+
+    return test;
+}
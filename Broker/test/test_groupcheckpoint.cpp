@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_groupcheckpoint.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for the group state kept across restarts
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+///////////////////////////////////////////////////////////////////////////////
+
+
+#include "gm/GroupCheckpoint.hpp"
+#include "unit_test.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using freedm::broker::gm::GroupCheckpoint;
+
+typedef GroupCheckpoint::Member Member;
+
+namespace {
+
+/// Where the tests write their checkpoints.
+const std::string FILENAME = "test_groupcheckpoint.xml";
+
+}
+
+void test_saved_group_loads()
+{
+    GroupCheckpoint saved;
+    saved.group = 4027;
+    saved.leader = "b";
+    saved.members.push_back(Member("a", "host-a", "1870"));
+    saved.members.push_back(Member("b", "host-b", "1871"));
+
+    BOOST_REQUIRE( saved.Save(FILENAME) );
+    GroupCheckpoint loaded;
+    BOOST_REQUIRE( loaded.Load(FILENAME) );
+    BOOST_CHECK( loaded == saved );
+    BOOST_CHECK_EQUAL( loaded.group, 4027u );
+    BOOST_REQUIRE_EQUAL( loaded.members.size(), 2u );
+    BOOST_CHECK_EQUAL( loaded.members[1].host, "host-b" );
+
+    // A solo group has no members to list.
+    GroupCheckpoint solo;
+    solo.group = 7;
+    solo.leader = "a";
+    BOOST_REQUIRE( solo.Save(FILENAME) );
+    BOOST_REQUIRE( loaded.Load(FILENAME) );
+    BOOST_CHECK( loaded == solo );
+    std::remove(FILENAME.c_str());
+}
+
+void test_bad_file_is_not_loaded()
+{
+    GroupCheckpoint kept;
+    kept.group = 12;
+    kept.leader = "c";
+
+    std::remove(FILENAME.c_str());
+    BOOST_CHECK( !kept.Load(FILENAME) );
+    {
+        std::ofstream out(FILENAME.c_str());
+        out << "<checkpoint><group>twelve</group></checkpoint>";
+    }
+    BOOST_CHECK( !kept.Load(FILENAME) );
+    // A failed load leaves the checkpoint as it was.
+    BOOST_CHECK_EQUAL( kept.group, 12u );
+    BOOST_CHECK_EQUAL( kept.leader, "c" );
+    std::remove(FILENAME.c_str());
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("Group Checkpoint Tests");
+
+    test->add(BOOST_TEST_CASE(&test_saved_group_loads));
+    test->add(BOOST_TEST_CASE(&test_bad_file_is_not_loaded));
+
+    return test;
+}
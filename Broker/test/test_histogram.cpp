@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_histogram.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for the scheduler latency histogram
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CHistogram.hpp"
+#include "unit_test.hpp"
+
+#include <sstream>
+
+using freedm::broker::CHistogram;
+
+void test_empty()
+{
+    CHistogram h;
+
+    BOOST_CHECK( h.GetCount() == 0 );
+    BOOST_CHECK( h.GetMin() == 0 );
+    BOOST_CHECK( h.GetMax() == 0 );
+    BOOST_CHECK( h.GetMean() == 0 );
+    BOOST_CHECK( h.GetPercentile(50) == 0 );
+}
+
+void test_small_values_exact()
+{
+    // Values below twice the sub-bucket count each have their own bucket.
+    CHistogram h;
+
+    for(CHistogram::Value v = 1; v <= 10; v++)
+    {
+        h.Record(v);
+    }
+    BOOST_CHECK( h.GetCount() == 10 );
+    BOOST_CHECK( h.GetMin() == 1 );
+    BOOST_CHECK( h.GetMax() == 10 );
+    BOOST_CHECK( h.GetMean() == 5.5 );
+    BOOST_CHECK( h.GetPercentile(50) == 5 );
+    BOOST_CHECK( h.GetPercentile(90) == 9 );
+    BOOST_CHECK( h.GetPercentile(100) == 10 );
+}
+
+void test_relative_error()
+{
+    // Large values are reported within one sub-bucket (1/16) of the truth.
+    CHistogram h;
+
+    for(CHistogram::Value v = 1; v <= 100000; v++)
+    {
+        h.Record(v);
+    }
+    CHistogram::Value p50 = h.GetPercentile(50);
+    CHistogram::Value p99 = h.GetPercentile(99);
+    BOOST_CHECK( p50 >= 50000 && p50 <= 50000 + 50000/16 );
+    BOOST_CHECK( p99 >= 99000 && p99 <= 100000 );
+    BOOST_CHECK( h.GetMax() == 100000 );
+}
+
+void test_reset_and_print()
+{
+    CHistogram h;
+    std::stringstream ss;
+
+    h.Record(~CHistogram::Value(0));
+    BOOST_CHECK( h.GetPercentile(50) == ~CHistogram::Value(0) );
+    h.Reset();
+    BOOST_CHECK( h.GetCount() == 0 );
+    h.Record(7);
+    ss << h;
+    BOOST_CHECK( ss.str().find("count=1 min=7") == 0 );
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("Histogram Tests");
+
+    test->add(BOOST_TEST_CASE(&test_empty));
+    test->add(BOOST_TEST_CASE(&test_small_values_exact));
+    test->add(BOOST_TEST_CASE(&test_relative_error));
+    test->add(BOOST_TEST_CASE(&test_reset_and_print));
+
+    return test;
+}
@@ -0,0 +1,157 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_logwriter.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for the background log writer and level filtering
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CLogger.hpp"
+#include "unit_test.hpp"
+
+#include <sstream>
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+using freedm::broker::CGlobalLogger;
+using freedm::broker::CLocalLogger;
+using freedm::broker::CLogWriter;
+
+namespace {
+
+CLocalLogger Logger(__FILE__);
+
+const int THREADS = 4;
+const int COUNT = 500;
+
+void LogLines(int id)
+{
+    for(int i = 0; i < COUNT; i++)
+    {
+        Logger.Info << "thread " << id << " line " << i << std::endl;
+    }
+}
+
+int CountLines(const std::string & text, const std::string & needle)
+{
+    int count = 0;
+    std::string::size_type pos = text.find(needle);
+    while(pos != std::string::npos)
+    {
+        count++;
+        pos = text.find(needle, pos + 1);
+    }
+    return count;
+}
+
+}
+
+void test_synchronous_until_started()
+{
+    std::ostringstream out;
+
+    CGlobalLogger::instance().SetGlobalLevel(6);
+    BOOST_CHECK( !CLogWriter::instance().IsRunning() );
+    Logger.Info << "before start" << std::endl;
+    Logger.Debug << "filtered" << std::endl;
+    CLogWriter::instance().Start(&out);
+    BOOST_CHECK( CLogWriter::instance().IsRunning() );
+    Logger.Info << "after start" << std::endl;
+    CLogWriter::instance().Stop();
+    BOOST_CHECK( !CLogWriter::instance().IsRunning() );
+    BOOST_CHECK( CountLines(out.str(), "after start") == 1 );
+    BOOST_CHECK( CountLines(out.str(), "filtered") == 0 );
+    BOOST_CHECK( CountLines(out.str(), "test_logwriter.cpp : Info(6)") == 1 );
+}
+
+void test_every_thread_written()
+{
+    std::ostringstream out;
+    boost::thread_group threads;
+
+    CGlobalLogger::instance().SetGlobalLevel(6);
+    CLogWriter::instance().Start(&out);
+    for(int i = 0; i < THREADS; i++)
+    {
+        threads.create_thread(boost::bind(&LogLines, i));
+    }
+    threads.join_all();
+    CLogWriter::instance().Stop();
+
+    // Each record is either written or counted as dropped, never both.
+    int written = CountLines(out.str(), " line ");
+    BOOST_CHECK( written + CLogWriter::instance().GetDropped() ==
+            static_cast<unsigned int>(THREADS * COUNT) );
+    // Records of one thread stay in the order they were logged.
+    std::string text = out.str();
+    std::string::size_type first = text.find("thread 0 line 0\n");
+    std::string::size_type last = text.find("thread 0 line 1\n");
+    if(first != std::string::npos && last != std::string::npos)
+    {
+        BOOST_CHECK( first < last );
+    }
+}
+
+void test_cached_levels()
+{
+    CGlobalLogger::instance().SetGlobalLevel(6);
+    BOOST_CHECK( Logger.GetOutputLevel() == 6 );
+    BOOST_CHECK( Logger.Info.IsEnabled() );
+    BOOST_CHECK( !Logger.Debug.IsEnabled() );
+
+    // A disabled level hands back a stream which formats nothing.
+    std::ostream & disabled = (Logger.Debug << "ignored");
+    BOOST_CHECK( disabled.bad() );
+    std::ostream & enabled = (Logger.Info << "");
+    BOOST_CHECK( !enabled.bad() );
+    Logger.Info << std::flush;
+
+    // Changing the level by name reaches every logger of that name.
+    CGlobalLogger::instance().SetOutputLevel(Logger.GetName(), 8);
+    BOOST_CHECK( Logger.GetOutputLevel() == 8 );
+    BOOST_CHECK( Logger.Trace.IsEnabled() );
+    {
+        CLocalLogger other(__FILE__);
+        BOOST_CHECK( other.GetOutputLevel() == 8 );
+        other.SetOutputLevel(2);
+        BOOST_CHECK( Logger.GetOutputLevel() == 2 );
+    }
+    CGlobalLogger::instance().SetGlobalLevel(6);
+    BOOST_CHECK( Logger.GetOutputLevel() == 6 );
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("Log Writer Tests");
+
+    test->add(BOOST_TEST_CASE(&test_synchronous_until_started));
+    test->add(BOOST_TEST_CASE(&test_every_thread_written));
+    test->add(BOOST_TEST_CASE(&test_cached_levels));
+
+    return test;
+}
@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_metricsregistry.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for the registry of named counters and histograms
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CMetricsRegistry.hpp"
+#include "unit_test.hpp"
+
+#include <sstream>
+
+using freedm::broker::CMetricsRegistry;
+
+void test_counter_is_shared_by_name()
+{
+    CMetricsRegistry & registry = CMetricsRegistry::instance();
+    CMetricsRegistry::Counter & a = registry.GetCounter("test.shared");
+    a.fetch_add(2);
+    BOOST_CHECK( &registry.GetCounter("test.shared") == &a );
+    BOOST_CHECK( registry.GetCounter("test.shared").load() == 2 );
+}
+
+void test_histogram_is_shared_by_name()
+{
+    CMetricsRegistry & registry = CMetricsRegistry::instance();
+    CMetricsRegistry::Histogram & h = registry.GetHistogram("test.latency");
+    h.Record(3);
+    h.Record(5);
+    BOOST_CHECK( &registry.GetHistogram("test.latency") == &h );
+    BOOST_CHECK( h.GetSnapshot().GetCount() == 2 );
+    BOOST_CHECK( h.GetSnapshot().GetMax() == 5 );
+}
+
+void test_print()
+{
+    CMetricsRegistry & registry = CMetricsRegistry::instance();
+    registry.GetCounter("test.printed").fetch_add(7);
+    registry.GetHistogram("test.printed.us").Record(40);
+    std::stringstream ss;
+    registry.Print(ss);
+    BOOST_CHECK( ss.str().find("test.printed 7\n") != std::string::npos );
+    BOOST_CHECK( ss.str().find("test.printed.us.count 1\n") != std::string::npos );
+    BOOST_CHECK( ss.str().find("test.printed.us.max 40\n") != std::string::npos );
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("Metrics Registry Tests");
+
+    test->add(BOOST_TEST_CASE(&test_counter_is_shared_by_name));
+    test->add(BOOST_TEST_CASE(&test_histogram_is_shared_by_name));
+    test->add(BOOST_TEST_CASE(&test_print));
+
+    return test;
+}
@@ -0,0 +1,164 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_networkemulator.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for the network emulator
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CNetworkEmulator.hpp"
+#include "unit_test.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/bind.hpp>
+
+using freedm::broker::CNetworkEmulator;
+
+namespace {
+
+const char * SETTINGS_FILE = "test_network.xml";
+
+void WriteSettings(const std::string & body)
+{
+    std::ofstream out(SETTINGS_FILE);
+    out << "<network><seed>7</seed>" << body << "</network>" << std::endl;
+}
+
+void Count(int * count)
+{
+    (*count)++;
+}
+
+unsigned int Deliver(CNetworkEmulator::Direction dir, const std::string & uuid,
+        boost::asio::io_service::strand & strand, int * count)
+{
+    return CNetworkEmulator::instance().Deliver(dir, uuid, 100, strand,
+            boost::bind(&Count, count));
+}
+
+}
+
+void test_disabled()
+{
+    boost::asio::io_service ios;
+    boost::asio::io_service::strand strand(ios);
+    int count = 0;
+
+    CNetworkEmulator::instance().Disable();
+    BOOST_CHECK( !CNetworkEmulator::instance().IsEnabled() );
+    BOOST_CHECK( Deliver(CNetworkEmulator::OUTGOING, "a", strand, &count) == 1 );
+    BOOST_CHECK( CNetworkEmulator::instance().GetPending() == 0 );
+}
+
+void test_loss_and_duplicates()
+{
+    boost::asio::io_service ios;
+    boost::asio::io_service::strand strand(ios);
+    int count = 0;
+
+    // Nothing reaches b, everything to c is doubled, and the legacy
+    // reliability element is still understood.
+    WriteSettings("<outgoing><channel uuid=\"b\"><reliability>0</reliability>"
+        "</channel><channel uuid=\"c\"><duplicate>1</duplicate></channel>"
+        "</outgoing>");
+    BOOST_REQUIRE( CNetworkEmulator::instance().Load(SETTINGS_FILE) );
+    for(int i = 0; i < 10; i++)
+    {
+        BOOST_CHECK( Deliver(CNetworkEmulator::OUTGOING, "a", strand, &count) == 1 );
+        BOOST_CHECK( Deliver(CNetworkEmulator::OUTGOING, "b", strand, &count) == 0 );
+        BOOST_CHECK( Deliver(CNetworkEmulator::OUTGOING, "c", strand, &count) == 2 );
+        BOOST_CHECK( Deliver(CNetworkEmulator::INCOMING, "b", strand, &count) == 1 );
+    }
+    CNetworkEmulator::instance().Disable();
+}
+
+void test_burst_loss()
+{
+    boost::asio::io_service ios;
+    boost::asio::io_service::strand strand(ios);
+    int count = 0, delivered = 0;
+
+    // The link enters the bad state on the first datagram and never leaves.
+    WriteSettings("<incoming><burst><enter>1</enter><leave>0</leave>"
+        "<loss>1</loss></burst></incoming>");
+    BOOST_REQUIRE( CNetworkEmulator::instance().Load(SETTINGS_FILE) );
+    for(int i = 0; i < 20; i++)
+    {
+        delivered += Deliver(CNetworkEmulator::INCOMING, "a", strand, &count);
+    }
+    BOOST_CHECK( delivered == 0 );
+
+    // Half the time in the bad state loses roughly half the datagrams.
+    WriteSettings("<incoming><burst><enter>0.5</enter><leave>0.5</leave>"
+        "<loss>1</loss></burst></incoming>");
+    BOOST_REQUIRE( CNetworkEmulator::instance().Load(SETTINGS_FILE) );
+    for(int i = 0; i < 1000; i++)
+    {
+        delivered += Deliver(CNetworkEmulator::INCOMING, "a", strand, &count);
+    }
+    BOOST_CHECK( delivered > 400 && delivered < 600 );
+    CNetworkEmulator::instance().Disable();
+}
+
+void test_delay()
+{
+    boost::asio::io_service ios;
+    boost::asio::io_service::strand strand(ios);
+    int count = 0;
+
+    WriteSettings("<outgoing><delay>10</delay><duplicate>1</duplicate>"
+        "</outgoing>");
+    CNetworkEmulator::instance().Start(ios, SETTINGS_FILE,
+            boost::posix_time::hours(1));
+    BOOST_REQUIRE( CNetworkEmulator::instance().IsEnabled() );
+    BOOST_CHECK( Deliver(CNetworkEmulator::OUTGOING, "a", strand, &count) == 0 );
+    BOOST_CHECK( CNetworkEmulator::instance().GetPending() == 2 );
+    while(count < 2)
+    {
+        ios.run_one();
+    }
+    BOOST_CHECK( CNetworkEmulator::instance().GetPending() == 0 );
+    CNetworkEmulator::instance().Stop();
+    CNetworkEmulator::instance().Disable();
+    std::remove(SETTINGS_FILE);
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("Network Emulator Tests");
+
+    test->add(BOOST_TEST_CASE(&test_disabled));
+    test->add(BOOST_TEST_CASE(&test_loss_and_duplicates));
+    test->add(BOOST_TEST_CASE(&test_burst_loss));
+    test->add(BOOST_TEST_CASE(&test_delay));
+
+    return test;
+}
@@ -0,0 +1,133 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_readyqueue.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for the broker's ready queue
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CReadyQueue.hpp"
+#include "unit_test.hpp"
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+using freedm::broker::CReadyQueue;
+
+void test_fifo_order()
+{
+    CReadyQueue<int> q(4);
+    int x;
+
+    BOOST_CHECK( !q.Pop(x) );
+    for(int i = 0; i < 3; i++)
+    {
+        q.Push(i);
+    }
+    BOOST_CHECK( q.Size() == 3 );
+    for(int i = 0; i < 3; i++)
+    {
+        BOOST_CHECK( q.Pop(x) );
+        BOOST_CHECK( x == i );
+    }
+    BOOST_CHECK( q.Empty() );
+}
+
+void test_overflow_order()
+{
+    // Twenty items through a ring of four must overflow and still come back
+    // in the order they were pushed, even when pops are interleaved.
+    CReadyQueue<int> q(4);
+    int x, next = 0;
+
+    for(int i = 0; i < 10; i++)
+    {
+        q.Push(i);
+    }
+    BOOST_CHECK( q.GetOverflowCount() > 0 );
+    for(int i = 0; i < 5; i++)
+    {
+        BOOST_CHECK( q.Pop(x) );
+        BOOST_CHECK( x == next++ );
+    }
+    for(int i = 10; i < 20; i++)
+    {
+        q.Push(i);
+    }
+    while(q.Pop(x))
+    {
+        BOOST_CHECK( x == next++ );
+    }
+    BOOST_CHECK( next == 20 );
+}
+
+void push_range(CReadyQueue<int> * q, int first, int count)
+{
+    for(int i = first; i < first + count; i++)
+    {
+        q->Push(i);
+    }
+}
+
+void test_many_producers()
+{
+    const int PRODUCERS = 4;
+    const int COUNT = 10000;
+    CReadyQueue<int> q(64);
+    boost::thread_group producers;
+    std::vector<int> last(PRODUCERS, -1);
+    int x, popped = 0;
+
+    for(int i = 0; i < PRODUCERS; i++)
+    {
+        producers.create_thread(boost::bind(&push_range, &q, i*COUNT, COUNT));
+    }
+    while(popped < PRODUCERS*COUNT)
+    {
+        if(q.Pop(x))
+        {
+            // Items from one producer must arrive in the order pushed.
+            BOOST_REQUIRE( x > last[x/COUNT] );
+            last[x/COUNT] = x;
+            popped++;
+        }
+    }
+    producers.join_all();
+    BOOST_CHECK( !q.Pop(x) );
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("Ready Queue Tests");
+
+    test->add(BOOST_TEST_CASE(&test_fifo_order));
+    test->add(BOOST_TEST_CASE(&test_overflow_order));
+    test->add(BOOST_TEST_CASE(&test_many_producers));
+
+    return test;
+}
@@ -0,0 +1,254 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_simulation.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for the group management simulator
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+
+#include "sim/CSimGMAgent.hpp"
+#include "sim/CSimNetwork.hpp"
+#include "sim/CSimulation.hpp"
+#include "unit_test.hpp"
+
+#include <vector>
+
+#include <boost/bind.hpp>
+
+using namespace boost::posix_time;
+using freedm::broker::sim::CSimGMAgent;
+using freedm::broker::sim::CSimNetwork;
+using freedm::broker::sim::CSimulation;
+
+/// Appends a value to a log, to record the order events ran in.
+void Append(std::vector<int> * log, int value)
+{
+    log->push_back(value);
+}
+
+void test_events_run_in_time_order()
+{
+    CSimulation sim(1);
+    std::vector<int> log;
+    ptime start = sim.GetTime();
+
+    sim.Schedule(milliseconds(20), boost::bind(&Append, &log, 3));
+    sim.Schedule(milliseconds(10), boost::bind(&Append, &log, 1));
+    sim.Schedule(milliseconds(10), boost::bind(&Append, &log, 2));
+    sim.Schedule(seconds(10), boost::bind(&Append, &log, 4));
+    sim.Run(seconds(1));
+    BOOST_REQUIRE( log.size() == 3 );
+    BOOST_CHECK( log[0] == 1 && log[1] == 2 && log[2] == 3 );
+    // The clock jumps to the end of the run, not to the next event.
+    BOOST_CHECK( sim.GetTime() == start + seconds(1) );
+    BOOST_CHECK( sim.GetMonotonicTime() == sim.GetTime() );
+    sim.Run(seconds(20));
+    BOOST_CHECK( log.size() == 4 );
+    BOOST_CHECK( sim.GetEventCount() == 4 );
+}
+
+void test_same_seed_same_draws()
+{
+    CSimulation a(42), b(42), c(43);
+    bool differs = false;
+    for(int i = 0; i < 100; i++)
+    {
+        double x = a.Random();
+        BOOST_CHECK( x >= 0 && x < 1 );
+        BOOST_CHECK( x == b.Random() );
+        differs = differs || (x != c.Random());
+        BOOST_CHECK( a.Random(7) == b.Random(7) );
+        c.Random(7);
+    }
+    BOOST_CHECK( differs );
+}
+
+void test_network_latency_and_partitions()
+{
+    CSimulation sim(1);
+    CSimNetwork net(sim, 3);
+    std::vector<int> log;
+    ptime start = sim.GetTime();
+
+    net.SetLatency(milliseconds(5), milliseconds(0));
+    net.Send(0, 1, ptime(), boost::bind(&Append, &log, 1));
+    net.SetPartition(2, 1);
+    BOOST_CHECK( !net.IsReachable(0, 2) );
+    net.Send(0, 2, start + seconds(1), boost::bind(&Append, &log, 2));
+    sim.Run(milliseconds(4));
+    BOOST_CHECK( log.empty() );
+    sim.Run(milliseconds(5));
+    BOOST_REQUIRE( log.size() == 1 );
+    BOOST_CHECK( log[0] == 1 );
+    BOOST_CHECK( net.GetLostCount() == 1 );
+    // The sender resends every 25 ms until the message expires.
+    BOOST_CHECK( net.GetDatagramCount() == 1 + 1 + 40 );
+    net.Heal();
+    BOOST_CHECK( net.IsReachable(0, 2) );
+}
+
+void test_lost_datagrams_are_resent()
+{
+    CSimulation sim(1);
+    CSimNetwork net(sim, 2);
+    std::vector<int> log;
+
+    net.SetLoss(1);
+    net.Send(0, 1, sim.GetTime() + milliseconds(100),
+            boost::bind(&Append, &log, 1));
+    sim.Run(seconds(1));
+    BOOST_CHECK( log.empty() );
+    BOOST_CHECK( net.GetDatagramCount() == 5 );
+    BOOST_CHECK( net.GetLostCount() == 1 );
+}
+
+void test_agents_elect_one_leader()
+{
+    CSimulation sim(3);
+    CSimNetwork net(sim, 5);
+    std::vector<CSimGMAgent *> agents;
+    for(unsigned int i = 0; i < 5; i++)
+    {
+        agents.push_back(new CSimGMAgent(i, sim, net, agents));
+        agents[i]->SetPhase(seconds(1), milliseconds(200));
+    }
+    for(unsigned int i = 0; i < 5; i++)
+    {
+        agents[i]->Start();
+    }
+    sim.Run(seconds(30));
+    unsigned int leader = agents[0]->GetLeader();
+    BOOST_CHECK( agents[leader]->IsCoordinator() );
+    BOOST_CHECK( agents[leader]->GetUpNodes().size() == 4 );
+    for(unsigned int i = 0; i < 5; i++)
+    {
+        BOOST_CHECK( agents[i]->GetLeader() == leader );
+        BOOST_CHECK( agents[i]->GetStatus() == CSimGMAgent::NORMAL );
+    }
+    for(unsigned int i = 0; i < 5; i++)
+    {
+        delete agents[i];
+    }
+}
+
+void test_fast_merge_elects_highest_priority()
+{
+    CSimulation sim(3);
+    CSimNetwork net(sim, 5);
+    std::vector<CSimGMAgent *> agents;
+    unsigned int highest = 0;
+    for(unsigned int i = 0; i < 5; i++)
+    {
+        agents.push_back(new CSimGMAgent(i, sim, net, agents));
+        agents[i]->SetPhase(seconds(1), milliseconds(200));
+        agents[i]->SetFastMerge(true);
+        if(agents[i]->GetPriority() > agents[highest]->GetPriority())
+        {
+            highest = i;
+        }
+    }
+    for(unsigned int i = 0; i < 5; i++)
+    {
+        agents[i]->Start();
+    }
+    sim.Run(seconds(30));
+    BOOST_CHECK( agents[highest]->IsCoordinator() );
+    BOOST_CHECK( agents[highest]->GetUpNodes().size() == 4 );
+    for(unsigned int i = 0; i < 5; i++)
+    {
+        BOOST_CHECK( agents[i]->GetLeader() == highest );
+        BOOST_CHECK( agents[i]->GetStatus() == CSimGMAgent::NORMAL );
+    }
+    for(unsigned int i = 0; i < 5; i++)
+    {
+        delete agents[i];
+    }
+}
+
+void test_zone_leaders_elect_one_top_leader()
+{
+    CSimulation sim(5);
+    CSimNetwork net(sim, 9);
+    std::vector<CSimGMAgent *> agents, tiers;
+    std::vector<unsigned int> zones;
+    for(unsigned int i = 0; i < 9; i++)
+    {
+        zones.push_back(i / 3);
+    }
+    for(unsigned int i = 0; i < 9; i++)
+    {
+        CSimGMAgent::PeerSet zone;
+        for(unsigned int j = 0; j < 9; j++)
+        {
+            if(zones[j] == zones[i])
+            {
+                zone.insert(j);
+            }
+        }
+        agents.push_back(new CSimGMAgent(i, sim, net, agents));
+        agents[i]->SetScope(zone);
+        tiers.push_back(new CSimGMAgent(i, sim, net, tiers));
+        tiers[i]->SetLower(agents[i], zones);
+    }
+    for(unsigned int i = 0; i < 9; i++)
+    {
+        agents[i]->Start();
+        tiers[i]->Start();
+    }
+    sim.Run(seconds(30));
+    unsigned int top = tiers[agents[0]->GetLeader()]->GetLeader();
+    BOOST_CHECK( tiers[top]->GetUpNodes().size() == 2 );
+    for(unsigned int i = 0; i < 9; i++)
+    {
+        // Every zone agent only groups with its own zone.
+        unsigned int leader = agents[i]->GetLeader();
+        BOOST_CHECK( zones[leader] == zones[i] );
+        BOOST_CHECK( agents[i]->GetUpNodes().size() == 2 );
+        BOOST_CHECK( agents[i]->GetStatus() == CSimGMAgent::NORMAL );
+        BOOST_CHECK( tiers[leader]->GetLeader() == top );
+        // The top leader's view reaches every node.
+        BOOST_CHECK( agents[i]->GetGroup().size() == 9 );
+    }
+    for(unsigned int i = 0; i < 9; i++)
+    {
+        delete agents[i];
+        delete tiers[i];
+    }
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("Simulator Tests");
+
+    test->add(BOOST_TEST_CASE(&test_events_run_in_time_order));
+    test->add(BOOST_TEST_CASE(&test_same_seed_same_draws));
+    test->add(BOOST_TEST_CASE(&test_network_latency_and_partitions));
+    test->add(BOOST_TEST_CASE(&test_lost_datagrams_are_resent));
+    test->add(BOOST_TEST_CASE(&test_agents_elect_one_leader));
+    test->add(BOOST_TEST_CASE(&test_fast_merge_elects_highest_priority));
+    test->add(BOOST_TEST_CASE(&test_zone_leaders_elect_one_top_leader));
+
+    return test;
+}
@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////////////
+/// @file      test_swimmembers.cpp
+///
+/// @compiler  C++
+///
+/// @project   FREEDM DGI
+///
+/// @description Tests for the membership table of the SWIM group management
+///
+/// @license
+/// These source code files were created at as part of the
+/// FREEDM DGI Subthrust, and are
+/// intended for use in teaching or research.  They may be 
+/// freely copied, modified and redistributed as long
+/// as modified versions are clearly marked as such and
+/// this notice is not removed.
+/// 
+/// Neither the authors nor the FREEDM Project nor the
+/// National Science Foundation
+/// make any warranty, express or implied, nor assumes
+/// any legal responsibility for the accuracy,
+/// completeness or usefulness of these codes or any
+/// information distributed with these codes.
+///
+/// Suggested modifications or questions about these codes 
+/// can be directed to Dr. Bruce McMillin, Department of 
+/// Computer Science, Missour University of Science and
+/// Technology, Rolla, /// MO  65409 (ff@mst.edu).
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#include "gm/SwimMemberList.hpp"
+#include "unit_test.hpp"
+
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace boost::posix_time;
+using freedm::broker::gm::SwimMemberList;
+
+typedef SwimMemberList::Update Update;
+
+void test_newer_news_overrides()
+{
+    SwimMemberList m("b");
+    ptime now(from_iso_string("20120101T000000"));
+
+    BOOST_CHECK( m.Apply(Update("a", SwimMemberList::ALIVE, 0), now) );
+    BOOST_CHECK( !m.Apply(Update("a", SwimMemberList::ALIVE, 0), now) );
+    // A suspicion overrides alive news of the same incarnation...
+    BOOST_CHECK( m.Apply(Update("a", SwimMemberList::SUSPECT, 0), now) );
+    BOOST_CHECK( !m.Apply(Update("a", SwimMemberList::ALIVE, 0), now) );
+    BOOST_CHECK( m.IsMember("a") );
+    // ...but not news from a newer incarnation, which only a death beats.
+    BOOST_CHECK( m.Apply(Update("a", SwimMemberList::ALIVE, 1), now) );
+    BOOST_CHECK( !m.Apply(Update("a", SwimMemberList::SUSPECT, 0), now) );
+    BOOST_CHECK( m.Apply(Update("a", SwimMemberList::DEAD, 1), now) );
+    BOOST_CHECK( !m.Apply(Update("a", SwimMemberList::SUSPECT, 1), now) );
+    BOOST_CHECK( !m.IsMember("a") );
+    BOOST_CHECK( m.Apply(Update("a", SwimMemberList::ALIVE, 2), now) );
+    BOOST_CHECK( m.IsMember("a") );
+}
+
+void test_refutes_news_about_itself()
+{
+    SwimMemberList m("b");
+    ptime now(from_iso_string("20120101T000000"));
+
+    BOOST_CHECK( !m.Apply(Update("b", SwimMemberList::ALIVE, 5), now) );
+    BOOST_CHECK_EQUAL( m.GetIncarnation(), 0u );
+    BOOST_CHECK( m.Apply(Update("b", SwimMemberList::SUSPECT, 0), now) );
+    BOOST_CHECK_EQUAL( m.GetIncarnation(), 1u );
+    BOOST_CHECK( !m.Apply(Update("b", SwimMemberList::DEAD, 0), now) );
+    BOOST_CHECK( m.Apply(Update("b", SwimMemberList::DEAD, 3), now) );
+    BOOST_CHECK_EQUAL( m.GetIncarnation(), 4u );
+    BOOST_CHECK( m.Get("b").state == SwimMemberList::ALIVE );
+}
+
+void test_suspicion_expires()
+{
+    SwimMemberList m("b");
+    ptime now(from_iso_string("20120101T000000"));
+
+    m.Apply(Update("a", SwimMemberList::ALIVE, 0), now);
+    m.Apply(Update("c", SwimMemberList::SUSPECT, 0), now);
+    m.Apply(Update("d", SwimMemberList::SUSPECT, 0), now + seconds(4));
+    BOOST_CHECK( m.GetLeader() == "d" );
+
+    std::vector<std::string> dead = m.Expire(now + seconds(5), seconds(3));
+    BOOST_REQUIRE_EQUAL( dead.size(), 1u );
+    BOOST_CHECK( dead[0] == "c" );
+    BOOST_CHECK( !m.IsMember("c") );
+    BOOST_CHECK( m.Expire(now + seconds(5), seconds(3)).empty() );
+
+    m.Expire(now + seconds(8), seconds(3));
+    std::vector<std::string> members = m.GetMembers();
+    BOOST_REQUIRE_EQUAL( members.size(), 2u );
+    BOOST_CHECK( members[0] == "a" && members[1] == "b" );
+    BOOST_CHECK( m.GetLeader() == "b" );
+}
+
+void test_gossip_is_bounded()
+{
+    SwimMemberList m("b");
+    ptime now(from_iso_string("20120101T000000"));
+
+    // Three members: each change is gossiped 3 log2(4) = 6 times at most.
+    m.Apply(Update("a", SwimMemberList::ALIVE, 0), now);
+    m.Apply(Update("c", SwimMemberList::ALIVE, 0), now);
+    unsigned int sent = 0;
+    for(unsigned int i = 0; i < 20; i++)
+    {
+        sent += m.Gossip(2).size();
+    }
+    BOOST_CHECK( sent > 0 );
+    BOOST_CHECK( sent <= 3 * 6 );
+    BOOST_CHECK( m.Gossip(2).empty() );
+
+    // The newest change goes out first.
+    m.Apply(Update("a", SwimMemberList::SUSPECT, 0), now);
+    std::vector<Update> gossip = m.Gossip(1);
+    BOOST_REQUIRE_EQUAL( gossip.size(), 1u );
+    BOOST_CHECK( gossip[0].uuid == "a" );
+    BOOST_CHECK( gossip[0].state == SwimMemberList::SUSPECT );
+}
+
+test_suite* init_unit_test_suite( int, char*[] )
+{
+    test_suite* test = BOOST_TEST_SUITE("SWIM Member List Tests");
+
+    test->add(BOOST_TEST_CASE(&test_newer_news_overrides));
+    test->add(BOOST_TEST_CASE(&test_refutes_news_about_itself));
+    test->add(BOOST_TEST_CASE(&test_suspicion_expires));
+    test->add(BOOST_TEST_CASE(&test_gossip_is_bounded));
+
+    return test;
+}